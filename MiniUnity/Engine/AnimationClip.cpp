@@ -0,0 +1,269 @@
+#include "AnimationClip.h"
+#include "MappedFile.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+namespace
+{
+    const char Magic[4] = { 'M', 'U', 'A', 'C' };
+
+    // the smallest three components of a unit quaternion are in [-1/sqrt(2), 1/sqrt(2)]
+    const float RotationRange = 0.70710678f;
+    const float RotationScale = 16383.0f / RotationRange;
+
+    struct FileHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t sourceHash;
+        uint64_t settingsHash;
+        uint32_t clipCount;
+        uint32_t reserved;
+    };
+
+    /// Followed by the clip name, the track names each with its terminator, the channels, the key frames and the key values.
+    struct ClipHeader
+    {
+        float sampleRate;
+        uint32_t frameCount;
+        uint32_t trackCount;
+        uint32_t keyCount;
+        uint32_t nameLength;
+        uint32_t trackNamesLength;
+        uint64_t sourceCurveBytes;
+    };
+
+    static_assert(sizeof(FileHeader) == 32, "FileHeader layout changed, bump AnimationClip::FormatVersion");
+    static_assert(sizeof(ClipHeader) == 32, "ClipHeader layout changed, bump AnimationClip::FormatVersion");
+    static_assert(sizeof(AnimationChannel) == 32, "AnimationChannel layout changed, bump AnimationClip::FormatVersion");
+
+    // bounds checked reads from the mapped file
+    class Reader
+    {
+    public:
+        Reader(const unsigned char* data, size_t size) : data(data), size(size) {}
+
+        bool Read(void* outData, size_t bytes)
+        {
+            if (bytes > size - offset) return false;
+            memcpy(outData, data + offset, bytes);
+            offset += bytes;
+            return true;
+        }
+
+        bool IsAtEnd() const { return offset == size; }
+
+    private:
+        const unsigned char* data;
+        size_t size;
+        size_t offset = 0;
+    };
+
+    void SampleChannel(const AnimationClip& clip, const AnimationChannel& channel, AnimationClip::ChannelType type, float frame, float out[4])
+    {
+        const uint16_t* frames = clip.keyFrames.data() + channel.firstKey;
+        const uint16_t* values = clip.keyValues.data() + (size_t)channel.firstKey * 3;
+
+        // first key after the frame, the frame numbers of a channel are a few hundred bytes at most
+        const uint32_t next = (uint32_t)(std::upper_bound(frames, frames + channel.keyCount, (uint16_t)frame) - frames);
+        if (next == 0 || next == channel.keyCount) {
+            AnimationClip::DecodeKey(channel, type, values + (next == 0 ? 0 : (size_t)(channel.keyCount - 1) * 3), out);
+            return;
+        }
+
+        float a[4];
+        float b[4];
+        AnimationClip::DecodeKey(channel, type, values + (size_t)(next - 1) * 3, a);
+        AnimationClip::DecodeKey(channel, type, values + (size_t)next * 3, b);
+        const float alpha = (frame - frames[next - 1]) / (float)(frames[next] - frames[next - 1]);
+        AnimationClip::Interpolate(type, a, b, alpha, out);
+    }
+}
+
+size_t AnimationClip::GetMemorySize() const
+{
+    return channels.size() * sizeof(AnimationChannel) + keyFrames.size() * sizeof(uint16_t) + keyValues.size() * sizeof(uint16_t);
+}
+
+void AnimationClip::Sample(float time, BonePose* outPoses) const
+{
+    float frame = time * sampleRate;
+    if (!(frame > 0.0f)) frame = 0.0f;
+    if (frame > (float)(frameCount ? frameCount - 1 : 0)) frame = (float)(frameCount ? frameCount - 1 : 0);
+
+    float value[4];
+    for (unsigned int track = 0; track < GetTrackCount(); ++track) {
+        const AnimationChannel* trackChannels = &channels[(size_t)track * ChannelCount];
+        BonePose& pose = outPoses[track];
+
+        SampleChannel(*this, trackChannels[Translation], Translation, frame, value);
+        memcpy(pose.translation, value, sizeof(pose.translation));
+        SampleChannel(*this, trackChannels[Rotation], Rotation, frame, value);
+        memcpy(pose.rotation, value, sizeof(pose.rotation));
+        SampleChannel(*this, trackChannels[Scale], Scale, frame, value);
+        memcpy(pose.scale, value, sizeof(pose.scale));
+    }
+}
+
+void AnimationClip::DecodeKey(const AnimationChannel& channel, ChannelType type, const uint16_t* value, float out[4])
+{
+    if (type == Rotation) {
+        UnpackRotation(value, out);
+        return;
+    }
+    for (int i = 0; i < 3; ++i) {
+        out[i] = channel.rangeMin[i] + channel.rangeExtent[i] * (value[i] * (1.0f / 65535.0f));
+    }
+}
+
+void AnimationClip::Interpolate(ChannelType type, const float a[4], const float b[4], float alpha, float out[4])
+{
+    if (type != Rotation) {
+        for (int i = 0; i < 3; ++i) out[i] = a[i] + (b[i] - a[i]) * alpha;
+        return;
+    }
+
+    // nlerp along the shortest arc, the packing doesn't keep the sign of consecutive keys
+    const float sign = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3] < 0.0f ? -1.0f : 1.0f;
+    float lengthSquared = 0.0f;
+    for (int i = 0; i < 4; ++i) {
+        out[i] = a[i] + (b[i] * sign - a[i]) * alpha;
+        lengthSquared += out[i] * out[i];
+    }
+    const float invLength = 1.0f / sqrtf(lengthSquared);
+    for (int i = 0; i < 4; ++i) out[i] *= invLength;
+}
+
+void AnimationClip::PackRotation(const float rotation[4], uint16_t outPacked[3])
+{
+    int largest = 0;
+    for (int i = 1; i < 4; ++i) {
+        if (fabsf(rotation[i]) > fabsf(rotation[largest])) largest = i;
+    }
+
+    // q and -q are the same rotation, flip it so the dropped component is positive
+    const float sign = rotation[largest] < 0.0f ? -1.0f : 1.0f;
+    uint16_t values[3];
+    for (int i = 0, j = 0; i < 4; ++i) {
+        if (i == largest) continue;
+        float value = rotation[i] * sign;
+        value = value < -RotationRange ? -RotationRange : (value > RotationRange ? RotationRange : value);
+        values[j++] = (uint16_t)lrintf(value * RotationScale + 16383.0f);
+    }
+
+    // 15 bits per component, the low bits of the first two hold the index of the dropped one
+    outPacked[0] = (uint16_t)((values[0] << 1) | (largest & 1));
+    outPacked[1] = (uint16_t)((values[1] << 1) | (largest >> 1));
+    outPacked[2] = (uint16_t)(values[2] << 1);
+}
+
+void AnimationClip::UnpackRotation(const uint16_t packed[3], float outRotation[4])
+{
+    const int largest = (packed[0] & 1) | ((packed[1] & 1) << 1);
+    float sumSquared = 0.0f;
+    for (int i = 0, j = 0; i < 4; ++i) {
+        if (i == largest) continue;
+        outRotation[i] = ((packed[j++] >> 1) - 16383.0f) / RotationScale;
+        sumSquared += outRotation[i] * outRotation[i];
+    }
+    outRotation[largest] = sqrtf(sumSquared < 1.0f ? 1.0f - sumSquared : 0.0f);
+}
+
+bool AnimationClip::Load(const char* filepath, uint64_t sourceHash, uint64_t settingsHash, std::vector<AnimationClip>& outClips)
+{
+    MappedFile file;
+    if (!file.Open(filepath)) return false;
+    Reader reader(file.GetData(), file.GetSize());
+
+    FileHeader header;
+    if (!reader.Read(&header, sizeof(header))) return false;
+    if (memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != FormatVersion) return false;
+    if (header.sourceHash != sourceHash || header.settingsHash != settingsHash) return false;
+    if (header.clipCount > file.GetSize() / sizeof(ClipHeader)) return false;
+
+    std::vector<AnimationClip> clips(header.clipCount);
+    for (AnimationClip& clip : clips) {
+        ClipHeader clipHeader;
+        if (!reader.Read(&clipHeader, sizeof(clipHeader))) return false;
+        if (clipHeader.trackNamesLength < clipHeader.trackCount || clipHeader.trackNamesLength > file.GetSize()) return false;
+        if (clipHeader.nameLength > file.GetSize() || clipHeader.keyCount > file.GetSize() / 8) return false;
+        if (clipHeader.trackCount > file.GetSize() / (ChannelCount * sizeof(AnimationChannel))) return false;
+
+        clip.sampleRate = clipHeader.sampleRate;
+        clip.frameCount = clipHeader.frameCount;
+        clip.sourceCurveBytes = clipHeader.sourceCurveBytes;
+
+        clip.name.resize(clipHeader.nameLength);
+        std::vector<char> trackNames(clipHeader.trackNamesLength);
+        clip.channels.resize((size_t)clipHeader.trackCount * ChannelCount);
+        clip.keyFrames.resize(clipHeader.keyCount);
+        clip.keyValues.resize((size_t)clipHeader.keyCount * 3);
+
+        bool read = reader.Read(&clip.name[0], clip.name.size());
+        read = read && reader.Read(trackNames.data(), trackNames.size());
+        read = read && reader.Read(clip.channels.data(), clip.channels.size() * sizeof(AnimationChannel));
+        read = read && reader.Read(clip.keyFrames.data(), clip.keyFrames.size() * sizeof(uint16_t));
+        read = read && reader.Read(clip.keyValues.data(), clip.keyValues.size() * sizeof(uint16_t));
+        if (!read || (!trackNames.empty() && trackNames.back() != '\0')) return false;
+
+        for (size_t begin = 0; begin < trackNames.size(); begin += clip.trackNames.back().size() + 1) {
+            clip.trackNames.push_back(&trackNames[begin]);
+        }
+        if (clip.trackNames.size() != clipHeader.trackCount) return false;
+
+        // a corrupted channel would make Sample read out of the key arrays
+        for (const AnimationChannel& channel : clip.channels) {
+            if (channel.keyCount == 0 || channel.firstKey > clipHeader.keyCount || channel.keyCount > clipHeader.keyCount - channel.firstKey) return false;
+        }
+    }
+    if (!reader.IsAtEnd()) return false;
+
+    outClips = std::move(clips);
+    return true;
+}
+
+bool AnimationClip::Save(const char* filepath, uint64_t sourceHash, uint64_t settingsHash, const std::vector<AnimationClip>& clips)
+{
+    FileHeader header = {};
+    memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = FormatVersion;
+    header.sourceHash = sourceHash;
+    header.settingsHash = settingsHash;
+    header.clipCount = (uint32_t)clips.size();
+
+    FILE* file = nullptr;
+#ifdef _WIN32
+    if (fopen_s(&file, filepath, "wb") != 0) return false;
+#else
+    file = fopen(filepath, "wb");
+    if (!file) return false;
+#endif
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (const AnimationClip& clip : clips) {
+        std::string trackNames;
+        for (const std::string& trackName : clip.trackNames) trackNames.append(trackName.c_str(), trackName.size() + 1);
+
+        ClipHeader clipHeader = {};
+        clipHeader.sampleRate = clip.sampleRate;
+        clipHeader.frameCount = clip.frameCount;
+        clipHeader.trackCount = clip.GetTrackCount();
+        clipHeader.keyCount = (uint32_t)clip.keyFrames.size();
+        clipHeader.nameLength = (uint32_t)clip.name.size();
+        clipHeader.trackNamesLength = (uint32_t)trackNames.size();
+        clipHeader.sourceCurveBytes = clip.sourceCurveBytes;
+
+        written = written && fwrite(&clipHeader, sizeof(clipHeader), 1, file) == 1;
+        written = written && fwrite(clip.name.data(), 1, clip.name.size(), file) == clip.name.size();
+        written = written && fwrite(trackNames.data(), 1, trackNames.size(), file) == trackNames.size();
+        written = written && fwrite(clip.channels.data(), sizeof(AnimationChannel), clip.channels.size(), file) == clip.channels.size();
+        written = written && fwrite(clip.keyFrames.data(), sizeof(uint16_t), clip.keyFrames.size(), file) == clip.keyFrames.size();
+        written = written && fwrite(clip.keyValues.data(), sizeof(uint16_t), clip.keyValues.size(), file) == clip.keyValues.size();
+    }
+    written = fclose(file) == 0 && written;
+
+    if (!written) remove(filepath);
+    return written;
+}
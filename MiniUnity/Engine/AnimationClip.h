@@ -0,0 +1,68 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/// Local transform of a bone, rotation is a unit quaternion x, y, z, w.
+struct BonePose
+{
+    float translation[3];
+    float rotation[4];
+    float scale[3];
+};
+
+/// Key range of one channel of a track in the key arrays of the clip.
+/// Values are dequantized as rangeMin + rangeExtent * value / 65535, rotations ignore the range.
+struct AnimationChannel
+{
+    uint32_t firstKey;
+    uint32_t keyCount;
+    float rangeMin[3];
+    float rangeExtent[3];
+};
+
+/// Compressed animation of a set of bones, sampled at a fixed rate with the redundant keys removed.
+/// Every track has a translation, a rotation and a scale channel. The keys of a channel are contiguous,
+/// their frame numbers in keyFrames and three 16 bit values each in keyValues:
+/// translations and scales are normalized in the channel range, rotations are smallest-three quaternions.
+class AnimationClip
+{
+public:
+    enum ChannelType { Translation, Rotation, Scale, ChannelCount };
+
+    static const uint32_t FormatVersion = 1;
+
+    std::string name;
+    float sampleRate = 30.0f;
+    uint32_t frameCount = 0;
+    /// Bone name of each track.
+    std::vector<std::string> trackNames;
+    /// ChannelCount per track.
+    std::vector<AnimationChannel> channels;
+    std::vector<uint16_t> keyFrames;
+    std::vector<uint16_t> keyValues;
+    /// Bytes of the OpenFBX curves the clip was baked from, for the import stats.
+    uint64_t sourceCurveBytes = 0;
+
+    unsigned int GetTrackCount() const { return (unsigned int)trackNames.size(); }
+    float GetDuration() const { return frameCount > 1 ? (frameCount - 1) / sampleRate : 0.0f; }
+    /// Bytes used by the keys and the channels, names excluded.
+    size_t GetMemorySize() const;
+
+    /// Writes the pose of every track at `time`, clamped to the clip, to outPoses[0..GetTrackCount()).
+    void Sample(float time, BonePose* outPoses) const;
+
+    /// Value of a key of the channel, xyz or a quaternion for rotations.
+    static void DecodeKey(const AnimationChannel& channel, ChannelType type, const uint16_t* value, float out[4]);
+    /// Interpolation between two keys, nlerp along the shortest arc for rotations.
+    static void Interpolate(ChannelType type, const float a[4], const float b[4], float alpha, float out[4]);
+
+    /// Smallest-three encoding: the index of the largest component and the other three in 15 bits each.
+    static void PackRotation(const float rotation[4], uint16_t outPacked[3]);
+    static void UnpackRotation(const uint16_t packed[3], float outRotation[4]);
+
+    /// Cooked clips of one source file, with the same staleness checks as MeshCache.
+    static bool Load(const char* filepath, uint64_t sourceHash, uint64_t settingsHash, std::vector<AnimationClip>& outClips);
+    static bool Save(const char* filepath, uint64_t sourceHash, uint64_t settingsHash, const std::vector<AnimationClip>& clips);
+};
@@ -0,0 +1,191 @@
+#include "AnimationCompressor.h"
+#include <math.h>
+#include <string.h>
+
+namespace
+{
+    // frames are stored in 16 bits
+    const uint32_t MaxFrameCount = 65536;
+    // bounds the cost of the key reduction, which checks every frame between two candidate keys
+    const uint32_t MaxKeySpacing = 255;
+
+    const float* GetChannelValue(const BonePose& pose, AnimationClip::ChannelType type)
+    {
+        switch (type) {
+        case AnimationClip::Translation: return pose.translation;
+        case AnimationClip::Rotation: return pose.rotation;
+        default: return pose.scale;
+        }
+    }
+
+    // euclidean distance for translations, angle for rotations, largest axis difference for scales
+    float Difference(AnimationClip::ChannelType type, const float* a, const float* b)
+    {
+        if (type == AnimationClip::Rotation) {
+            // in double, the cosine of small tolerances is too close to 1 for a float
+            double dot = fabs((double)a[0] * b[0] + (double)a[1] * b[1] + (double)a[2] * b[2] + (double)a[3] * b[3]);
+            double length = sqrt(((double)a[0] * a[0] + (double)a[1] * a[1] + (double)a[2] * a[2] + (double)a[3] * a[3])
+                * ((double)b[0] * b[0] + (double)b[1] * b[1] + (double)b[2] * b[2] + (double)b[3] * b[3]));
+            dot = length > 0.0 ? dot / length : 1.0;
+            return (float)(2.0 * acos(dot < 1.0 ? dot : 1.0) * 57.29577951308232);
+        }
+        if (type == AnimationClip::Translation) {
+            const float x = a[0] - b[0], y = a[1] - b[1], z = a[2] - b[2];
+            return sqrtf(x * x + y * y + z * z);
+        }
+        float largest = 0.0f;
+        for (int i = 0; i < 3; ++i) {
+            if (fabsf(a[i] - b[i]) > largest) largest = fabsf(a[i] - b[i]);
+        }
+        return largest;
+    }
+
+    float GetTolerance(const AnimationCompressionSettings& settings, AnimationClip::ChannelType type)
+    {
+        switch (type) {
+        case AnimationClip::Translation: return settings.translationTolerance;
+        case AnimationClip::Rotation: return settings.rotationToleranceDegrees;
+        default: return settings.scaleTolerance;
+        }
+    }
+
+    void Quantize(AnimationChannel& channel, AnimationClip::ChannelType type, const float* value, uint16_t outValue[3])
+    {
+        if (type == AnimationClip::Rotation) {
+            AnimationClip::PackRotation(value, outValue);
+            return;
+        }
+        for (int i = 0; i < 3; ++i) {
+            const float normalized = channel.rangeExtent[i] > 0.0f ? (value[i] - channel.rangeMin[i]) / channel.rangeExtent[i] : 0.0f;
+            outValue[i] = (uint16_t)lrintf((normalized < 0.0f ? 0.0f : (normalized > 1.0f ? 1.0f : normalized)) * 65535.0f);
+        }
+    }
+
+    // the baked frames of a channel, quantized and decoded back so the reduction sees the final values
+    struct ChannelFrames
+    {
+        std::vector<float> source;
+        std::vector<uint16_t> quantized;
+        std::vector<float> decoded;
+    };
+
+    // true when interpolating between the keys at `first` and `last` stays within the tolerance of every frame in between
+    bool IsSegmentWithinTolerance(const ChannelFrames& frames, AnimationClip::ChannelType type, uint32_t first, uint32_t last, float tolerance)
+    {
+        float value[4];
+        for (uint32_t frame = first + 1; frame < last; ++frame) {
+            const float alpha = (float)(frame - first) / (float)(last - first);
+            AnimationClip::Interpolate(type, &frames.decoded[(size_t)first * 4], &frames.decoded[(size_t)last * 4], alpha, value);
+            if (Difference(type, value, &frames.source[(size_t)frame * 4]) > tolerance) return false;
+        }
+        return true;
+    }
+
+    void CompressChannel(const BakedAnimation& animation, unsigned int track, AnimationClip::ChannelType type,
+        const AnimationCompressionSettings& settings, AnimationClip& clip)
+    {
+        const uint32_t frameCount = animation.frameCount;
+        const int componentCount = type == AnimationClip::Rotation ? 4 : 3;
+
+        AnimationChannel channel = {};
+        ChannelFrames frames;
+        frames.source.resize((size_t)frameCount * 4, 0.0f);
+        for (uint32_t frame = 0; frame < frameCount; ++frame) {
+            memcpy(&frames.source[(size_t)frame * 4], GetChannelValue(animation.GetPose(track, frame), type), componentCount * sizeof(float));
+        }
+
+        if (type != AnimationClip::Rotation) {
+            for (int i = 0; i < 3; ++i) {
+                float minimum = frames.source[i];
+                float maximum = frames.source[i];
+                for (uint32_t frame = 1; frame < frameCount; ++frame) {
+                    const float value = frames.source[(size_t)frame * 4 + i];
+                    minimum = value < minimum ? value : minimum;
+                    maximum = value > maximum ? value : maximum;
+                }
+                channel.rangeMin[i] = minimum;
+                channel.rangeExtent[i] = maximum - minimum;
+            }
+        }
+
+        frames.quantized.resize((size_t)frameCount * 3);
+        frames.decoded.resize((size_t)frameCount * 4);
+        for (uint32_t frame = 0; frame < frameCount; ++frame) {
+            Quantize(channel, type, &frames.source[(size_t)frame * 4], &frames.quantized[(size_t)frame * 3]);
+            AnimationClip::DecodeKey(channel, type, &frames.quantized[(size_t)frame * 3], &frames.decoded[(size_t)frame * 4]);
+        }
+
+        const float tolerance = GetTolerance(settings, type);
+        std::vector<uint32_t> keys(1, 0);
+
+        // constant channels, most scales and many translations, keep a single key
+        bool constant = true;
+        for (uint32_t frame = 1; frame < frameCount && constant; ++frame) {
+            constant = Difference(type, &frames.decoded[0], &frames.source[(size_t)frame * 4]) <= tolerance;
+        }
+
+        if (!constant && frameCount > 1) {
+            // greedy: extend each segment as long as the frames it skips stay within the tolerance
+            uint32_t first = 0;
+            uint32_t last = 1;
+            while (last < frameCount - 1) {
+                if (last + 1 - first <= MaxKeySpacing && IsSegmentWithinTolerance(frames, type, first, last + 1, tolerance)) {
+                    ++last;
+                    continue;
+                }
+                keys.push_back(last);
+                first = last;
+                last = first + 1;
+            }
+            keys.push_back(frameCount - 1);
+        }
+
+        channel.firstKey = (uint32_t)clip.keyFrames.size();
+        channel.keyCount = (uint32_t)keys.size();
+        for (uint32_t key : keys) {
+            clip.keyFrames.push_back((uint16_t)key);
+            clip.keyValues.insert(clip.keyValues.end(), &frames.quantized[(size_t)key * 3], &frames.quantized[(size_t)key * 3] + 3);
+        }
+        clip.channels.push_back(channel);
+    }
+}
+
+bool AnimationCompressor::Compress(const BakedAnimation& animation, const AnimationCompressionSettings& settings, AnimationClip& outClip)
+{
+    if (animation.frameCount == 0 || animation.frameCount > MaxFrameCount) return false;
+    if (animation.poses.size() != (size_t)animation.frameCount * animation.trackNames.size()) return false;
+
+    AnimationClip clip;
+    clip.name = animation.name;
+    clip.sampleRate = animation.sampleRate;
+    clip.frameCount = animation.frameCount;
+    clip.trackNames = animation.trackNames;
+
+    for (unsigned int track = 0; track < clip.GetTrackCount(); ++track) {
+        CompressChannel(animation, track, AnimationClip::Translation, settings, clip);
+        CompressChannel(animation, track, AnimationClip::Rotation, settings, clip);
+        CompressChannel(animation, track, AnimationClip::Scale, settings, clip);
+    }
+
+    outClip = std::move(clip);
+    return true;
+}
+
+AnimationCompressionError AnimationCompressor::MeasureError(const BakedAnimation& animation, const AnimationClip& clip)
+{
+    AnimationCompressionError error;
+    std::vector<BonePose> poses(clip.GetTrackCount());
+    for (uint32_t frame = 0; frame < animation.frameCount && frame < clip.frameCount; ++frame) {
+        clip.Sample(frame / clip.sampleRate, poses.data());
+        for (unsigned int track = 0; track < clip.GetTrackCount(); ++track) {
+            const BonePose& source = animation.GetPose(track, frame);
+            const float translation = Difference(AnimationClip::Translation, poses[track].translation, source.translation);
+            const float rotation = Difference(AnimationClip::Rotation, poses[track].rotation, source.rotation);
+            const float scale = Difference(AnimationClip::Scale, poses[track].scale, source.scale);
+            error.translation = translation > error.translation ? translation : error.translation;
+            error.rotationDegrees = rotation > error.rotationDegrees ? rotation : error.rotationDegrees;
+            error.scale = scale > error.scale ? scale : error.scale;
+        }
+    }
+    return error;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "AnimationClip.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/// Animation sampled at a fixed rate before compression, one pose per track and frame.
+struct BakedAnimation
+{
+    std::string name;
+    float sampleRate = 30.0f;
+    uint32_t frameCount = 0;
+    std::vector<std::string> trackNames;
+    /// Track after track, frameCount poses each.
+    std::vector<BonePose> poses;
+
+    const BonePose& GetPose(unsigned int track, unsigned int frame) const { return poses[(size_t)track * frameCount + frame]; }
+};
+
+/// Largest difference allowed between the baked and the compressed animation when removing keys.
+/// Quantization alone can exceed tolerances smaller than its precision.
+struct AnimationCompressionSettings
+{
+    /// In scene units.
+    float translationTolerance = 0.001f;
+    float rotationToleranceDegrees = 0.05f;
+    float scaleTolerance = 0.0001f;
+};
+
+/// Largest difference between the baked and the compressed animation over all the frames.
+struct AnimationCompressionError
+{
+    float translation = 0.0f;
+    float rotationDegrees = 0.0f;
+    float scale = 0.0f;
+};
+
+/// Turns baked animations into AnimationClip: every channel is quantized, then only the keys
+/// needed to stay within the tolerances from the baked frames are kept.
+class AnimationCompressor
+{
+public:
+    /// Fails when the animation has more frames than AnimationClip can address.
+    static bool Compress(const BakedAnimation& animation, const AnimationCompressionSettings& settings, AnimationClip& outClip);
+
+    static AnimationCompressionError MeasureError(const BakedAnimation& animation, const AnimationClip& clip);
+};
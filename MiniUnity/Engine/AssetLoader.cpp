@@ -0,0 +1,350 @@
+#include "AssetLoader.h"
+#include "JobSystem.h"
+#include "MappedFile.h"
+#include "MeshCache.h"
+#include <SFML/Graphics/Image.hpp>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+    // buffers are uploaded in slices so one big mesh can be spread over several frames
+    const size_t UploadSliceBytes = 256 * 1024;
+
+    bool ReadText(const std::string& filepath, std::string& outText)
+    {
+        std::ifstream file(filepath);
+        if (!file.is_open()) return false;
+        std::stringstream text;
+        text << file.rdbuf();
+        outText = text.str();
+        return true;
+    }
+
+    // the store is allocated right away and filled by the upload slices
+    void CreateTextureBuffer(GLenum format, size_t bytes, GLuint& outBuffer, GLuint& outTexture)
+    {
+        glGenBuffers(1, &outBuffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, outBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, bytes, nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        glGenTextures(1, &outTexture);
+        glBindTexture(GL_TEXTURE_BUFFER, outTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, format, outBuffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+
+    float MillisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // the decoded pixels only live until the texture is cooked
+    bool DecodeAndCook(const void* data, size_t size, const TextureCookSettings& settings, CookedTexture& outTexture, TextureCookStats& stats)
+    {
+        auto decodeStart = std::chrono::steady_clock::now();
+        sf::Image image;
+        if (!image.loadFromMemory(data, size) || image.getSize().x == 0 || image.getSize().y == 0) return false;
+        stats.decodeMilliseconds += MillisecondsSince(decodeStart);
+
+        auto cookStart = std::chrono::steady_clock::now();
+        TextureCooker::Cook(image.getPixelsPtr(), image.getSize().x, image.getSize().y, settings, outTexture);
+        stats.cookMilliseconds += MillisecondsSince(cookStart);
+        stats.uncookedBytes += TextureCooker::GetUncookedSize(image.getSize().x, image.getSize().y);
+        stats.cookedBytes += outTexture.GetMemorySize();
+        return true;
+    }
+
+    struct DecodeJob
+    {
+        const ImportedTexture* texture;
+        const TextureCookSettings* settings;
+        CookedTexture* cooked;
+        TextureCookStats stats;
+        bool decoded;
+    };
+
+    void DecodeImage(void* data)
+    {
+        DecodeJob& job = *(DecodeJob*)data;
+        const std::vector<uint8_t>& bytes = job.texture->encodedImage;
+        job.decoded = DecodeAndCook(bytes.data(), bytes.size(), *job.settings, *job.cooked, job.stats);
+    }
+}
+
+AssetLoader::~AssetLoader()
+{
+    // the jobs write into the assets, they can't go before them
+    while (jobsInFlight.load(std::memory_order_acquire) != 0)
+        std::this_thread::yield();
+}
+
+AssetLoader::Handle AssetLoader::LoadMesh(const char* filepath, const FbxImportSettings& settings)
+{
+    Handle handle = Queue(AssetType::Mesh, filepath);
+    assets[handle]->importSettings = settings;
+    JobSystem::Dispatch(&AssetLoader::LoadJob, assets[handle].get());
+    return handle;
+}
+
+AssetLoader::Handle AssetLoader::LoadTexture(const char* filepath, const TextureCookSettings& settings)
+{
+    Handle handle = Queue(AssetType::Texture, filepath);
+    assets[handle]->cookSettings = settings;
+    JobSystem::Dispatch(&AssetLoader::LoadJob, assets[handle].get());
+    return handle;
+}
+
+AssetLoader::Handle AssetLoader::LoadFbxTextures(const char* filepath, const TextureCookSettings& settings)
+{
+    Handle handle = Queue(AssetType::FbxTextures, filepath);
+    assets[handle]->cookSettings = settings;
+    JobSystem::Dispatch(&AssetLoader::LoadJob, assets[handle].get());
+    return handle;
+}
+
+AssetLoader::Handle AssetLoader::LoadText(const char* filepath)
+{
+    Handle handle = Queue(AssetType::Text, filepath);
+    JobSystem::Dispatch(&AssetLoader::LoadJob, assets[handle].get());
+    return handle;
+}
+
+AssetLoader::Handle AssetLoader::LoadAnimations(const char* filepath, const AnimationImportSettings& settings)
+{
+    Handle handle = Queue(AssetType::Animations, filepath);
+    assets[handle]->animationSettings = settings;
+    JobSystem::Dispatch(&AssetLoader::LoadJob, assets[handle].get());
+    return handle;
+}
+
+AssetLoader::Handle AssetLoader::Queue(AssetType type, const char* filepath)
+{
+    std::unique_ptr<Asset> asset(new Asset());
+    asset->owner = this;
+    asset->type = type;
+    asset->path = filepath;
+    assets.push_back(std::move(asset));
+    jobsInFlight.fetch_add(1);
+    return (Handle)(assets.size() - 1);
+}
+
+void AssetLoader::LoadJob(void* data)
+{
+    Asset& asset = *(Asset*)data;
+    auto loadStart = std::chrono::steady_clock::now();
+
+    bool loaded = false;
+    switch (asset.type) {
+    case AssetType::Mesh:
+        loaded = FbxImporter::ImportFBX(asset.path.c_str(), asset.mesh, asset.importSettings, &asset.meshStats, &asset.error);
+        break;
+    case AssetType::Texture:
+        loaded = LoadTextureJob(asset);
+        break;
+    case AssetType::FbxTextures:
+        loaded = LoadFbxTexturesJob(asset);
+        break;
+    case AssetType::Text:
+        loaded = ReadText(asset.path, asset.text);
+        break;
+    case AssetType::Animations:
+        loaded = FbxImporter::ImportAnimations(asset.path.c_str(), asset.clips, asset.animationSettings, &asset.animationStats, &asset.error);
+        break;
+    }
+    asset.loadMilliseconds = MillisecondsSince(loadStart);
+    // the state belongs to the GL thread, it reads this once the asset is handed over
+    asset.loadFailed = !loaded;
+
+    AssetLoader* owner = asset.owner;
+    {
+        std::lock_guard<std::mutex> lock(owner->loadedMutex);
+        owner->loaded.push_back(&asset);
+    }
+    owner->jobsInFlight.fetch_sub(1, std::memory_order_release);
+}
+
+bool AssetLoader::LoadTextureJob(Asset& asset)
+{
+    MappedFile file;
+    if (!file.Open(asset.path.c_str())) return false;
+    const TextureCookSettings& settings = asset.cookSettings;
+    asset.cookedTextures.resize(1);
+    CookedTexture& cooked = asset.cookedTextures[0];
+
+    uint64_t sourceHash = 0;
+    uint64_t settingsHash = 0;
+    const std::string cachePath = asset.path + ".mutex";
+    if (settings.useTextureCache) {
+        sourceHash = MeshCache::Hash(file.GetData(), file.GetSize());
+        settingsHash = TextureCooker::HashSettings(settings);
+        if (CookedTexture::Load(cachePath.c_str(), sourceHash, settingsHash, cooked)) {
+            asset.cookStats.loadedFromCache = true;
+            asset.cookStats.uncookedBytes = TextureCooker::GetUncookedSize(cooked.GetWidth(), cooked.GetHeight());
+            asset.cookStats.cookedBytes = cooked.GetMemorySize();
+            return true;
+        }
+    }
+
+    if (!DecodeAndCook(file.GetData(), file.GetSize(), settings, cooked, asset.cookStats)) return false;
+    if (settings.useTextureCache) CookedTexture::Save(cachePath.c_str(), sourceHash, settingsHash, cooked);
+    return true;
+}
+
+bool AssetLoader::LoadFbxTexturesJob(Asset& asset)
+{
+    std::vector<ImportedTexture> textures;
+    if (!FbxImporter::ImportTextures(asset.path.c_str(), textures, &asset.textureStats, &asset.error)) return false;
+
+    // the images are decoded and cooked on every worker, nested in this job like the arrays of ofbx::load
+    std::vector<CookedTexture> cooked(textures.size());
+    std::vector<DecodeJob> jobs(textures.size());
+    for (size_t i = 0; i < textures.size(); ++i) jobs[i] = { &textures[i], &asset.cookSettings, &cooked[i], TextureCookStats(), false };
+    JobSystem::ParallelFor(&DecodeImage, jobs.data(), sizeof(DecodeJob), (unsigned int)jobs.size());
+
+    for (size_t i = 0; i < textures.size(); ++i) {
+        if (!jobs[i].decoded) {
+            TextureImportStats& stats = asset.textureStats;
+            if (textures[i].embedded) --stats.embeddedCount;
+            else --stats.referencedCount;
+            ++stats.missingCount;
+            continue;
+        }
+        TextureCookStats& stats = asset.cookStats;
+        stats.decodeMilliseconds += jobs[i].stats.decodeMilliseconds;
+        stats.cookMilliseconds += jobs[i].stats.cookMilliseconds;
+        stats.uncookedBytes += jobs[i].stats.uncookedBytes;
+        stats.cookedBytes += jobs[i].stats.cookedBytes;
+        textures[i].encodedImage = std::vector<uint8_t>();
+        asset.fbxTextures.push_back(std::move(textures[i]));
+        asset.cookedTextures.push_back(std::move(cooked[i]));
+    }
+    return true;
+}
+
+void AssetLoader::Update(float budgetMilliseconds)
+{
+    {
+        std::lock_guard<std::mutex> lock(loadedMutex);
+        for (Asset* asset : loaded) {
+            if (asset->loadFailed) {
+                asset->state = AssetState::Failed;
+                continue;
+            }
+            asset->state = AssetState::Uploading;
+            uploads.push_back(asset);
+        }
+        loaded.clear();
+    }
+
+    auto updateStart = std::chrono::steady_clock::now();
+    while (!uploads.empty()) {
+        if (UploadStep(*uploads.front())) {
+            uploads.front()->state = AssetState::Ready;
+            uploads.pop_front();
+        }
+        if (MillisecondsSince(updateStart) >= budgetMilliseconds) break;
+    }
+}
+
+unsigned int AssetLoader::GetPendingCount() const
+{
+    unsigned int pending = 0;
+    for (const std::unique_ptr<Asset>& asset : assets) {
+        if (asset->state == AssetState::Loading || asset->state == AssetState::Uploading) ++pending;
+    }
+    return pending;
+}
+
+bool AssetLoader::UploadStep(Asset& asset)
+{
+    switch (asset.type) {
+    case AssetType::Mesh: {
+        const ImportedMesh& mesh = asset.mesh;
+        const bool quantized = !mesh.quantizedVertices.empty();
+        const unsigned char* vertices = quantized ? (const unsigned char*)mesh.quantizedVertices.data() : (const unsigned char*)mesh.vertices.data();
+        const size_t vertexBytes = quantized ? mesh.quantizedVertices.size() * sizeof(QuantizedVertex) : mesh.vertices.size() * sizeof(GLfloat);
+        const size_t skinBytes = mesh.skinVertices.size() * sizeof(SkinVertex);
+        const size_t indexBytes = mesh.indices.size() * sizeof(GLuint);
+        const size_t morphStartBytes = mesh.morphStarts.size() * sizeof(uint32_t);
+        const size_t morphDeltaBytes = mesh.morphDeltas.size() * sizeof(MorphDelta);
+
+        if (asset.vertexBuffer == 0) {
+            asset.skinVertexOffset = vertexBytes;
+            glGenBuffers(1, &asset.vertexBuffer);
+            glBindBuffer(GL_ARRAY_BUFFER, asset.vertexBuffer);
+            glBufferData(GL_ARRAY_BUFFER, vertexBytes + skinBytes, nullptr, GL_STATIC_DRAW);
+            glGenBuffers(1, &asset.indexBuffer);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, asset.indexBuffer);
+            glBufferData(GL_COPY_WRITE_BUFFER, indexBytes, nullptr, GL_STATIC_DRAW);
+            if (mesh.HasMorphTargets()) {
+                CreateTextureBuffer(GL_R32UI, morphStartBytes, asset.morphStartBuffer, asset.morphStartTexture);
+                CreateTextureBuffer(GL_RGBA16I, morphDeltaBytes, asset.morphDeltaBuffer, asset.morphDeltaTexture);
+            }
+        }
+
+        // the index buffer goes through GL_COPY_WRITE_BUFFER so no VAO gets it bound as element buffer
+        struct Source { GLenum target; GLuint buffer; size_t bufferOffset; const unsigned char* data; size_t bytes; };
+        const Source sources[] = {
+            { GL_ARRAY_BUFFER, asset.vertexBuffer, 0, vertices, vertexBytes },
+            { GL_ARRAY_BUFFER, asset.vertexBuffer, vertexBytes, (const unsigned char*)mesh.skinVertices.data(), skinBytes },
+            { GL_COPY_WRITE_BUFFER, asset.indexBuffer, 0, (const unsigned char*)mesh.indices.data(), indexBytes },
+            { GL_TEXTURE_BUFFER, asset.morphStartBuffer, 0, (const unsigned char*)mesh.morphStarts.data(), morphStartBytes },
+            { GL_TEXTURE_BUFFER, asset.morphDeltaBuffer, 0, (const unsigned char*)mesh.morphDeltas.data(), morphDeltaBytes },
+        };
+
+        // a slice never crosses two sources, the next step starts the following one
+        size_t sourceStart = 0;
+        for (const Source& source : sources) {
+            if (asset.uploadedBytes < sourceStart + source.bytes) {
+                const size_t offset = asset.uploadedBytes - sourceStart;
+                const size_t sliceBytes = std::min(UploadSliceBytes, source.bytes - offset);
+                glBindBuffer(source.target, source.buffer);
+                glBufferSubData(source.target, source.bufferOffset + offset, sliceBytes, source.data + offset);
+                glBindBuffer(source.target, 0);
+                asset.uploadedBytes += sliceBytes;
+                break;
+            }
+            sourceStart += source.bytes;
+        }
+        return asset.uploadedBytes >= vertexBytes + skinBytes + indexBytes + morphStartBytes + morphDeltaBytes;
+    }
+    case AssetType::Texture:
+    case AssetType::FbxTextures: {
+        // a texture per step, the ones left wait for the next steps
+        if (asset.textures.size() == asset.cookedTextures.size()) return true;
+        CookedTexture& cooked = asset.cookedTextures[asset.textures.size()];
+        // cooked BC1 before any context could tell, the driver takes the decoded texels instead
+        if (cooked.format == TextureFormat::BC1 && !GLEW_EXT_texture_compression_s3tc) cooked.DecompressBC1();
+        GLuint texture = 0;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        // the levels are laid out the way GL takes them, one call each
+        for (unsigned int i = 0; i < cooked.GetLevelCount(); ++i) {
+            const TextureLevel& level = cooked.levels[i];
+            const uint8_t* data = cooked.data.data() + level.offset;
+            if (cooked.format == TextureFormat::BC1)
+                glCompressedTexImage2D(GL_TEXTURE_2D, i, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, level.width, level.height, 0, level.size, data);
+            else
+                glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA8, level.width, level.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, cooked.GetLevelCount() - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        // the texels are on the GPU now
+        cooked = CookedTexture();
+        asset.textures.push_back(texture);
+        return asset.textures.size() == asset.cookedTextures.size();
+    }
+    case AssetType::Text:
+    case AssetType::Animations:
+        return true;
+    }
+    return true;
+}
@@ -0,0 +1,143 @@
+#pragma once
+#include "gl/glew.h"
+#include "AnimationClip.h"
+#include "FbxImporter.h"
+#include "ImportedMesh.h"
+#include "TextureCooker.h"
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum class AssetState { Loading, Uploading, Ready, Failed };
+
+/// Loads assets in the background: files are read and parsed on the JobSystem threads,
+/// then Update creates the GL objects on the GL thread within a time budget per frame.
+/// Buffers and textures live in the shared GL context, so they survive window recreation.
+class AssetLoader
+{
+public:
+    typedef unsigned int Handle;
+
+    AssetLoader() = default;
+    /// Waits for the background jobs still running, GL objects are left to the context.
+    ~AssetLoader();
+
+    AssetLoader(const AssetLoader&) = delete;
+    AssetLoader& operator=(const AssetLoader&) = delete;
+
+    Handle LoadMesh(const char* filepath, const FbxImportSettings& settings = FbxImportSettings());
+    /// The texture is decoded and cooked with its mips on a worker, or read from the cooked file next to it when the settings allow.
+    Handle LoadTexture(const char* filepath, const TextureCookSettings& settings = TextureCookSettings());
+    /// Plain text like shader sources, nothing to upload.
+    Handle LoadText(const char* filepath);
+    /// The animation stacks of an FBX file baked into clips, nothing to upload.
+    Handle LoadAnimations(const char* filepath, const AnimationImportSettings& settings = AnimationImportSettings());
+    /// The textures of the materials of an FBX file, embedded or referenced, decoded and cooked concurrently and uploaded one per step.
+    /// Images that fail to decode are left out and counted as missing. They are cooked on every load, there is no file to cache them next to.
+    Handle LoadFbxTextures(const char* filepath, const TextureCookSettings& settings = TextureCookSettings());
+
+    /// Uploads parsed assets until budgetMilliseconds are spent, at least one step is always done so loading can't stall.
+    /// Must be called on the thread owning the GL context.
+    void Update(float budgetMilliseconds);
+
+    AssetState GetState(Handle handle) const { return assets[handle]->state; }
+    bool IsReady(Handle handle) const { return GetState(handle) == AssetState::Ready; }
+    /// Assets neither ready nor failed.
+    unsigned int GetPendingCount() const;
+    const std::string& GetPath(Handle handle) const { return assets[handle]->path; }
+    /// Why a failed FBX asset couldn't be imported, empty for the other assets and once loaded.
+    const std::string& GetError(Handle handle) const { return assets[handle]->error; }
+
+    /// Valid once the mesh is ready. Vertices are the quantized ones when the import settings asked for them.
+    const ImportedMesh& GetMesh(Handle handle) const { return assets[handle]->mesh; }
+    const FbxImportStats& GetMeshStats(Handle handle) const { return assets[handle]->meshStats; }
+    GLuint GetVertexBuffer(Handle handle) const { return assets[handle]->vertexBuffer; }
+    GLuint GetIndexBuffer(Handle handle) const { return assets[handle]->indexBuffer; }
+    /// Byte offset of the skin vertices in the vertex buffer, they follow the vertices when the mesh is skinned.
+    size_t GetSkinVertexOffset(Handle handle) const { return assets[handle]->skinVertexOffset; }
+    /// GL_TEXTURE_BUFFER textures over ImportedMesh::morphStarts, one R32UI texel per entry, and morphDeltas,
+    /// two RGBA16I texels per delta holding the target and position then the normal. 0 when the mesh has no morph targets.
+    GLuint GetMorphStartTexture(Handle handle) const { return assets[handle]->morphStartTexture; }
+    GLuint GetMorphDeltaTexture(Handle handle) const { return assets[handle]->morphDeltaTexture; }
+
+    /// Texture with its cooked mip chain, valid once ready. Textures of an FBX file follow the order of GetFbxTextures.
+    GLuint GetTexture(Handle handle, unsigned int index = 0) const { return assets[handle]->textures[index]; }
+    unsigned int GetTextureCount(Handle handle) const { return (unsigned int)assets[handle]->textures.size(); }
+    /// Usage, material and path of the textures of an FBX file, their encoded images are released once decoded.
+    const std::vector<ImportedTexture>& GetFbxTextures(Handle handle) const { return assets[handle]->fbxTextures; }
+    const TextureImportStats& GetTextureStats(Handle handle) const { return assets[handle]->textureStats; }
+    /// Summed over the textures of the asset, with what they would take uncooked.
+    const TextureCookStats& GetTextureCookStats(Handle handle) const { return assets[handle]->cookStats; }
+
+    const std::string& GetText(Handle handle) const { return assets[handle]->text; }
+
+    const std::vector<AnimationClip>& GetAnimations(Handle handle) const { return assets[handle]->clips; }
+    /// Summed over the clips, each also keeps its own source and baked sizes.
+    const AnimationImportStats& GetAnimationStats(Handle handle) const { return assets[handle]->animationStats; }
+
+    /// Time spent reading and parsing on the worker thread.
+    float GetLoadMilliseconds(Handle handle) const { return assets[handle]->loadMilliseconds; }
+
+private:
+    enum class AssetType { Mesh, Texture, FbxTextures, Text, Animations };
+
+    struct Asset
+    {
+        AssetLoader* owner = nullptr;
+        AssetType type = AssetType::Text;
+        AssetState state = AssetState::Loading;
+        std::string path;
+        float loadMilliseconds = 0.0f;
+        bool loadFailed = false;
+        // written by the importer on the worker, read once the asset is handed over like loadFailed
+        std::string error;
+
+        FbxImportSettings importSettings;
+        ImportedMesh mesh;
+        FbxImportStats meshStats;
+        GLuint vertexBuffer = 0;
+        GLuint indexBuffer = 0;
+        size_t skinVertexOffset = 0;
+        GLuint morphStartBuffer = 0;
+        GLuint morphDeltaBuffer = 0;
+        GLuint morphStartTexture = 0;
+        GLuint morphDeltaTexture = 0;
+        // bytes of vertices, skin vertices, indices then morph data already sent to the GPU
+        size_t uploadedBytes = 0;
+
+        TextureCookSettings cookSettings;
+        TextureCookStats cookStats;
+        // one per texture, released as they are uploaded
+        std::vector<CookedTexture> cookedTextures;
+        std::vector<GLuint> textures;
+        std::vector<ImportedTexture> fbxTextures;
+        TextureImportStats textureStats;
+
+        std::string text;
+
+        AnimationImportSettings animationSettings;
+        std::vector<AnimationClip> clips;
+        AnimationImportStats animationStats;
+    };
+
+    Handle Queue(AssetType type, const char* filepath);
+    static void LoadJob(void* asset);
+    static bool LoadTextureJob(Asset& asset);
+    static bool LoadFbxTexturesJob(Asset& asset);
+    // returns true when the asset is done
+    bool UploadStep(Asset& asset);
+
+    // only touched by the GL thread, the deque keeps the assets in place while jobs hold them
+    std::deque<std::unique_ptr<Asset>> assets;
+
+    // assets finished by the jobs, waiting for Update
+    std::mutex loadedMutex;
+    std::vector<Asset*> loaded;
+    std::atomic<unsigned int> jobsInFlight{ 0 };
+
+    // assets being uploaded, in loading order
+    std::deque<Asset*> uploads;
+};
@@ -0,0 +1,191 @@
+#include "Base64.h"
+#include <string.h>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#define BASE64_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+// MSVC compiles AVX2 intrinsics without /arch:AVX2, they are only called after checking the CPU
+#define BASE64_TARGET_AVX2
+#else
+#define BASE64_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace
+{
+    const uint8_t Invalid = 0xFF;
+    // the AVX2 kernel stores 32 bytes for the 24 it decodes
+    const size_t StoreSlack = 8;
+
+    struct DecodeTable
+    {
+        uint8_t values[256];
+
+        DecodeTable()
+        {
+            memset(values, Invalid, sizeof(values));
+            const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+            for (uint8_t i = 0; i < 64; ++i) values[(uint8_t)alphabet[i]] = i;
+        }
+    };
+
+    // Decodes whole quads of the alphabet, stopping before the first one holding padding or anything else.
+    // Returns the characters consumed, their bytes are at out.
+    size_t DecodeScalar(const DecodeTable& table, const uint8_t* text, size_t length, uint8_t* out)
+    {
+        size_t i = 0;
+        for (; i + 4 <= length; i += 4) {
+            const uint32_t a = table.values[text[i]];
+            const uint32_t b = table.values[text[i + 1]];
+            const uint32_t c = table.values[text[i + 2]];
+            const uint32_t d = table.values[text[i + 3]];
+            if ((a | b | c | d) == Invalid) break;
+            const uint32_t bits = a << 18 | b << 12 | c << 6 | d;
+            *out++ = (uint8_t)(bits >> 16);
+            *out++ = (uint8_t)(bits >> 8);
+            *out++ = (uint8_t)bits;
+        }
+        return i;
+    }
+
+#ifdef BASE64_X86
+    // Lookups on the high and low nibble of each character flag the ones outside the alphabet and give the offset
+    // taking the others to their value, then multiply-adds pack four 6 bit values into three bytes (Mula and Lemire).
+    BASE64_TARGET_AVX2 size_t DecodeAVX2(const uint8_t* text, size_t length, uint8_t* out)
+    {
+        const __m256i lowNibbleFlags = _mm256_setr_epi8(
+            0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+            0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+        const __m256i highNibbleFlags = _mm256_setr_epi8(
+            0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+            0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+        const __m256i offsets = _mm256_setr_epi8(
+            0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+        const __m256i slash = _mm256_set1_epi8(0x2F);
+        const __m256i mergePairs = _mm256_set1_epi32(0x01400140);
+        const __m256i mergeQuads = _mm256_set1_epi32(0x00011000);
+        const __m256i gatherBytes = _mm256_setr_epi8(
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+        const __m256i gatherLanes = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, -1, -1);
+
+        size_t i = 0;
+        for (; i + 32 <= length; i += 32, out += 24) {
+            const __m256i chars = _mm256_loadu_si256((const __m256i*)(text + i));
+            // 0x2F also keeps the top bit clear, so the shuffles never zero a lane
+            const __m256i highNibbles = _mm256_and_si256(_mm256_srli_epi32(chars, 4), slash);
+            const __m256i lowNibbles = _mm256_and_si256(chars, slash);
+            const __m256i lowFlags = _mm256_shuffle_epi8(lowNibbleFlags, lowNibbles);
+            const __m256i highFlags = _mm256_shuffle_epi8(highNibbleFlags, highNibbles);
+            if (!_mm256_testz_si256(lowFlags, highFlags)) break;
+
+            // '/' shares its high nibble with '+', it takes the offset before it
+            const __m256i isSlash = _mm256_cmpeq_epi8(chars, slash);
+            const __m256i values = _mm256_add_epi8(chars, _mm256_shuffle_epi8(offsets, _mm256_add_epi8(isSlash, highNibbles)));
+
+            const __m256i pairs = _mm256_maddubs_epi16(values, mergePairs);
+            const __m256i quads = _mm256_madd_epi16(pairs, mergeQuads);
+            const __m256i bytes = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(quads, gatherBytes), gatherLanes);
+            _mm256_storeu_si256((__m256i*)out, bytes);
+        }
+        return i;
+    }
+
+    bool CpuSupportsAvx2()
+    {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) return false;
+        // the OS must save the AVX registers, OSXSAVE then XCR0
+        __cpuid(info, 1);
+        if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0) return false;
+        if ((_xgetbv(0) & 6) != 6) return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+#endif
+}
+
+Base64::Kernel Base64::GetBestKernel()
+{
+    return IsSupported(Kernel::AVX2) ? Kernel::AVX2 : Kernel::Scalar;
+}
+
+bool Base64::IsSupported(Kernel kernel)
+{
+    switch (kernel) {
+    case Kernel::Scalar:
+        return true;
+#ifdef BASE64_X86
+    case Kernel::AVX2: {
+        static const bool supported = CpuSupportsAvx2();
+        return supported;
+    }
+#endif
+    default:
+        return false;
+    }
+}
+
+const char* Base64::GetKernelName(Kernel kernel)
+{
+    switch (kernel) {
+    case Kernel::Scalar: return "scalar";
+    case Kernel::AVX2: return "AVX2";
+    }
+    return "";
+}
+
+bool Base64::Decode(const char* text, size_t length, std::vector<uint8_t>& outBytes, Kernel kernel)
+{
+    static const DecodeTable table;
+
+    const size_t start = outBytes.size();
+    outBytes.resize(start + length / 4 * 3 + 3 + StoreSlack);
+    const uint8_t* chars = (const uint8_t*)text;
+    uint8_t* out = outBytes.data() + start;
+
+    size_t i = 0;
+    while (i < length) {
+        size_t decoded = 0;
+#ifdef BASE64_X86
+        if (kernel == Kernel::AVX2) decoded = DecodeAVX2(chars + i, length - i, out);
+#endif
+        decoded += DecodeScalar(table, chars + i + decoded, length - i - decoded, out + decoded / 4 * 3);
+        out += decoded / 4 * 3;
+        i += decoded;
+        if (i == length) break;
+
+        // the kernels stopped on a quad with padding ending an encoding, an unpadded end, or a bad character
+        const size_t rest = std::min(length - i, (size_t)4);
+        uint32_t bits = 0;
+        size_t count = 0;
+        for (; count < rest && chars[i + count] != '='; ++count) {
+            const uint32_t value = table.values[chars[i + count]];
+            if (value == Invalid) {
+                outBytes.resize(start);
+                return false;
+            }
+            bits |= value << (18 - 6 * count);
+        }
+        bool padded = count >= 2;
+        for (size_t k = count; k < rest; ++k) padded = padded && chars[i + k] == '=';
+        if (!padded) {
+            outBytes.resize(start);
+            return false;
+        }
+        for (size_t k = 0; k + 1 < count; ++k) *out++ = (uint8_t)(bits >> (16 - 8 * k));
+        i += rest;
+    }
+
+    outBytes.resize(out - outBytes.data());
+    return true;
+}
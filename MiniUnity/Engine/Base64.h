@@ -0,0 +1,23 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/// Decodes base64 text, the way FBX text files embed their media. The AVX2 kernel translates and packs
+/// 32 characters per step, the scalar one is the reference and handles the tails.
+class Base64
+{
+public:
+    enum class Kernel { Scalar, AVX2 };
+
+    /// Fastest kernel the running CPU supports.
+    static Kernel GetBestKernel();
+    static bool IsSupported(Kernel kernel);
+    static const char* GetKernelName(Kernel kernel);
+
+    /// Appends the bytes of text to outBytes. The text may be several encodings one after the other, each ending
+    /// with its padding, like the chunks of an FBX Content property once joined; unpadded ends are accepted too.
+    /// Returns false on any character outside the standard alphabet, whitespace included, leaving outBytes as it was.
+    /// The kernel must be supported.
+    static bool Decode(const char* text, size_t length, std::vector<uint8_t>& outBytes, Kernel kernel = GetBestKernel());
+};
@@ -0,0 +1,33 @@
+#include "BonePalette.h"
+
+unsigned int BonePalette::Add(const float* palette, unsigned int boneCount)
+{
+    const unsigned int firstBone = GetBoneCount();
+    bones.insert(bones.end(), palette, palette + (size_t)boneCount * BoneStride);
+    return firstBone;
+}
+
+void BonePalette::Upload()
+{
+    const size_t bytes = bones.size() * sizeof(float);
+    // a texture buffer over an empty store is incomplete, there is always room for one bone
+    if (capacityBytes < bytes || capacityBytes == 0) capacityBytes = bytes > 0 ? bytes : BoneStride * sizeof(float);
+
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    if (buffer == 0) {
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, capacityBytes, nullptr, GL_STREAM_DRAW);
+        // the texture follows the buffer object, reallocating its store doesn't detach it
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+    else {
+        // orphan the store the frames in flight still read instead of waiting for them
+        glBufferData(GL_TEXTURE_BUFFER, capacityBytes, nullptr, GL_STREAM_DRAW);
+    }
+    if (bytes > 0) glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, bones.data());
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
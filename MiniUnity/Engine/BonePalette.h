@@ -0,0 +1,39 @@
+#pragma once
+#include "gl/glew.h"
+#include <vector>
+
+/// The bone matrices of every skinned mesh drawn in a frame, gathered on the CPU and sent to the GPU
+/// in a single upload. The shader reads them from a texture buffer, three RGBA32F texels per bone
+/// holding the rows of its affine transform, starting at the first bone returned by Add.
+/// The buffer and texture live in the shared GL context, so they survive window recreation.
+class BonePalette
+{
+public:
+    /// Floats per bone, matches SkeletonPose::PaletteStride.
+    static const unsigned int BoneStride = 12;
+
+    BonePalette() = default;
+    /// GL objects are left to the context, like the AssetLoader ones.
+    ~BonePalette() = default;
+
+    BonePalette(const BonePalette&) = delete;
+    BonePalette& operator=(const BonePalette&) = delete;
+
+    /// Starts a new frame, the bones added before are dropped.
+    void Clear() { bones.clear(); }
+    /// Copies boneCount bones of BoneStride floats and returns the index of the first one in the palette.
+    unsigned int Add(const float* palette, unsigned int boneCount);
+    unsigned int GetBoneCount() const { return (unsigned int)(bones.size() / BoneStride); }
+
+    /// Sends the bones added since Clear, once per frame before drawing. Must be called on the thread owning the GL context.
+    void Upload();
+    /// GL_TEXTURE_BUFFER texture over the palette, valid after the first Upload.
+    GLuint GetTexture() const { return texture; }
+
+private:
+    std::vector<float> bones;
+    GLuint buffer = 0;
+    GLuint texture = 0;
+    // bytes allocated for the buffer, it only grows
+    size_t capacityBytes = 0;
+};
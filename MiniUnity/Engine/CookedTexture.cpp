@@ -0,0 +1,161 @@
+#include "CookedTexture.h"
+#include "MappedFile.h"
+#include <stdio.h>
+#include <string.h>
+
+namespace
+{
+    const char Magic[4] = { 'M', 'U', 'T', 'X' };
+
+    /// Followed by the levels, then the data.
+    struct FileHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t sourceHash;
+        uint64_t settingsHash;
+        uint32_t format;
+        uint32_t levelCount;
+        uint32_t dataSize;
+        uint32_t reserved;
+    };
+
+    static_assert(sizeof(FileHeader) == 40, "FileHeader layout changed, bump CookedTexture::FormatVersion");
+    static_assert(sizeof(TextureLevel) == 16, "TextureLevel layout changed, bump CookedTexture::FormatVersion");
+
+    // a full chain of a 2^32 texture has 33 levels
+    const uint32_t MaxLevelCount = 33;
+
+    void UnpackColor565(uint16_t packed, uint8_t* outColor)
+    {
+        const int r = packed >> 11, g = (packed >> 5) & 63, b = packed & 31;
+        outColor[0] = (uint8_t)(r << 3 | r >> 2);
+        outColor[1] = (uint8_t)(g << 2 | g >> 4);
+        outColor[2] = (uint8_t)(b << 3 | b >> 2);
+        outColor[3] = 255;
+    }
+
+    // the palette of GL_COMPRESSED_RGB_S3TC_DXT1_EXT, whose three color mode ends with opaque black
+    void DecodeBC1Block(const uint8_t* block, uint8_t outPalette[4][4], uint32_t& outIndices)
+    {
+        const uint16_t color0 = (uint16_t)(block[0] | block[1] << 8);
+        const uint16_t color1 = (uint16_t)(block[2] | block[3] << 8);
+        UnpackColor565(color0, outPalette[0]);
+        UnpackColor565(color1, outPalette[1]);
+        for (int c = 0; c < 3; ++c) {
+            if (color0 > color1) {
+                outPalette[2][c] = (uint8_t)((2 * outPalette[0][c] + outPalette[1][c]) / 3);
+                outPalette[3][c] = (uint8_t)((outPalette[0][c] + 2 * outPalette[1][c]) / 3);
+            }
+            else {
+                outPalette[2][c] = (uint8_t)((outPalette[0][c] + outPalette[1][c]) / 2);
+                outPalette[3][c] = 0;
+            }
+        }
+        outPalette[2][3] = outPalette[3][3] = 255;
+        outIndices = (uint32_t)block[4] | (uint32_t)block[5] << 8 | (uint32_t)block[6] << 16 | (uint32_t)block[7] << 24;
+    }
+}
+
+void CookedTexture::DecompressBC1()
+{
+    if (format != TextureFormat::BC1) return;
+
+    std::vector<TextureLevel> rgbaLevels(levels.size());
+    uint32_t offset = 0;
+    for (size_t i = 0; i < levels.size(); ++i) {
+        rgbaLevels[i] = { levels[i].width, levels[i].height, offset, GetLevelSize(TextureFormat::RGBA8, levels[i].width, levels[i].height) };
+        offset += rgbaLevels[i].size;
+    }
+
+    std::vector<uint8_t> rgba(offset);
+    for (size_t i = 0; i < levels.size(); ++i) {
+        const TextureLevel& level = levels[i];
+        const uint32_t blocksWide = (level.width + 3) / 4;
+        uint8_t* out = rgba.data() + rgbaLevels[i].offset;
+        for (uint32_t y = 0; y < level.height; y += 4) {
+            for (uint32_t x = 0; x < level.width; x += 4) {
+                uint8_t palette[4][4];
+                uint32_t indices;
+                DecodeBC1Block(data.data() + level.offset + ((size_t)(y / 4) * blocksWide + x / 4) * 8, palette, indices);
+                // the texels of the blocks past the edges of the small levels are dropped
+                for (uint32_t texel = 0; texel < 16; ++texel) {
+                    const uint32_t texelX = x + texel % 4, texelY = y + texel / 4;
+                    if (texelX < level.width && texelY < level.height)
+                        memcpy(out + ((size_t)texelY * level.width + texelX) * 4, palette[(indices >> (2 * texel)) & 3], 4);
+                }
+            }
+        }
+    }
+
+    format = TextureFormat::RGBA8;
+    levels.swap(rgbaLevels);
+    data.swap(rgba);
+}
+
+uint32_t CookedTexture::GetLevelSize(TextureFormat format, uint32_t width, uint32_t height)
+{
+    if (format == TextureFormat::BC1) return ((width + 3) / 4) * ((height + 3) / 4) * 8;
+    return width * height * 4;
+}
+
+bool CookedTexture::Load(const char* filepath, uint64_t sourceHash, uint64_t settingsHash, CookedTexture& outTexture)
+{
+    MappedFile file;
+    if (!file.Open(filepath)) return false;
+    if (file.GetSize() < sizeof(FileHeader)) return false;
+
+    FileHeader header;
+    memcpy(&header, file.GetData(), sizeof(header));
+    if (memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != FormatVersion) return false;
+    if (header.sourceHash != sourceHash || header.settingsHash != settingsHash) return false;
+    if (header.format > (uint32_t)TextureFormat::BC1 || header.levelCount == 0 || header.levelCount > MaxLevelCount) return false;
+    if (file.GetSize() != sizeof(FileHeader) + (size_t)header.levelCount * sizeof(TextureLevel) + header.dataSize) return false;
+
+    const TextureFormat format = (TextureFormat)header.format;
+    std::vector<TextureLevel> levels(header.levelCount);
+    memcpy(levels.data(), file.GetData() + sizeof(FileHeader), levels.size() * sizeof(TextureLevel));
+
+    // the levels are uploaded as they are, a corrupted one would make GL read past the data
+    for (uint32_t i = 0; i < header.levelCount; ++i) {
+        const TextureLevel& level = levels[i];
+        if (level.width == 0 || level.height == 0) return false;
+        if (i > 0 && (level.width != (levels[i - 1].width > 1 ? levels[i - 1].width / 2 : 1) || level.height != (levels[i - 1].height > 1 ? levels[i - 1].height / 2 : 1))) return false;
+        if (level.size != GetLevelSize(format, level.width, level.height) || level.offset > header.dataSize || level.size > header.dataSize - level.offset) return false;
+    }
+
+    const uint8_t* data = file.GetData() + sizeof(FileHeader) + levels.size() * sizeof(TextureLevel);
+    outTexture.format = format;
+    outTexture.levels.swap(levels);
+    outTexture.data.assign(data, data + header.dataSize);
+    return true;
+}
+
+bool CookedTexture::Save(const char* filepath, uint64_t sourceHash, uint64_t settingsHash, const CookedTexture& texture)
+{
+    FileHeader header = {};
+    memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = FormatVersion;
+    header.sourceHash = sourceHash;
+    header.settingsHash = settingsHash;
+    header.format = (uint32_t)texture.format;
+    header.levelCount = texture.GetLevelCount();
+    header.dataSize = (uint32_t)texture.data.size();
+
+    FILE* file = nullptr;
+#ifdef _WIN32
+    if (fopen_s(&file, filepath, "wb") != 0) return false;
+#else
+    file = fopen(filepath, "wb");
+    if (!file) return false;
+#endif
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+    written = written && fwrite(texture.levels.data(), sizeof(TextureLevel), texture.levels.size(), file) == texture.levels.size();
+    written = written && fwrite(texture.data.data(), 1, texture.data.size(), file) == texture.data.size();
+    written = fclose(file) == 0 && written;
+
+    // a truncated file would be rejected by Load anyway, but there's no point keeping it
+    if (!written) remove(filepath);
+    return written;
+}
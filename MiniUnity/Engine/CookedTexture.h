@@ -0,0 +1,52 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/// Layout of the texels of a cooked texture.
+enum class TextureFormat : uint32_t
+{
+    /// Four bytes per texel, sRGB encoded colors and linear alpha, uploaded as GL_RGBA8 like the textures before cooking.
+    RGBA8,
+    /// 8 bytes per 4x4 block of opaque texels, GL_COMPRESSED_RGB_S3TC_DXT1_EXT.
+    BC1,
+};
+
+/// A level of the mip chain, its bytes are data[offset, offset + size) of the texture.
+struct TextureLevel
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t offset;
+    uint32_t size;
+};
+
+/// Texture ready for the GPU: the whole mip chain computed offline, every level laid out
+/// the way glTexImage2D or glCompressedTexImage2D takes it, so uploading is one call per level.
+class CookedTexture
+{
+public:
+    static const uint32_t FormatVersion = 1;
+
+    TextureFormat format = TextureFormat::RGBA8;
+    /// From the full size down to 1x1.
+    std::vector<TextureLevel> levels;
+    std::vector<uint8_t> data;
+
+    uint32_t GetWidth() const { return levels.empty() ? 0 : levels[0].width; }
+    uint32_t GetHeight() const { return levels.empty() ? 0 : levels[0].height; }
+    unsigned int GetLevelCount() const { return (unsigned int)levels.size(); }
+    /// Bytes the texture takes on the GPU, all the levels.
+    size_t GetMemorySize() const { return data.size(); }
+
+    /// Turns BC1 levels into RGBA8 with the colors the GPU would have decoded, for drivers without
+    /// GL_EXT_texture_compression_s3tc. Does nothing to RGBA8 textures.
+    void DecompressBC1();
+
+    /// Bytes of one level in the given format, BC1 levels are rounded up to whole blocks.
+    static uint32_t GetLevelSize(TextureFormat format, uint32_t width, uint32_t height);
+
+    /// Cooked texture of one source file, with the same staleness checks as MeshCache.
+    static bool Load(const char* filepath, uint64_t sourceHash, uint64_t settingsHash, CookedTexture& outTexture);
+    static bool Save(const char* filepath, uint64_t sourceHash, uint64_t settingsHash, const CookedTexture& texture);
+};
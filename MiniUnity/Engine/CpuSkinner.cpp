@@ -0,0 +1,332 @@
+#include "CpuSkinner.h"
+#include "JobSystem.h"
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#define CPUSKINNER_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+// MSVC compiles AVX2 intrinsics without /arch:AVX2, they are only called after checking the CPU
+#define CPUSKINNER_TARGET_AVX2
+#else
+#define CPUSKINNER_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace
+{
+    const float WeightScale = 1.0f / 65535.0f;
+    // normals shorter than this aren't normalized, zero normals stay zero
+    const float MinNormalLengthSquared = 1e-30f;
+    // vertices per job, a multiple of the widest kernel
+    const unsigned int BatchVertices = 4096;
+
+    void SkinScalar(const float* vertices, const SkinVertex* skinVertices, unsigned int vertexCount,
+        const float* bones, unsigned int boneCount, float* outVertices)
+    {
+        for (unsigned int i = 0; i < vertexCount; ++i) {
+            const float* vertex = vertices + (size_t)i * ImportedMesh::VertexSize;
+            float* outVertex = outVertices + (size_t)i * ImportedMesh::VertexSize;
+            const SkinVertex& skin = skinVertices[i];
+
+            // the weight the bones don't take keeps the vertex where it was bound
+            float weights[4];
+            float rest = 1.0f;
+            for (int slot = 0; slot < 4; ++slot) {
+                weights[slot] = skin.boneWeights[slot] * WeightScale;
+                rest -= weights[slot];
+            }
+            float m[CpuSkinner::BoneElements] = { rest, 0.0f, 0.0f, 0.0f, 0.0f, rest, 0.0f, 0.0f, 0.0f, 0.0f, rest, 0.0f };
+            for (int slot = 0; slot < 4; ++slot) {
+                const unsigned int bone = std::min((unsigned int)skin.boneIndices[slot], boneCount - 1);
+                for (unsigned int element = 0; element < CpuSkinner::BoneElements; ++element)
+                    m[element] += weights[slot] * bones[element * boneCount + bone];
+            }
+
+            const float x = vertex[0], y = vertex[1], z = vertex[2];
+            outVertex[0] = m[0] * x + m[1] * y + m[2] * z + m[3];
+            outVertex[1] = m[4] * x + m[5] * y + m[6] * z + m[7];
+            outVertex[2] = m[8] * x + m[9] * y + m[10] * z + m[11];
+
+            const float nx = vertex[3], ny = vertex[4], nz = vertex[5];
+            const float sx = m[0] * nx + m[1] * ny + m[2] * nz;
+            const float sy = m[4] * nx + m[5] * ny + m[6] * nz;
+            const float sz = m[8] * nx + m[9] * ny + m[10] * nz;
+            const float invLength = 1.0f / sqrtf(std::max(sx * sx + sy * sy + sz * sz, MinNormalLengthSquared));
+            outVertex[3] = sx * invLength;
+            outVertex[4] = sy * invLength;
+            outVertex[5] = sz * invLength;
+
+            outVertex[6] = vertex[6];
+            outVertex[7] = vertex[7];
+        }
+    }
+
+#ifdef CPUSKINNER_X86
+    // One vertex per lane: four vertices are transposed so each register holds one attribute of all of them,
+    // and the bones of every lane are loaded element by element from the transposed palette.
+    unsigned int SkinSSE(const float* vertices, const SkinVertex* skinVertices, unsigned int vertexCount,
+        const float* bones, unsigned int boneCount, float* outVertices)
+    {
+        const unsigned int lastBone = boneCount - 1;
+        const __m128 weightScale = _mm_set1_ps(WeightScale);
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 minLengthSquared = _mm_set1_ps(MinNormalLengthSquared);
+
+        unsigned int i = 0;
+        for (; i + 4 <= vertexCount; i += 4) {
+            const float* vertex = vertices + (size_t)i * ImportedMesh::VertexSize;
+            __m128 x = _mm_loadu_ps(vertex), y = _mm_loadu_ps(vertex + 8), z = _mm_loadu_ps(vertex + 16), nx = _mm_loadu_ps(vertex + 24);
+            __m128 ny = _mm_loadu_ps(vertex + 4), nz = _mm_loadu_ps(vertex + 12), u = _mm_loadu_ps(vertex + 20), v = _mm_loadu_ps(vertex + 28);
+            _MM_TRANSPOSE4_PS(x, y, z, nx);
+            _MM_TRANSPOSE4_PS(ny, nz, u, v);
+
+            const SkinVertex* skin = skinVertices + i;
+            __m128 rest = one;
+            __m128 m[CpuSkinner::BoneElements];
+            for (unsigned int element = 0; element < CpuSkinner::BoneElements; ++element) m[element] = _mm_setzero_ps();
+            for (int slot = 0; slot < 4; ++slot) {
+                const __m128 weight = _mm_mul_ps(_mm_cvtepi32_ps(_mm_setr_epi32(skin[0].boneWeights[slot], skin[1].boneWeights[slot],
+                    skin[2].boneWeights[slot], skin[3].boneWeights[slot])), weightScale);
+                rest = _mm_sub_ps(rest, weight);
+
+                const unsigned int bone0 = std::min((unsigned int)skin[0].boneIndices[slot], lastBone);
+                const unsigned int bone1 = std::min((unsigned int)skin[1].boneIndices[slot], lastBone);
+                const unsigned int bone2 = std::min((unsigned int)skin[2].boneIndices[slot], lastBone);
+                const unsigned int bone3 = std::min((unsigned int)skin[3].boneIndices[slot], lastBone);
+                for (unsigned int element = 0; element < CpuSkinner::BoneElements; ++element) {
+                    const float* values = bones + element * boneCount;
+                    const __m128 value = _mm_setr_ps(values[bone0], values[bone1], values[bone2], values[bone3]);
+                    m[element] = _mm_add_ps(m[element], _mm_mul_ps(weight, value));
+                }
+            }
+            m[0] = _mm_add_ps(m[0], rest);
+            m[5] = _mm_add_ps(m[5], rest);
+            m[10] = _mm_add_ps(m[10], rest);
+
+            const __m128 px = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0], x), _mm_mul_ps(m[1], y)), _mm_mul_ps(m[2], z)), m[3]);
+            const __m128 py = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m[4], x), _mm_mul_ps(m[5], y)), _mm_mul_ps(m[6], z)), m[7]);
+            const __m128 pz = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m[8], x), _mm_mul_ps(m[9], y)), _mm_mul_ps(m[10], z)), m[11]);
+
+            __m128 sx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0], nx), _mm_mul_ps(m[1], ny)), _mm_mul_ps(m[2], nz));
+            __m128 sy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[4], nx), _mm_mul_ps(m[5], ny)), _mm_mul_ps(m[6], nz));
+            __m128 sz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[8], nx), _mm_mul_ps(m[9], ny)), _mm_mul_ps(m[10], nz));
+            const __m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, sx), _mm_mul_ps(sy, sy)), _mm_mul_ps(sz, sz));
+            const __m128 invLength = _mm_div_ps(one, _mm_sqrt_ps(_mm_max_ps(lengthSquared, minLengthSquared)));
+            sx = _mm_mul_ps(sx, invLength);
+            sy = _mm_mul_ps(sy, invLength);
+            sz = _mm_mul_ps(sz, invLength);
+
+            // back to one vertex per register, the first and second halves of each vertex
+            __m128 a0 = px, a1 = py, a2 = pz, a3 = sx;
+            __m128 b0 = sy, b1 = sz, b2 = u, b3 = v;
+            _MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+            _MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+            float* outVertex = outVertices + (size_t)i * ImportedMesh::VertexSize;
+            _mm_storeu_ps(outVertex, a0);
+            _mm_storeu_ps(outVertex + 4, b0);
+            _mm_storeu_ps(outVertex + 8, a1);
+            _mm_storeu_ps(outVertex + 12, b1);
+            _mm_storeu_ps(outVertex + 16, a2);
+            _mm_storeu_ps(outVertex + 20, b2);
+            _mm_storeu_ps(outVertex + 24, a3);
+            _mm_storeu_ps(outVertex + 28, b3);
+        }
+        return i;
+    }
+
+    // eight vertices of eight floats, rows become columns
+    CPUSKINNER_TARGET_AVX2 void Transpose8x8(__m256 rows[8])
+    {
+        __m256 t[8];
+        for (int i = 0; i < 8; i += 2) {
+            t[i] = _mm256_unpacklo_ps(rows[i], rows[i + 1]);
+            t[i + 1] = _mm256_unpackhi_ps(rows[i], rows[i + 1]);
+        }
+        __m256 s[8];
+        for (int i = 0; i < 8; i += 4) {
+            s[i] = _mm256_shuffle_ps(t[i], t[i + 2], _MM_SHUFFLE(1, 0, 1, 0));
+            s[i + 1] = _mm256_shuffle_ps(t[i], t[i + 2], _MM_SHUFFLE(3, 2, 3, 2));
+            s[i + 2] = _mm256_shuffle_ps(t[i + 1], t[i + 3], _MM_SHUFFLE(1, 0, 1, 0));
+            s[i + 3] = _mm256_shuffle_ps(t[i + 1], t[i + 3], _MM_SHUFFLE(3, 2, 3, 2));
+        }
+        for (int i = 0; i < 4; ++i) {
+            rows[i] = _mm256_permute2f128_ps(s[i], s[i + 4], 0x20);
+            rows[i + 4] = _mm256_permute2f128_ps(s[i], s[i + 4], 0x31);
+        }
+    }
+
+    // Same layout as the SSE kernel with eight lanes, the skin vertices and the bones are gathered.
+    CPUSKINNER_TARGET_AVX2 unsigned int SkinAVX2(const float* vertices, const SkinVertex* skinVertices, unsigned int vertexCount,
+        const float* bones, unsigned int boneCount, float* outVertices)
+    {
+        const __m256i lastBone = _mm256_set1_epi32((int)boneCount - 1);
+        const __m256i skinOffsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32((int)sizeof(SkinVertex)));
+        const __m256i byteMask = _mm256_set1_epi32(0xff);
+        const __m256i shortMask = _mm256_set1_epi32(0xffff);
+        const __m256 weightScale = _mm256_set1_ps(WeightScale);
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 minLengthSquared = _mm256_set1_ps(MinNormalLengthSquared);
+
+        unsigned int i = 0;
+        for (; i + 8 <= vertexCount; i += 8) {
+            const float* vertex = vertices + (size_t)i * ImportedMesh::VertexSize;
+            __m256 attributes[8];
+            for (int lane = 0; lane < 8; ++lane) attributes[lane] = _mm256_loadu_ps(vertex + lane * ImportedMesh::VertexSize);
+            Transpose8x8(attributes);
+            const __m256 x = attributes[0], y = attributes[1], z = attributes[2];
+            const __m256 nx = attributes[3], ny = attributes[4], nz = attributes[5];
+
+            // the four index bytes and the weight pairs of each skin vertex, as 32 bit integers
+            const int* skin = (const int*)(skinVertices + i);
+            const __m256i packedIndices = _mm256_i32gather_epi32(skin, skinOffsets, 1);
+            const __m256i packedWeights01 = _mm256_i32gather_epi32(skin + 1, skinOffsets, 1);
+            const __m256i packedWeights23 = _mm256_i32gather_epi32(skin + 2, skinOffsets, 1);
+
+            __m256 rest = one;
+            __m256 m[CpuSkinner::BoneElements];
+            for (unsigned int element = 0; element < CpuSkinner::BoneElements; ++element) m[element] = _mm256_setzero_ps();
+            for (int slot = 0; slot < 4; ++slot) {
+                const __m256i packedWeights = slot < 2 ? packedWeights01 : packedWeights23;
+                const __m256i weightBits = (slot & 1) ? _mm256_srli_epi32(packedWeights, 16) : _mm256_and_si256(packedWeights, shortMask);
+                const __m256 weight = _mm256_mul_ps(_mm256_cvtepi32_ps(weightBits), weightScale);
+                rest = _mm256_sub_ps(rest, weight);
+
+                const __m256i bone = _mm256_min_epu32(_mm256_and_si256(_mm256_srlv_epi32(packedIndices, _mm256_set1_epi32(slot * 8)), byteMask), lastBone);
+                for (unsigned int element = 0; element < CpuSkinner::BoneElements; ++element) {
+                    const __m256 value = _mm256_i32gather_ps(bones + element * boneCount, bone, 4);
+                    m[element] = _mm256_add_ps(m[element], _mm256_mul_ps(weight, value));
+                }
+            }
+            m[0] = _mm256_add_ps(m[0], rest);
+            m[5] = _mm256_add_ps(m[5], rest);
+            m[10] = _mm256_add_ps(m[10], rest);
+
+            attributes[0] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[0], x), _mm256_mul_ps(m[1], y)), _mm256_mul_ps(m[2], z)), m[3]);
+            attributes[1] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[4], x), _mm256_mul_ps(m[5], y)), _mm256_mul_ps(m[6], z)), m[7]);
+            attributes[2] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[8], x), _mm256_mul_ps(m[9], y)), _mm256_mul_ps(m[10], z)), m[11]);
+
+            const __m256 sx = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[0], nx), _mm256_mul_ps(m[1], ny)), _mm256_mul_ps(m[2], nz));
+            const __m256 sy = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[4], nx), _mm256_mul_ps(m[5], ny)), _mm256_mul_ps(m[6], nz));
+            const __m256 sz = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[8], nx), _mm256_mul_ps(m[9], ny)), _mm256_mul_ps(m[10], nz));
+            const __m256 lengthSquared = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, sx), _mm256_mul_ps(sy, sy)), _mm256_mul_ps(sz, sz));
+            const __m256 invLength = _mm256_div_ps(one, _mm256_sqrt_ps(_mm256_max_ps(lengthSquared, minLengthSquared)));
+            attributes[3] = _mm256_mul_ps(sx, invLength);
+            attributes[4] = _mm256_mul_ps(sy, invLength);
+            attributes[5] = _mm256_mul_ps(sz, invLength);
+
+            Transpose8x8(attributes);
+            float* outVertex = outVertices + (size_t)i * ImportedMesh::VertexSize;
+            for (int lane = 0; lane < 8; ++lane) _mm256_storeu_ps(outVertex + lane * ImportedMesh::VertexSize, attributes[lane]);
+        }
+        return i;
+    }
+
+    bool CpuSupportsAvx2()
+    {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) return false;
+        // the OS must save the AVX registers, OSXSAVE then XCR0
+        __cpuid(info, 1);
+        if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0) return false;
+        if ((_xgetbv(0) & 6) != 6) return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+#endif
+
+    struct SkinBatch
+    {
+        const float* vertices;
+        const SkinVertex* skinVertices;
+        unsigned int vertexCount;
+        const float* bones;
+        unsigned int boneCount;
+        float* outVertices;
+        CpuSkinner::Kernel kernel;
+    };
+
+    void RunSkinBatch(void* data)
+    {
+        const SkinBatch& batch = *(const SkinBatch*)data;
+        CpuSkinner::Skin(batch.vertices, batch.skinVertices, batch.vertexCount, batch.bones, batch.boneCount, batch.outVertices, batch.kernel);
+    }
+}
+
+CpuSkinner::Kernel CpuSkinner::GetBestKernel()
+{
+    if (IsSupported(Kernel::AVX2)) return Kernel::AVX2;
+    if (IsSupported(Kernel::SSE)) return Kernel::SSE;
+    return Kernel::Scalar;
+}
+
+bool CpuSkinner::IsSupported(Kernel kernel)
+{
+    switch (kernel) {
+    case Kernel::Scalar:
+        return true;
+#ifdef CPUSKINNER_X86
+    case Kernel::SSE:
+        return true;
+    case Kernel::AVX2: {
+        static const bool supported = CpuSupportsAvx2();
+        return supported;
+    }
+#endif
+    default:
+        return false;
+    }
+}
+
+const char* CpuSkinner::GetKernelName(Kernel kernel)
+{
+    switch (kernel) {
+    case Kernel::Scalar: return "scalar";
+    case Kernel::SSE: return "SSE";
+    case Kernel::AVX2: return "AVX2";
+    }
+    return "";
+}
+
+void CpuSkinner::TransposePalette(const float* palette, unsigned int boneCount, float* outBones)
+{
+    for (unsigned int bone = 0; bone < boneCount; ++bone) {
+        for (unsigned int element = 0; element < BoneElements; ++element)
+            outBones[element * boneCount + bone] = palette[bone * BoneElements + element];
+    }
+}
+
+void CpuSkinner::Skin(const float* vertices, const SkinVertex* skinVertices, unsigned int vertexCount,
+    const float* bones, unsigned int boneCount, float* outVertices, Kernel kernel)
+{
+    if (vertexCount == 0 || boneCount == 0) return;
+
+    // the SIMD kernels do whole groups of vertices, the scalar one finishes the rest
+    unsigned int done = 0;
+#ifdef CPUSKINNER_X86
+    if (kernel == Kernel::AVX2) done = SkinAVX2(vertices, skinVertices, vertexCount, bones, boneCount, outVertices);
+    else if (kernel == Kernel::SSE) done = SkinSSE(vertices, skinVertices, vertexCount, bones, boneCount, outVertices);
+#endif
+    const size_t offset = (size_t)done * ImportedMesh::VertexSize;
+    SkinScalar(vertices + offset, skinVertices + done, vertexCount - done, bones, boneCount, outVertices + offset);
+}
+
+void CpuSkinner::SkinParallel(const float* vertices, const SkinVertex* skinVertices, unsigned int vertexCount,
+    const float* bones, unsigned int boneCount, float* outVertices, Kernel kernel)
+{
+    std::vector<SkinBatch> batches;
+    batches.reserve(vertexCount / BatchVertices + 1);
+    for (unsigned int first = 0; first < vertexCount; first += BatchVertices) {
+        const size_t offset = (size_t)first * ImportedMesh::VertexSize;
+        batches.push_back({ vertices + offset, skinVertices + first, std::min(BatchVertices, vertexCount - first), bones, boneCount, outVertices + offset, kernel });
+    }
+    JobSystem::ParallelFor(&RunSkinBatch, batches.data(), sizeof(SkinBatch), (unsigned int)batches.size());
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "ImportedMesh.h"
+
+/// Skins the float vertices of a mesh on the CPU, for when the vertex shader can't: positions and normals
+/// go through the blended bones like in vertex_shader.glsl, texture coordinates are copied.
+/// Works on the interleaved ImportedMesh::VertexSize floats stream, not on the quantized vertices.
+class CpuSkinner
+{
+public:
+    enum class Kernel { Scalar, SSE, AVX2 };
+
+    /// Floats per bone in the transposed palette, like SkeletonPose::PaletteStride.
+    static const unsigned int BoneElements = 12;
+
+    /// Fastest kernel the running CPU supports.
+    static Kernel GetBestKernel();
+    static bool IsSupported(Kernel kernel);
+    static const char* GetKernelName(Kernel kernel);
+
+    /// Rearranges a palette of BoneElements floats per bone so each element of all the bones is contiguous,
+    /// the SIMD kernels load one element for several bones at once. outBones holds boneCount * BoneElements floats.
+    static void TransposePalette(const float* palette, unsigned int boneCount, float* outBones);
+
+    /// Skins vertexCount vertices with the bones given by TransposePalette, bone indices past boneCount use the last bone.
+    /// The kernel must be supported, outVertices mustn't overlap vertices.
+    static void Skin(const float* vertices, const SkinVertex* skinVertices, unsigned int vertexCount,
+        const float* bones, unsigned int boneCount, float* outVertices, Kernel kernel);
+    /// Same as Skin, split in batches run by the JobSystem workers.
+    static void SkinParallel(const float* vertices, const SkinVertex* skinVertices, unsigned int vertexCount,
+        const float* bones, unsigned int boneCount, float* outVertices, Kernel kernel);
+};
@@ -1,23 +1,31 @@
 #include "FbxImporter.h"
+#include "AnimationCompressor.h"
+#include "Base64.h"
+#include "JobSystem.h"
+#include "MappedFile.h"
+#include "MeshCache.h"
+#include "MeshletBuilder.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "MeshWelder.h"
+#include "VertexQuantizer.h"
 #include "../ExternalCode/OpenFBX/src/ofbx.h"
-#include <stdio.h>
 #include "gl/glew.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
-bool FbxImporter::ImportFBX(const char* filepath, std::vector<GLfloat>& outVertices, std::vector<GLuint>& outTriangles, unsigned int& outTrianglesCount)
+namespace
 {
-    FILE* fp;
-    fopen_s(&fp, filepath, "rb");
-
-    if (!fp) return false;
-
-    fseek(fp, 0, SEEK_END);
-    long file_size = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
-    auto* content = new ofbx::u8[file_size];
-    fread(content, 1, file_size, fp);
-
-    ofbx::LoadFlags flags =
+    const ofbx::LoadFlags ImportFlags =
+        ofbx::LoadFlags::BORROW_DATA |
         //		ofbx::LoadFlags::IGNORE_MODELS |
         ofbx::LoadFlags::IGNORE_BLEND_SHAPES |
         ofbx::LoadFlags::IGNORE_CAMERAS |
@@ -33,19 +41,317 @@ bool FbxImporter::ImportFBX(const char* filepath, std::vector<GLfloat>& outVerti
         //		ofbx::LoadFlags::IGNORE_MESHES |
         ofbx::LoadFlags::IGNORE_ANIMATIONS;
 
-    ofbx::IScene* g_scene = ofbx::load((ofbx::u8*)content, file_size, (ofbx::u16)flags);
+    // skins need the clusters and the bone nodes they link to, with the pivots the baked animations include
+    const ofbx::LoadFlags SkinnedImportFlags =
+        ofbx::LoadFlags::BORROW_DATA |
+        ofbx::LoadFlags::IGNORE_BLEND_SHAPES |
+        ofbx::LoadFlags::IGNORE_CAMERAS |
+        ofbx::LoadFlags::IGNORE_LIGHTS |
+        ofbx::LoadFlags::IGNORE_TEXTURES |
+        ofbx::LoadFlags::IGNORE_MATERIALS |
+        ofbx::LoadFlags::IGNORE_POSES |
+        ofbx::LoadFlags::IGNORE_VIDEOS |
+        ofbx::LoadFlags::IGNORE_ANIMATIONS;
 
-    delete[] content;
-    fclose(fp);
+    // skin data rides along as eight more float components while welding and reordering,
+    // the bone indices and the weights, all integers and exact in a float
+    const unsigned int SkinComponents = 8;
+    // blend shapes add one, the control point the vertex comes from, exact in a float below 2^24
+    const uint32_t NoControlPoint = (1 << 24) - 1;
 
-    int mesh_count = g_scene->getMeshCount();
-    int polygonCount = 0;
-    int trianglesCount = 0;
+    // nodes and curves only, pivots are part of the baked local transforms
+    const ofbx::LoadFlags AnimationImportFlags =
+        ofbx::LoadFlags::BORROW_DATA |
+        ofbx::LoadFlags::IGNORE_GEOMETRY |
+        ofbx::LoadFlags::IGNORE_BLEND_SHAPES |
+        ofbx::LoadFlags::IGNORE_CAMERAS |
+        ofbx::LoadFlags::IGNORE_LIGHTS |
+        ofbx::LoadFlags::IGNORE_TEXTURES |
+        ofbx::LoadFlags::IGNORE_SKIN |
+        ofbx::LoadFlags::IGNORE_BONES |
+        ofbx::LoadFlags::IGNORE_MATERIALS |
+        ofbx::LoadFlags::IGNORE_POSES |
+        ofbx::LoadFlags::IGNORE_VIDEOS;
 
-    // output unindexed geometry
-    for (int mesh_idx = 0; mesh_idx < mesh_count; ++mesh_idx) {
-        const ofbx::Mesh& mesh = *g_scene->getMesh(mesh_idx);
-        const ofbx::GeometryData& geom = mesh.getGeometryData();
+    // materials with their textures and the videos embedding them, nothing else
+    const ofbx::LoadFlags TextureImportFlags =
+        ofbx::LoadFlags::BORROW_DATA |
+        ofbx::LoadFlags::IGNORE_GEOMETRY |
+        ofbx::LoadFlags::IGNORE_BLEND_SHAPES |
+        ofbx::LoadFlags::IGNORE_CAMERAS |
+        ofbx::LoadFlags::IGNORE_LIGHTS |
+        ofbx::LoadFlags::IGNORE_SKIN |
+        ofbx::LoadFlags::IGNORE_BONES |
+        ofbx::LoadFlags::IGNORE_PIVOTS |
+        ofbx::LoadFlags::IGNORE_ANIMATIONS |
+        ofbx::LoadFlags::IGNORE_POSES |
+        ofbx::LoadFlags::IGNORE_LIMBS |
+        ofbx::LoadFlags::IGNORE_MESHES |
+        ofbx::LoadFlags::IGNORE_MODELS;
+
+    // the error goes to the caller's string, imports running on several threads each have their own
+    bool Fail(std::string* outError, const char* error)
+    {
+        if (outError) *outError = error && *error ? error : "Invalid file";
+        return false;
+    }
+
+    // strongest bones of a control point, palette indices and weights as found in the file
+    struct Influences
+    {
+        int bones[4];
+        double weights[4];
+    };
+
+    // inverse of an affine transform, column major
+    ofbx::DMatrix InvertAffine(const ofbx::DMatrix& matrix)
+    {
+        const double* m = matrix.m;
+        const double determinant = m[0] * (m[5] * m[10] - m[6] * m[9]) - m[4] * (m[1] * m[10] - m[2] * m[9]) + m[8] * (m[1] * m[6] - m[2] * m[5]);
+        const double invDeterminant = determinant != 0.0 ? 1.0 / determinant : 0.0;
+
+        ofbx::DMatrix result = {};
+        double* r = result.m;
+        r[0] = (m[5] * m[10] - m[6] * m[9]) * invDeterminant;
+        r[1] = (m[2] * m[9] - m[1] * m[10]) * invDeterminant;
+        r[2] = (m[1] * m[6] - m[2] * m[5]) * invDeterminant;
+        r[4] = (m[6] * m[8] - m[4] * m[10]) * invDeterminant;
+        r[5] = (m[0] * m[10] - m[2] * m[8]) * invDeterminant;
+        r[6] = (m[2] * m[4] - m[0] * m[6]) * invDeterminant;
+        r[8] = (m[4] * m[9] - m[5] * m[8]) * invDeterminant;
+        r[9] = (m[1] * m[8] - m[0] * m[9]) * invDeterminant;
+        r[10] = (m[0] * m[5] - m[1] * m[4]) * invDeterminant;
+        for (int row = 0; row < 3; ++row)
+            r[12 + row] = -(r[row] * m[12] + r[4 + row] * m[13] + r[8 + row] * m[14]);
+        r[15] = 1.0;
+        return result;
+    }
+
+    ofbx::DMatrix Multiply(const ofbx::DMatrix& lhs, const ofbx::DMatrix& rhs)
+    {
+        ofbx::DMatrix result;
+        for (int column = 0; column < 4; ++column) {
+            for (int row = 0; row < 4; ++row) {
+                double sum = 0.0;
+                for (int k = 0; k < 4; ++k) sum += lhs.m[k * 4 + row] * rhs.m[column * 4 + k];
+                result.m[column * 4 + row] = sum;
+            }
+        }
+        return result;
+    }
+
+    void ToFloats(const ofbx::DMatrix& matrix, float out[16])
+    {
+        for (int i = 0; i < 16; ++i) out[i] = (float)matrix.m[i];
+    }
+
+    // bones shared by the meshes of a file, and the nodes above them once Finish is called
+    class SkeletonBuilder
+    {
+    public:
+        explicit SkeletonBuilder(const ofbx::IScene& scene) : hierarchy(ofbx::createTransformHierarchy(scene)) {}
+        ~SkeletonBuilder() { hierarchy->destroy(); }
+
+        // palette index of the bone, -1 when the link isn't a node or the palette is full
+        int AddBone(const ofbx::Cluster& cluster)
+        {
+            const ofbx::Object* link = cluster.getLink();
+            const int node = link ? hierarchy->getNodeIndex(*link) : -1;
+            if (node < 0) return -1;
+
+            // a node can be bound to meshes with different transforms, each pair is a bone
+            const ofbx::DMatrix meshTransform = cluster.getTransformMatrix();
+            for (size_t i = 0; i < bones.size(); ++i) {
+                if (bones[i].node == node && memcmp(bones[i].meshTransform.m, meshTransform.m, sizeof(meshTransform.m)) == 0) return (int)i;
+            }
+            if (bones.size() >= ImportedMesh::MaxBones) return -1;
+
+            bones.push_back({ node, meshTransform, cluster.getTransformLinkMatrix() });
+            return (int)bones.size() - 1;
+        }
+
+        bool IsEmpty() const { return bones.empty(); }
+
+        void Finish(Skeleton& outSkeleton) const
+        {
+            // the bone nodes and all their ancestors, kept in hierarchy order so parents come first
+            std::vector<int> skeletonIndex(hierarchy->getNodeCount(), -1);
+            for (const Bone& bone : bones) {
+                for (int node = bone.node; node >= 0 && skeletonIndex[node] != 0; node = hierarchy->getParentIndex(node))
+                    skeletonIndex[node] = 0;
+            }
+
+            // the rest pose is the bind pose: bones sit where their clusters were bound, which the
+            // scene's current node transforms often don't match, and the nodes between them follow
+            std::vector<const ofbx::DMatrix*> bindTransform(hierarchy->getNodeCount(), nullptr);
+            for (const Bone& bone : bones) {
+                if (!bindTransform[bone.node]) bindTransform[bone.node] = &bone.linkTransform;
+            }
+
+            outSkeleton = Skeleton();
+            std::vector<ofbx::DMatrix> restGlobal;
+            restGlobal.reserve(hierarchy->getNodeCount());
+            for (int node = 0; node < hierarchy->getNodeCount(); ++node) {
+                if (skeletonIndex[node] < 0) continue;
+                skeletonIndex[node] = (int)outSkeleton.nodes.size();
+
+                SkeletonNode skeletonNode;
+                const int parent = hierarchy->getParentIndex(node);
+                skeletonNode.parent = parent >= 0 ? skeletonIndex[parent] : -1;
+
+                const ofbx::DMatrix local = hierarchy->getNode(node)->getLocalTransform();
+                const ofbx::DMatrix* parentGlobal = skeletonNode.parent >= 0 ? &restGlobal[skeletonNode.parent] : nullptr;
+                if (bindTransform[node]) {
+                    restGlobal.push_back(*bindTransform[node]);
+                    ToFloats(parentGlobal ? Multiply(InvertAffine(*parentGlobal), *bindTransform[node]) : *bindTransform[node], skeletonNode.restLocal);
+                } else {
+                    restGlobal.push_back(parentGlobal ? Multiply(*parentGlobal, local) : local);
+                    ToFloats(local, skeletonNode.restLocal);
+                }
+                outSkeleton.nodes.push_back(skeletonNode);
+                outSkeleton.nodeNames.push_back(hierarchy->getNode(node)->name);
+            }
+
+            for (const Bone& bone : bones) {
+                SkinBone skinBone;
+                skinBone.node = (uint32_t)skeletonIndex[bone.node];
+                ToFloats(Multiply(InvertAffine(bone.linkTransform), bone.meshTransform), skinBone.inverseBind);
+                ToFloats(InvertAffine(bone.meshTransform), skinBone.meshFromScene);
+                outSkeleton.bones.push_back(skinBone);
+            }
+        }
+
+    private:
+        struct Bone
+        {
+            int node;
+            ofbx::DMatrix meshTransform;
+            ofbx::DMatrix linkTransform;
+        };
+
+        ofbx::TransformHierarchy* hierarchy;
+        std::vector<Bone> bones;
+    };
+
+    // keeps the four strongest bones of every control point of the mesh
+    void GatherInfluences(const ofbx::Skin& skin, int controlPointCount, SkeletonBuilder& skeleton, std::vector<Influences>& outInfluences)
+    {
+        outInfluences.assign(controlPointCount, { { -1, -1, -1, -1 }, { 0.0, 0.0, 0.0, 0.0 } });
+        for (int cluster_idx = 0; cluster_idx < skin.getClusterCount(); ++cluster_idx) {
+            const ofbx::Cluster& cluster = *skin.getCluster(cluster_idx);
+            const int count = cluster.getIndicesCount() < cluster.getWeightsCount() ? cluster.getIndicesCount() : cluster.getWeightsCount();
+            if (count == 0) continue;
+            const int bone = skeleton.AddBone(cluster);
+            if (bone < 0) continue;
+
+            const int* indices = cluster.getIndices();
+            const double* weights = cluster.getWeights();
+            for (int i = 0; i < count; ++i) {
+                if (indices[i] < 0 || indices[i] >= controlPointCount || !(weights[i] > 0.0)) continue;
+
+                // replaces the weakest slot, the empty ones have a weight of 0
+                Influences& influences = outInfluences[indices[i]];
+                int weakest = 0;
+                for (int slot = 1; slot < 4; ++slot) {
+                    if (influences.weights[slot] < influences.weights[weakest]) weakest = slot;
+                }
+                if (weights[i] > influences.weights[weakest]) {
+                    influences.bones[weakest] = bone;
+                    influences.weights[weakest] = weights[i];
+                }
+            }
+        }
+    }
+
+    // normalized to unorm16, the rounding error goes to the strongest bone so the sum is exactly 65535
+    SkinVertex EncodeInfluences(const Influences& influences)
+    {
+        SkinVertex vertex = {};
+        double sum = 0.0;
+        for (int slot = 0; slot < 4; ++slot) sum += influences.weights[slot];
+        if (!(sum > 0.0)) return vertex;
+
+        int strongest = 0;
+        int total = 0;
+        for (int slot = 0; slot < 4; ++slot) {
+            if (influences.bones[slot] < 0) continue;
+            vertex.boneIndices[slot] = (uint8_t)influences.bones[slot];
+            vertex.boneWeights[slot] = (uint16_t)lrint(influences.weights[slot] / sum * 65535.0);
+            total += vertex.boneWeights[slot];
+            if (influences.weights[slot] > influences.weights[strongest]) strongest = slot;
+        }
+        vertex.boneWeights[strongest] = (uint16_t)(vertex.boneWeights[strongest] + 65535 - total);
+        return vertex;
+    }
+
+    // blend shape delta of a control point, numbered over all the meshes of the file
+    struct ControlPointDelta
+    {
+        uint32_t controlPoint;
+        uint32_t target;
+        float position[3];
+        float normal[3];
+    };
+
+    // blend shapes as found in the file, turned into morph targets once the vertices are final
+    struct MorphSource
+    {
+        std::vector<ControlPointDelta> deltas;
+        // control point of every vertex, carried through welding and reordering
+        std::vector<uint32_t> vertexControlPoints;
+        uint32_t controlPointCount = 0;
+    };
+
+    // channels with the same name drive the same target, in-between shapes are left out
+    void GatherBlendShape(const ofbx::BlendShape& blendShape, int controlPointCount, uint32_t firstControlPoint, ImportedMesh& output, MorphSource& morphs)
+    {
+        for (int channel_idx = 0; channel_idx < blendShape.getBlendShapeChannelCount(); ++channel_idx) {
+            const ofbx::BlendShapeChannel& channel = *blendShape.getBlendShapeChannel(channel_idx);
+            if (channel.getShapeCount() == 0) continue;
+            // the last shape is the one at full weight
+            const ofbx::Shape& shape = *channel.getShape(channel.getShapeCount() - 1);
+            const int count = std::min(shape.getIndexCount(), shape.getVertexCount());
+            if (count == 0) continue;
+
+            std::vector<std::string>& names = output.morphTargetNames;
+            const size_t target = std::find(names.begin(), names.end(), channel.name) - names.begin();
+            if (target == names.size()) {
+                if (names.size() >= ImportedMesh::MaxMorphTargets) continue;
+                names.push_back(channel.name);
+            }
+
+            const int* indices = shape.getIndices();
+            const ofbx::Vec3* positions = shape.getVertices();
+            const ofbx::Vec3* normals = shape.getNormals();
+            for (int i = 0; i < count; ++i) {
+                if (indices[i] < 0 || indices[i] >= controlPointCount) continue;
+                ControlPointDelta delta = { firstControlPoint + (uint32_t)indices[i], (uint32_t)target, { positions[i].x, positions[i].y, positions[i].z }, {} };
+                if (normals) {
+                    delta.normal[0] = normals[i].x;
+                    delta.normal[1] = normals[i].y;
+                    delta.normal[2] = normals[i].z;
+                }
+                morphs.deltas.push_back(delta);
+            }
+        }
+    }
+
+    // data appended for every polygon corner next to the vertices
+    struct CornerStreams
+    {
+        // the influences of the control point of the corner, none when the mesh has no skin
+        std::vector<SkinVertex>* skinVertices = nullptr;
+        const std::vector<Influences>* influences = nullptr;
+        // the control point of the corner, offset by firstControlPoint
+        std::vector<uint32_t>* controlPoints = nullptr;
+        uint32_t firstControlPoint = 0;
+    };
+
+    // appends the unindexed geometry, one vertex per polygon corner, and a submesh per partition
+    void AppendGeometry(const ofbx::GeometryData& geom, ImportedMesh& output, const CornerStreams* streams = nullptr)
+    {
+        int polygonCount = 0;
+        int trianglesCount = 0;
 
         // each ofbx::Mesh can have several materials == partitions
         for (int partition_idx = 0; partition_idx < geom.getPartitionCount(); ++partition_idx) {
@@ -53,88 +359,887 @@ bool FbxImporter::ImportFBX(const char* filepath, std::vector<GLfloat>& outVerti
 
             for (int polygon_idx = 0; polygon_idx < partition.polygon_count; ++polygon_idx) {
                 const ofbx::GeometryPartition::Polygon& polygon = partition.polygons[polygon_idx];
-                
-                for (int i = polygon.from_vertex; i < polygon.from_vertex + polygon.vertex_count; ++i) {
-                    polygonCount++;
-                }
-
-                if (polygon.vertex_count == 3)
-                    trianglesCount++;
-                else if (polygon.vertex_count == 4)
-                    trianglesCount += 2;
-                else
-                    trianglesCount += polygon.vertex_count - 2;
+                polygonCount += polygon.vertex_count;
+                trianglesCount += polygon.vertex_count - 2;
             }
         }
-    }
-
-    outVertices.resize(polygonCount * 8);
-    outTriangles.resize(trianglesCount * 3);
 
-    int currentOutVerticesIndex = 0;
-    int currentOutTrianglesIndex = 0;
-    outTrianglesCount = 0;
+        int currentOutVerticesIndex = (int)output.vertices.size();
+        int currentOutTrianglesIndex = (int)output.indices.size();
+        output.vertices.resize(output.vertices.size() + polygonCount * 8);
+        output.indices.resize(output.indices.size() + trianglesCount * 3);
 
-    for (int mesh_idx = 0; mesh_idx < mesh_count; ++mesh_idx) {
-        const ofbx::Mesh& mesh = *g_scene->getMesh(mesh_idx);
-        const ofbx::GeometryData& geom = mesh.getGeometryData();
         const ofbx::Vec3Attributes& positions = geom.getPositions();
         const ofbx::Vec3Attributes& normals = geom.getNormals();
         const ofbx::Vec2Attributes& uvs = geom.getUVs();
 
         for (int partition_idx = 0; partition_idx < geom.getPartitionCount(); ++partition_idx) {
             const ofbx::GeometryPartition& partition = geom.getPartition(partition_idx);
+            Submesh submesh;
+            submesh.firstIndex = currentOutTrianglesIndex;
 
             for (int polygon_idx = 0; polygon_idx < partition.polygon_count; ++polygon_idx) {
                 const ofbx::GeometryPartition::Polygon& polygon = partition.polygons[polygon_idx];
+                // indices refer to the output vertices, polygon.from_vertex is only valid inside its own mesh
+                const GLuint firstVertex = currentOutVerticesIndex / 8;
 
                 for (int i = polygon.from_vertex; i < polygon.from_vertex + polygon.vertex_count; ++i) {
+                    if (streams) {
+                        const int controlPoint = positions.indices ? positions.indices[i] : i;
+                        if (streams->skinVertices) {
+                            const std::vector<Influences>* influences = streams->influences;
+                            const bool hasInfluences = influences && controlPoint >= 0 && controlPoint < (int)influences->size();
+                            streams->skinVertices->push_back(hasInfluences ? EncodeInfluences((*influences)[controlPoint]) : SkinVertex());
+                        }
+                        if (streams->controlPoints)
+                            streams->controlPoints->push_back(controlPoint >= 0 ? streams->firstControlPoint + (uint32_t)controlPoint : NoControlPoint);
+                    }
                     ofbx::Vec3 v = positions.get(i);
-                    ofbx::Vec3 n = normals.values == nullptr ? ofbx::Vec3() : normals.get(i);
-                    ofbx::Vec2 uv = uvs.values == nullptr ? ofbx::Vec2() : uvs.get(i);
-                    outVertices[currentOutVerticesIndex + 0] = v.x;
-                    outVertices[currentOutVerticesIndex + 1] = v.y;
-                    outVertices[currentOutVerticesIndex + 2] = v.z;
-                    outVertices[currentOutVerticesIndex + 3] = n.x;
-                    outVertices[currentOutVerticesIndex + 4] = n.y;
-                    outVertices[currentOutVerticesIndex + 5] = n.z;
-                    outVertices[currentOutVerticesIndex + 6] = uv.x;
-                    outVertices[currentOutVerticesIndex + 7] = uv.y;
+                    // negative attribute indices mark corners without data (e.g. unmapped uvs)
+                    ofbx::Vec3 n = normals.values == nullptr || (normals.indices && normals.indices[i] < 0) ? ofbx::Vec3() : normals.get(i);
+                    ofbx::Vec2 uv = uvs.values == nullptr || (uvs.indices && uvs.indices[i] < 0) ? ofbx::Vec2() : uvs.get(i);
+                    output.vertices[currentOutVerticesIndex + 0] = v.x;
+                    output.vertices[currentOutVerticesIndex + 1] = v.y;
+                    output.vertices[currentOutVerticesIndex + 2] = v.z;
+                    output.vertices[currentOutVerticesIndex + 3] = n.x;
+                    output.vertices[currentOutVerticesIndex + 4] = n.y;
+                    output.vertices[currentOutVerticesIndex + 5] = n.z;
+                    output.vertices[currentOutVerticesIndex + 6] = uv.x;
+                    output.vertices[currentOutVerticesIndex + 7] = uv.y;
                     currentOutVerticesIndex += 8;
                 }
 
                 if (polygon.vertex_count == 3) {
-                    outTriangles[currentOutTrianglesIndex + 0] = polygon.from_vertex;
-                    outTriangles[currentOutTrianglesIndex + 1] = polygon.from_vertex + 1;
-                    outTriangles[currentOutTrianglesIndex + 2] = polygon.from_vertex + 2;
+                    output.indices[currentOutTrianglesIndex + 0] = firstVertex;
+                    output.indices[currentOutTrianglesIndex + 1] = firstVertex + 1;
+                    output.indices[currentOutTrianglesIndex + 2] = firstVertex + 2;
                     currentOutTrianglesIndex += 3;
-                    outTrianglesCount += 3;
                 }
                 else if (polygon.vertex_count == 4) {
 
-                    outTriangles[currentOutTrianglesIndex + 0] = polygon.from_vertex;
-                    outTriangles[currentOutTrianglesIndex + 1] = polygon.from_vertex + 1;
-                    outTriangles[currentOutTrianglesIndex + 2] = polygon.from_vertex + 2;
+                    output.indices[currentOutTrianglesIndex + 0] = firstVertex;
+                    output.indices[currentOutTrianglesIndex + 1] = firstVertex + 1;
+                    output.indices[currentOutTrianglesIndex + 2] = firstVertex + 2;
 
-                    outTriangles[currentOutTrianglesIndex + 3] = polygon.from_vertex;
-                    outTriangles[currentOutTrianglesIndex + 4] = polygon.from_vertex + 2;
-                    outTriangles[currentOutTrianglesIndex + 5] = polygon.from_vertex + 3;
+                    output.indices[currentOutTrianglesIndex + 3] = firstVertex;
+                    output.indices[currentOutTrianglesIndex + 4] = firstVertex + 2;
+                    output.indices[currentOutTrianglesIndex + 5] = firstVertex + 3;
 
                     currentOutTrianglesIndex += 6;
-                    outTrianglesCount += 6;
                 }
                 else {
                     for (int tri = 0; tri < polygon.vertex_count - 2; ++tri) {
-                        outTriangles[currentOutTrianglesIndex + tri * 3 + 0] = polygon.from_vertex;
-                        outTriangles[currentOutTrianglesIndex + tri * 3 + 1] = polygon.from_vertex + 1 + tri;
-                        outTriangles[currentOutTrianglesIndex + tri * 3 + 2] = polygon.from_vertex + 2 + tri;
+                        output.indices[currentOutTrianglesIndex + tri * 3 + 0] = firstVertex;
+                        output.indices[currentOutTrianglesIndex + tri * 3 + 1] = firstVertex + 1 + tri;
+                        output.indices[currentOutTrianglesIndex + tri * 3 + 2] = firstVertex + 2 + tri;
                     }
                     currentOutTrianglesIndex += 3 * (polygon.vertex_count - 2);
-                    outTrianglesCount += 3 * (polygon.vertex_count - 2);
                 }
             }
+
+            submesh.indexCount = currentOutTrianglesIndex - submesh.firstIndex;
+            if (submesh.indexCount > 0) output.submeshes.push_back(submesh);
+        }
+    }
+
+    // morphs is only given when the blend shapes are imported
+    bool LoadScene(const char* filepath, const FbxImportSettings& settings, ImportedMesh& output, MorphSource* morphs, std::string* outError)
+    {
+        // the file is mapped and tokenized in place, OpenFBX borrows the mapping instead of copying it
+        MappedFile file;
+        if (!file.Open(filepath)) return Fail(outError, "Cannot open the file");
+
+        ofbx::JobProcessor jobProcessor = settings.parallelParsing ? &JobSystem::OfbxJobProcessor : nullptr;
+        ofbx::u16 flags = (ofbx::u16)(settings.importSkin ? SkinnedImportFlags : ImportFlags);
+        if (morphs) flags &= ~(ofbx::u16)ofbx::LoadFlags::IGNORE_BLEND_SHAPES;
+        ofbx::IScene* g_scene = ofbx::load(file.GetData(), file.GetSize(), flags, jobProcessor);
+        // read right away on the thread that loaded, the OpenFBX error is kept per thread until its next load
+        if (!g_scene) return Fail(outError, ofbx::getError());
+
+        std::unique_ptr<SkeletonBuilder> skeleton;
+        if (settings.importSkin) skeleton.reset(new SkeletonBuilder(*g_scene));
+        std::vector<Influences> influences;
+        for (int mesh_idx = 0; mesh_idx < g_scene->getMeshCount(); ++mesh_idx) {
+            const ofbx::Mesh& mesh = *g_scene->getMesh(mesh_idx);
+            const ofbx::GeometryData& geom = mesh.getGeometryData();
+            if (!skeleton && !morphs) {
+                AppendGeometry(geom, output);
+                continue;
+            }
+
+            const int controlPointCount = geom.getPositions().values_count;
+            CornerStreams streams;
+            if (skeleton) {
+                const ofbx::Skin* skin = mesh.getSkin();
+                if (skin) GatherInfluences(*skin, controlPointCount, *skeleton, influences);
+                streams.skinVertices = &output.skinVertices;
+                streams.influences = skin ? &influences : nullptr;
+            }
+            if (morphs) {
+                const ofbx::BlendShape* blendShape = mesh.getBlendShape();
+                if (blendShape) GatherBlendShape(*blendShape, controlPointCount, morphs->controlPointCount, output, *morphs);
+                streams.controlPoints = &morphs->vertexControlPoints;
+                streams.firstControlPoint = morphs->controlPointCount;
+                morphs->controlPointCount += controlPointCount;
+            }
+            AppendGeometry(geom, output, &streams);
+        }
+
+        // meshes without skin don't need the skin vertices, nor those without blend shapes the control points
+        if (skeleton) {
+            if (skeleton->IsEmpty()) output.skinVertices.clear();
+            else skeleton->Finish(output.skeleton);
+        }
+        if (morphs && (morphs->deltas.empty() || morphs->controlPointCount >= NoControlPoint)) {
+            *morphs = MorphSource();
+            output.morphTargetNames.clear();
+        }
+
+        // the scene references the mapping, so it has to go before the file is unmapped
+        g_scene->destroy();
+        return true;
+    }
+
+    bool ReadFileAt(void* userPointer, ofbx::u64 offset, void* buffer, ofbx::usize size)
+    {
+        FILE* file = (FILE*)userPointer;
+#ifdef _WIN32
+        if (_fseeki64(file, (long long)offset, SEEK_SET) != 0) return false;
+#else
+        if (fseeko(file, (off_t)offset, SEEK_SET) != 0) return false;
+#endif
+        return fread(buffer, 1, size, file) == size;
+    }
+
+    bool AppendStreamedGeometry(void* userPointer, ofbx::u64, const char*, const ofbx::GeometryData& geometry)
+    {
+        AppendGeometry(geometry, *(ImportedMesh*)userPointer);
+        return true;
+    }
+
+    bool StreamGeometries(const char* filepath, const FbxImportSettings& settings, ImportedMesh& output, std::string* outError)
+    {
+        FILE* file = nullptr;
+#ifdef _WIN32
+        if (fopen_s(&file, filepath, "rb") != 0) return Fail(outError, "Cannot open the file");
+        _fseeki64(file, 0, SEEK_END);
+        ofbx::u64 size = (ofbx::u64)_ftelli64(file);
+#else
+        file = fopen(filepath, "rb");
+        if (!file) return Fail(outError, "Cannot open the file");
+        fseeko(file, 0, SEEK_END);
+        ofbx::u64 size = (ofbx::u64)ftello(file);
+#endif
+
+        ofbx::JobProcessor jobProcessor = settings.parallelParsing ? &JobSystem::OfbxJobProcessor : nullptr;
+        bool result = ofbx::streamGeometries(&ReadFileAt, file, size, (ofbx::u16)ImportFlags, &AppendStreamedGeometry, &output, jobProcessor);
+        fclose(file);
+        return result || Fail(outError, ofbx::getError());
+    }
+
+    // only the settings changing the output, a cooked mesh is reused whatever the others are
+    uint64_t HashSettings(const FbxImportSettings& settings)
+    {
+        const float values[] = {
+            settings.weldVertices ? 1.0f : 0.0f,
+            settings.weldEpsilon,
+            settings.optimizeVertexCache ? 1.0f : 0.0f,
+            settings.optimizeOverdraw ? 1.0f : 0.0f,
+            settings.importSkin ? 1.0f : 0.0f,
+            settings.importBlendShapes ? 1.0f : 0.0f,
+            (float)settings.lodCount,
+            settings.lodReduction,
+            settings.lodMaxError,
+            settings.buildMeshlets ? 1.0f : 0.0f,
+        };
+        return MeshCache::Hash(values, sizeof(values));
+    }
+
+    // interleaves the skin vertices and the control points after each vertex, returns the resulting vertex size
+    unsigned int AttachVertexData(ImportedMesh& mesh, const std::vector<uint32_t>* controlPoints)
+    {
+        const bool skinned = mesh.IsSkinned();
+        const unsigned int vertexSize = ImportedMesh::VertexSize + (skinned ? SkinComponents : 0) + (controlPoints ? 1 : 0);
+        if (vertexSize == ImportedMesh::VertexSize) return vertexSize;
+
+        const unsigned int vertexCount = mesh.GetVertexCount();
+        std::vector<GLfloat> vertices((size_t)vertexCount * vertexSize);
+        for (unsigned int i = 0; i < vertexCount; ++i) {
+            GLfloat* vertex = &vertices[(size_t)i * vertexSize];
+            memcpy(vertex, &mesh.vertices[(size_t)i * ImportedMesh::VertexSize], sizeof(GLfloat) * ImportedMesh::VertexSize);
+            GLfloat* extra = vertex + ImportedMesh::VertexSize;
+            if (skinned) {
+                const SkinVertex& skin = mesh.skinVertices[i];
+                for (int slot = 0; slot < 4; ++slot) {
+                    extra[slot] = skin.boneIndices[slot];
+                    extra[4 + slot] = skin.boneWeights[slot];
+                }
+                extra += SkinComponents;
+            }
+            if (controlPoints) extra[0] = (GLfloat)(*controlPoints)[i];
+        }
+        mesh.vertices.swap(vertices);
+        mesh.skinVertices.clear();
+        return vertexSize;
+    }
+
+    void DetachVertexData(ImportedMesh& mesh, unsigned int vertexSize, bool skinned, std::vector<uint32_t>* controlPoints)
+    {
+        if (vertexSize == ImportedMesh::VertexSize) return;
+
+        const size_t vertexCount = mesh.vertices.size() / vertexSize;
+        std::vector<GLfloat> vertices(vertexCount * ImportedMesh::VertexSize);
+        if (skinned) mesh.skinVertices.resize(vertexCount);
+        if (controlPoints) controlPoints->resize(vertexCount);
+        for (size_t i = 0; i < vertexCount; ++i) {
+            const GLfloat* vertex = &mesh.vertices[i * vertexSize];
+            memcpy(&vertices[i * ImportedMesh::VertexSize], vertex, sizeof(GLfloat) * ImportedMesh::VertexSize);
+            const GLfloat* extra = vertex + ImportedMesh::VertexSize;
+            if (skinned) {
+                SkinVertex& skin = mesh.skinVertices[i];
+                for (int slot = 0; slot < 4; ++slot) {
+                    skin.boneIndices[slot] = (uint8_t)extra[slot];
+                    skin.boneWeights[slot] = (uint16_t)extra[4 + slot];
+                }
+                extra += SkinComponents;
+            }
+            if (controlPoints) (*controlPoints)[i] = (uint32_t)extra[0];
+        }
+        mesh.vertices.swap(vertices);
+    }
+
+    int16_t QuantizeDelta(float value, float toSnorm)
+    {
+        return (int16_t)std::min(std::max(lrintf(value * toSnorm), -32767l), 32767l);
+    }
+
+    // groups the deltas by vertex, the ones too small to survive quantization are dropped
+    void BuildMorphTargets(MorphSource& morphs, ImportedMesh& mesh)
+    {
+        std::vector<ControlPointDelta>& deltas = morphs.deltas;
+        std::stable_sort(deltas.begin(), deltas.end(), [](const ControlPointDelta& a, const ControlPointDelta& b) { return a.controlPoint < b.controlPoint; });
+        std::vector<uint32_t> controlPointStarts(morphs.controlPointCount + 1, 0);
+        for (const ControlPointDelta& delta : deltas) ++controlPointStarts[delta.controlPoint + 1];
+        for (uint32_t i = 0; i < morphs.controlPointCount; ++i) controlPointStarts[i + 1] += controlPointStarts[i];
+
+        float positionScale = 0.0f;
+        float normalScale = 0.0f;
+        for (const ControlPointDelta& delta : deltas) {
+            for (int axis = 0; axis < 3; ++axis) {
+                positionScale = std::max(positionScale, fabsf(delta.position[axis]));
+                normalScale = std::max(normalScale, fabsf(delta.normal[axis]));
+            }
+        }
+        const float positionToSnorm = positionScale > 0.0f ? 32767.0f / positionScale : 0.0f;
+        const float normalToSnorm = normalScale > 0.0f ? 32767.0f / normalScale : 0.0f;
+
+        const unsigned int vertexCount = mesh.GetVertexCount();
+        mesh.morphStarts.assign(vertexCount + 1, 0);
+        mesh.morphDeltas.clear();
+        for (unsigned int vertex = 0; vertex < vertexCount; ++vertex) {
+            const uint32_t controlPoint = morphs.vertexControlPoints[vertex];
+            if (controlPoint < morphs.controlPointCount) {
+                for (uint32_t i = controlPointStarts[controlPoint]; i < controlPointStarts[controlPoint + 1]; ++i) {
+                    MorphDelta quantized = {};
+                    quantized.target = (uint16_t)deltas[i].target;
+                    bool moves = false;
+                    for (int axis = 0; axis < 3; ++axis) {
+                        quantized.position[axis] = QuantizeDelta(deltas[i].position[axis], positionToSnorm);
+                        quantized.normal[axis] = QuantizeDelta(deltas[i].normal[axis], normalToSnorm);
+                        moves = moves || quantized.position[axis] != 0 || quantized.normal[axis] != 0;
+                    }
+                    if (moves) mesh.morphDeltas.push_back(quantized);
+                }
+            }
+            mesh.morphStarts[vertex + 1] = (uint32_t)mesh.morphDeltas.size();
+        }
+
+        if (mesh.morphDeltas.empty()) {
+            mesh.morphTargetNames.clear();
+            mesh.morphStarts.clear();
+            return;
+        }
+        mesh.morphPositionScale = positionScale;
+        mesh.morphNormalScale = normalScale;
+    }
+
+    // a level hardly smaller than the one before isn't worth its indices, the simplification got stuck on the error limit
+    const float MinLodReduction = 0.9f;
+
+    // the full mesh becomes the first level, the others are simplified from it and appended to the index buffer
+    void BuildLods(const FbxImportSettings& settings, ImportedMesh& mesh, unsigned int vertexCount, unsigned int vertexSize)
+    {
+        const uint32_t submeshCount = (uint32_t)mesh.submeshes.size();
+        mesh.lods.push_back({ 0, (uint32_t)mesh.indices.size(), 0, 0.0f, 0, 0 });
+
+        std::vector<GLuint> simplified;
+        float reduction = 1.0f;
+        for (unsigned int level = 1; level <= settings.lodCount; ++level) {
+            reduction *= settings.lodReduction;
+            const MeshLod& previous = mesh.lods.back();
+            MeshLod lod = { (uint32_t)mesh.indices.size(), 0, (uint32_t)mesh.submeshes.size(), previous.error, 0, 0 };
+            for (uint32_t i = 0; i < submeshCount; ++i) {
+                const Submesh source = mesh.submeshes[i];
+                const size_t targetIndexCount = (size_t)(source.indexCount / 3 * reduction) * 3;
+                const float error = MeshSimplifier::Simplify(mesh.indices.data() + source.firstIndex, source.indexCount, mesh.vertices.data(), vertexCount, vertexSize,
+                    targetIndexCount, settings.lodMaxError, simplified);
+                Submesh submesh;
+                submesh.firstIndex = (unsigned int)mesh.indices.size();
+                submesh.indexCount = (unsigned int)simplified.size();
+                mesh.indices.insert(mesh.indices.end(), simplified.begin(), simplified.end());
+                mesh.submeshes.push_back(submesh);
+                lod.error = std::max(lod.error, error);
+            }
+            lod.indexCount = (uint32_t)mesh.indices.size() - lod.firstIndex;
+
+            if (lod.indexCount > previous.indexCount * MinLodReduction) {
+                mesh.indices.resize(lod.firstIndex);
+                mesh.submeshes.resize(lod.firstSubmesh);
+                break;
+            }
+            mesh.lods.push_back(lod);
+        }
+    }
+
+    // splits the submeshes of each level into meshlets, so a level draws from a contiguous range of them
+    void BuildMeshlets(ImportedMesh& mesh, unsigned int vertexCount, unsigned int vertexSize, bool optimizeVertexCache)
+    {
+        for (size_t level = 0; level < mesh.lods.size(); ++level) {
+            MeshLod& lod = mesh.lods[level];
+            const size_t submeshEnd = level + 1 < mesh.lods.size() ? mesh.lods[level + 1].firstSubmesh : mesh.submeshes.size();
+            lod.firstMeshlet = (uint32_t)mesh.meshlets.size();
+            for (size_t i = lod.firstSubmesh; i < submeshEnd; ++i) {
+                const Submesh& submesh = mesh.submeshes[i];
+                MeshletBuilder::Partition(mesh.indices.data() + submesh.firstIndex, submesh.indexCount, submesh.firstIndex,
+                    mesh.vertices.data(), vertexCount, vertexSize, mesh.meshlets);
+            }
+            lod.meshletCount = (uint32_t)mesh.meshlets.size() - lod.firstMeshlet;
+        }
+        if (!optimizeVertexCache) return;
+
+        // the cache order is restored inside each meshlet, on local indices so the cost doesn't grow with the mesh
+        std::vector<GLuint> local;
+        std::vector<GLuint> global;
+        std::vector<GLuint> localIndex(vertexCount, ~0u);
+        for (const Meshlet& meshlet : mesh.meshlets) {
+            GLuint* indices = mesh.indices.data() + meshlet.firstIndex;
+            local.resize(meshlet.indexCount);
+            global.clear();
+            for (uint32_t i = 0; i < meshlet.indexCount; ++i) {
+                if (localIndex[indices[i]] == ~0u) {
+                    localIndex[indices[i]] = (GLuint)global.size();
+                    global.push_back(indices[i]);
+                }
+                local[i] = localIndex[indices[i]];
+            }
+            MeshOptimizer::OptimizeVertexCache(local.data(), local.size(), (unsigned int)global.size());
+            for (uint32_t i = 0; i < meshlet.indexCount; ++i) indices[i] = global[local[i]];
+            for (GLuint vertex : global) localIndex[vertex] = ~0u;
+        }
+    }
+
+    // the levels of detail follow the full mesh in the index buffer, the stats only look at the full one
+    VertexCacheStats AnalyzeFullMesh(const ImportedMesh& mesh, unsigned int vertexCount)
+    {
+        if (mesh.lods.size() <= 1) return MeshOptimizer::AnalyzeVertexCache(mesh.indices, vertexCount);
+        const std::vector<GLuint> indices(mesh.indices.begin(), mesh.indices.begin() + mesh.lods[0].indexCount);
+        return MeshOptimizer::AnalyzeVertexCache(indices, vertexCount);
+    }
+
+    void ComputeBounds(ImportedMesh& mesh)
+    {
+        const unsigned int vertexCount = mesh.GetVertexCount();
+        for (int axis = 0; axis < 3; ++axis) {
+            mesh.boundsMin[axis] = vertexCount ? mesh.vertices[axis] : 0.0f;
+            mesh.boundsMax[axis] = mesh.boundsMin[axis];
+        }
+        for (unsigned int i = 1; i < vertexCount; ++i) {
+            const GLfloat* position = &mesh.vertices[(size_t)i * ImportedMesh::VertexSize];
+            for (int axis = 0; axis < 3; ++axis) {
+                if (position[axis] < mesh.boundsMin[axis]) mesh.boundsMin[axis] = position[axis];
+                if (position[axis] > mesh.boundsMax[axis]) mesh.boundsMax[axis] = position[axis];
+            }
+        }
+    }
+
+    // node driven by curve nodes of a layer, -1 for the properties keeping their value from the file
+    struct AnimatedNode
+    {
+        const ofbx::Object* node;
+        int curveNodes[AnimationClip::ChannelCount];
+    };
+
+    // splits a local matrix into translation, rotation and scale, a mirroring goes to the x scale
+    void Decompose(const ofbx::DMatrix& matrix, BonePose& outPose)
+    {
+        const double* m = matrix.m;
+        double axes[3][3];
+        double scale[3];
+        for (int column = 0; column < 3; ++column) {
+            scale[column] = sqrt(m[column * 4] * m[column * 4] + m[column * 4 + 1] * m[column * 4 + 1] + m[column * 4 + 2] * m[column * 4 + 2]);
+            for (int row = 0; row < 3; ++row) axes[column][row] = scale[column] > 0.0 ? m[column * 4 + row] / scale[column] : (row == column ? 1.0 : 0.0);
+        }
+        const double determinant = axes[0][0] * (axes[1][1] * axes[2][2] - axes[2][1] * axes[1][2])
+            - axes[1][0] * (axes[0][1] * axes[2][2] - axes[2][1] * axes[0][2])
+            + axes[2][0] * (axes[0][1] * axes[1][2] - axes[1][1] * axes[0][2]);
+        if (determinant < 0.0) {
+            scale[0] = -scale[0];
+            for (int row = 0; row < 3; ++row) axes[0][row] = -axes[0][row];
+        }
+
+        // rotation matrix to quaternion, axes[column][row]
+        double q[4];
+        const double trace = axes[0][0] + axes[1][1] + axes[2][2];
+        if (trace > 0.0) {
+            const double s = sqrt(trace + 1.0) * 2.0;
+            q[3] = 0.25 * s;
+            q[0] = (axes[1][2] - axes[2][1]) / s;
+            q[1] = (axes[2][0] - axes[0][2]) / s;
+            q[2] = (axes[0][1] - axes[1][0]) / s;
+        }
+        else if (axes[0][0] > axes[1][1] && axes[0][0] > axes[2][2]) {
+            const double s = sqrt(1.0 + axes[0][0] - axes[1][1] - axes[2][2]) * 2.0;
+            q[3] = (axes[1][2] - axes[2][1]) / s;
+            q[0] = 0.25 * s;
+            q[1] = (axes[1][0] + axes[0][1]) / s;
+            q[2] = (axes[2][0] + axes[0][2]) / s;
         }
+        else if (axes[1][1] > axes[2][2]) {
+            const double s = sqrt(1.0 + axes[1][1] - axes[0][0] - axes[2][2]) * 2.0;
+            q[3] = (axes[2][0] - axes[0][2]) / s;
+            q[0] = (axes[1][0] + axes[0][1]) / s;
+            q[1] = 0.25 * s;
+            q[2] = (axes[2][1] + axes[1][2]) / s;
+        }
+        else {
+            const double s = sqrt(1.0 + axes[2][2] - axes[0][0] - axes[1][1]) * 2.0;
+            q[3] = (axes[0][1] - axes[1][0]) / s;
+            q[0] = (axes[2][0] + axes[0][2]) / s;
+            q[1] = (axes[2][1] + axes[1][2]) / s;
+            q[2] = 0.25 * s;
+        }
+        const double length = sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+
+        for (int i = 0; i < 3; ++i) {
+            outPose.translation[i] = (float)m[12 + i];
+            outPose.scale[i] = (float)scale[i];
+        }
+        for (int i = 0; i < 4; ++i) outPose.rotation[i] = (float)(q[i] / length);
+    }
+
+    // resamples the first layer of the stack at a fixed rate, the local transforms are evaluated
+    // like Object::evalLocal so pre and post rotations, pivots and offsets are baked in
+    bool BakeStack(const ofbx::IScene& scene, const ofbx::AnimationStack& stack, float sampleRate, BakedAnimation& outAnimation, uint64_t& outSourceCurveBytes)
+    {
+        const ofbx::AnimationLayer* layer = stack.getLayer(0);
+        if (!layer) return false;
+
+        ofbx::AnimationSampler* sampler = ofbx::createAnimationSampler(*layer);
+        const char* properties[AnimationClip::ChannelCount] = { "Lcl Translation", "Lcl Rotation", "Lcl Scaling" };
+
+        std::vector<AnimatedNode> nodes;
+        std::unordered_map<const ofbx::Object*, size_t> nodeIndices;
+        std::unordered_set<const ofbx::AnimationCurve*> curves;
+        ofbx::i64 firstKey = 0;
+        ofbx::i64 lastKey = 0;
+        outSourceCurveBytes = 0;
+        for (int i = 0; i < sampler->getCurveNodeCount(); ++i) {
+            const ofbx::AnimationCurveNode* curveNode = sampler->getCurveNode(i);
+            const ofbx::Object* node = curveNode->getBone();
+            int channel = 0;
+            while (channel < AnimationClip::ChannelCount && !(curveNode->getBoneLinkProperty() == properties[channel])) ++channel;
+            if (!node || channel == AnimationClip::ChannelCount) continue;
+
+            auto inserted = nodeIndices.emplace(node, nodes.size());
+            if (inserted.second) nodes.push_back({ node, { -1, -1, -1 } });
+            nodes[inserted.first->second].curveNodes[channel] = i;
+
+            for (int axis = 0; axis < 3; ++axis) {
+                const ofbx::AnimationCurve* curve = curveNode->getCurve(axis);
+                if (!curve || curve->getKeyCount() == 0 || !curves.insert(curve).second) continue;
+                const ofbx::i64* times = curve->getKeyTime();
+                if (curves.size() == 1 || times[0] < firstKey) firstKey = times[0];
+                if (curves.size() == 1 || times[curve->getKeyCount() - 1] > lastKey) lastKey = times[curve->getKeyCount() - 1];
+                outSourceCurveBytes += (uint64_t)curve->getKeyCount() * (sizeof(ofbx::i64) + sizeof(float));
+            }
+        }
+
+        // the take range when the file has one, the keys otherwise
+        double from = ofbx::fbxTimeToSeconds(firstKey);
+        double to = ofbx::fbxTimeToSeconds(lastKey);
+        const ofbx::TakeInfo* take = scene.getTakeInfo(stack.name);
+        if (take && take->local_time_to > take->local_time_from) {
+            from = take->local_time_from;
+            to = take->local_time_to;
+        }
+
+        outAnimation = BakedAnimation();
+        outAnimation.name = stack.name;
+        outAnimation.sampleRate = sampleRate;
+        outAnimation.frameCount = (uint32_t)ceil((to - from) * sampleRate - 1e-6) + 1;
+        for (const AnimatedNode& node : nodes) outAnimation.trackNames.push_back(node.node->name);
+        outAnimation.poses.resize(nodes.size() * outAnimation.frameCount);
+
+        std::vector<ofbx::DVec3> values(sampler->getCurveNodeCount());
+        for (uint32_t frame = 0; frame < outAnimation.frameCount; ++frame) {
+            const double time = frame + 1 < outAnimation.frameCount ? from + frame / (double)sampleRate : to;
+            sampler->sample(time, values.data());
+
+            for (size_t i = 0; i < nodes.size(); ++i) {
+                const AnimatedNode& node = nodes[i];
+                const ofbx::DVec3 translation = node.curveNodes[0] >= 0 ? values[node.curveNodes[0]] : node.node->getLocalTranslation();
+                const ofbx::DVec3 rotation = node.curveNodes[1] >= 0 ? values[node.curveNodes[1]] : node.node->getLocalRotation();
+                const ofbx::DVec3 scaling = node.curveNodes[2] >= 0 ? values[node.curveNodes[2]] : node.node->getLocalScaling();
+                Decompose(node.node->evalLocal(translation, rotation, scaling), outAnimation.poses[i * outAnimation.frameCount + frame]);
+            }
+        }
+
+        sampler->destroy();
+        return true;
+    }
+
+    uint64_t HashAnimationSettings(const AnimationImportSettings& settings)
+    {
+        const float values[] = {
+            settings.sampleRate,
+            settings.compression.translationTolerance,
+            settings.compression.rotationToleranceDegrees,
+            settings.compression.scaleTolerance,
+        };
+        return MeshCache::Hash(values, sizeof(values));
+    }
+
+    struct BatchJob
+    {
+        const char* filepath;
+        const FbxImportSettings* settings;
+        ImportedMesh* mesh;
+        FbxBatchResult* result;
+    };
+
+    void RunBatchJob(void* data)
+    {
+        BatchJob& job = *(BatchJob*)data;
+        job.result->imported = FbxImporter::ImportFBX(job.filepath, *job.mesh, *job.settings, &job.result->stats, &job.result->error);
+    }
+
+    static_assert((int)ImportedTexture::Usage::Reflection == ofbx::Texture::REFLECTION, "ImportedTexture::Usage follows ofbx::Texture::TextureType");
+
+    std::string ToString(const ofbx::DataView& view)
+    {
+        return view.begin ? std::string((const char*)view.begin, (const char*)view.end) : std::string();
+    }
+
+    struct TextureJob
+    {
+        const ofbx::Texture* texture;
+        // the directory of the FBX, ending with its separator
+        const std::string* directory;
+        ImportedTexture* output;
+        bool found;
+        uint64_t base64Bytes;
+        float base64Milliseconds;
+    };
+
+    bool ReadWholeFile(const std::string& path, std::vector<uint8_t>& outBytes)
+    {
+        MappedFile file;
+        if (!file.Open(path.c_str())) return false;
+        outBytes.assign(file.GetData(), file.GetData() + file.GetSize());
+        return true;
+    }
+
+    // tries the relative name next to the FBX, the absolute name, then the bare file name next to the FBX,
+    // the one that works when the textures were copied along with the model
+    bool ReadReferencedTexture(const ofbx::Texture& texture, const std::string& directory, std::vector<uint8_t>& outBytes)
+    {
+        std::string relative = ToString(texture.getRelativeFileName());
+        std::string absolute = ToString(texture.getFileName());
+        std::replace(relative.begin(), relative.end(), '\\', '/');
+        std::replace(absolute.begin(), absolute.end(), '\\', '/');
+
+        if (!relative.empty() && ReadWholeFile(directory + relative, outBytes)) return true;
+        if (!absolute.empty() && ReadWholeFile(absolute, outBytes)) return true;
+        const std::string& named = absolute.empty() ? relative : absolute;
+        const size_t slash = named.find_last_of('/');
+        return !named.empty() && ReadWholeFile(directory + named.substr(slash == std::string::npos ? 0 : slash + 1), outBytes);
     }
 
+    void RunTextureJob(void* data)
+    {
+        TextureJob& job = *(TextureJob*)data;
+        ImportedTexture& output = *job.output;
+
+        const ofbx::DataView content = job.texture->getEmbeddedData();
+        if (content.begin && content.end - content.begin > 4) {
+            // binary files store the raw bytes, after their length
+            output.embedded = true;
+            output.encodedImage.assign(content.begin + 4, content.end);
+            job.found = true;
+            return;
+        }
+
+        const ofbx::IElementProperty* chunk = job.texture->getEmbeddedBase64Data();
+        if (chunk) {
+            // text files split the base64 in quoted chunks, each padded on its own
+            std::string text;
+            for (; chunk; chunk = chunk->getNext()) {
+                const ofbx::DataView value = chunk->getValue();
+                text.append((const char*)value.begin, (const char*)value.end);
+            }
+            auto decodeStart = std::chrono::steady_clock::now();
+            job.found = Base64::Decode(text.data(), text.size(), output.encodedImage) && !output.encodedImage.empty();
+            job.base64Milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - decodeStart).count();
+            job.base64Bytes = text.size();
+            output.embedded = true;
+            return;
+        }
+
+        job.found = ReadReferencedTexture(*job.texture, *job.directory, output.encodedImage);
+    }
+
+    // quantization is cheap and not part of the cooked file, it runs after importing or loading it
+    void QuantizeVertices(const FbxImportSettings& settings, ImportedMesh& mesh, FbxImportStats* outStats)
+    {
+        if (!settings.quantizeVertices) return;
+        VertexQuantizer::Quantize(mesh);
+        if (outStats) outStats->quantizationError = VertexQuantizer::MeasureError(mesh);
+    }
+}
+
+bool FbxImporter::ImportFBX(const char* filepath, ImportedMesh& outMesh, const FbxImportSettings& settings, FbxImportStats* outStats, std::string* outError)
+{
+    outMesh = ImportedMesh();
+    if (outError) outError->clear();
+    auto parseStart = std::chrono::steady_clock::now();
+
+    uint64_t sourceHash = 0;
+    uint64_t settingsHash = 0;
+    std::string cachePath;
+    if (settings.useMeshCache) {
+        MappedFile source;
+        if (!source.Open(filepath)) return Fail(outError, "Cannot open the file");
+        sourceHash = MeshCache::Hash(source.GetData(), source.GetSize());
+        settingsHash = HashSettings(settings);
+        cachePath = std::string(filepath) + ".mumesh";
+
+        unsigned int sourceVertexCount = 0;
+        if (MeshCache::Load(cachePath.c_str(), sourceHash, settingsHash, outMesh, &sourceVertexCount)) {
+            if (outStats) {
+                *outStats = FbxImportStats();
+                outStats->loadedFromCache = true;
+                outStats->sourceVertexCount = sourceVertexCount;
+                outStats->outputVertexCount = outMesh.GetVertexCount();
+                outStats->parseMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - parseStart).count();
+                outStats->cacheStatsBefore = outStats->cacheStatsAfter = AnalyzeFullMesh(outMesh, outMesh.GetVertexCount());
+                outStats->boneCount = (unsigned int)outMesh.skeleton.bones.size();
+                outStats->morphTargetCount = (unsigned int)outMesh.morphTargetNames.size();
+                outStats->morphDeltaCount = (unsigned int)outMesh.morphDeltas.size();
+                outStats->lodCount = (unsigned int)outMesh.lods.size();
+                outStats->meshletCount = (unsigned int)outMesh.meshlets.size();
+            }
+            QuantizeVertices(settings, outMesh, outStats);
+            return true;
+        }
+    }
+
+    MorphSource morphs;
+    bool loaded = settings.streamGeometry ? StreamGeometries(filepath, settings, outMesh, outError)
+        : LoadScene(filepath, settings, outMesh, settings.importBlendShapes ? &morphs : nullptr, outError);
+    if (!loaded) return false;
+    float parseMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - parseStart).count();
+
+    const unsigned int polygonCount = outMesh.GetVertexCount();
+    const bool skinned = outMesh.IsSkinned();
+    const bool morphed = !morphs.vertexControlPoints.empty();
+    const unsigned int vertexSize = AttachVertexData(outMesh, morphed ? &morphs.vertexControlPoints : nullptr);
+
+    unsigned int outputVertexCount = polygonCount;
+    if (settings.weldVertices)
+        outputVertexCount = MeshWelder::Weld(outMesh.vertices, outMesh.indices, vertexSize, settings.weldEpsilon);
+
+    if (outStats)
+        outStats->cacheStatsBefore = MeshOptimizer::AnalyzeVertexCache(outMesh.indices, outputVertexCount);
+
+    // the levels reuse the vertices of the full mesh, skin and morph data included
+    BuildLods(settings, outMesh, outputVertexCount, vertexSize);
+
+    if (settings.optimizeVertexCache) {
+        // triangles only move inside their submesh, so the ranges of the submeshes and levels stay valid
+        for (const Submesh& submesh : outMesh.submeshes) {
+            GLuint* indices = outMesh.indices.data() + submesh.firstIndex;
+            MeshOptimizer::OptimizeVertexCache(indices, submesh.indexCount, outputVertexCount);
+            if (settings.optimizeOverdraw && !settings.buildMeshlets)
+                MeshOptimizer::OptimizeOverdraw(indices, submesh.indexCount, outMesh.vertices.data(), outputVertexCount, vertexSize);
+        }
+    }
+    // only the order of the triangles changes from here, the vertex reordering below keeps the meshlet ranges
+    if (settings.buildMeshlets)
+        BuildMeshlets(outMesh, outputVertexCount, vertexSize, settings.optimizeVertexCache);
+    if (settings.optimizeVertexCache)
+        outputVertexCount = MeshOptimizer::OptimizeVertexFetch(outMesh.vertices, outMesh.indices, vertexSize);
+
+    DetachVertexData(outMesh, vertexSize, skinned, morphed ? &morphs.vertexControlPoints : nullptr);
+    if (morphed) BuildMorphTargets(morphs, outMesh);
+    ComputeBounds(outMesh);
+    // the bounds need the final skin and morph data
+    for (Meshlet& meshlet : outMesh.meshlets) MeshletBuilder::ComputeBounds(outMesh, meshlet);
+
+    // a failed write only means importing again next time
+    if (settings.useMeshCache)
+        MeshCache::Save(cachePath.c_str(), sourceHash, settingsHash, outMesh, polygonCount);
+
+    if (outStats) {
+        outStats->loadedFromCache = false;
+        outStats->sourceVertexCount = polygonCount;
+        outStats->outputVertexCount = outputVertexCount;
+        outStats->parseMilliseconds = parseMilliseconds;
+        outStats->cacheStatsAfter = AnalyzeFullMesh(outMesh, outputVertexCount);
+        outStats->boneCount = (unsigned int)outMesh.skeleton.bones.size();
+        outStats->morphTargetCount = (unsigned int)outMesh.morphTargetNames.size();
+        outStats->morphDeltaCount = (unsigned int)outMesh.morphDeltas.size();
+        outStats->lodCount = (unsigned int)outMesh.lods.size();
+        outStats->meshletCount = (unsigned int)outMesh.meshlets.size();
+    }
+
+    QuantizeVertices(settings, outMesh, outStats);
+    return true;
+}
+
+void FbxImporter::ImportFBXBatch(const std::vector<std::string>& filepaths, std::vector<ImportedMesh>& outMeshes, std::vector<FbxBatchResult>& outResults,
+    const FbxImportSettings& settings)
+{
+    outMeshes.clear();
+    outMeshes.resize(filepaths.size());
+    outResults.clear();
+    outResults.resize(filepaths.size());
+
+    // a file per job, the jobs ofbx::load dispatches for the arrays of a file are stolen by the idle workers
+    std::vector<BatchJob> jobs(filepaths.size());
+    for (size_t i = 0; i < filepaths.size(); ++i) {
+        jobs[i] = { filepaths[i].c_str(), &settings, &outMeshes[i], &outResults[i] };
+    }
+    JobSystem::ParallelFor(&RunBatchJob, jobs.data(), sizeof(BatchJob), (unsigned int)jobs.size());
+}
+
+bool FbxImporter::ImportAnimations(const char* filepath, std::vector<AnimationClip>& outClips, const AnimationImportSettings& settings, AnimationImportStats* outStats,
+    std::string* outError)
+{
+    outClips.clear();
+    if (outError) outError->clear();
+    if (outStats) *outStats = AnimationImportStats();
+    auto importStart = std::chrono::steady_clock::now();
+
+    MappedFile file;
+    if (!file.Open(filepath)) return Fail(outError, "Cannot open the file");
+
+    uint64_t sourceHash = 0;
+    uint64_t settingsHash = 0;
+    std::string cachePath;
+    bool loaded = false;
+    if (settings.useAnimationCache) {
+        sourceHash = MeshCache::Hash(file.GetData(), file.GetSize());
+        settingsHash = HashAnimationSettings(settings);
+        cachePath = std::string(filepath) + ".muanim";
+        loaded = AnimationClip::Load(cachePath.c_str(), sourceHash, settingsHash, outClips);
+    }
+
+    if (!loaded) {
+        ofbx::IScene* scene = ofbx::load(file.GetData(), file.GetSize(), (ofbx::u16)AnimationImportFlags, &JobSystem::OfbxJobProcessor);
+        if (!scene) return Fail(outError, ofbx::getError());
+
+        BakedAnimation animation;
+        for (int i = 0; i < scene->getAnimationStackCount(); ++i) {
+            uint64_t sourceCurveBytes = 0;
+            AnimationClip clip;
+            if (!BakeStack(*scene, *scene->getAnimationStack(i), settings.sampleRate, animation, sourceCurveBytes)) continue;
+            if (!AnimationCompressor::Compress(animation, settings.compression, clip)) continue;
+            clip.sourceCurveBytes = sourceCurveBytes;
+
+            if (outStats) {
+                AnimationCompressionError error = AnimationCompressor::MeasureError(animation, clip);
+                AnimationCompressionError& worst = outStats->compressionError;
+                worst.translation = error.translation > worst.translation ? error.translation : worst.translation;
+                worst.rotationDegrees = error.rotationDegrees > worst.rotationDegrees ? error.rotationDegrees : worst.rotationDegrees;
+                worst.scale = error.scale > worst.scale ? error.scale : worst.scale;
+            }
+            outClips.push_back(std::move(clip));
+        }
+        scene->destroy();
+
+        if (settings.useAnimationCache)
+            AnimationClip::Save(cachePath.c_str(), sourceHash, settingsHash, outClips);
+    }
+
+    if (outStats) {
+        outStats->loadedFromCache = loaded;
+        for (const AnimationClip& clip : outClips) {
+            outStats->sourceCurveBytes += clip.sourceCurveBytes;
+            outStats->clipBytes += clip.GetMemorySize();
+        }
+        outStats->importMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - importStart).count();
+    }
+    return true;
+}
+
+bool FbxImporter::ImportTextures(const char* filepath, std::vector<ImportedTexture>& outTextures, TextureImportStats* outStats, std::string* outError)
+{
+    outTextures.clear();
+    if (outError) outError->clear();
+    if (outStats) *outStats = TextureImportStats();
+    auto importStart = std::chrono::steady_clock::now();
+
+    MappedFile file;
+    if (!file.Open(filepath)) return Fail(outError, "Cannot open the file");
+    ofbx::IScene* scene = ofbx::load(file.GetData(), file.GetSize(), (ofbx::u16)TextureImportFlags, &JobSystem::OfbxJobProcessor);
+    if (!scene) return Fail(outError, ofbx::getError());
+
+    const std::string path = filepath;
+    const size_t separator = path.find_last_of("/\\");
+    const std::string directory = separator == std::string::npos ? std::string() : path.substr(0, separator + 1);
+
+    // materials share textures, each one is extracted once, for its first slot
+    std::vector<ImportedTexture> textures;
+    std::vector<TextureJob> jobs;
+    std::unordered_set<const ofbx::Texture*> seen;
+    const ofbx::Object* const* objects = scene->getAllObjects();
+    for (int i = 0; i < scene->getAllObjectCount(); ++i) {
+        if (objects[i]->getType() != ofbx::Object::Type::MATERIAL) continue;
+        const ofbx::Material& material = *(const ofbx::Material*)objects[i];
+        for (int type = 0; type < ofbx::Texture::COUNT; ++type) {
+            const ofbx::Texture* texture = material.getTexture((ofbx::Texture::TextureType)type);
+            if (!texture || !seen.insert(texture).second) continue;
+
+            ImportedTexture imported;
+            imported.usage = (ImportedTexture::Usage)type;
+            imported.materialName = material.name;
+            imported.path = ToString(texture->getRelativeFileName());
+            if (imported.path.empty()) imported.path = ToString(texture->getFileName());
+            textures.push_back(std::move(imported));
+            jobs.push_back({ texture, &directory, nullptr, false, 0, 0.0f });
+        }
+    }
+    for (size_t i = 0; i < jobs.size(); ++i) jobs[i].output = &textures[i];
+
+    JobSystem::ParallelFor(&RunTextureJob, jobs.data(), sizeof(TextureJob), (unsigned int)jobs.size());
+    scene->destroy();
+
+    TextureImportStats stats;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        stats.base64Bytes += jobs[i].base64Bytes;
+        stats.base64Milliseconds += jobs[i].base64Milliseconds;
+        if (!jobs[i].found) {
+            ++stats.missingCount;
+            continue;
+        }
+        if (textures[i].embedded) ++stats.embeddedCount;
+        else ++stats.referencedCount;
+        outTextures.push_back(std::move(textures[i]));
+    }
+
+    if (outStats) {
+        *outStats = stats;
+        outStats->importMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - importStart).count();
+    }
     return true;
 }
@@ -1,10 +1,161 @@
 #pragma once
 #include "gl/glew.h"
+#include "AnimationClip.h"
+#include "AnimationCompressor.h"
+#include "ImportedMesh.h"
+#include "MeshOptimizer.h"
+#include "VertexQuantizer.h"
+#include <stdint.h>
+#include <string>
 #include <vector>
 
+/// Optional processing applied to the imported geometry.
+struct FbxImportSettings
+{
+    /// Merge polygon-vertices sharing position, normal and uv so the index buffer gets real reuse.
+    bool weldVertices = false;
+    /// Attributes closer than this weld together, 0 only welds bitwise equal vertices.
+    float weldEpsilon = 0.0f;
+    /// Reorder triangles for post-transform vertex cache locality, then vertices in first use order.
+    bool optimizeVertexCache = false;
+    /// Also reorder triangle clusters to reduce overdraw, only used together with optimizeVertexCache and not with buildMeshlets,
+    /// whose triangles must stay together.
+    bool optimizeOverdraw = false;
+    /// Decode vertex arrays and postprocess geometry on the JobSystem threads.
+    bool parallelParsing = true;
+    /// Read binary files one geometry record at a time instead of loading the whole scene,
+    /// so memory is bounded by the biggest mesh. Meant for huge files, text FBX isn't supported.
+    bool streamGeometry = false;
+    /// Save the result next to the source as <file>.mumesh and load that instead while the source is unchanged.
+    bool useMeshCache = false;
+    /// Also fill ImportedMesh::quantizedVertices, the 16 byte layout meant for upload.
+    bool quantizeVertices = false;
+    /// Convert the skin clusters into ImportedMesh::skinVertices and the skeleton, the four strongest bones per vertex.
+    /// Not available with streamGeometry, which has no scene to find the skins in.
+    bool importSkin = false;
+    /// Convert the blend shapes into sparse ImportedMesh morph targets, a channel per target. Not available with streamGeometry either.
+    bool importBlendShapes = false;
+    /// Levels of detail simplified from the full mesh and appended to its index buffer, see ImportedMesh::lods.
+    /// Needs weldVertices, unwelded corners share no edges to collapse.
+    unsigned int lodCount = 0;
+    /// Each level aims at this fraction of the triangles of the level before.
+    float lodReduction = 0.5f;
+    /// Largest error a level may reach relative to the size of the mesh, its simplification stops there.
+    float lodMaxError = 0.05f;
+    /// Split every level of detail into meshlets with their culling bounds, see ImportedMesh::meshlets.
+    bool buildMeshlets = false;
+};
+
+/// Figures gathered while importing, for logging and profiling.
+struct FbxImportStats
+{
+    /// The mesh came from the cooked file, nothing was parsed.
+    bool loadedFromCache = false;
+    /// One vertex per polygon corner, as found in the file.
+    unsigned int sourceVertexCount = 0;
+    /// Vertices written to the output after welding.
+    unsigned int outputVertexCount = 0;
+    /// Vertex cache efficiency of the index buffer before and after optimization, of the full mesh only.
+    VertexCacheStats cacheStatsBefore;
+    VertexCacheStats cacheStatsAfter;
+    /// Time spent reading, tokenizing and decoding the file, or loading the cooked one.
+    float parseMilliseconds = 0.0f;
+    /// Filled when quantizeVertices is set.
+    QuantizationError quantizationError;
+    /// Bones of the palette, 0 when the mesh isn't skinned.
+    unsigned int boneCount = 0;
+    /// 0 when the mesh has no blend shapes.
+    unsigned int morphTargetCount = 0;
+    /// Vertices moved summed over all the targets, each a 16 byte MorphDelta.
+    unsigned int morphDeltaCount = 0;
+    /// Levels of detail including the full mesh, fewer than asked for when simplifying stalls.
+    unsigned int lodCount = 0;
+    /// Meshlets of all the levels, 0 unless buildMeshlets is set.
+    unsigned int meshletCount = 0;
+
+    float GetVertexReductionRatio() const { return outputVertexCount ? (float)sourceVertexCount / outputVertexCount : 1.0f; }
+};
+
+/// How the animation stacks are baked into clips.
+struct AnimationImportSettings
+{
+    /// Frames per second the curves are resampled at.
+    float sampleRate = 30.0f;
+    AnimationCompressionSettings compression;
+    /// Save the clips next to the source as <file>.muanim and load that instead while the source is unchanged.
+    bool useAnimationCache = false;
+};
+
+/// Figures gathered while importing animations, summed over all the clips.
+/// Each clip also keeps its own sourceCurveBytes and GetMemorySize().
+struct AnimationImportStats
+{
+    bool loadedFromCache = false;
+    /// Keys of the OpenFBX curves, 8 byte times and 4 byte values.
+    uint64_t sourceCurveBytes = 0;
+    uint64_t clipBytes = 0;
+    float importMilliseconds = 0.0f;
+    /// Worst over all the clips, not measured when the clips come from the cooked file.
+    AnimationCompressionError compressionError;
+
+    float GetCompressionRatio() const { return clipBytes ? (float)sourceCurveBytes / clipBytes : 1.0f; }
+};
+
+/// A texture of the materials of an FBX file, still encoded as a JPEG, PNG or whatever the file holds, for the caller to decode.
+struct ImportedTexture
+{
+    /// The material slot it's bound to, in the order of ofbx::Texture::TextureType.
+    enum class Usage { Diffuse, Normal, Specular, Shininess, Ambient, Emissive, Reflection };
+
+    Usage usage = Usage::Diffuse;
+    /// One of the materials using it, the others share the same entry.
+    std::string materialName;
+    /// File name as written in the FBX, the relative one when there is one.
+    std::string path;
+    /// The image was in the FBX itself, otherwise it was read from disk.
+    bool embedded = false;
+    std::vector<uint8_t> encodedImage;
+};
+
+/// Figures gathered while importing textures.
+struct TextureImportStats
+{
+    unsigned int embeddedCount = 0;
+    unsigned int referencedCount = 0;
+    /// Referenced files found nowhere, they are left out of the textures.
+    unsigned int missingCount = 0;
+    /// Characters of the embedded images stored as base64 text, and the time spent decoding them summed over the workers.
+    uint64_t base64Bytes = 0;
+    float base64Milliseconds = 0.0f;
+    float importMilliseconds = 0.0f;
+};
+
+/// Outcome of one file of FbxImporter::ImportFBXBatch.
+struct FbxBatchResult
+{
+    bool imported = false;
+    /// Why the import failed, empty when it succeeded.
+    std::string error;
+    FbxImportStats stats;
+};
+
 class FbxImporter
 {
 public:
-    static bool ImportFBX(const char* filepath, std::vector<GLfloat>& outVertices, std::vector<GLuint>& outTriangles, unsigned int& outTrianglesCount);
-};
+    /// outError, when given, gets why the import failed and is cleared when it succeeds, like FbxBatchResult::error.
+    static bool ImportFBX(const char* filepath, ImportedMesh& outMesh, const FbxImportSettings& settings = FbxImportSettings(), FbxImportStats* outStats = nullptr,
+        std::string* outError = nullptr);
 
+    /// Imports the files concurrently on the JobSystem threads, each of them still splitting its own parsing.
+    /// outMeshes and outResults get one entry per file, in the same order. With useMeshCache the paths must be different.
+    static void ImportFBXBatch(const std::vector<std::string>& filepaths, std::vector<ImportedMesh>& outMeshes, std::vector<FbxBatchResult>& outResults,
+        const FbxImportSettings& settings = FbxImportSettings());
+
+    /// One clip per animation stack, with a track per animated node. Only the first layer of each stack is baked.
+    static bool ImportAnimations(const char* filepath, std::vector<AnimationClip>& outClips, const AnimationImportSettings& settings = AnimationImportSettings(), AnimationImportStats* outStats = nullptr,
+        std::string* outError = nullptr);
+
+    /// The textures of the materials, one entry each however many materials share it. Embedded images are extracted, base64 ones
+    /// decoded, referenced ones read from disk relative to the FBX first, all of them concurrently on the JobSystem threads.
+    static bool ImportTextures(const char* filepath, std::vector<ImportedTexture>& outTextures, TextureImportStats* outStats = nullptr, std::string* outError = nullptr);
+};
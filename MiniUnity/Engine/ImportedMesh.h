@@ -0,0 +1,154 @@
+#pragma once
+#include "gl/glew.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/// Range of the index buffer using a single material.
+struct Submesh
+{
+    unsigned int firstIndex = 0;
+    unsigned int indexCount = 0;
+};
+
+/// The whole mesh at a level of detail: a range of the index buffer holding a simplified copy of every submesh,
+/// in the same order, over the same vertices.
+struct MeshLod
+{
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    /// Index in ImportedMesh::submeshes of the first submesh of the level.
+    uint32_t firstSubmesh;
+    /// How far the simplified surface strays from the full one, in model units. 0 for the full mesh.
+    float error;
+    /// Range of ImportedMesh::meshlets covering the level, empty when none were built.
+    uint32_t firstMeshlet;
+    uint32_t meshletCount;
+};
+
+/// Cluster of neighbouring triangles, contiguous in the index buffer, with the bounds to cull it on its own.
+struct Meshlet
+{
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    /// Sphere around its vertices in the bind pose, grown by the reach of the morph targets.
+    float center[3];
+    float radius;
+    /// All its triangles face away from a camera at c when dot(center - c, coneAxis) >= coneCutoff * |center - c| + radius.
+    /// A cutoff of 1 never culls, for clusters whose normals spread too much or move.
+    float coneAxis[3];
+    float coneCutoff;
+    /// Bone carrying most of its vertices, the bounds follow it when the mesh is skinned. NoBone for rigid meshes.
+    uint32_t bone;
+
+    static const uint32_t NoBone = ~0u;
+};
+
+/// 16 byte vertex: position as unorm16 relative to the mesh bounds, octahedral snorm16 normal and half float uv.
+struct QuantizedVertex
+{
+    uint16_t position[3];
+    uint16_t padding;
+    int16_t normal[2];
+    uint16_t texCoord[2];
+};
+
+/// Up to four bones influencing a vertex, the weights are unorm16 summing to 65535.
+/// A vertex without influences has all its weights at 0 and stays where it is.
+struct SkinVertex
+{
+    uint8_t boneIndices[4];
+    uint16_t boneWeights[4];
+};
+
+/// Node of the hierarchy above the bones.
+struct SkeletonNode
+{
+    /// Index of the parent in Skeleton::nodes, always smaller than the node's own, -1 for the roots.
+    int32_t parent;
+    /// Local transform from the file, column major, used while the node isn't animated.
+    float restLocal[16];
+};
+
+/// Entry of the bone palette. Its matrix is meshFromScene * global transform of the node * inverseBind,
+/// the identity in the bind pose, so a skinned mesh at rest is drawn like the unskinned one.
+struct SkinBone
+{
+    uint32_t node;
+    /// Inverse of the bone transform at bind time times the transform of the mesh at bind time.
+    float inverseBind[16];
+    /// Inverse of the transform of the mesh at bind time.
+    float meshFromScene[16];
+};
+
+/// Nodes needed to pose the bones of a skinned mesh, parents come before their children.
+struct Skeleton
+{
+    std::vector<std::string> nodeNames;
+    std::vector<SkeletonNode> nodes;
+    std::vector<SkinBone> bones;
+};
+
+/// One vertex moved by a morph target. The deltas are snorm16 scaled by ImportedMesh::morphPositionScale
+/// and morphNormalScale, added to the vertex times the weight of the target.
+struct MorphDelta
+{
+    uint16_t target;
+    int16_t position[3];
+    int16_t normal[3];
+    uint16_t padding;
+};
+
+/// Indexed triangle list ready to be uploaded, vertices are interleaved position(3) normal(3) uv(2).
+struct ImportedMesh
+{
+    static const unsigned int VertexSize = 8;
+    /// Bone indices are stored in 8 bits.
+    static const unsigned int MaxBones = 256;
+    /// Morph target indices are stored in 16 bits.
+    static const unsigned int MaxMorphTargets = 65536;
+    /// Meshlet limits, 124 triangles leave room for a 128 primitive mesh shader group.
+    static const unsigned int MaxMeshletVertices = 64;
+    static const unsigned int MaxMeshletTriangles = 124;
+
+    std::vector<GLfloat> vertices;
+    std::vector<GLuint> indices;
+    /// The submeshes of every level of detail, the full mesh ones first.
+    std::vector<Submesh> submeshes;
+    /// Levels of detail from the full mesh down, each with more error and fewer triangles than the one before.
+    /// The importer always fills at least the full one.
+    std::vector<MeshLod> lods;
+    /// The meshlets of every level of detail, in the order of the levels.
+    std::vector<Meshlet> meshlets;
+    /// Compact copy of the vertices, only filled when quantization is requested.
+    std::vector<QuantizedVertex> quantizedVertices;
+    /// One per vertex when the mesh is skinned, uploaded after the vertices.
+    std::vector<SkinVertex> skinVertices;
+    Skeleton skeleton;
+    /// Blend shapes, their weights are given in this order. Empty when the mesh has none.
+    std::vector<std::string> morphTargetNames;
+    /// Sparse and grouped by vertex: the deltas of vertex v go from morphStarts[v] to morphStarts[v + 1],
+    /// vertices no target moves have none. morphStarts has one entry more than vertices when there are deltas.
+    std::vector<uint32_t> morphStarts;
+    std::vector<MorphDelta> morphDeltas;
+    /// Largest delta component, what a snorm16 of 32767 stands for.
+    float morphPositionScale = 0.0f;
+    float morphNormalScale = 0.0f;
+    /// Axis aligned box around all positions.
+    GLfloat boundsMin[3] = { 0.0f, 0.0f, 0.0f };
+    GLfloat boundsMax[3] = { 0.0f, 0.0f, 0.0f };
+
+    unsigned int GetVertexCount() const { return (unsigned int)(vertices.size() / VertexSize); }
+    unsigned int GetIndexCount() const { return (unsigned int)indices.size(); }
+    bool IsSkinned() const { return !skinVertices.empty(); }
+    bool HasMorphTargets() const { return !morphDeltas.empty(); }
+
+    /// Coarsest level of detail whose error covers less than maxPixelError pixels on screen,
+    /// given how many pixels a model unit covers where the mesh is drawn.
+    unsigned int SelectLod(float pixelsPerUnit, float maxPixelError) const
+    {
+        unsigned int lod = 0;
+        while (lod + 1 < lods.size() && lods[lod + 1].error * pixelsPerUnit < maxPixelError) ++lod;
+        return lod;
+    }
+};
@@ -0,0 +1,263 @@
+#include "JobSystem.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // the jobs of one ParallelFor call, its caller sleeps on done until the last one finishes
+    struct Batch
+    {
+        std::mutex mutex;
+        std::condition_variable done;
+        unsigned int pending;
+    };
+
+    // a contiguous range of elements of one ParallelFor call, or a single dispatched job without batch
+    struct Job
+    {
+        JobSystem::JobFunction function;
+        unsigned char* data;
+        unsigned int size;
+        unsigned int begin;
+        unsigned int end;
+        Batch* batch;
+    };
+
+    class WorkQueue
+    {
+    public:
+        void Push(const Job& job)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(job);
+        }
+
+        // the owner takes the newest job, its data is the most likely to still be in cache
+        bool Pop(Job& outJob)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (jobs.empty()) return false;
+            outJob = jobs.back();
+            jobs.pop_back();
+            return true;
+        }
+
+        // thieves take the oldest one
+        bool Steal(Job& outJob)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (jobs.empty()) return false;
+            outJob = jobs.front();
+            jobs.pop_front();
+            return true;
+        }
+
+        // a waiting ParallelFor only takes its own jobs, the newest first like Pop
+        bool Take(const Batch* batch, Job& outJob)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto iter = jobs.rbegin(); iter != jobs.rend(); ++iter) {
+                if (iter->batch != batch) continue;
+                outJob = *iter;
+                jobs.erase(std::next(iter).base());
+                return true;
+            }
+            return false;
+        }
+
+    private:
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    // queue owned by the current thread, threads outside the pool share the last queue
+    thread_local int t_queueIndex = -1;
+
+    class ThreadPool
+    {
+    public:
+        ThreadPool(unsigned int workerCount)
+        {
+            for (unsigned int i = 0; i < workerCount + 1; ++i) {
+                queues.emplace_back(new WorkQueue());
+            }
+            for (unsigned int i = 0; i < workerCount; ++i) {
+                threads.emplace_back(&ThreadPool::WorkerMain, this, i);
+            }
+        }
+
+        ~ThreadPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(sleepMutex);
+                stopping = true;
+            }
+            wakeUp.notify_all();
+            for (std::thread& thread : threads) thread.join();
+        }
+
+        unsigned int GetWorkerCount() const { return (unsigned int)threads.size(); }
+
+        void ParallelFor(JobSystem::JobFunction function, void* data, unsigned int size, unsigned int count)
+        {
+            if (count == 0) return;
+
+            // a few jobs per thread, so the ones finishing early have something left to steal
+            const unsigned int threadCount = GetWorkerCount() + 1;
+            const unsigned int jobCount = count < threadCount * 4 ? count : threadCount * 4;
+            const unsigned int jobSize = (count + jobCount - 1) / jobCount;
+
+            Batch batch;
+            batch.pending = (count + jobSize - 1) / jobSize;
+            const int ownQueue = GetOwnQueue();
+
+            unsigned int queue = ownQueue;
+            for (unsigned int begin = 0; begin < count; begin += jobSize) {
+                Job job = { function, (unsigned char*)data, size, begin, begin + jobSize < count ? begin + jobSize : count, &batch };
+                // the calling worker keeps its share, the rest is spread so every worker starts right away
+                if (t_queueIndex >= 0) {
+                    queues[ownQueue]->Push(job);
+                }
+                else {
+                    queues[queue]->Push(job);
+                    queue = (queue + 1) % queues.size();
+                }
+                queuedJobs.fetch_add(1);
+            }
+            {
+                std::lock_guard<std::mutex> lock(sleepMutex);
+            }
+            wakeUp.notify_all();
+
+            // Helping with anything else could start a whole dispatched import, delaying the return by far more than the
+            // call takes. Once none of its jobs is left queued the others are running, and no new one can be queued.
+            Job job;
+            while (TakeBatchJob(&batch, ownQueue, job)) {
+                queuedJobs.fetch_sub(1);
+                RunJob(job);
+            }
+            std::unique_lock<std::mutex> lock(batch.mutex);
+            batch.done.wait(lock, [&batch] { return batch.pending == 0; });
+        }
+
+        void Dispatch(JobSystem::JobFunction function, void* data)
+        {
+            if (GetWorkerCount() == 0) {
+                function(data);
+                return;
+            }
+
+            // workers keep the job for themselves, other threads hand it to the pool
+            Job job = { function, (unsigned char*)data, 0, 0, 1, nullptr };
+            queues[t_queueIndex >= 0 ? t_queueIndex : 0]->Push(job);
+            queuedJobs.fetch_add(1);
+            {
+                std::lock_guard<std::mutex> lock(sleepMutex);
+            }
+            wakeUp.notify_one();
+        }
+
+    private:
+        int GetOwnQueue() const { return t_queueIndex >= 0 ? t_queueIndex : (int)queues.size() - 1; }
+
+        bool RunOneJob(int ownQueue)
+        {
+            Job job;
+            bool found = queues[ownQueue]->Pop(job);
+            for (size_t i = 1; !found && i < queues.size(); ++i) {
+                found = queues[(ownQueue + i) % queues.size()]->Steal(job);
+            }
+            if (!found) return false;
+
+            queuedJobs.fetch_sub(1);
+            RunJob(job);
+            return true;
+        }
+
+        bool TakeBatchJob(const Batch* batch, int ownQueue, Job& outJob)
+        {
+            for (size_t i = 0; i < queues.size(); ++i) {
+                if (queues[(ownQueue + i) % queues.size()]->Take(batch, outJob)) return true;
+            }
+            return false;
+        }
+
+        static void RunJob(const Job& job)
+        {
+            for (unsigned int i = job.begin; i < job.end; ++i) {
+                job.function(job.data + (size_t)i * job.size);
+            }
+            if (!job.batch) return;
+            // notified under the lock, the waiter can't return and destroy the batch before it's released
+            std::lock_guard<std::mutex> lock(job.batch->mutex);
+            if (--job.batch->pending == 0) job.batch->done.notify_all();
+        }
+
+        void WorkerMain(unsigned int index)
+        {
+            t_queueIndex = (int)index;
+            for (;;) {
+                if (RunOneJob(index)) continue;
+
+                std::unique_lock<std::mutex> lock(sleepMutex);
+                wakeUp.wait(lock, [this] { return stopping || queuedJobs.load() != 0; });
+                if (stopping) return;
+            }
+        }
+
+        std::vector<std::unique_ptr<WorkQueue>> queues;
+        std::vector<std::thread> threads;
+        std::atomic<unsigned int> queuedJobs{ 0 };
+
+        std::mutex sleepMutex;
+        std::condition_variable wakeUp;
+        bool stopping = false;
+    };
+
+    std::mutex s_poolMutex;
+    std::unique_ptr<ThreadPool> s_pool;
+
+    ThreadPool& GetPool()
+    {
+        std::lock_guard<std::mutex> lock(s_poolMutex);
+        if (!s_pool) {
+            // one worker less than the hardware threads, the dispatching thread helps too
+            unsigned int hardwareThreads = std::thread::hardware_concurrency();
+            s_pool.reset(new ThreadPool(hardwareThreads > 1 ? hardwareThreads - 1 : 0));
+        }
+        return *s_pool;
+    }
+}
+
+void JobSystem::SetWorkerCount(unsigned int workerCount)
+{
+    std::lock_guard<std::mutex> lock(s_poolMutex);
+    s_pool.reset();
+    s_pool.reset(new ThreadPool(workerCount));
+}
+
+unsigned int JobSystem::GetWorkerCount()
+{
+    return GetPool().GetWorkerCount();
+}
+
+void JobSystem::ParallelFor(JobFunction function, void* data, unsigned int size, unsigned int count)
+{
+    GetPool().ParallelFor(function, data, size, count);
+}
+
+void JobSystem::Dispatch(JobFunction function, void* data)
+{
+    GetPool().Dispatch(function, data);
+}
+
+void JobSystem::OfbxJobProcessor(JobFunction function, void*, void* data, unsigned int size, unsigned int count)
+{
+    GetPool().ParallelFor(function, data, size, count);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+/// Work-stealing thread pool shared by the engine.
+/// Every worker owns a queue and idle workers steal from the others. A thread waiting in ParallelFor
+/// only helps running its own jobs, then sleeps until the rest are done, so jobs can safely wait for
+/// more jobs without picking up unrelated ones like dispatched imports.
+class JobSystem
+{
+public:
+    typedef void (*JobFunction)(void*);
+
+    /// Restarts the pool with the given number of worker threads, must not be called while jobs are running.
+    /// With 0 workers jobs run on the dispatching thread. By default there is one worker less than hardware threads.
+    static void SetWorkerCount(unsigned int workerCount);
+    static unsigned int GetWorkerCount();
+
+    /// Calls function on count elements of size bytes starting at data, and returns when all are done.
+    /// The calling thread runs some of them itself.
+    static void ParallelFor(JobFunction function, void* data, unsigned int size, unsigned int count);
+
+    /// Queues function(data) and returns immediately, for background work nobody waits on.
+    /// The job may run ParallelFor itself. With 0 workers it runs before Dispatch returns.
+    static void Dispatch(JobFunction function, void* data);
+
+    /// Same as ParallelFor, with the signature of ofbx::JobProcessor so it can be passed to ofbx::load.
+    static void OfbxJobProcessor(JobFunction function, void* userPointer, void* data, unsigned int size, unsigned int count);
+};
@@ -0,0 +1,244 @@
+#include "MeshCache.h"
+#include "MappedFile.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+    const char Magic[4] = { 'M', 'U', 'M', 'C' };
+
+    static_assert(sizeof(MeshCacheHeader) == 112, "MeshCacheHeader layout changed, bump MeshCache::FormatVersion");
+    static_assert(sizeof(Submesh) == 8, "Submesh layout changed, bump MeshCache::FormatVersion");
+    static_assert(sizeof(MeshLod) == 24, "MeshLod layout changed, bump MeshCache::FormatVersion");
+    static_assert(sizeof(Meshlet) == 44, "Meshlet layout changed, bump MeshCache::FormatVersion");
+    static_assert(sizeof(SkinVertex) == 12, "SkinVertex layout changed, bump MeshCache::FormatVersion");
+    static_assert(sizeof(SkeletonNode) == 68, "SkeletonNode layout changed, bump MeshCache::FormatVersion");
+    static_assert(sizeof(SkinBone) == 132, "SkinBone layout changed, bump MeshCache::FormatVersion");
+    static_assert(sizeof(MorphDelta) == 16, "MorphDelta layout changed, bump MeshCache::FormatVersion");
+
+    inline uint64_t Rotate(uint64_t value, int bits)
+    {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    inline uint64_t Mix(uint64_t hash, uint64_t word)
+    {
+        hash ^= word * 0x9e3779b97f4a7c15ull;
+        return Rotate(hash, 27) * 0xc2b2ae3d27d4eb4full;
+    }
+
+    uint32_t GetMorphStartCount(const MeshCacheHeader& header)
+    {
+        return header.morphDeltaCount > 0 ? header.vertexCount + 1 : 0;
+    }
+
+    // splits a blob of terminated strings, false when it doesn't hold exactly count of them
+    bool ReadNames(const char* blob, uint32_t length, uint32_t count, std::vector<std::string>& outNames)
+    {
+        outNames.clear();
+        for (uint32_t begin = 0; begin < length; begin += (uint32_t)outNames.back().size() + 1) {
+            const void* end = memchr(blob + begin, '\0', length - begin);
+            if (!end) return false;
+            outNames.push_back(blob + begin);
+        }
+        return outNames.size() == count;
+    }
+
+    size_t GetFileSize(const MeshCacheHeader& header)
+    {
+        return sizeof(MeshCacheHeader)
+            + (size_t)header.vertexCount * header.vertexSize * sizeof(GLfloat)
+            + (size_t)header.indexCount * sizeof(GLuint)
+            + (size_t)header.submeshCount * sizeof(Submesh)
+            + (size_t)header.lodCount * sizeof(MeshLod)
+            + (size_t)header.meshletCount * sizeof(Meshlet)
+            + (size_t)header.skinVertexCount * sizeof(SkinVertex)
+            + (size_t)header.skeletonNodeCount * sizeof(SkeletonNode)
+            + (size_t)header.boneCount * sizeof(SkinBone)
+            + (size_t)GetMorphStartCount(header) * sizeof(uint32_t)
+            + (size_t)header.morphDeltaCount * sizeof(MorphDelta)
+            + header.nodeNamesLength
+            + header.morphNamesLength;
+    }
+}
+
+uint64_t MeshCache::Hash(const void* data, size_t size, uint64_t seed)
+{
+    // 8 bytes per step, it only has to notice that the source changed
+    const unsigned char* bytes = (const unsigned char*)data;
+    uint64_t hash = Mix(seed, size);
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        hash = Mix(hash, word);
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, bytes + i, size - i);
+    hash = Mix(hash, tail);
+
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+bool MeshCache::Load(const char* filepath, uint64_t sourceHash, uint64_t settingsHash, ImportedMesh& outMesh, unsigned int* outSourceVertexCount)
+{
+    MappedFile file;
+    if (!file.Open(filepath)) return false;
+    if (file.GetSize() < sizeof(MeshCacheHeader)) return false;
+
+    MeshCacheHeader header;
+    memcpy(&header, file.GetData(), sizeof(header));
+    if (memcmp(header.magic, Magic, sizeof(Magic)) != 0) return false;
+    if (header.version != FormatVersion || header.vertexSize != ImportedMesh::VertexSize) return false;
+    if (header.sourceHash != sourceHash || header.settingsHash != settingsHash) return false;
+    if (GetFileSize(header) != file.GetSize()) return false;
+    if (header.skinVertexCount != 0 && header.skinVertexCount != header.vertexCount) return false;
+
+    const GLfloat* vertices = (const GLfloat*)(file.GetData() + sizeof(MeshCacheHeader));
+    const GLuint* indices = (const GLuint*)(vertices + (size_t)header.vertexCount * header.vertexSize);
+    const Submesh* submeshes = (const Submesh*)(indices + header.indexCount);
+    const MeshLod* lods = (const MeshLod*)(submeshes + header.submeshCount);
+    const Meshlet* meshlets = (const Meshlet*)(lods + header.lodCount);
+    const SkinVertex* skinVertices = (const SkinVertex*)(meshlets + header.meshletCount);
+    const SkeletonNode* skeletonNodes = (const SkeletonNode*)(skinVertices + header.skinVertexCount);
+    const SkinBone* bones = (const SkinBone*)(skeletonNodes + header.skeletonNodeCount);
+    const uint32_t* morphStarts = (const uint32_t*)(bones + header.boneCount);
+    const MorphDelta* morphDeltas = (const MorphDelta*)(morphStarts + GetMorphStartCount(header));
+    const char* nodeNames = (const char*)(morphDeltas + header.morphDeltaCount);
+    const char* morphNames = nodeNames + header.nodeNamesLength;
+
+    // the submeshes, levels and meshlets are drawn as they are, a corrupted range would read past the index buffer
+    for (uint32_t i = 0; i < header.submeshCount; ++i) {
+        if ((uint64_t)submeshes[i].firstIndex + submeshes[i].indexCount > header.indexCount) return false;
+    }
+    for (uint32_t i = 0; i < header.lodCount; ++i) {
+        if ((uint64_t)lods[i].firstIndex + lods[i].indexCount > header.indexCount) return false;
+        if ((uint64_t)lods[i].firstMeshlet + lods[i].meshletCount > header.meshletCount) return false;
+        // the submeshes of a level go up to the first one of the next
+        const uint32_t submeshEnd = i + 1 < header.lodCount ? lods[i + 1].firstSubmesh : header.submeshCount;
+        if (lods[i].firstSubmesh > submeshEnd || submeshEnd > header.submeshCount) return false;
+    }
+    for (uint32_t i = 0; i < header.meshletCount; ++i) {
+        if ((uint64_t)meshlets[i].firstIndex + meshlets[i].indexCount > header.indexCount) return false;
+    }
+    // nor may an index point past the vertices
+    for (uint32_t i = 0; i < header.indexCount; ++i) {
+        if (indices[i] >= header.vertexCount) return false;
+    }
+
+    // a corrupted skeleton would make posing it read out of its arrays
+    for (uint32_t i = 0; i < header.skeletonNodeCount; ++i) {
+        if (skeletonNodes[i].parent >= (int32_t)i) return false;
+    }
+    for (uint32_t i = 0; i < header.boneCount; ++i) {
+        if (bones[i].node >= header.skeletonNodeCount) return false;
+    }
+    // or skinning read past the palette, unused slots hold bone 0 too
+    for (uint32_t i = 0; i < header.skinVertexCount; ++i) {
+        for (int slot = 0; slot < 4; ++slot) {
+            if (skinVertices[i].boneIndices[slot] >= header.boneCount) return false;
+        }
+    }
+    std::vector<std::string> names;
+    if (!ReadNames(nodeNames, header.nodeNamesLength, header.skeletonNodeCount, names)) return false;
+
+    // and corrupted morph starts would make the shader read out of the deltas
+    const uint32_t morphStartCount = GetMorphStartCount(header);
+    if (morphStartCount > 0 && (morphStarts[0] != 0 || morphStarts[morphStartCount - 1] != header.morphDeltaCount)) return false;
+    for (uint32_t i = 1; i < morphStartCount; ++i) {
+        if (morphStarts[i] < morphStarts[i - 1]) return false;
+    }
+    for (uint32_t i = 0; i < header.morphDeltaCount; ++i) {
+        if (morphDeltas[i].target >= header.morphTargetCount) return false;
+    }
+    std::vector<std::string> targetNames;
+    if (!ReadNames(morphNames, header.morphNamesLength, header.morphTargetCount, targetNames)) return false;
+
+    outMesh.vertices.assign(vertices, vertices + (size_t)header.vertexCount * header.vertexSize);
+    outMesh.indices.assign(indices, indices + header.indexCount);
+    outMesh.submeshes.assign(submeshes, submeshes + header.submeshCount);
+    outMesh.lods.assign(lods, lods + header.lodCount);
+    outMesh.meshlets.assign(meshlets, meshlets + header.meshletCount);
+    outMesh.skinVertices.assign(skinVertices, skinVertices + header.skinVertexCount);
+    outMesh.skeleton.nodes.assign(skeletonNodes, skeletonNodes + header.skeletonNodeCount);
+    outMesh.skeleton.bones.assign(bones, bones + header.boneCount);
+    outMesh.skeleton.nodeNames.swap(names);
+    outMesh.morphTargetNames.swap(targetNames);
+    outMesh.morphStarts.assign(morphStarts, morphStarts + morphStartCount);
+    outMesh.morphDeltas.assign(morphDeltas, morphDeltas + header.morphDeltaCount);
+    outMesh.morphPositionScale = header.morphPositionScale;
+    outMesh.morphNormalScale = header.morphNormalScale;
+    memcpy(outMesh.boundsMin, header.boundsMin, sizeof(header.boundsMin));
+    memcpy(outMesh.boundsMax, header.boundsMax, sizeof(header.boundsMax));
+
+    if (outSourceVertexCount) *outSourceVertexCount = header.sourceVertexCount;
+    return true;
+}
+
+bool MeshCache::Save(const char* filepath, uint64_t sourceHash, uint64_t settingsHash, const ImportedMesh& mesh, unsigned int sourceVertexCount)
+{
+    MeshCacheHeader header = {};
+    memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = FormatVersion;
+    header.sourceHash = sourceHash;
+    header.settingsHash = settingsHash;
+    header.vertexSize = ImportedMesh::VertexSize;
+    header.vertexCount = mesh.GetVertexCount();
+    header.indexCount = mesh.GetIndexCount();
+    header.submeshCount = (uint32_t)mesh.submeshes.size();
+    header.lodCount = (uint32_t)mesh.lods.size();
+    header.meshletCount = (uint32_t)mesh.meshlets.size();
+    header.sourceVertexCount = sourceVertexCount;
+    memcpy(header.boundsMin, mesh.boundsMin, sizeof(header.boundsMin));
+    memcpy(header.boundsMax, mesh.boundsMax, sizeof(header.boundsMax));
+
+    std::string nodeNames;
+    for (const std::string& name : mesh.skeleton.nodeNames) nodeNames.append(name.c_str(), name.size() + 1);
+    header.skinVertexCount = (uint32_t)mesh.skinVertices.size();
+    header.skeletonNodeCount = (uint32_t)mesh.skeleton.nodes.size();
+    header.boneCount = (uint32_t)mesh.skeleton.bones.size();
+    header.nodeNamesLength = (uint32_t)nodeNames.size();
+
+    std::string morphNames;
+    for (const std::string& name : mesh.morphTargetNames) morphNames.append(name.c_str(), name.size() + 1);
+    header.morphTargetCount = (uint32_t)mesh.morphTargetNames.size();
+    header.morphDeltaCount = (uint32_t)mesh.morphDeltas.size();
+    header.morphNamesLength = (uint32_t)morphNames.size();
+    header.morphPositionScale = mesh.morphPositionScale;
+    header.morphNormalScale = mesh.morphNormalScale;
+    // the starts are only meaningful with deltas, Load expects them then
+    if (mesh.morphStarts.size() != (size_t)GetMorphStartCount(header)) return false;
+
+    FILE* file = nullptr;
+#ifdef _WIN32
+    if (fopen_s(&file, filepath, "wb") != 0) return false;
+#else
+    file = fopen(filepath, "wb");
+    if (!file) return false;
+#endif
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+    written = written && fwrite(mesh.vertices.data(), sizeof(GLfloat), mesh.vertices.size(), file) == mesh.vertices.size();
+    written = written && fwrite(mesh.indices.data(), sizeof(GLuint), mesh.indices.size(), file) == mesh.indices.size();
+    written = written && fwrite(mesh.submeshes.data(), sizeof(Submesh), mesh.submeshes.size(), file) == mesh.submeshes.size();
+    written = written && fwrite(mesh.lods.data(), sizeof(MeshLod), mesh.lods.size(), file) == mesh.lods.size();
+    written = written && fwrite(mesh.meshlets.data(), sizeof(Meshlet), mesh.meshlets.size(), file) == mesh.meshlets.size();
+    written = written && fwrite(mesh.skinVertices.data(), sizeof(SkinVertex), mesh.skinVertices.size(), file) == mesh.skinVertices.size();
+    written = written && fwrite(mesh.skeleton.nodes.data(), sizeof(SkeletonNode), mesh.skeleton.nodes.size(), file) == mesh.skeleton.nodes.size();
+    written = written && fwrite(mesh.skeleton.bones.data(), sizeof(SkinBone), mesh.skeleton.bones.size(), file) == mesh.skeleton.bones.size();
+    written = written && fwrite(mesh.morphStarts.data(), sizeof(uint32_t), mesh.morphStarts.size(), file) == mesh.morphStarts.size();
+    written = written && fwrite(mesh.morphDeltas.data(), sizeof(MorphDelta), mesh.morphDeltas.size(), file) == mesh.morphDeltas.size();
+    written = written && fwrite(nodeNames.data(), 1, nodeNames.size(), file) == nodeNames.size();
+    written = written && fwrite(morphNames.data(), 1, morphNames.size(), file) == morphNames.size();
+    written = fclose(file) == 0 && written;
+
+    // a truncated file would be rejected by Load anyway, but there's no point keeping it
+    if (!written) remove(filepath);
+    return written;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "ImportedMesh.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/// Header of a cooked mesh file. It's followed by the vertices, the indices, the submeshes, the levels of detail, for skinned meshes
+/// the skin vertices, the skeleton nodes and the bones, for morphed meshes the morph starts and deltas, then the
+/// node names and the morph target names each with its terminator. Everything is stored exactly as it is
+/// in memory so loading it is just copying the mapped bytes.
+struct MeshCacheHeader
+{
+    char magic[4];
+    uint32_t version;
+    /// Hash of the source file, the cooked file is stale when it changes.
+    uint64_t sourceHash;
+    /// Hash of the import settings the mesh was cooked with.
+    uint64_t settingsHash;
+    uint32_t vertexSize;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t submeshCount;
+    /// Vertices before welding, kept for the import stats.
+    uint32_t sourceVertexCount;
+    float boundsMin[3];
+    float boundsMax[3];
+    /// 0 or vertexCount.
+    uint32_t skinVertexCount;
+    uint32_t skeletonNodeCount;
+    uint32_t boneCount;
+    uint32_t nodeNamesLength;
+    uint32_t morphTargetCount;
+    /// The morph starts are vertexCount + 1 when there are deltas, none otherwise.
+    uint32_t morphDeltaCount;
+    uint32_t morphNamesLength;
+    float morphPositionScale;
+    float morphNormalScale;
+    uint32_t lodCount;
+    uint32_t meshletCount;
+};
+
+/// Engine native cooked mesh files, written on first import and loaded instead of the source while it's unchanged.
+class MeshCache
+{
+public:
+    static const uint32_t FormatVersion = 5;
+
+    static uint64_t Hash(const void* data, size_t size, uint64_t seed = 0);
+
+    /// Returns false when the file is missing, corrupted, from another format version or cooked from different source data.
+    static bool Load(const char* filepath, uint64_t sourceHash, uint64_t settingsHash, ImportedMesh& outMesh, unsigned int* outSourceVertexCount = nullptr);
+
+    static bool Save(const char* filepath, uint64_t sourceHash, uint64_t settingsHash, const ImportedMesh& mesh, unsigned int sourceVertexCount);
+};
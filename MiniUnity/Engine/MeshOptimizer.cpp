@@ -0,0 +1,305 @@
+#include "MeshOptimizer.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+    // Forsyth's tuning constants, see https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html
+    const int MaxCacheSize = 32;
+    const int MaxValence = 32;
+    const float CacheDecayPower = 1.5f;
+    const float LastTriScore = 0.75f;
+    const float ValenceBoostScale = 2.0f;
+    const float ValenceBoostPower = 0.5f;
+
+    struct ScoreTables
+    {
+        float cache[MaxCacheSize];
+        float valence[MaxValence + 1];
+
+        ScoreTables()
+        {
+            for (int i = 0; i < MaxCacheSize; ++i) {
+                // the vertices of the last triangle get a fixed score so that triangles sharing an edge with it aren't favoured too much
+                cache[i] = i < 3 ? LastTriScore : powf(1.0f - (float)(i - 3) / (MaxCacheSize - 3), CacheDecayPower);
+            }
+            valence[0] = 0.0f;
+            for (int i = 1; i <= MaxValence; ++i) {
+                valence[i] = ValenceBoostScale * powf((float)i, -ValenceBoostPower);
+            }
+        }
+    };
+
+    inline float VertexScore(const ScoreTables& tables, int cachePosition, unsigned int remainingTriangles)
+    {
+        if (remainingTriangles == 0) return -1.0f;
+
+        float score = cachePosition >= 0 ? tables.cache[cachePosition] : 0.0f;
+        return score + tables.valence[std::min(remainingTriangles, (unsigned int)MaxValence)];
+    }
+
+    struct Float3
+    {
+        float x, y, z;
+    };
+
+    inline Float3 Sub(const Float3& a, const Float3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+    inline Float3 Cross(const Float3& a, const Float3& b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+
+    inline Float3 GetPosition(const GLfloat* vertices, unsigned int vertexSize, GLuint index)
+    {
+        const GLfloat* v = vertices + (size_t)index * vertexSize;
+        return { v[0], v[1], v[2] };
+    }
+}
+
+void MeshOptimizer::OptimizeVertexCache(GLuint* indices, size_t indexCount, unsigned int vertexCount)
+{
+    static const ScoreTables tables;
+
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) return;
+
+    // triangles using each vertex, stored contiguously per vertex
+    std::vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t i = 0; i < indexCount; ++i) adjacencyOffsets[indices[i] + 1]++;
+    for (unsigned int i = 0; i < vertexCount; ++i) adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+
+    std::vector<unsigned int> adjacency(indexCount);
+    std::vector<unsigned int> remainingTriangles(vertexCount, 0);
+    for (size_t i = 0; i < indexCount; ++i) {
+        GLuint v = indices[i];
+        adjacency[adjacencyOffsets[v] + remainingTriangles[v]++] = (unsigned int)(i / 3);
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    for (unsigned int v = 0; v < vertexCount; ++v) {
+        vertexScores[v] = VertexScore(tables, -1, remainingTriangles[v]);
+    }
+
+    std::vector<float> triangleScores(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        triangleScores[t] = vertexScores[indices[t * 3 + 0]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+    }
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<GLuint> result;
+    result.reserve(indexCount);
+
+    GLuint cache[MaxCacheSize + 3];
+    GLuint newCache[MaxCacheSize + 3];
+    int cacheCount = 0;
+
+    size_t bestTriangle = std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin();
+    size_t deadEndCursor = 0;
+
+    for (size_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount) {
+        if (bestTriangle == triangleCount) {
+            // nothing in the cache has triangles left, continue with the next triangle in input order
+            while (emitted[deadEndCursor]) ++deadEndCursor;
+            bestTriangle = deadEndCursor;
+        }
+
+        const GLuint* triangle = &indices[bestTriangle * 3];
+        result.insert(result.end(), triangle, triangle + 3);
+        emitted[bestTriangle] = true;
+
+        // the new triangle's vertices move to the front of the cache
+        int newCacheCount = 0;
+        for (int i = 0; i < 3; ++i) {
+            GLuint v = triangle[i];
+            newCache[newCacheCount++] = v;
+
+            unsigned int* vertexTriangles = &adjacency[adjacencyOffsets[v]];
+            unsigned int& remaining = remainingTriangles[v];
+            for (unsigned int j = 0; j < remaining; ++j) {
+                if (vertexTriangles[j] == bestTriangle) {
+                    vertexTriangles[j] = vertexTriangles[remaining - 1];
+                    --remaining;
+                    break;
+                }
+            }
+        }
+        for (int i = 0; i < cacheCount; ++i) {
+            GLuint v = cache[i];
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2]) newCache[newCacheCount++] = v;
+        }
+
+        // rescore everything that moved, including the vertices pushed out of the cache
+        for (int i = 0; i < newCacheCount; ++i) {
+            GLuint v = newCache[i];
+            cachePosition[v] = i < MaxCacheSize ? i : -1;
+
+            float score = VertexScore(tables, cachePosition[v], remainingTriangles[v]);
+            float delta = score - vertexScores[v];
+            vertexScores[v] = score;
+
+            const unsigned int* vertexTriangles = &adjacency[adjacencyOffsets[v]];
+            for (unsigned int j = 0; j < remainingTriangles[v]; ++j) triangleScores[vertexTriangles[j]] += delta;
+        }
+
+        cacheCount = std::min(newCacheCount, MaxCacheSize);
+        memcpy(cache, newCache, sizeof(GLuint) * cacheCount);
+
+        // the next triangle is the best one touching the cache
+        bestTriangle = triangleCount;
+        float bestScore = -1.0f;
+        for (int i = 0; i < cacheCount; ++i) {
+            GLuint v = cache[i];
+            const unsigned int* vertexTriangles = &adjacency[adjacencyOffsets[v]];
+            for (unsigned int j = 0; j < remainingTriangles[v]; ++j) {
+                unsigned int t = vertexTriangles[j];
+                if (triangleScores[t] > bestScore) {
+                    bestScore = triangleScores[t];
+                    bestTriangle = t;
+                }
+            }
+        }
+    }
+
+    std::copy(result.begin(), result.end(), indices);
+}
+
+void MeshOptimizer::OptimizeOverdraw(GLuint* indices, size_t indexCount, const GLfloat* vertices, unsigned int vertexCount, unsigned int vertexSize)
+{
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) return;
+
+    // a triangle missing all three vertices means the cache starts over, which is where clusters can be moved freely
+    const unsigned int cacheSize = 16;
+    std::vector<unsigned int> cacheTimestamps(vertexCount, 0);
+    unsigned int timestamp = cacheSize + 1;
+
+    std::vector<size_t> clusterStarts;
+    for (size_t t = 0; t < triangleCount; ++t) {
+        int misses = 0;
+        for (int i = 0; i < 3; ++i) {
+            GLuint v = indices[t * 3 + i];
+            if (timestamp - cacheTimestamps[v] > cacheSize) {
+                cacheTimestamps[v] = timestamp++;
+                ++misses;
+            }
+        }
+        if (t == 0 || misses == 3) clusterStarts.push_back(t);
+    }
+    clusterStarts.push_back(triangleCount);
+
+    const size_t clusterCount = clusterStarts.size() - 1;
+    if (clusterCount < 2) return;
+
+    // area weighted centroid and normal of each cluster
+    std::vector<Float3> clusterCentroids(clusterCount);
+    std::vector<Float3> clusterNormals(clusterCount);
+    Float3 meshCentroid = { 0, 0, 0 };
+    float meshArea = 0.0f;
+
+    for (size_t c = 0; c < clusterCount; ++c) {
+        Float3 centroid = { 0, 0, 0 };
+        Float3 normal = { 0, 0, 0 };
+        float clusterArea = 0.0f;
+
+        for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; ++t) {
+            Float3 p0 = GetPosition(vertices, vertexSize, indices[t * 3 + 0]);
+            Float3 p1 = GetPosition(vertices, vertexSize, indices[t * 3 + 1]);
+            Float3 p2 = GetPosition(vertices, vertexSize, indices[t * 3 + 2]);
+
+            Float3 n = Cross(Sub(p1, p0), Sub(p2, p0));
+            float area = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+
+            centroid.x += (p0.x + p1.x + p2.x) * (area / 3.0f);
+            centroid.y += (p0.y + p1.y + p2.y) * (area / 3.0f);
+            centroid.z += (p0.z + p1.z + p2.z) * (area / 3.0f);
+            normal.x += n.x;
+            normal.y += n.y;
+            normal.z += n.z;
+            clusterArea += area;
+        }
+
+        meshCentroid.x += centroid.x;
+        meshCentroid.y += centroid.y;
+        meshCentroid.z += centroid.z;
+        meshArea += clusterArea;
+
+        float inverseArea = clusterArea == 0.0f ? 0.0f : 1.0f / clusterArea;
+        clusterCentroids[c] = { centroid.x * inverseArea, centroid.y * inverseArea, centroid.z * inverseArea };
+
+        float normalLength = sqrtf(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+        float inverseNormalLength = normalLength == 0.0f ? 0.0f : 1.0f / normalLength;
+        clusterNormals[c] = { normal.x * inverseNormalLength, normal.y * inverseNormalLength, normal.z * inverseNormalLength };
+    }
+
+    float inverseMeshArea = meshArea == 0.0f ? 0.0f : 1.0f / meshArea;
+    meshCentroid = { meshCentroid.x * inverseMeshArea, meshCentroid.y * inverseMeshArea, meshCentroid.z * inverseMeshArea };
+
+    // clusters on the outside facing away from the center are likely to occlude the rest, so they go first
+    std::vector<float> sortKeys(clusterCount);
+    std::vector<size_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; ++c) {
+        Float3 offset = Sub(clusterCentroids[c], meshCentroid);
+        sortKeys[c] = offset.x * clusterNormals[c].x + offset.y * clusterNormals[c].y + offset.z * clusterNormals[c].z;
+        order[c] = c;
+    }
+    std::stable_sort(order.begin(), order.end(), [&sortKeys](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+    std::vector<GLuint> result;
+    result.reserve(indexCount);
+    for (size_t c : order) {
+        result.insert(result.end(), indices + clusterStarts[c] * 3, indices + clusterStarts[c + 1] * 3);
+    }
+    std::copy(result.begin(), result.end(), indices);
+}
+
+unsigned int MeshOptimizer::OptimizeVertexFetch(std::vector<GLfloat>& vertices, std::vector<GLuint>& indices, unsigned int vertexSize)
+{
+    const unsigned int vertexCount = (unsigned int)(vertices.size() / vertexSize);
+    const GLuint Unused = ~0u;
+
+    std::vector<GLuint> remap(vertexCount, Unused);
+    std::vector<GLfloat> result;
+    result.reserve(vertices.size());
+
+    GLuint nextVertex = 0;
+    for (GLuint& index : indices) {
+        GLuint& newIndex = remap[index];
+        if (newIndex == Unused) {
+            newIndex = nextVertex++;
+            result.insert(result.end(), vertices.begin() + (size_t)index * vertexSize, vertices.begin() + ((size_t)index + 1) * vertexSize);
+        }
+        index = newIndex;
+    }
+
+    vertices.swap(result);
+    return nextVertex;
+}
+
+VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const std::vector<GLuint>& indices, unsigned int vertexCount, unsigned int cacheSize)
+{
+    VertexCacheStats stats;
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) return stats;
+
+    // FIFO cache, a vertex is cached while fewer than cacheSize misses happened since it was loaded
+    std::vector<unsigned int> cacheTimestamps(vertexCount, 0);
+    std::vector<bool> referenced(vertexCount, false);
+    unsigned int timestamp = cacheSize + 1;
+    unsigned int misses = 0;
+    unsigned int referencedCount = 0;
+
+    for (GLuint v : indices) {
+        if (timestamp - cacheTimestamps[v] > cacheSize) {
+            cacheTimestamps[v] = timestamp++;
+            ++misses;
+        }
+        if (!referenced[v]) {
+            referenced[v] = true;
+            ++referencedCount;
+        }
+    }
+
+    stats.acmr = (float)misses / triangleCount;
+    stats.atvr = referencedCount ? (float)misses / referencedCount : 0.0f;
+    return stats;
+}
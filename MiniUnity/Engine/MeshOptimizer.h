@@ -0,0 +1,31 @@
+#pragma once
+#include "gl/glew.h"
+#include <vector>
+
+/// Post-transform cache efficiency of an index buffer, measured with a FIFO cache simulation.
+struct VertexCacheStats
+{
+    /// Average cache miss ratio, transformed vertices per triangle. 0.5 is ideal for regular grids, 3 is the worst case.
+    float acmr = 0.0f;
+    /// Average transformed vertex ratio, transformed vertices per referenced vertex. 1 is ideal.
+    float atvr = 0.0f;
+};
+
+/// Reorders triangles and vertices of an indexed triangle list for faster GPU processing.
+class MeshOptimizer
+{
+public:
+    /// Reorders triangles for post-transform vertex cache locality (Tom Forsyth's linear-speed algorithm).
+    /// Works on a range of the index buffer, so submeshes can be optimized separately.
+    static void OptimizeVertexCache(GLuint* indices, size_t indexCount, unsigned int vertexCount);
+
+    /// Reorders clusters of an already cache optimized index range so outward facing ones are drawn first.
+    /// Clusters are split where the cache restarts, so the vertex cache order is mostly preserved.
+    static void OptimizeOverdraw(GLuint* indices, size_t indexCount, const GLfloat* vertices, unsigned int vertexCount, unsigned int vertexSize);
+
+    /// Renumbers vertices in first use order, rewriting indices and dropping unreferenced vertices.
+    /// Returns the new vertex count.
+    static unsigned int OptimizeVertexFetch(std::vector<GLfloat>& vertices, std::vector<GLuint>& indices, unsigned int vertexSize);
+
+    static VertexCacheStats AnalyzeVertexCache(const std::vector<GLuint>& indices, unsigned int vertexCount, unsigned int cacheSize = 16);
+};
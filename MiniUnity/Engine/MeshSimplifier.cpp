@@ -0,0 +1,393 @@
+#include "MeshSimplifier.h"
+#include "MeshWelder.h"
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+    // open borders show against the background, they weigh more than seams when measuring the error
+    const float BorderWeight = 10.0f;
+    const float SeamWeight = 1.0f;
+    // a collapse may turn a triangle by up to about 75 degrees, more and it likely folds over its neighbours
+    const float MinNormalCosine = 0.25f;
+
+    // values of the open edge of a vertex when it hasn't exactly one
+    const GLuint NoEdge = ~0u;
+    const GLuint ManyEdges = ~0u - 1;
+
+    enum class VertexKind : uint8_t { Manifold, Border, Seam, Locked };
+
+    struct Float3
+    {
+        float x, y, z;
+    };
+
+    inline Float3 Sub(const Float3& a, const Float3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+    inline Float3 Cross(const Float3& a, const Float3& b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+    inline float Dot(const Float3& a, const Float3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+    inline float Length(const Float3& a) { return sqrtf(Dot(a, a)); }
+
+    // squared distances to a set of planes as a symmetric 4x4 matrix, each plane weighted by the area it stands for
+    struct Quadric
+    {
+        float a00 = 0.0f, a11 = 0.0f, a22 = 0.0f, a10 = 0.0f, a20 = 0.0f, a21 = 0.0f;
+        float b0 = 0.0f, b1 = 0.0f, b2 = 0.0f;
+        float c = 0.0f;
+        float weight = 0.0f;
+    };
+
+    void AddPlane(Quadric& q, const Float3& normal, float distance, float weight)
+    {
+        q.a00 += weight * normal.x * normal.x;
+        q.a11 += weight * normal.y * normal.y;
+        q.a22 += weight * normal.z * normal.z;
+        q.a10 += weight * normal.y * normal.x;
+        q.a20 += weight * normal.z * normal.x;
+        q.a21 += weight * normal.z * normal.y;
+        q.b0 += weight * normal.x * distance;
+        q.b1 += weight * normal.y * distance;
+        q.b2 += weight * normal.z * distance;
+        q.c += weight * distance * distance;
+        q.weight += weight;
+    }
+
+    void AddQuadric(Quadric& q, const Quadric& other)
+    {
+        q.a00 += other.a00;
+        q.a11 += other.a11;
+        q.a22 += other.a22;
+        q.a10 += other.a10;
+        q.a20 += other.a20;
+        q.a21 += other.a21;
+        q.b0 += other.b0;
+        q.b1 += other.b1;
+        q.b2 += other.b2;
+        q.c += other.c;
+        q.weight += other.weight;
+    }
+
+    // mean squared distance of a point to the planes
+    float Evaluate(const Quadric& q, const Float3& p)
+    {
+        float value = q.a00 * p.x * p.x + q.a11 * p.y * p.y + q.a22 * p.z * p.z
+            + 2.0f * (q.a10 * p.x * p.y + q.a20 * p.x * p.z + q.a21 * p.y * p.z)
+            + 2.0f * (q.b0 * p.x + q.b1 * p.y + q.b2 * p.z)
+            + q.c;
+        return q.weight > 0.0f ? fabsf(value) / q.weight : 0.0f;
+    }
+
+    struct Collapse
+    {
+        GLuint vertex;
+        GLuint target;
+        float cost;
+    };
+
+    // collapses edges of an index list in rounds, each round only touches vertices far enough apart
+    // that the checks made at its start still hold when it applies them
+    class EdgeCollapser
+    {
+    public:
+        EdgeCollapser(const GLfloat* vertices, unsigned int vertexCount, unsigned int vertexSize, std::vector<GLuint>& indices)
+            : indices(indices), vertexCount(vertexCount), positions(vertexCount)
+        {
+            // the position twins of each vertex, in a circular list
+            std::vector<GLfloat> rawPositions((size_t)vertexCount * 3);
+            for (unsigned int i = 0; i < vertexCount; ++i) {
+                const GLfloat* vertex = vertices + (size_t)i * vertexSize;
+                rawPositions[(size_t)i * 3] = vertex[0];
+                rawPositions[(size_t)i * 3 + 1] = vertex[1];
+                rawPositions[(size_t)i * 3 + 2] = vertex[2];
+            }
+            const unsigned int positionCount = MeshWelder::BuildRemap(rawPositions.data(), vertexCount, 3, 0.0f, positionIds);
+            std::vector<GLuint> firstTwin(positionCount, NoEdge);
+            twins.resize(vertexCount);
+            for (unsigned int i = 0; i < vertexCount; ++i) {
+                GLuint& first = firstTwin[positionIds[i]];
+                if (first == NoEdge) {
+                    first = i;
+                    twins[i] = i;
+                }
+                else {
+                    twins[i] = twins[first];
+                    twins[first] = i;
+                }
+            }
+
+            // errors are measured on positions scaled to a unit box so the limit is independent of the mesh size
+            Float3 boundsMin = { 0.0f, 0.0f, 0.0f };
+            Float3 boundsMax = { 0.0f, 0.0f, 0.0f };
+            for (unsigned int i = 0; i < vertexCount; ++i) {
+                const Float3 p = { rawPositions[(size_t)i * 3], rawPositions[(size_t)i * 3 + 1], rawPositions[(size_t)i * 3 + 2] };
+                boundsMin = i == 0 ? p : Float3{ std::min(boundsMin.x, p.x), std::min(boundsMin.y, p.y), std::min(boundsMin.z, p.z) };
+                boundsMax = i == 0 ? p : Float3{ std::max(boundsMax.x, p.x), std::max(boundsMax.y, p.y), std::max(boundsMax.z, p.z) };
+            }
+            extent = std::max(std::max(boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y), boundsMax.z - boundsMin.z);
+            const float scale = extent > 0.0f ? 1.0f / extent : 1.0f;
+            for (unsigned int i = 0; i < vertexCount; ++i) {
+                positions[i] = { (rawPositions[(size_t)i * 3] - boundsMin.x) * scale, (rawPositions[(size_t)i * 3 + 1] - boundsMin.y) * scale,
+                    (rawPositions[(size_t)i * 3 + 2] - boundsMin.z) * scale };
+            }
+
+            quadrics.resize(positionCount);
+            BuildCorners();
+            for (size_t corner = 0; corner < indices.size(); ++corner) {
+                const GLuint a = indices[corner];
+                const GLuint b = Next((unsigned int)corner);
+                const Float3 edge = Sub(positions[b], positions[a]);
+                const Float3 normal = Cross(edge, Sub(positions[Previous((unsigned int)corner)], positions[a]));
+                const float area = Length(normal);
+                if (area == 0.0f) continue;
+
+                // every corner adds its triangle once, at its first vertex
+                if (corner % 3 == 0) {
+                    const Float3 n = { normal.x / area, normal.y / area, normal.z / area };
+                    const float distance = -Dot(n, positions[a]);
+                    for (unsigned int k = 0; k < 3; ++k) AddPlane(quadrics[positionIds[indices[corner + k]]], n, distance, area);
+                }
+
+                // an open edge also gets a plane through it perpendicular to its triangle, so it keeps its line
+                if (HasEdge(b, a)) continue;
+                Float3 side = Cross(edge, normal);
+                const float sideLength = Length(side);
+                if (sideLength == 0.0f) continue;
+                side = { side.x / sideLength, side.y / sideLength, side.z / sideLength };
+                const float weight = Dot(edge, edge) * (IsSeamEdge(a, b) ? SeamWeight : BorderWeight);
+                const float distance = -Dot(side, positions[a]);
+                AddPlane(quadrics[positionIds[a]], side, distance, weight);
+                AddPlane(quadrics[positionIds[b]], side, distance, weight);
+            }
+        }
+
+        // one round of collapses cheaper than maxError, a squared distance in the unit box.
+        // Returns false when none could be done.
+        bool Round(size_t targetIndexCount, float maxError)
+        {
+            BuildCorners();
+            Classify();
+
+            // each edge is considered once, in the cheaper of the directions it can collapse
+            std::vector<Collapse> collapses;
+            for (size_t corner = 0; corner < indices.size(); ++corner) {
+                const GLuint a = indices[corner];
+                const GLuint b = Next((unsigned int)corner);
+                if (a > b && HasEdge(b, a)) continue;
+                Collapse best = { NoEdge, NoEdge, 0.0f };
+                if (CanCollapse(a, b)) best = { a, b, Evaluate(quadrics[positionIds[a]], positions[b]) };
+                if (CanCollapse(b, a)) {
+                    const float cost = Evaluate(quadrics[positionIds[b]], positions[a]);
+                    if (best.vertex == NoEdge || cost < best.cost) best = { b, a, cost };
+                }
+                if (best.vertex != NoEdge) collapses.push_back(best);
+            }
+            std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+            std::vector<GLuint> collapseTo(vertexCount);
+            for (unsigned int i = 0; i < vertexCount; ++i) collapseTo[i] = i;
+            std::vector<uint8_t> locked(quadrics.size(), 0);
+            const size_t removableTriangles = (indices.size() - std::min(indices.size(), targetIndexCount)) / 3;
+            size_t removedTriangles = 0;
+            bool collapsed = false;
+
+            for (const Collapse& collapse : collapses) {
+                if (collapse.cost > maxError || removedTriangles >= removableTriangles) break;
+                const GLuint vertex = collapse.vertex;
+                const GLuint target = collapse.target;
+                if (locked[positionIds[vertex]] || locked[positionIds[target]]) continue;
+
+                // the twin on the other side of a seam follows its own seam edge to the twin of the target
+                GLuint twin = NoEdge;
+                GLuint twinTarget = NoEdge;
+                if (kinds[vertex] == VertexKind::Seam) {
+                    twin = twins[vertex];
+                    twinTarget = target == openOut[vertex] ? openIn[twin] : openOut[twin];
+                }
+                if (Flips(vertex, target) || (twin != NoEdge && Flips(twin, twinTarget))) continue;
+
+                collapseTo[vertex] = target;
+                removedTriangles += CountShared(vertex, target);
+                Lock(vertex, locked);
+                if (twin != NoEdge) {
+                    collapseTo[twin] = twinTarget;
+                    removedTriangles += CountShared(twin, twinTarget);
+                    Lock(twin, locked);
+                }
+                if (positionIds[vertex] != positionIds[target]) AddQuadric(quadrics[positionIds[target]], quadrics[positionIds[vertex]]);
+                error = std::max(error, collapse.cost);
+                collapsed = true;
+            }
+            if (!collapsed) return false;
+
+            // the triangles around the collapsed edges are left with two equal vertices
+            size_t written = 0;
+            for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+                const GLuint a = collapseTo[indices[i]];
+                const GLuint b = collapseTo[indices[i + 1]];
+                const GLuint c = collapseTo[indices[i + 2]];
+                if (a == b || b == c || a == c) continue;
+                indices[written++] = a;
+                indices[written++] = b;
+                indices[written++] = c;
+            }
+            indices.resize(written);
+            return true;
+        }
+
+        /// Largest error of the collapses done, in model units.
+        float GetError() const { return sqrtf(error) * (extent > 0.0f ? extent : 1.0f); }
+
+    private:
+        std::vector<GLuint>& indices;
+        unsigned int vertexCount;
+        std::vector<Float3> positions;
+        std::vector<GLuint> positionIds;
+        std::vector<GLuint> twins;
+        float extent = 0.0f;
+        // one per position, shared by the twins
+        std::vector<Quadric> quadrics;
+        float error = 0.0f;
+
+        // the corners of each vertex, stored contiguously per vertex
+        std::vector<unsigned int> cornerOffsets;
+        std::vector<unsigned int> corners;
+        // the vertex each vertex has an edge to without one coming back, and the one it comes from
+        std::vector<GLuint> openOut;
+        std::vector<GLuint> openIn;
+        std::vector<VertexKind> kinds;
+
+        GLuint Next(unsigned int corner) const { return indices[corner - corner % 3 + (corner % 3 + 1) % 3]; }
+        GLuint Previous(unsigned int corner) const { return indices[corner - corner % 3 + (corner % 3 + 2) % 3]; }
+
+        void BuildCorners()
+        {
+            cornerOffsets.assign(vertexCount + 1, 0);
+            for (GLuint index : indices) cornerOffsets[index + 1]++;
+            for (unsigned int i = 0; i < vertexCount; ++i) cornerOffsets[i + 1] += cornerOffsets[i];
+            corners.resize(indices.size());
+            std::vector<unsigned int> filled(cornerOffsets.begin(), cornerOffsets.end() - 1);
+            for (size_t i = 0; i < indices.size(); ++i) corners[filled[indices[i]]++] = (unsigned int)i;
+        }
+
+        bool HasEdge(GLuint from, GLuint to) const
+        {
+            for (unsigned int i = cornerOffsets[from]; i < cornerOffsets[from + 1]; ++i) {
+                if (Next(corners[i]) == to) return true;
+            }
+            return false;
+        }
+
+        // an open edge is on a seam when the triangles on the other side use twins of its vertices
+        bool IsSeamEdge(GLuint from, GLuint to) const
+        {
+            GLuint x = to;
+            do {
+                GLuint y = from;
+                do {
+                    if (HasEdge(x, y)) return true;
+                    y = twins[y];
+                } while (y != from);
+                x = twins[x];
+            } while (x != to);
+            return false;
+        }
+
+        static bool IsSingle(GLuint edge) { return edge != NoEdge && edge != ManyEdges; }
+
+        void Classify()
+        {
+            openOut.assign(vertexCount, NoEdge);
+            openIn.assign(vertexCount, NoEdge);
+            for (unsigned int v = 0; v < vertexCount; ++v) {
+                for (unsigned int i = cornerOffsets[v]; i < cornerOffsets[v + 1]; ++i) {
+                    const GLuint next = Next(corners[i]);
+                    const GLuint previous = Previous(corners[i]);
+                    if (!HasEdge(next, v)) openOut[v] = openOut[v] == NoEdge ? next : ManyEdges;
+                    if (!HasEdge(v, previous)) openIn[v] = openIn[v] == NoEdge ? previous : ManyEdges;
+                }
+            }
+
+            kinds.assign(vertexCount, VertexKind::Locked);
+            for (unsigned int v = 0; v < vertexCount; ++v) {
+                const GLuint twin = twins[v];
+                if (twin == v) {
+                    if (openOut[v] == NoEdge && openIn[v] == NoEdge)
+                        kinds[v] = VertexKind::Manifold;
+                    else if (IsSingle(openOut[v]) && IsSingle(openIn[v]) && !IsSeamEdge(v, openOut[v]) && !IsSeamEdge(openIn[v], v))
+                        kinds[v] = VertexKind::Border;
+                }
+                else if (twins[twin] == v) {
+                    // both sides run along the same seam in opposite directions
+                    const bool single = IsSingle(openOut[v]) && IsSingle(openIn[v]) && IsSingle(openOut[twin]) && IsSingle(openIn[twin]);
+                    if (single && positionIds[openOut[v]] == positionIds[openIn[twin]] && positionIds[openIn[v]] == positionIds[openOut[twin]]
+                        && IsSeamEdge(v, openOut[v]) && IsSeamEdge(openIn[v], v))
+                        kinds[v] = VertexKind::Seam;
+                }
+            }
+        }
+
+        bool CanCollapse(GLuint vertex, GLuint target) const
+        {
+            switch (kinds[vertex]) {
+            case VertexKind::Manifold:
+                return true;
+            case VertexKind::Seam:
+                if (kinds[twins[vertex]] != VertexKind::Seam) return false;
+                // the twin slides along its side of the seam
+                [[fallthrough]];
+            case VertexKind::Border:
+                // sliding along its open edges keeps the outline
+                return target == openOut[vertex] || target == openIn[vertex];
+            case VertexKind::Locked:
+                return false;
+            }
+            return false;
+        }
+
+        // whether moving vertex onto target turns one of the triangles that survive too much
+        bool Flips(GLuint vertex, GLuint target) const
+        {
+            for (unsigned int i = cornerOffsets[vertex]; i < cornerOffsets[vertex + 1]; ++i) {
+                const GLuint a = Next(corners[i]);
+                const GLuint b = Previous(corners[i]);
+                if (a == target || b == target) continue;
+                const Float3 before = Cross(Sub(positions[a], positions[vertex]), Sub(positions[b], positions[vertex]));
+                const Float3 after = Cross(Sub(positions[a], positions[target]), Sub(positions[b], positions[target]));
+                const float beforeLength = Length(before);
+                if (beforeLength > 0.0f && Dot(before, after) <= MinNormalCosine * beforeLength * Length(after)) return true;
+            }
+            return false;
+        }
+
+        unsigned int CountShared(GLuint vertex, GLuint target) const
+        {
+            unsigned int shared = 0;
+            for (unsigned int i = cornerOffsets[vertex]; i < cornerOffsets[vertex + 1]; ++i) {
+                if (Next(corners[i]) == target || Previous(corners[i]) == target) ++shared;
+            }
+            return shared;
+        }
+
+        // the triangles around a collapsed vertex change, nothing else may move them in the same round
+        void Lock(GLuint vertex, std::vector<uint8_t>& locked) const
+        {
+            locked[positionIds[vertex]] = 1;
+            for (unsigned int i = cornerOffsets[vertex]; i < cornerOffsets[vertex + 1]; ++i) {
+                locked[positionIds[Next(corners[i])]] = 1;
+                locked[positionIds[Previous(corners[i])]] = 1;
+            }
+        }
+    };
+}
+
+float MeshSimplifier::Simplify(const GLuint* indices, size_t indexCount, const GLfloat* vertices, unsigned int vertexCount, unsigned int vertexSize,
+    size_t targetIndexCount, float targetError, std::vector<GLuint>& outIndices)
+{
+    outIndices.assign(indices, indices + indexCount);
+    if (indexCount <= targetIndexCount) return 0.0f;
+
+    EdgeCollapser collapser(vertices, vertexCount, vertexSize, outIndices);
+    while (outIndices.size() > targetIndexCount && collapser.Round(targetIndexCount, targetError * targetError)) {}
+    return collapser.GetError();
+}
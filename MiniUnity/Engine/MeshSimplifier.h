@@ -0,0 +1,19 @@
+#pragma once
+#include "gl/glew.h"
+#include <vector>
+
+/// Reduces the triangle count of an indexed triangle list by collapsing edges in order of quadric error
+/// (Garland and Heckbert), keeping the vertices it starts from so the result can share their buffer.
+/// Positions are the first three components of each vertex. Vertices sharing a position but not their other
+/// components sit on a uv or normal seam: they only collapse along it, together with their twin on the other
+/// side, so the seam stays closed. Open borders only collapse along themselves, and vertices where more
+/// than two sides meet, like the edges between submeshes, never move.
+class MeshSimplifier
+{
+public:
+    /// Writes to outIndices a simplified copy of an index range, aiming at targetIndexCount indices without going
+    /// over targetError, a distance relative to the largest extent of the vertices so one setting fits meshes of any size.
+    /// Returns the error reached in model units, how far the simplified surface strays from the source one.
+    static float Simplify(const GLuint* indices, size_t indexCount, const GLfloat* vertices, unsigned int vertexCount, unsigned int vertexSize,
+        size_t targetIndexCount, float targetError, std::vector<GLuint>& outIndices);
+};
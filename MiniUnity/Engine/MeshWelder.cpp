@@ -0,0 +1,139 @@
+#include "MeshWelder.h"
+#include <math.h>
+#include <string.h>
+#include <stdint.h>
+#include <vector>
+
+namespace
+{
+    const GLuint EmptySlot = ~0u;
+    // grid cells are kept within +-2^62, the keys of values off the grid start above them
+    const double MaxCell = 4611686018427387904.0;
+    const uint64_t OffGridKey = 1ull << 62;
+
+    struct Slot
+    {
+        uint32_t hash;
+        GLuint vertex;
+    };
+
+    // maps a component to the integer that's compared and hashed
+    inline uint64_t ComponentKey(float value, float inverseEpsilon)
+    {
+        if (inverseEpsilon == 0.0f) {
+            // +0 turns -0 into +0 so both weld together
+            float normalized = value + 0.0f;
+            uint32_t bits;
+            memcpy(&bits, &normalized, sizeof(bits));
+            return bits;
+        }
+        // NaN, infinities and values too far for the grid come straight from the file, they only weld bitwise
+        const double cell = floor((double)value * inverseEpsilon + 0.5);
+        if (!(cell > -MaxCell && cell < MaxCell)) {
+            uint32_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            return OffGridKey + bits;
+        }
+        return (uint64_t)(int64_t)cell;
+    }
+
+    inline uint32_t HashVertex(const GLfloat* vertex, unsigned int vertexSize, float inverseEpsilon)
+    {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        for (unsigned int i = 0; i < vertexSize; ++i) {
+            hash ^= ComponentKey(vertex[i], inverseEpsilon);
+            hash *= 0x100000001b3ull;
+            hash ^= hash >> 29;
+        }
+        hash ^= hash >> 32;
+        return (uint32_t)hash;
+    }
+
+    inline bool VertexEquals(const GLfloat* a, const GLfloat* b, unsigned int vertexSize, float inverseEpsilon)
+    {
+        for (unsigned int i = 0; i < vertexSize; ++i) {
+            if (ComponentKey(a[i], inverseEpsilon) != ComponentKey(b[i], inverseEpsilon)) return false;
+        }
+        return true;
+    }
+
+    // linear probing table of unique vertices, sized to at most 50% load
+    class VertexTable
+    {
+    public:
+        VertexTable(unsigned int vertexCount)
+        {
+            size_t capacity = 16;
+            while (capacity < (size_t)vertexCount * 2) capacity *= 2;
+            slots.resize(capacity, { 0, EmptySlot });
+            mask = capacity - 1;
+        }
+
+        // returns the slot holding an equal vertex, or the empty slot where it has to be inserted
+        Slot& Find(const GLfloat* vertices, const GLfloat* vertex, uint32_t hash, unsigned int vertexSize, float inverseEpsilon)
+        {
+            size_t index = hash & mask;
+            for (;;) {
+                Slot& slot = slots[index];
+                if (slot.vertex == EmptySlot) return slot;
+                if (slot.hash == hash && VertexEquals(vertices + (size_t)slot.vertex * vertexSize, vertex, vertexSize, inverseEpsilon)) return slot;
+                index = (index + 1) & mask;
+            }
+        }
+
+    private:
+        std::vector<Slot> slots;
+        size_t mask;
+    };
+}
+
+unsigned int MeshWelder::BuildRemap(const GLfloat* vertices, unsigned int vertexCount, unsigned int vertexSize, float epsilon, std::vector<GLuint>& outRemap)
+{
+    const float inverseEpsilon = epsilon > 0.0f ? 1.0f / epsilon : 0.0f;
+
+    outRemap.resize(vertexCount);
+    VertexTable table(vertexCount);
+
+    // the table refers to source vertices, the first occurrence represents all its duplicates
+    unsigned int uniqueCount = 0;
+    for (unsigned int i = 0; i < vertexCount; ++i) {
+        const GLfloat* vertex = vertices + (size_t)i * vertexSize;
+        uint32_t hash = HashVertex(vertex, vertexSize, inverseEpsilon);
+        Slot& slot = table.Find(vertices, vertex, hash, vertexSize, inverseEpsilon);
+        if (slot.vertex == EmptySlot) {
+            slot.hash = hash;
+            slot.vertex = i;
+            outRemap[i] = uniqueCount++;
+        }
+        else {
+            outRemap[i] = outRemap[slot.vertex];
+        }
+    }
+    return uniqueCount;
+}
+
+unsigned int MeshWelder::Weld(std::vector<GLfloat>& vertices, std::vector<GLuint>& indices, unsigned int vertexSize, float epsilon)
+{
+    const unsigned int vertexCount = (unsigned int)(vertices.size() / vertexSize);
+
+    std::vector<GLuint> remap;
+    const unsigned int uniqueCount = BuildRemap(vertices.data(), vertexCount, vertexSize, epsilon, remap);
+
+    // unique vertices are numbered in first use order, so the first occurrence of the next unique
+    // vertex is always at or after its destination and compacting in place is safe
+    unsigned int written = 0;
+    for (unsigned int i = 0; i < vertexCount; ++i) {
+        if (remap[i] != written) continue;
+        if (written != i) {
+            memcpy(&vertices[(size_t)written * vertexSize], &vertices[(size_t)i * vertexSize], sizeof(GLfloat) * vertexSize);
+        }
+        ++written;
+    }
+    vertices.resize((size_t)uniqueCount * vertexSize);
+
+    for (GLuint& index : indices) {
+        index = remap[index];
+    }
+
+    return uniqueCount;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include "gl/glew.h"
+#include <vector>
+
+/// Merges duplicated vertices of an interleaved float vertex stream into a unique vertex table.
+class MeshWelder
+{
+public:
+    /// Computes for each vertex the index of its unique representative, numbered in first use order.
+    /// Components are quantized to a grid of size epsilon and weld when they round to the same cell, so two values
+    /// less than epsilon apart may still not weld across a cell boundary. An epsilon of 0 compares them bitwise.
+    /// Returns the number of unique vertices.
+    static unsigned int BuildRemap(const GLfloat* vertices, unsigned int vertexCount, unsigned int vertexSize, float epsilon, std::vector<GLuint>& outRemap);
+
+    /// Welds vertices in place, compacting them and rewriting indices to point to the unique ones.
+    /// Returns the number of unique vertices.
+    static unsigned int Weld(std::vector<GLfloat>& vertices, std::vector<GLuint>& indices, unsigned int vertexSize, float epsilon);
+};
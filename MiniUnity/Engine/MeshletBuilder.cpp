@@ -0,0 +1,227 @@
+#include "MeshletBuilder.h"
+#include "MeshWelder.h"
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+    // how much a triangle facing away from the meshlet costs compared to bringing in one more vertex
+    const float ConeWeight = 0.5f;
+    // below this the triangles span more than a hemisphere and no view sees them all from behind
+    const float MinConeSpread = 0.1f;
+    // a skinned meshlet keeps its cone when its bone moves all of its vertices, up to rounding
+    const uint32_t RigidWeight = 65535 * 99 / 100;
+
+    const uint32_t NotInMeshlet = ~0u;
+
+    struct Float3
+    {
+        float x, y, z;
+    };
+
+    inline Float3 Sub(const Float3& a, const Float3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+    inline Float3 Cross(const Float3& a, const Float3& b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+    inline float Dot(const Float3& a, const Float3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+    inline Float3 Normalize(const Float3& a)
+    {
+        const float length = sqrtf(Dot(a, a));
+        return length > 0.0f ? Float3{ a.x / length, a.y / length, a.z / length } : Float3{ 0.0f, 0.0f, 0.0f };
+    }
+
+    inline Float3 GetPosition(const GLfloat* vertices, unsigned int vertexSize, GLuint index)
+    {
+        const GLfloat* v = vertices + (size_t)index * vertexSize;
+        return { v[0], v[1], v[2] };
+    }
+
+    inline Float3 TriangleNormal(const GLfloat* vertices, unsigned int vertexSize, const GLuint* triangle)
+    {
+        const Float3 a = GetPosition(vertices, vertexSize, triangle[0]);
+        return Normalize(Cross(Sub(GetPosition(vertices, vertexSize, triangle[1]), a), Sub(GetPosition(vertices, vertexSize, triangle[2]), a)));
+    }
+}
+
+void MeshletBuilder::Partition(GLuint* indices, size_t indexCount, unsigned int firstIndex, const GLfloat* vertices, unsigned int vertexCount,
+    unsigned int vertexSize, std::vector<Meshlet>& outMeshlets)
+{
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) return;
+
+    // the triangles grow across uv and normal seams, so neighbours are found by position
+    std::vector<GLfloat> rawPositions((size_t)vertexCount * 3);
+    for (unsigned int i = 0; i < vertexCount; ++i) {
+        const GLfloat* vertex = vertices + (size_t)i * vertexSize;
+        rawPositions[(size_t)i * 3] = vertex[0];
+        rawPositions[(size_t)i * 3 + 1] = vertex[1];
+        rawPositions[(size_t)i * 3 + 2] = vertex[2];
+    }
+    std::vector<GLuint> positionIds;
+    const unsigned int positionCount = MeshWelder::BuildRemap(rawPositions.data(), vertexCount, 3, 0.0f, positionIds);
+
+    // triangles using each position, stored contiguously per position
+    std::vector<unsigned int> adjacencyOffsets(positionCount + 1, 0);
+    for (size_t i = 0; i < indexCount; ++i) adjacencyOffsets[positionIds[indices[i]] + 1]++;
+    for (unsigned int i = 0; i < positionCount; ++i) adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+    std::vector<unsigned int> adjacency(indexCount);
+    {
+        std::vector<unsigned int> filled(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < indexCount; ++i) adjacency[filled[positionIds[indices[i]]]++] = (unsigned int)(i / 3);
+    }
+
+    std::vector<Float3> normals(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t) normals[t] = TriangleNormal(vertices, vertexSize, indices + t * 3);
+
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    // the meshlet each vertex and position was last added to, so membership is a compare
+    std::vector<uint32_t> vertexMeshlet(vertexCount, NotInMeshlet);
+    std::vector<uint32_t> positionMeshlet(positionCount, NotInMeshlet);
+    std::vector<GLuint> ordered;
+    ordered.reserve(triangleCount * 3);
+    unsigned int meshletVertexCount = 0;
+    std::vector<GLuint> meshletPositions;
+    meshletPositions.reserve(ImportedMesh::MaxMeshletVertices);
+
+    size_t seed = 0;
+    size_t emittedCount = 0;
+    uint32_t meshletId = 0;
+    while (emittedCount < triangleCount) {
+        Meshlet meshlet = {};
+        meshlet.firstIndex = firstIndex + (uint32_t)ordered.size();
+        meshlet.bone = Meshlet::NoBone;
+        meshletVertexCount = 0;
+        meshletPositions.clear();
+        Float3 normalSum = { 0.0f, 0.0f, 0.0f };
+
+        // the next meshlet starts where the source order left off, it's spatially coherent after cache optimization
+        while (emitted[seed]) ++seed;
+        size_t triangle = seed;
+        unsigned int meshletTriangles = 0;
+        for (;;) {
+            const GLuint* corners = indices + triangle * 3;
+            for (int k = 0; k < 3; ++k) {
+                if (vertexMeshlet[corners[k]] == meshletId) continue;
+                vertexMeshlet[corners[k]] = meshletId;
+                ++meshletVertexCount;
+                const GLuint position = positionIds[corners[k]];
+                if (positionMeshlet[position] == meshletId) continue;
+                positionMeshlet[position] = meshletId;
+                meshletPositions.push_back(position);
+            }
+            ordered.insert(ordered.end(), corners, corners + 3);
+            emitted[triangle] = 1;
+            ++emittedCount;
+            normalSum = { normalSum.x + normals[triangle].x, normalSum.y + normals[triangle].y, normalSum.z + normals[triangle].z };
+            if (++meshletTriangles == ImportedMesh::MaxMeshletTriangles) break;
+
+            // the neighbour bringing in the fewest vertices, then the one facing most like the meshlet
+            const Float3 axis = Normalize(normalSum);
+            size_t best = triangleCount;
+            float bestScore = 0.0f;
+            for (GLuint position : meshletPositions) {
+                for (unsigned int i = adjacencyOffsets[position]; i < adjacencyOffsets[position + 1]; ++i) {
+                    const unsigned int candidate = adjacency[i];
+                    if (emitted[candidate]) continue;
+                    const GLuint* candidateCorners = indices + (size_t)candidate * 3;
+                    unsigned int extra = 0;
+                    for (int k = 0; k < 3; ++k) extra += vertexMeshlet[candidateCorners[k]] != meshletId ? 1 : 0;
+                    if (meshletVertexCount + extra > ImportedMesh::MaxMeshletVertices) continue;
+                    const float score = extra + (1.0f - Dot(normals[candidate], axis)) * ConeWeight;
+                    if (best == triangleCount || score < bestScore) {
+                        best = candidate;
+                        bestScore = score;
+                    }
+                }
+            }
+            if (best == triangleCount) break;
+            triangle = best;
+        }
+
+        meshlet.indexCount = meshletTriangles * 3;
+        outMeshlets.push_back(meshlet);
+        ++meshletId;
+    }
+
+    std::copy(ordered.begin(), ordered.end(), indices);
+}
+
+void MeshletBuilder::ComputeBounds(const ImportedMesh& mesh, Meshlet& meshlet)
+{
+    const GLuint* indices = mesh.indices.data() + meshlet.firstIndex;
+    const unsigned int vertexSize = ImportedMesh::VertexSize;
+
+    Float3 boundsMin = GetPosition(mesh.vertices.data(), vertexSize, indices[0]);
+    Float3 boundsMax = boundsMin;
+    for (uint32_t i = 1; i < meshlet.indexCount; ++i) {
+        const Float3 p = GetPosition(mesh.vertices.data(), vertexSize, indices[i]);
+        boundsMin = { std::min(boundsMin.x, p.x), std::min(boundsMin.y, p.y), std::min(boundsMin.z, p.z) };
+        boundsMax = { std::max(boundsMax.x, p.x), std::max(boundsMax.y, p.y), std::max(boundsMax.z, p.z) };
+    }
+    const Float3 center = { (boundsMin.x + boundsMax.x) * 0.5f, (boundsMin.y + boundsMax.y) * 0.5f, (boundsMin.z + boundsMax.z) * 0.5f };
+    float radiusSquared = 0.0f;
+    for (uint32_t i = 0; i < meshlet.indexCount; ++i) {
+        const Float3 offset = Sub(GetPosition(mesh.vertices.data(), vertexSize, indices[i]), center);
+        radiusSquared = std::max(radiusSquared, Dot(offset, offset));
+    }
+
+    // each target can add its whole delta, so the reach of a vertex is the sum of their lengths
+    float morphReach = 0.0f;
+    if (mesh.HasMorphTargets()) {
+        const float toUnits = mesh.morphPositionScale / 32767.0f;
+        for (uint32_t i = 0; i < meshlet.indexCount; ++i) {
+            float reach = 0.0f;
+            for (uint32_t d = mesh.morphStarts[indices[i]]; d < mesh.morphStarts[indices[i] + 1]; ++d) {
+                const int16_t* delta = mesh.morphDeltas[d].position;
+                const Float3 move = { (float)delta[0], (float)delta[1], (float)delta[2] };
+                reach += sqrtf(Dot(move, move)) * toUnits;
+            }
+            morphReach = std::max(morphReach, reach);
+        }
+    }
+
+    meshlet.center[0] = center.x;
+    meshlet.center[1] = center.y;
+    meshlet.center[2] = center.z;
+    meshlet.radius = sqrtf(radiusSquared) + morphReach;
+
+    bool rigid = morphReach == 0.0f;
+    meshlet.bone = Meshlet::NoBone;
+    if (mesh.IsSkinned()) {
+        std::vector<uint32_t> boneWeights(mesh.skeleton.bones.size(), 0);
+        for (uint32_t i = 0; i < meshlet.indexCount; ++i) {
+            const SkinVertex& skin = mesh.skinVertices[indices[i]];
+            for (int slot = 0; slot < 4; ++slot) {
+                if (skin.boneWeights[slot] > 0 && skin.boneIndices[slot] < boneWeights.size()) boneWeights[skin.boneIndices[slot]] += skin.boneWeights[slot];
+            }
+        }
+        meshlet.bone = (uint32_t)(std::max_element(boneWeights.begin(), boneWeights.end()) - boneWeights.begin());
+        for (uint32_t i = 0; i < meshlet.indexCount && rigid; ++i) {
+            const SkinVertex& skin = mesh.skinVertices[indices[i]];
+            uint32_t weight = 0;
+            for (int slot = 0; slot < 4; ++slot) {
+                if (skin.boneIndices[slot] == meshlet.bone) weight += skin.boneWeights[slot];
+            }
+            rigid = weight >= RigidWeight;
+        }
+    }
+
+    // the cone opens from the mean normal to the triangle facing furthest from it
+    Float3 normalSum = { 0.0f, 0.0f, 0.0f };
+    for (uint32_t i = 0; i < meshlet.indexCount; i += 3) {
+        const Float3 normal = TriangleNormal(mesh.vertices.data(), vertexSize, indices + i);
+        normalSum = { normalSum.x + normal.x, normalSum.y + normal.y, normalSum.z + normal.z };
+    }
+    const Float3 axis = Normalize(normalSum);
+    float minSpread = 1.0f;
+    for (uint32_t i = 0; i < meshlet.indexCount; i += 3) {
+        // degenerate triangles draw nothing, they don't widen the cone
+        const Float3 normal = TriangleNormal(mesh.vertices.data(), vertexSize, indices + i);
+        if (Dot(normal, normal) > 0.0f) minSpread = std::min(minSpread, Dot(normal, axis));
+    }
+    meshlet.coneAxis[0] = axis.x;
+    meshlet.coneAxis[1] = axis.y;
+    meshlet.coneAxis[2] = axis.z;
+    meshlet.coneCutoff = rigid && minSpread > MinConeSpread ? sqrtf(1.0f - minSpread * minSpread) : 1.0f;
+}
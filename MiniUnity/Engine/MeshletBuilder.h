@@ -0,0 +1,21 @@
+#pragma once
+#include "gl/glew.h"
+#include "ImportedMesh.h"
+#include <vector>
+
+/// Splits index ranges into meshlets, small clusters of neighbouring triangles that can be culled on their own.
+class MeshletBuilder
+{
+public:
+    /// Reorders the triangles of an index range so they form meshlets of at most ImportedMesh::MaxMeshletVertices vertices
+    /// and MaxMeshletTriangles triangles. Each grows over shared positions from the first triangle left, preferring the
+    /// triangles facing like the ones already in so its normal cone stays narrow. Positions are the first three components
+    /// of each vertex. The ranges, offset by firstIndex, are appended to outMeshlets; their bounds are left to ComputeBounds.
+    static void Partition(GLuint* indices, size_t indexCount, unsigned int firstIndex, const GLfloat* vertices, unsigned int vertexCount,
+        unsigned int vertexSize, std::vector<Meshlet>& outMeshlets);
+
+    /// Fills the sphere, normal cone and bone of a meshlet from the final mesh. Skinned meshlets follow the bone carrying most
+    /// of their weight and keep their cone only when it carries all of it. Morphed ones grow by how far their vertices move
+    /// with every weight at 1 and lose their cone.
+    static void ComputeBounds(const ImportedMesh& mesh, Meshlet& meshlet);
+};
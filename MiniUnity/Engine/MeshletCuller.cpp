@@ -0,0 +1,95 @@
+#include "MeshletCuller.h"
+#include "SkeletonPose.h"
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+
+const float MeshletCuller::SkinnedRadiusScale = 1.5f;
+
+namespace
+{
+    inline float Dot3(const float* a, const float* b) { return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]; }
+}
+
+MeshletCuller::View MeshletCuller::MakeView(const float* modelViewProjection, const float* cameraPosition)
+{
+    // each plane is the last row of the matrix plus or minus one of the others (Gribb and Hartmann)
+    const float* m = modelViewProjection;
+    View view;
+    for (int axis = 0; axis < 3; ++axis) {
+        for (int side = 0; side < 2; ++side) {
+            float* plane = view.planes[axis * 2 + side];
+            const float sign = side == 0 ? 1.0f : -1.0f;
+            for (int column = 0; column < 4; ++column) plane[column] = m[column * 4 + 3] + sign * m[column * 4 + axis];
+            const float length = sqrtf(Dot3(plane, plane));
+            if (length > 0.0f) {
+                for (int column = 0; column < 4; ++column) plane[column] /= length;
+            }
+        }
+    }
+    for (int i = 0; i < 3; ++i) view.cameraPosition[i] = cameraPosition[i];
+    return view;
+}
+
+void MeshletCuller::Cull(const Meshlet* meshlets, unsigned int meshletCount, const View& view, const float* bonePalette, unsigned int boneCount,
+    MeshletDrawList& outDrawList, MeshletCullStats* outStats)
+{
+    outDrawList.Clear();
+    MeshletCullStats stats;
+    stats.meshletCount = meshletCount;
+
+    // the end of the last range drawn, to append the meshlets following it instead of starting a new one
+    uint32_t drawEnd = ~0u;
+    for (unsigned int i = 0; i < meshletCount; ++i) {
+        const Meshlet& meshlet = meshlets[i];
+        stats.triangleCount += meshlet.indexCount / 3;
+
+        float center[3] = { meshlet.center[0], meshlet.center[1], meshlet.center[2] };
+        float axis[3] = { meshlet.coneAxis[0], meshlet.coneAxis[1], meshlet.coneAxis[2] };
+        float radius = meshlet.radius;
+        if (bonePalette && meshlet.bone < boneCount) {
+            // rows of the affine transform of the bone
+            const float* m = bonePalette + (size_t)meshlet.bone * SkeletonPose::PaletteStride;
+            float scale = 0.0f;
+            for (int column = 0; column < 3; ++column)
+                scale = std::max(scale, m[column] * m[column] + m[4 + column] * m[4 + column] + m[8 + column] * m[8 + column]);
+            for (int row = 0; row < 3; ++row) {
+                center[row] = Dot3(m + row * 4, meshlet.center) + m[row * 4 + 3];
+                axis[row] = Dot3(m + row * 4, meshlet.coneAxis);
+            }
+            radius *= sqrtf(scale) * SkinnedRadiusScale;
+            const float axisLength = sqrtf(Dot3(axis, axis));
+            if (axisLength > 0.0f) {
+                for (int k = 0; k < 3; ++k) axis[k] /= axisLength;
+            }
+        }
+
+        bool culled = false;
+        for (int p = 0; p < 6 && !culled; ++p) culled = Dot3(view.planes[p], center) + view.planes[p][3] < -radius;
+        if (culled) {
+            ++stats.frustumCulled;
+        }
+        else if (meshlet.coneCutoff < 1.0f) {
+            // seen from inside the cone mirrored behind the meshlet every triangle faces away (meshoptimizer's test)
+            const float toCenter[3] = { center[0] - view.cameraPosition[0], center[1] - view.cameraPosition[1], center[2] - view.cameraPosition[2] };
+            culled = Dot3(toCenter, axis) >= meshlet.coneCutoff * sqrtf(Dot3(toCenter, toCenter)) + radius;
+            if (culled) ++stats.backfaceCulled;
+        }
+        if (culled) {
+            stats.trianglesCulled += meshlet.indexCount / 3;
+            continue;
+        }
+
+        if (meshlet.firstIndex == drawEnd) {
+            outDrawList.counts.back() += (GLsizei)meshlet.indexCount;
+        }
+        else {
+            outDrawList.counts.push_back((GLsizei)meshlet.indexCount);
+            outDrawList.offsets.push_back((const void*)(sizeof(GLuint) * meshlet.firstIndex));
+        }
+        drawEnd = meshlet.firstIndex + meshlet.indexCount;
+    }
+
+    stats.drawCount = (unsigned int)outDrawList.counts.size();
+    if (outStats) *outStats = stats;
+}
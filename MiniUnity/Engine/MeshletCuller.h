@@ -0,0 +1,56 @@
+#pragma once
+#include "gl/glew.h"
+#include "ImportedMesh.h"
+#include <vector>
+
+/// Index ranges left after culling, ready for glMultiDrawElements.
+struct MeshletDrawList
+{
+    std::vector<GLsizei> counts;
+    /// Byte offsets of the first index of each range in the index buffer.
+    std::vector<const void*> offsets;
+
+    void Clear()
+    {
+        counts.clear();
+        offsets.clear();
+    }
+    GLsizei GetDrawCount() const { return (GLsizei)counts.size(); }
+};
+
+/// What a culling pass rejected, for logging and profiling.
+struct MeshletCullStats
+{
+    unsigned int meshletCount = 0;
+    unsigned int frustumCulled = 0;
+    unsigned int backfaceCulled = 0;
+    unsigned int triangleCount = 0;
+    unsigned int trianglesCulled = 0;
+    /// Ranges in the draw list after merging neighbouring meshlets.
+    unsigned int drawCount = 0;
+};
+
+/// Rejects the meshlets outside the view frustum or facing away from the camera on the CPU before drawing,
+/// and turns the ones left into a draw list, merging those following each other in the index buffer.
+class MeshletCuller
+{
+public:
+    /// Frustum planes and camera position in the model space of the mesh, so the meshlets are tested as they are stored.
+    struct View
+    {
+        /// Inside is where dot(plane.xyz, p) + plane.w >= 0, the normals are unit length.
+        float planes[6][4];
+        float cameraPosition[3];
+    };
+
+    /// Skinned meshlets are posed by their main bone only, their spheres grow by this factor for the pull of the others.
+    static const float SkinnedRadiusScale;
+
+    /// modelViewProjection is column major like GL, cameraPosition is in model space.
+    static View MakeView(const float* modelViewProjection, const float* cameraPosition);
+
+    /// Culls meshlets and writes the visible ones to outDrawList. bonePalette poses the meshlets of skinned meshes with
+    /// SkeletonPose::PaletteStride floats per bone, null tests them in their bind pose.
+    static void Cull(const Meshlet* meshlets, unsigned int meshletCount, const View& view, const float* bonePalette, unsigned int boneCount,
+        MeshletDrawList& outDrawList, MeshletCullStats* outStats = nullptr);
+};
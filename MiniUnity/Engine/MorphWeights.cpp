@@ -0,0 +1,32 @@
+#include "MorphWeights.h"
+
+unsigned int MorphWeights::Add(const float* targetWeights, unsigned int targetCount)
+{
+    const unsigned int firstWeight = GetWeightCount();
+    weights.insert(weights.end(), targetWeights, targetWeights + targetCount);
+    return firstWeight;
+}
+
+void MorphWeights::Upload()
+{
+    const size_t bytes = weights.size() * sizeof(float);
+    // a texture buffer over an empty store is incomplete, there is always room for one weight
+    if (capacityBytes < bytes || capacityBytes == 0) capacityBytes = bytes > 0 ? bytes : sizeof(float);
+
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    if (buffer == 0) {
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, capacityBytes, nullptr, GL_STREAM_DRAW);
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, buffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+    else {
+        // orphaned like the BonePalette, the frames in flight keep their weights
+        glBufferData(GL_TEXTURE_BUFFER, capacityBytes, nullptr, GL_STREAM_DRAW);
+    }
+    if (bytes > 0) glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, weights.data());
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "gl/glew.h"
+#include <vector>
+
+/// The morph target weights of every morphed mesh drawn in a frame, gathered on the CPU and sent to the GPU
+/// in a single upload like the BonePalette. The shader reads them from a texture buffer, one R32F texel per
+/// target starting at the first weight returned by Add, and skips the targets weighing 0.
+/// The buffer and texture live in the shared GL context, so they survive window recreation.
+class MorphWeights
+{
+public:
+    MorphWeights() = default;
+    /// GL objects are left to the context, like the AssetLoader ones.
+    ~MorphWeights() = default;
+
+    MorphWeights(const MorphWeights&) = delete;
+    MorphWeights& operator=(const MorphWeights&) = delete;
+
+    /// Starts a new frame, the weights added before are dropped.
+    void Clear() { weights.clear(); }
+    /// Copies one weight per morph target of a mesh and returns the index of the first one.
+    unsigned int Add(const float* targetWeights, unsigned int targetCount);
+    unsigned int GetWeightCount() const { return (unsigned int)weights.size(); }
+
+    /// Sends the weights added since Clear, once per frame before drawing. Must be called on the thread owning the GL context.
+    void Upload();
+    /// GL_TEXTURE_BUFFER texture over the weights, valid after the first Upload.
+    GLuint GetTexture() const { return texture; }
+
+private:
+    std::vector<float> weights;
+    GLuint buffer = 0;
+    GLuint texture = 0;
+    // bytes allocated for the buffer, it only grows
+    size_t capacityBytes = 0;
+};
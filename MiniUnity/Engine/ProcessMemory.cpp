@@ -0,0 +1,29 @@
+#include "ProcessMemory.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <stdio.h>
+#include <unistd.h>
+#endif
+
+size_t ProcessMemory::GetResidentSize()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.WorkingSetSize;
+#else
+    // the second field of statm is the resident size in pages
+    FILE* file = fopen("/proc/self/statm", "r");
+    if (!file) return 0;
+    unsigned long long totalPages = 0;
+    unsigned long long residentPages = 0;
+    const bool read = fscanf(file, "%llu %llu", &totalPages, &residentPages) == 2;
+    fclose(file);
+    return read ? (size_t)(residentPages * (unsigned long long)sysconf(_SC_PAGESIZE)) : 0;
+#endif
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include <stddef.h>
+
+/// Memory of the running process, for the benchmarks.
+class ProcessMemory
+{
+public:
+    /// Bytes of the process currently in physical memory, the pages of mapped files included. 0 when it can't be queried.
+    static size_t GetResidentSize();
+};
@@ -0,0 +1,83 @@
+#include "SkeletonPose.h"
+#include <string.h>
+#include <unordered_map>
+
+namespace
+{
+    // column major 4x4
+    void Multiply(const float* lhs, const float* rhs, float* out)
+    {
+        for (int column = 0; column < 4; ++column) {
+            for (int row = 0; row < 4; ++row) {
+                out[column * 4 + row] = lhs[row] * rhs[column * 4] + lhs[4 + row] * rhs[column * 4 + 1]
+                    + lhs[8 + row] * rhs[column * 4 + 2] + lhs[12 + row] * rhs[column * 4 + 3];
+            }
+        }
+    }
+
+    // translation * rotation * scale, like the matrices the poses were decomposed from
+    void ComposePose(const BonePose& pose, float* out)
+    {
+        const float x = pose.rotation[0], y = pose.rotation[1], z = pose.rotation[2], w = pose.rotation[3];
+        const float axes[3][3] = {
+            { 1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + z * w), 2.0f * (x * z - y * w) },
+            { 2.0f * (x * y - z * w), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + x * w) },
+            { 2.0f * (x * z + y * w), 2.0f * (y * z - x * w), 1.0f - 2.0f * (x * x + y * y) },
+        };
+        for (int column = 0; column < 3; ++column) {
+            for (int row = 0; row < 3; ++row) out[column * 4 + row] = axes[column][row] * pose.scale[column];
+            out[column * 4 + 3] = 0.0f;
+        }
+        for (int row = 0; row < 3; ++row) out[12 + row] = pose.translation[row];
+        out[15] = 1.0f;
+    }
+}
+
+SkeletonPose::SkeletonPose(const Skeleton& skeleton, const AnimationClip* clip)
+    : skeleton(skeleton), clip(clip)
+{
+    nodeTracks.assign(skeleton.nodes.size(), -1);
+    if (clip) {
+        std::unordered_map<std::string, int> tracks;
+        for (unsigned int track = 0; track < clip->GetTrackCount(); ++track) tracks.emplace(clip->trackNames[track], (int)track);
+        for (size_t node = 0; node < skeleton.nodes.size(); ++node) {
+            auto found = tracks.find(skeleton.nodeNames[node]);
+            if (found != tracks.end()) nodeTracks[node] = found->second;
+        }
+        poses.resize(clip->GetTrackCount());
+    }
+    globals.resize(skeleton.nodes.size() * 16);
+    palette.resize(skeleton.bones.size() * PaletteStride);
+}
+
+void SkeletonPose::Evaluate(float time)
+{
+    if (clip) clip->Sample(time, poses.data());
+
+    // parents come first, their global transform is always ready
+    float local[16];
+    for (size_t node = 0; node < skeleton.nodes.size(); ++node) {
+        const SkeletonNode& skeletonNode = skeleton.nodes[node];
+        const float* nodeLocal = skeletonNode.restLocal;
+        if (nodeTracks[node] >= 0) {
+            ComposePose(poses[nodeTracks[node]], local);
+            nodeLocal = local;
+        }
+        float* global = &globals[node * 16];
+        if (skeletonNode.parent < 0) memcpy(global, nodeLocal, sizeof(local));
+        else Multiply(&globals[(size_t)skeletonNode.parent * 16], nodeLocal, global);
+    }
+
+    float boneToScene[16];
+    float matrix[16];
+    for (size_t bone = 0; bone < skeleton.bones.size(); ++bone) {
+        const SkinBone& skinBone = skeleton.bones[bone];
+        Multiply(&globals[(size_t)skinBone.node * 16], skinBone.inverseBind, boneToScene);
+        Multiply(skinBone.meshFromScene, boneToScene, matrix);
+
+        float* rows = &palette[bone * PaletteStride];
+        for (int row = 0; row < 3; ++row) {
+            for (int column = 0; column < 4; ++column) rows[row * 4 + column] = matrix[column * 4 + row];
+        }
+    }
+}
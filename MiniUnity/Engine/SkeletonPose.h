@@ -0,0 +1,34 @@
+#pragma once
+#include "AnimationClip.h"
+#include "ImportedMesh.h"
+#include <vector>
+
+/// Poses the skeleton of a skinned mesh with an animation clip and computes its bone palette,
+/// the matrices the vertex shader blends. Tracks are matched to the skeleton nodes by name,
+/// the nodes without one keep their rest pose.
+class SkeletonPose
+{
+public:
+    /// Floats per bone in the palette, the three rows of its affine transform.
+    static const unsigned int PaletteStride = 12;
+
+    /// The skeleton and the clip must outlive the pose, without clip the skeleton stays in its rest pose.
+    SkeletonPose(const Skeleton& skeleton, const AnimationClip* clip);
+
+    /// Samples the clip at time, clamped to the clip, and recomputes the palette.
+    void Evaluate(float time);
+
+    unsigned int GetBoneCount() const { return (unsigned int)skeleton.bones.size(); }
+    /// PaletteStride floats per bone, valid after Evaluate.
+    const float* GetPalette() const { return palette.data(); }
+
+private:
+    const Skeleton& skeleton;
+    const AnimationClip* clip;
+    // clip track of each node, -1 for the ones in their rest pose
+    std::vector<int> nodeTracks;
+    std::vector<BonePose> poses;
+    // column major transforms of the nodes in the scene
+    std::vector<float> globals;
+    std::vector<float> palette;
+};
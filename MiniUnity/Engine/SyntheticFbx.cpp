@@ -0,0 +1,526 @@
+#include "SyntheticFbx.h"
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+    // FBX 7.4 records have 32 bit offsets, the ones holding children end with a null record of 13 bytes
+    const uint32_t FbxVersion = 7400;
+    const size_t NullRecordSize = 13;
+
+    // Deflate stream of a single block of fixed Huffman literals with a zlib header, bigger than the input
+    // but enough to exercise the decompressor without shipping a compressor.
+    std::vector<uint8_t> Deflate(const void* data, size_t size)
+    {
+        std::vector<uint8_t> stream = { 0x78, 0x01 };
+        uint32_t bitBuffer = 0;
+        unsigned int bitCount = 0;
+        // deflate packs bits from the least significant, Huffman codes from their most significant bit
+        auto putBits = [&](uint32_t bits, unsigned int count) {
+            bitBuffer |= bits << bitCount;
+            bitCount += count;
+            while (bitCount >= 8) {
+                stream.push_back((uint8_t)bitBuffer);
+                bitBuffer >>= 8;
+                bitCount -= 8;
+            }
+        };
+        auto putCode = [&](uint32_t code, unsigned int length) {
+            uint32_t reversed = 0;
+            for (unsigned int i = 0; i < length; ++i) reversed |= ((code >> i) & 1) << (length - 1 - i);
+            putBits(reversed, length);
+        };
+
+        putBits(1, 1); // last block
+        putBits(1, 2); // fixed Huffman codes
+        const uint8_t* bytes = (const uint8_t*)data;
+        uint32_t adlerA = 1, adlerB = 0;
+        for (size_t i = 0; i < size; ++i) {
+            if (bytes[i] < 144) putCode(0x30 + bytes[i], 8);
+            else putCode(0x190 + bytes[i] - 144, 9);
+            adlerA = (adlerA + bytes[i]) % 65521;
+            adlerB = (adlerB + adlerA) % 65521;
+        }
+        putCode(0, 7); // end of block
+        if (bitCount > 0) putBits(0, 8 - bitCount);
+
+        const uint32_t adler = (adlerB << 16) | adlerA;
+        stream.insert(stream.end(), { (uint8_t)(adler >> 24), (uint8_t)(adler >> 16), (uint8_t)(adler >> 8), (uint8_t)adler });
+        return stream;
+    }
+
+    // Builds the file in memory, the offsets of the records are patched as they are closed.
+    class RecordWriter
+    {
+    public:
+        std::vector<uint8_t> bytes;
+        bool compressArrays = false;
+
+        RecordWriter()
+        {
+            const char magic[23] = "Kaydara FBX Binary  \0\x1a";
+            Append(magic, sizeof(magic));
+            Append(&FbxVersion, sizeof(FbxVersion));
+        }
+
+        // the properties of the record follow, then its children
+        void Begin(const char* name)
+        {
+            if (!records.empty() && !records.back().hasChildren) {
+                ClosePropertyList(records.back());
+                records.back().hasChildren = true;
+            }
+            Record record = { bytes.size(), 0, 0, false };
+            bytes.resize(bytes.size() + 12, 0);
+            const uint8_t length = (uint8_t)strlen(name);
+            Append(&length, 1);
+            Append(name, length);
+            record.propertiesStart = bytes.size();
+            records.push_back(record);
+        }
+
+        void End()
+        {
+            Record& record = records.back();
+            if (!record.hasChildren) ClosePropertyList(record);
+            else bytes.resize(bytes.size() + NullRecordSize, 0);
+            const uint32_t endOffset = (uint32_t)bytes.size();
+            memcpy(&bytes[record.start], &endOffset, sizeof(endOffset));
+            records.pop_back();
+        }
+
+        // a record without children, the usual way of storing a value
+        template <typename T> void Leaf(const char* name, const T& value)
+        {
+            Begin(name);
+            Property(value);
+            End();
+        }
+
+        void Property(int32_t value) { Typed('I', &value, sizeof(value)); }
+        void Property(int64_t value) { Typed('L', &value, sizeof(value)); }
+        void Property(double value) { Typed('D', &value, sizeof(value)); }
+        void Property(const std::string& value)
+        {
+            const uint32_t length = (uint32_t)value.size();
+            Typed('S', &length, sizeof(length));
+            Append(value.data(), value.size());
+        }
+        void Property(const char* value) { Property(std::string(value)); }
+        void Property(const std::vector<double>& values) { Array('d', values.data(), (uint32_t)values.size(), sizeof(double)); }
+        void Property(const std::vector<float>& values) { Array('f', values.data(), (uint32_t)values.size(), sizeof(float)); }
+        void Property(const std::vector<int32_t>& values) { Array('i', values.data(), (uint32_t)values.size(), sizeof(int32_t)); }
+        void Property(const std::vector<int64_t>& values) { Array('l', values.data(), (uint32_t)values.size(), sizeof(int64_t)); }
+
+    private:
+        struct Record
+        {
+            size_t start;
+            size_t propertiesStart;
+            uint32_t propertyCount;
+            bool hasChildren;
+        };
+        std::vector<Record> records;
+
+        void Append(const void* data, size_t size)
+        {
+            const uint8_t* begin = (const uint8_t*)data;
+            bytes.insert(bytes.end(), begin, begin + size);
+        }
+
+        void Typed(char type, const void* data, size_t size)
+        {
+            Append(&type, 1);
+            Append(data, size);
+            ++records.back().propertyCount;
+        }
+
+        // encoding 0 for raw arrays, 1 for deflated ones
+        void Array(char type, const void* data, uint32_t count, uint32_t elementSize)
+        {
+            if (compressArrays) {
+                const std::vector<uint8_t> compressed = Deflate(data, (size_t)count * elementSize);
+                const uint32_t header[3] = { count, 1, (uint32_t)compressed.size() };
+                Typed(type, header, sizeof(header));
+                Append(compressed.data(), compressed.size());
+                return;
+            }
+            const uint32_t header[3] = { count, 0, count * elementSize };
+            Typed(type, header, sizeof(header));
+            Append(data, (size_t)count * elementSize);
+        }
+
+        void ClosePropertyList(const Record& record)
+        {
+            const uint32_t propertyListLength = (uint32_t)(bytes.size() - record.propertiesStart);
+            memcpy(&bytes[record.start + 4], &record.propertyCount, sizeof(uint32_t));
+            memcpy(&bytes[record.start + 8], &propertyListLength, sizeof(uint32_t));
+        }
+    };
+
+    // names are "<name><index>\0\x01<class>" in binary files
+    std::string ObjectName(const char* name, unsigned int index, const char* objectClass)
+    {
+        return name + std::to_string(index) + std::string("\0\x01", 2) + objectClass;
+    }
+
+    void WriteLayerElement(RecordWriter& writer, const char* type)
+    {
+        writer.Begin("LayerElement");
+        writer.Leaf("Type", type);
+        writer.Leaf("TypedIndex", (int32_t)0);
+        writer.End();
+    }
+
+    // A wavy grid of quads, shifted along x so the meshes don't overlap. Normals are per polygon-vertex
+    // and uvs are indexed, the mappings exporters use the most.
+    void WriteGrid(RecordWriter& writer, unsigned int mesh, unsigned int gridSize, int64_t id)
+    {
+        const unsigned int side = gridSize + 1;
+        const double offset = (double)mesh * (gridSize + 2);
+        std::vector<double> vertices;
+        std::vector<double> controlNormals;
+        std::vector<double> uvs;
+        vertices.reserve((size_t)side * side * 3);
+        controlNormals.reserve((size_t)side * side * 3);
+        uvs.reserve((size_t)side * side * 2);
+        for (unsigned int z = 0; z < side; ++z) {
+            for (unsigned int x = 0; x < side; ++x) {
+                const double height = 0.5 * sin(x * 0.3) * cos(z * 0.2);
+                const double slopeX = 0.15 * cos(x * 0.3) * cos(z * 0.2);
+                const double slopeZ = -0.1 * sin(x * 0.3) * sin(z * 0.2);
+                const double length = sqrt(slopeX * slopeX + 1.0 + slopeZ * slopeZ);
+                vertices.insert(vertices.end(), { offset + x, height, (double)z });
+                controlNormals.insert(controlNormals.end(), { -slopeX / length, 1.0 / length, -slopeZ / length });
+                uvs.insert(uvs.end(), { (double)x / gridSize, (double)z / gridSize });
+            }
+        }
+
+        // the last index of each polygon is stored as -(index + 1)
+        std::vector<int32_t> polygonVertices;
+        std::vector<int32_t> uvIndices;
+        std::vector<double> normals;
+        polygonVertices.reserve((size_t)gridSize * gridSize * 4);
+        normals.reserve((size_t)gridSize * gridSize * 12);
+        for (unsigned int z = 0; z < gridSize; ++z) {
+            for (unsigned int x = 0; x < gridSize; ++x) {
+                const int32_t corner = (int32_t)(z * side + x);
+                const int32_t corners[4] = { corner, corner + (int32_t)side, corner + (int32_t)side + 1, corner + 1 };
+                for (int i = 0; i < 4; ++i) {
+                    polygonVertices.push_back(i == 3 ? -corners[i] - 1 : corners[i]);
+                    normals.insert(normals.end(), controlNormals.begin() + corners[i] * 3, controlNormals.begin() + corners[i] * 3 + 3);
+                }
+            }
+        }
+        for (int32_t index : polygonVertices) uvIndices.push_back(index < 0 ? -index - 1 : index);
+
+        writer.Begin("Geometry");
+        writer.Property(id);
+        writer.Property(ObjectName("grid", mesh, "Geometry"));
+        writer.Property("Mesh");
+        writer.Leaf("Vertices", vertices);
+        writer.Leaf("PolygonVertexIndex", polygonVertices);
+        writer.Leaf("GeometryVersion", (int32_t)124);
+
+        writer.Begin("LayerElementNormal");
+        writer.Property((int32_t)0);
+        writer.Leaf("Version", (int32_t)101);
+        writer.Leaf("Name", "");
+        writer.Leaf("MappingInformationType", "ByPolygonVertex");
+        writer.Leaf("ReferenceInformationType", "Direct");
+        writer.Leaf("Normals", normals);
+        writer.End();
+
+        writer.Begin("LayerElementUV");
+        writer.Property((int32_t)0);
+        writer.Leaf("Version", (int32_t)101);
+        writer.Leaf("Name", "map1");
+        writer.Leaf("MappingInformationType", "ByPolygonVertex");
+        writer.Leaf("ReferenceInformationType", "IndexToDirect");
+        writer.Leaf("UV", uvs);
+        writer.Leaf("UVIndex", uvIndices);
+        writer.End();
+
+        writer.Begin("Layer");
+        writer.Property((int32_t)0);
+        writer.Leaf("Version", (int32_t)100);
+        WriteLayerElement(writer, "LayerElementNormal");
+        WriteLayerElement(writer, "LayerElementUV");
+        writer.End();
+        writer.End();
+
+        writer.Begin("Model");
+        writer.Property(id + 1);
+        writer.Property(ObjectName("grid", mesh, "Model"));
+        writer.Property("Mesh");
+        writer.Leaf("Version", (int32_t)232);
+        writer.End();
+    }
+
+    void WriteConnection(RecordWriter& writer, int64_t child, int64_t parent, const char* parentProperty = nullptr)
+    {
+        writer.Begin("C");
+        writer.Property(parentProperty ? "OP" : "OO");
+        writer.Property(child);
+        writer.Property(parent);
+        if (parentProperty) writer.Property(parentProperty);
+        writer.End();
+    }
+
+    // a P record of Properties70 holding a vector, like the Lcl transforms
+    void WriteVectorProperty(RecordWriter& writer, const char* name, double x, double y, double z)
+    {
+        writer.Begin("P");
+        writer.Property(name);
+        writer.Property(name);
+        writer.Property("");
+        writer.Property("A");
+        writer.Property(x);
+        writer.Property(y);
+        writer.Property(z);
+        writer.End();
+    }
+
+    // FBX time units per second
+    const int64_t FbxSecond = 46186158000;
+
+    // Limb nodes in a tree whose children are offset along y, each weighting one vertex of the grid, then a rotation
+    // curve node per bone. Connections are written by the caller, the skin link last like exporters that append it.
+    struct Rig
+    {
+        int64_t firstBone, firstCluster, skin, stack, layer, firstCurveNode;
+
+        void WriteObjects(RecordWriter& writer, const SyntheticFbxSettings& settings, unsigned int vertexCount)
+        {
+            for (unsigned int bone = 0; bone < settings.boneCount; ++bone) {
+                writer.Begin("Model");
+                writer.Property(firstBone + bone);
+                writer.Property(ObjectName("bone", bone, "Model"));
+                writer.Property("LimbNode");
+                writer.Leaf("Version", (int32_t)232);
+                writer.Begin("Properties70");
+                WriteVectorProperty(writer, "Lcl Translation", bone % 3 * 0.1, 1.0, 0.0);
+                WriteVectorProperty(writer, "Lcl Rotation", 0.0, bone % 7 * 5.0, 10.0);
+                writer.End();
+                writer.End();
+
+                writer.Begin("Deformer");
+                writer.Property(firstCluster + bone);
+                writer.Property(ObjectName("cluster", bone, "SubDeformer"));
+                writer.Property("Cluster");
+                writer.Leaf("Version", (int32_t)100);
+                writer.Leaf("Indexes", std::vector<int32_t>(1, (int32_t)(bone % vertexCount)));
+                writer.Leaf("Weights", std::vector<double>(1, 1.0));
+                std::vector<double> identity(16, 0.0);
+                identity[0] = identity[5] = identity[10] = identity[15] = 1.0;
+                writer.Leaf("Transform", identity);
+                writer.Leaf("TransformLink", identity);
+                writer.End();
+            }
+            writer.Begin("Deformer");
+            writer.Property(skin);
+            writer.Property(ObjectName("skin", 0, "Deformer"));
+            writer.Property("Skin");
+            writer.Leaf("Version", (int32_t)101);
+            writer.End();
+
+            if (settings.animationKeyCount == 0) return;
+            writer.Begin("AnimationStack");
+            writer.Property(stack);
+            writer.Property(ObjectName("take", 0, "AnimStack"));
+            writer.Property("");
+            writer.End();
+            writer.Begin("AnimationLayer");
+            writer.Property(layer);
+            writer.Property(ObjectName("layer", 0, "AnimLayer"));
+            writer.Property("");
+            writer.End();
+
+            std::vector<int64_t> times(settings.animationKeyCount);
+            for (unsigned int key = 0; key < settings.animationKeyCount; ++key) times[key] = key * (FbxSecond / 30);
+            std::vector<float> values(settings.animationKeyCount);
+            for (unsigned int bone = 0; bone < settings.boneCount; ++bone) {
+                const int64_t curveNode = firstCurveNode + bone * 4;
+                writer.Begin("AnimationCurveNode");
+                writer.Property(curveNode);
+                writer.Property(ObjectName("R", bone, "AnimCurveNode"));
+                writer.Property("");
+                writer.Begin("Properties70");
+                for (const char* channel : { "d|X", "d|Y", "d|Z" }) {
+                    writer.Begin("P");
+                    writer.Property(channel);
+                    writer.Property("Number");
+                    writer.Property("");
+                    writer.Property("A");
+                    writer.Property(0.0);
+                    writer.End();
+                }
+                writer.End();
+                writer.End();
+
+                for (unsigned int axis = 0; axis < 3; ++axis) {
+                    for (unsigned int key = 0; key < settings.animationKeyCount; ++key)
+                        values[key] = (float)(30.0 * sin(key * 0.05 + bone * 0.3 + axis));
+                    writer.Begin("AnimationCurve");
+                    writer.Property(curveNode + 1 + axis);
+                    writer.Property(ObjectName("curve", bone * 3 + axis, "AnimCurve"));
+                    writer.Property("");
+                    writer.Leaf("Default", 0.0);
+                    writer.Leaf("KeyVer", (int32_t)4009);
+                    writer.Leaf("KeyTime", times);
+                    writer.Leaf("KeyValueFloat", values);
+                    writer.End();
+                }
+            }
+        }
+
+        void WriteConnections(RecordWriter& writer, const SyntheticFbxSettings& settings, int64_t geometry)
+        {
+            for (unsigned int bone = 0; bone < settings.boneCount; ++bone) {
+                const int64_t parent = bone == 0 ? 0 : firstBone + (bone - 1) / std::max(settings.boneBranching, 1u);
+                WriteConnection(writer, firstBone + bone, parent);
+                WriteConnection(writer, firstBone + bone, firstCluster + bone);
+                WriteConnection(writer, firstCluster + bone, skin);
+            }
+            if (settings.animationKeyCount > 0) {
+                WriteConnection(writer, layer, stack);
+                for (unsigned int bone = 0; bone < settings.boneCount; ++bone) {
+                    const int64_t curveNode = firstCurveNode + bone * 4;
+                    WriteConnection(writer, curveNode, layer);
+                    WriteConnection(writer, curveNode, firstBone + bone, "Lcl Rotation");
+                    WriteConnection(writer, curveNode + 1, curveNode, "d|X");
+                    WriteConnection(writer, curveNode + 2, curveNode, "d|Y");
+                    WriteConnection(writer, curveNode + 3, curveNode, "d|Z");
+                }
+            }
+            WriteConnection(writer, skin, geometry);
+        }
+    };
+
+    // Channels of a single full shape each, moving the control points of the first grid within a disc of it up
+    // and tilting their normals away from its center, so every target only covers a part of the mesh.
+    struct BlendShapes
+    {
+        int64_t blendShape, firstChannel;
+
+        void WriteObjects(RecordWriter& writer, const SyntheticFbxSettings& settings)
+        {
+            writer.Begin("Deformer");
+            writer.Property(blendShape);
+            writer.Property(ObjectName("blend", 0, "Deformer"));
+            writer.Property("BlendShape");
+            writer.Leaf("Version", (int32_t)100);
+            writer.End();
+
+            const unsigned int side = settings.gridSize + 1;
+            const double radius = std::max(settings.gridSize * 0.12, 1.0);
+            for (unsigned int channel = 0; channel < settings.blendShapeCount; ++channel) {
+                const double centerX = settings.gridSize * (0.5 + 0.4 * sin(channel * 2.4));
+                const double centerZ = settings.gridSize * (0.5 + 0.4 * cos(channel * 1.7));
+                std::vector<int32_t> indexes;
+                std::vector<double> vertices;
+                std::vector<double> normals;
+                for (unsigned int z = 0; z < side; ++z) {
+                    for (unsigned int x = 0; x < side; ++x) {
+                        const double dx = x - centerX, dz = z - centerZ;
+                        const double distance = sqrt(dx * dx + dz * dz);
+                        if (distance >= radius) continue;
+                        const double falloff = cos(distance / radius * 1.5707963);
+                        const double tilt = -0.3 * sin(distance / radius * 3.1415927) / std::max(distance, 1e-9);
+                        indexes.push_back((int32_t)(z * side + x));
+                        vertices.insert(vertices.end(), { 0.0, 3.0 * falloff * falloff, 0.0 });
+                        normals.insert(normals.end(), { tilt * dx, 0.0, tilt * dz });
+                    }
+                }
+
+                writer.Begin("Geometry");
+                writer.Property(firstChannel + channel * 2 + 1);
+                writer.Property(ObjectName("shape", channel, "Geometry"));
+                writer.Property("Shape");
+                writer.Leaf("Version", (int32_t)100);
+                writer.Leaf("Indexes", indexes);
+                writer.Leaf("Vertices", vertices);
+                writer.Leaf("Normals", normals);
+                writer.End();
+
+                writer.Begin("Deformer");
+                writer.Property(firstChannel + channel * 2);
+                writer.Property(ObjectName("target", channel, "SubDeformer"));
+                writer.Property("BlendShapeChannel");
+                writer.Leaf("Version", (int32_t)100);
+                writer.Leaf("DeformPercent", 0.0);
+                writer.Leaf("FullWeights", std::vector<double>(1, 100.0));
+                writer.End();
+            }
+        }
+
+        void WriteConnections(RecordWriter& writer, const SyntheticFbxSettings& settings, int64_t geometry)
+        {
+            for (unsigned int channel = 0; channel < settings.blendShapeCount; ++channel) {
+                WriteConnection(writer, firstChannel + channel * 2, blendShape);
+                WriteConnection(writer, firstChannel + channel * 2 + 1, firstChannel + channel * 2);
+            }
+            WriteConnection(writer, blendShape, geometry);
+        }
+    };
+}
+
+uint64_t SyntheticFbx::Write(const char* filepath, const SyntheticFbxSettings& settings)
+{
+    // geometry and model ids go in pairs, 0 is the root
+    const int64_t FirstId = 1000;
+
+    RecordWriter writer;
+    writer.compressArrays = settings.compressArrays;
+    writer.Begin("FBXHeaderExtension");
+    writer.Leaf("FBXHeaderVersion", (int32_t)1003);
+    writer.Leaf("FBXVersion", (int32_t)FbxVersion);
+    writer.End();
+
+    // the rig ids follow the grids
+    const int64_t rigId = FirstId + (int64_t)settings.meshCount * 2;
+    const int64_t boneCount = settings.boneCount;
+    Rig rig = { rigId, rigId + boneCount, rigId + boneCount * 2, rigId + boneCount * 2 + 1, rigId + boneCount * 2 + 2, rigId + boneCount * 2 + 3 };
+    const bool skinned = settings.boneCount > 0 && settings.meshCount > 0;
+    // then the blend shapes
+    const int64_t blendShapeId = rigId + boneCount * 6 + 3;
+    BlendShapes blendShapes = { blendShapeId, blendShapeId + 1 };
+    const bool morphed = settings.blendShapeCount > 0 && settings.meshCount > 0;
+
+    writer.Begin("Objects");
+    for (unsigned int mesh = 0; mesh < settings.meshCount; ++mesh)
+        WriteGrid(writer, mesh, settings.gridSize, FirstId + mesh * 2);
+    if (skinned) rig.WriteObjects(writer, settings, (settings.gridSize + 1) * (settings.gridSize + 1));
+    if (morphed) blendShapes.WriteObjects(writer, settings);
+    writer.End();
+
+    writer.Begin("Connections");
+    for (unsigned int mesh = 0; mesh < settings.meshCount; ++mesh) {
+        const int64_t geometry = FirstId + mesh * 2;
+        WriteConnection(writer, geometry, geometry + 1);
+        WriteConnection(writer, geometry + 1, 0);
+    }
+    if (skinned) rig.WriteConnections(writer, settings, FirstId);
+    if (morphed) blendShapes.WriteConnections(writer, settings, FirstId);
+    writer.End();
+    writer.bytes.resize(writer.bytes.size() + NullRecordSize, 0);
+
+    FILE* file = nullptr;
+#ifdef _WIN32
+    if (fopen_s(&file, filepath, "wb") != 0) return 0;
+#else
+    file = fopen(filepath, "wb");
+    if (!file) return 0;
+#endif
+    bool written = fwrite(writer.bytes.data(), 1, writer.bytes.size(), file) == writer.bytes.size();
+    written = fclose(file) == 0 && written;
+    if (!written) {
+        remove(filepath);
+        return 0;
+    }
+    return writer.bytes.size();
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <stdint.h>
+
+/// Shape of a generated FBX file.
+struct SyntheticFbxSettings
+{
+    /// Grids written as separate geometries and models, side by side.
+    unsigned int meshCount = 1;
+    /// Quads per side of each grid, (gridSize + 1)^2 control points and 4 * gridSize^2 polygon-vertices.
+    unsigned int gridSize = 100;
+    /// Deflate the arrays like exporters do, so each one goes through the decompressor when loaded.
+    bool compressArrays = false;
+    /// Limb nodes skinning the first grid through a cluster each, 0 writes no skin.
+    unsigned int boneCount = 0;
+    /// Children of every bone, the bones fill a tree level by level from a single root. 1 makes a single chain.
+    unsigned int boneBranching = 2;
+    /// Keys of the X, Y and Z curves animating the rotation of every bone at 30 per second, 0 writes no animation.
+    unsigned int animationKeyCount = 0;
+    /// Blend shape channels of the first grid, each raising a disc of its control points, 0 writes no blend shape.
+    unsigned int blendShapeCount = 0;
+};
+
+/// Writes binary FBX files of wavy grids, with double vertices and normals like most exporters write them,
+/// optionally skinned to an animated rig or morphed by blend shapes, so the importer can be benchmarked on files bigger or more fragmented than the resources.
+class SyntheticFbx
+{
+public:
+    /// Returns the size of the file written, 0 when it couldn't be.
+    static uint64_t Write(const char* filepath, const SyntheticFbxSettings& settings);
+};
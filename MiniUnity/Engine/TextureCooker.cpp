@@ -0,0 +1,568 @@
+#include "TextureCooker.h"
+#include "JobSystem.h"
+#include "MeshCache.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#define TEXTURECOOKER_X86
+#endif
+
+namespace
+{
+    // the Kaiser filter reaches this many texels of the smaller level each side
+    const float KaiserRadius = 2.0f;
+    // shape of its window, higher rings less but blurs more
+    const double KaiserAlpha = 4.0;
+    const float Pi = 3.14159265f;
+    // linear values are quantized to 16 bits to find their sRGB encoding in a table
+    const int LinearSteps = 65535;
+    // rows of texels, or of BC1 blocks, per job
+    const uint32_t BatchRows = 32;
+
+    float SrgbToLinear(float value)
+    {
+        return value <= 0.04045f ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+    }
+
+    float LinearToSrgb(float value)
+    {
+        return value <= 0.0031308f ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+    }
+
+    struct ColorTables
+    {
+        float toLinear[256];
+        uint8_t toSrgb[LinearSteps + 1];
+
+        ColorTables()
+        {
+            for (int i = 0; i < 256; ++i) toLinear[i] = SrgbToLinear(i / 255.0f);
+            for (int i = 0; i <= LinearSteps; ++i) toSrgb[i] = (uint8_t)(LinearToSrgb((float)i / LinearSteps) * 255.0f + 0.5f);
+        }
+    };
+
+    const ColorTables& GetColorTables()
+    {
+        static const ColorTables tables;
+        return tables;
+    }
+
+    double BesselI0(double x)
+    {
+        // the series converges fast for the arguments of the window
+        double sum = 1.0;
+        double term = 1.0;
+        for (int k = 1; k < 32; ++k) {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+        }
+        return sum;
+    }
+
+    // t in texels of the smaller level, the sinc cuts at its Nyquist frequency
+    float KaiserSinc(float t)
+    {
+        const float ratio = t / KaiserRadius;
+        if (ratio <= -1.0f || ratio >= 1.0f) return 0.0f;
+        const float sinc = t == 0.0f ? 1.0f : sinf(Pi * t) / (Pi * t);
+        return sinc * (float)(BesselI0(KaiserAlpha * sqrt(1.0 - (double)ratio * ratio)) / BesselI0(KaiserAlpha));
+    }
+
+    // the source texels, wrapped, and their weights for each texel of a reduced row or column,
+    // the same number for all of them with zero weights filling the shorter ones
+    struct ReductionTaps
+    {
+        unsigned int tapCount = 0;
+        std::vector<uint32_t> sources;
+        std::vector<float> weights;
+    };
+
+    void BuildTaps(MipFilter filter, uint32_t sourceSize, uint32_t size, ReductionTaps& outTaps)
+    {
+        // texel i covers [i - 0.5, i + 0.5] of the source, the reduced texel x is centered on (x + 0.5) * scale - 0.5
+        const float scale = (float)sourceSize / size;
+        const float radius = (filter == MipFilter::Box ? 0.5f : KaiserRadius) * scale;
+        std::vector<int> firsts(size);
+        unsigned int tapCount = 0;
+        for (uint32_t x = 0; x < size; ++x) {
+            const float center = (x + 0.5f) * scale - 0.5f;
+            firsts[x] = (int)floorf(center - radius + 0.5f);
+            const int last = (int)ceilf(center + radius - 0.5f);
+            tapCount = std::max(tapCount, (unsigned int)(last - firsts[x] + 1));
+        }
+
+        outTaps.tapCount = tapCount;
+        outTaps.sources.assign((size_t)size * tapCount, 0);
+        outTaps.weights.assign((size_t)size * tapCount, 0.0f);
+        for (uint32_t x = 0; x < size; ++x) {
+            const float center = (x + 0.5f) * scale - 0.5f;
+            float* weights = &outTaps.weights[(size_t)x * tapCount];
+            float sum = 0.0f;
+            for (unsigned int k = 0; k < tapCount; ++k) {
+                const int source = firsts[x] + (int)k;
+                if (filter == MipFilter::Box) {
+                    const float overlap = std::min(source + 0.5f, center + radius) - std::max(source - 0.5f, center - radius);
+                    weights[k] = std::max(overlap, 0.0f);
+                }
+                else {
+                    weights[k] = KaiserSinc((source - center) / scale);
+                }
+                sum += weights[k];
+                outTaps.sources[(size_t)x * tapCount + k] = (uint32_t)(((source % (int)sourceSize) + (int)sourceSize) % (int)sourceSize);
+            }
+            for (unsigned int k = 0; k < tapCount; ++k) weights[k] /= sum;
+        }
+    }
+
+    // sRGB bytes to premultiplied linear floats
+    void LinearizeRow(const ColorTables& tables, const uint8_t* pixels, uint32_t count, float* out)
+    {
+        for (uint32_t i = 0; i < count; ++i, pixels += 4, out += 4) {
+            const float alpha = pixels[3] / 255.0f;
+            out[0] = tables.toLinear[pixels[0]] * alpha;
+            out[1] = tables.toLinear[pixels[1]] * alpha;
+            out[2] = tables.toLinear[pixels[2]] * alpha;
+            out[3] = alpha;
+        }
+    }
+
+    void ReduceRowsScalar(const float* source, uint32_t sourceWidth, const ReductionTaps& taps, uint32_t width, uint32_t firstRow, uint32_t rowCount, float* out)
+    {
+        for (uint32_t y = firstRow; y < firstRow + rowCount; ++y) {
+            const float* row = source + (size_t)y * sourceWidth * 4;
+            float* outTexel = out + (size_t)y * width * 4;
+            for (uint32_t x = 0; x < width; ++x, outTexel += 4) {
+                float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+                for (unsigned int k = 0; k < taps.tapCount; ++k) {
+                    const float weight = taps.weights[(size_t)x * taps.tapCount + k];
+                    const float* texel = row + (size_t)taps.sources[(size_t)x * taps.tapCount + k] * 4;
+                    for (int c = 0; c < 4; ++c) sum[c] += weight * texel[c];
+                }
+                for (int c = 0; c < 4; ++c) outTexel[c] = sum[c];
+            }
+        }
+    }
+
+    void ReduceColumnsScalar(const float* source, uint32_t width, const ReductionTaps& taps, uint32_t firstRow, uint32_t rowCount, float* out)
+    {
+        const size_t rowFloats = (size_t)width * 4;
+        for (uint32_t y = firstRow; y < firstRow + rowCount; ++y) {
+            float* outRow = out + y * rowFloats;
+            std::fill(outRow, outRow + rowFloats, 0.0f);
+            for (unsigned int k = 0; k < taps.tapCount; ++k) {
+                const float weight = taps.weights[(size_t)y * taps.tapCount + k];
+                const float* row = source + taps.sources[(size_t)y * taps.tapCount + k] * rowFloats;
+                for (size_t i = 0; i < rowFloats; ++i) outRow[i] += weight * row[i];
+            }
+        }
+    }
+
+    // back from premultiplied linear floats to sRGB bytes, the negative lobes of the Kaiser filter can overshoot
+    void StoreScalar(const ColorTables& tables, const float* texels, size_t count, uint8_t* out)
+    {
+        for (size_t i = 0; i < count; ++i, texels += 4, out += 4) {
+            const float alpha = std::min(std::max(texels[3], 0.0f), 1.0f);
+            const float unpremultiply = alpha > 0.0f ? 1.0f / alpha : 0.0f;
+            for (int c = 0; c < 3; ++c) {
+                const float value = std::min(std::max(texels[c] * unpremultiply, 0.0f), 1.0f);
+                out[c] = tables.toSrgb[(int)(value * LinearSteps + 0.5f)];
+            }
+            out[3] = (uint8_t)(alpha * 255.0f + 0.5f);
+        }
+    }
+
+#ifdef TEXTURECOOKER_X86
+    // a texel is one register, red to alpha
+    void ReduceRowsSSE(const float* source, uint32_t sourceWidth, const ReductionTaps& taps, uint32_t width, uint32_t firstRow, uint32_t rowCount, float* out)
+    {
+        for (uint32_t y = firstRow; y < firstRow + rowCount; ++y) {
+            const float* row = source + (size_t)y * sourceWidth * 4;
+            float* outTexel = out + (size_t)y * width * 4;
+            const uint32_t* sources = taps.sources.data();
+            const float* weights = taps.weights.data();
+            for (uint32_t x = 0; x < width; ++x, outTexel += 4) {
+                __m128 sum = _mm_setzero_ps();
+                for (unsigned int k = 0; k < taps.tapCount; ++k, ++sources, ++weights)
+                    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(*weights), _mm_loadu_ps(row + (size_t)*sources * 4)));
+                _mm_storeu_ps(outTexel, sum);
+            }
+        }
+    }
+
+    // rows hold a whole number of texels, so of registers
+    void ReduceColumnsSSE(const float* source, uint32_t width, const ReductionTaps& taps, uint32_t firstRow, uint32_t rowCount, float* out)
+    {
+        const size_t rowFloats = (size_t)width * 4;
+        for (uint32_t y = firstRow; y < firstRow + rowCount; ++y) {
+            float* outRow = out + y * rowFloats;
+            const uint32_t* sources = taps.sources.data() + (size_t)y * taps.tapCount;
+            const float* weights = taps.weights.data() + (size_t)y * taps.tapCount;
+            // two texels per step with a last single one
+            size_t i = 0;
+            for (; i + 8 <= rowFloats; i += 8) {
+                __m128 sum0 = _mm_setzero_ps();
+                __m128 sum1 = _mm_setzero_ps();
+                for (unsigned int k = 0; k < taps.tapCount; ++k) {
+                    const __m128 weight = _mm_set1_ps(weights[k]);
+                    const float* row = source + sources[k] * rowFloats + i;
+                    sum0 = _mm_add_ps(sum0, _mm_mul_ps(weight, _mm_loadu_ps(row)));
+                    sum1 = _mm_add_ps(sum1, _mm_mul_ps(weight, _mm_loadu_ps(row + 4)));
+                }
+                _mm_storeu_ps(outRow + i, sum0);
+                _mm_storeu_ps(outRow + i + 4, sum1);
+            }
+            if (i < rowFloats) {
+                __m128 sum = _mm_setzero_ps();
+                for (unsigned int k = 0; k < taps.tapCount; ++k)
+                    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(source + sources[k] * rowFloats + i)));
+                _mm_storeu_ps(outRow + i, sum);
+            }
+        }
+    }
+
+    void StoreSSE(const ColorTables& tables, const float* texels, size_t count, uint8_t* out)
+    {
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 steps = _mm_setr_ps((float)LinearSteps, (float)LinearSteps, (float)LinearSteps, 255.0f);
+        for (size_t i = 0; i < count; ++i, texels += 4, out += 4) {
+            const __m128 texel = _mm_loadu_ps(texels);
+            const float alpha = std::min(std::max(_mm_cvtss_f32(_mm_shuffle_ps(texel, texel, _MM_SHUFFLE(3, 3, 3, 3))), 0.0f), 1.0f);
+            const float unpremultiply = alpha > 0.0f ? 1.0f / alpha : 0.0f;
+            // alpha keeps its own value
+            const __m128 scale = _mm_setr_ps(unpremultiply, unpremultiply, unpremultiply, 1.0f);
+            const __m128 value = _mm_min_ps(_mm_max_ps(_mm_mul_ps(texel, scale), zero), one);
+            alignas(16) int32_t quantized[4];
+            _mm_store_si128((__m128i*)quantized, _mm_cvtps_epi32(_mm_mul_ps(value, steps)));
+            out[0] = tables.toSrgb[quantized[0]];
+            out[1] = tables.toSrgb[quantized[1]];
+            out[2] = tables.toSrgb[quantized[2]];
+            out[3] = (uint8_t)quantized[3];
+        }
+    }
+#endif
+
+    inline uint16_t PackColor565(const float* color)
+    {
+        const int r = (int)(std::min(std::max(color[0], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+        const int g = (int)(std::min(std::max(color[1], 0.0f), 255.0f) * 63.0f / 255.0f + 0.5f);
+        const int b = (int)(std::min(std::max(color[2], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+        return (uint16_t)(r << 11 | g << 5 | b);
+    }
+
+    inline void UnpackColor565(uint16_t packed, int* outColor)
+    {
+        const int r = packed >> 11, g = (packed >> 5) & 63, b = packed & 31;
+        outColor[0] = r << 3 | r >> 2;
+        outColor[1] = g << 2 | g >> 4;
+        outColor[2] = b << 3 | b >> 2;
+    }
+
+    // endpoints at the ends of the principal axis of the colors, in the four color mode
+    void EncodeBC1Block(const uint8_t* texels, uint8_t* out)
+    {
+        float mean[3] = { 0.0f, 0.0f, 0.0f };
+        for (int i = 0; i < 16; ++i) {
+            for (int c = 0; c < 3; ++c) mean[c] += texels[i * 4 + c] / 16.0f;
+        }
+        float covariance[6] = {};
+        for (int i = 0; i < 16; ++i) {
+            const float d[3] = { texels[i * 4] - mean[0], texels[i * 4 + 1] - mean[1], texels[i * 4 + 2] - mean[2] };
+            covariance[0] += d[0] * d[0]; covariance[1] += d[0] * d[1]; covariance[2] += d[0] * d[2];
+            covariance[3] += d[1] * d[1]; covariance[4] += d[1] * d[2]; covariance[5] += d[2] * d[2];
+        }
+        // a few power iterations are enough to tell the direction
+        float axis[3] = { 1.0f, 1.0f, 1.0f };
+        for (int iteration = 0; iteration < 8; ++iteration) {
+            const float next[3] = {
+                covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+                covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+                covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2],
+            };
+            const float length = std::max(std::max(fabsf(next[0]), fabsf(next[1])), fabsf(next[2]));
+            if (length == 0.0f) break;
+            for (int c = 0; c < 3; ++c) axis[c] = next[c] / length;
+        }
+
+        int minTexel = 0, maxTexel = 0;
+        float minProjection = 0.0f, maxProjection = 0.0f;
+        for (int i = 0; i < 16; ++i) {
+            const float projection = texels[i * 4] * axis[0] + texels[i * 4 + 1] * axis[1] + texels[i * 4 + 2] * axis[2];
+            if (i == 0 || projection < minProjection) { minProjection = projection; minTexel = i; }
+            if (i == 0 || projection > maxProjection) { maxProjection = projection; maxTexel = i; }
+        }
+        const float high[3] = { (float)texels[maxTexel * 4], (float)texels[maxTexel * 4 + 1], (float)texels[maxTexel * 4 + 2] };
+        const float low[3] = { (float)texels[minTexel * 4], (float)texels[minTexel * 4 + 1], (float)texels[minTexel * 4 + 2] };
+        uint16_t color0 = PackColor565(high);
+        uint16_t color1 = PackColor565(low);
+        if (color0 < color1) std::swap(color0, color1);
+
+        uint32_t indices = 0;
+        // equal endpoints would switch to the three color mode, every texel takes the first one anyway
+        if (color0 != color1) {
+            int palette[4][3];
+            UnpackColor565(color0, palette[0]);
+            UnpackColor565(color1, palette[1]);
+            for (int c = 0; c < 3; ++c) {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+            // the palette lies on a line, the nearest entry is the nearest along it
+            const int direction[3] = { palette[0][0] - palette[1][0], palette[0][1] - palette[1][1], palette[0][2] - palette[1][2] };
+            const float toSteps = 3.0f / (direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+            // steps from color1 to color0 to palette entries
+            const uint32_t stepIndices[4] = { 1, 3, 2, 0 };
+            for (int i = 0; i < 16; ++i) {
+                int along = 0;
+                for (int c = 0; c < 3; ++c) along += (texels[i * 4 + c] - palette[1][c]) * direction[c];
+                const int step = std::min(std::max((int)(along * toSteps + 0.5f), 0), 3);
+                indices |= stepIndices[step] << (2 * i);
+            }
+        }
+
+        out[0] = (uint8_t)color0; out[1] = (uint8_t)(color0 >> 8);
+        out[2] = (uint8_t)color1; out[3] = (uint8_t)(color1 >> 8);
+        for (int i = 0; i < 4; ++i) out[4 + i] = (uint8_t)(indices >> (8 * i));
+    }
+
+    // the blocks past the edges of the small levels repeat the last texels
+    void CompressBC1Rows(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t firstBlockRow, uint32_t blockRowCount, uint8_t* out)
+    {
+        const uint32_t blocksWide = (width + 3) / 4;
+        uint8_t block[16 * 4];
+        for (uint32_t by = firstBlockRow; by < firstBlockRow + blockRowCount; ++by) {
+            for (uint32_t bx = 0; bx < blocksWide; ++bx) {
+                for (uint32_t i = 0; i < 16; ++i) {
+                    const uint32_t x = std::min(bx * 4 + i % 4, width - 1);
+                    const uint32_t y = std::min(by * 4 + i / 4, height - 1);
+                    memcpy(block + i * 4, pixels + ((size_t)y * width + x) * 4, 4);
+                }
+                EncodeBC1Block(block, out + ((size_t)by * blocksWide + bx) * 8);
+            }
+        }
+    }
+
+    enum class Pass { ReduceRows, ReduceColumns, Store, CompressBC1 };
+
+    // rows [firstRow, firstRow + rowCount) of one pass over a level, rows of blocks for the compression.
+    // The first reduction reads the source pixels instead of floats, a row at a time.
+    struct PassBatch
+    {
+        Pass pass;
+        TextureCooker::Kernel kernel;
+        const float* source;
+        float* out;
+        const ReductionTaps* taps;
+        uint32_t sourceWidth;
+        uint32_t width;
+        uint32_t height;
+        uint32_t firstRow;
+        uint32_t rowCount;
+        const uint8_t* pixels;
+        uint8_t* outBytes;
+    };
+
+    void RunPassBatch(void* data)
+    {
+        const PassBatch& batch = *(const PassBatch*)data;
+        const bool simd = batch.kernel == TextureCooker::Kernel::SSE;
+        switch (batch.pass) {
+        case Pass::ReduceRows: {
+            std::vector<float> linearRow(batch.pixels ? (size_t)batch.sourceWidth * 4 : 0);
+            for (uint32_t y = batch.firstRow; y < batch.firstRow + batch.rowCount; ++y) {
+                const float* source = batch.source + (size_t)y * batch.sourceWidth * 4;
+                if (batch.pixels) {
+                    LinearizeRow(GetColorTables(), batch.pixels + (size_t)y * batch.sourceWidth * 4, batch.sourceWidth, linearRow.data());
+                    source = linearRow.data();
+                }
+                float* out = batch.out + (size_t)y * batch.width * 4;
+#ifdef TEXTURECOOKER_X86
+                if (simd) {
+                    ReduceRowsSSE(source, batch.sourceWidth, *batch.taps, batch.width, 0, 1, out);
+                    continue;
+                }
+#endif
+                ReduceRowsScalar(source, batch.sourceWidth, *batch.taps, batch.width, 0, 1, out);
+            }
+            break;
+        }
+        case Pass::ReduceColumns:
+#ifdef TEXTURECOOKER_X86
+            if (simd) {
+                ReduceColumnsSSE(batch.source, batch.width, *batch.taps, batch.firstRow, batch.rowCount, batch.out);
+                break;
+            }
+#endif
+            ReduceColumnsScalar(batch.source, batch.width, *batch.taps, batch.firstRow, batch.rowCount, batch.out);
+            break;
+        case Pass::Store: {
+            const size_t first = (size_t)batch.firstRow * batch.width;
+            const size_t count = (size_t)batch.rowCount * batch.width;
+#ifdef TEXTURECOOKER_X86
+            if (simd) {
+                StoreSSE(GetColorTables(), batch.source + first * 4, count, batch.outBytes + first * 4);
+                break;
+            }
+#endif
+            StoreScalar(GetColorTables(), batch.source + first * 4, count, batch.outBytes + first * 4);
+            break;
+        }
+        case Pass::CompressBC1:
+            CompressBC1Rows(batch.pixels, batch.width, batch.height, batch.firstRow, batch.rowCount, batch.outBytes);
+            break;
+        }
+    }
+
+    // splits rowCount rows in batches run by the JobSystem workers
+    void RunPass(PassBatch batch, uint32_t rowCount)
+    {
+        std::vector<PassBatch> batches;
+        batches.reserve(rowCount / BatchRows + 1);
+        for (uint32_t first = 0; first < rowCount; first += BatchRows) {
+            batch.firstRow = first;
+            batch.rowCount = std::min(BatchRows, rowCount - first);
+            batches.push_back(batch);
+        }
+        JobSystem::ParallelFor(&RunPassBatch, batches.data(), sizeof(PassBatch), (unsigned int)batches.size());
+    }
+}
+
+TextureCooker::Kernel TextureCooker::GetBestKernel()
+{
+    return IsSupported(Kernel::SSE) ? Kernel::SSE : Kernel::Scalar;
+}
+
+bool TextureCooker::IsSupported(Kernel kernel)
+{
+    switch (kernel) {
+    case Kernel::Scalar:
+        return true;
+#ifdef TEXTURECOOKER_X86
+    case Kernel::SSE:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+const char* TextureCooker::GetKernelName(Kernel kernel)
+{
+    switch (kernel) {
+    case Kernel::Scalar: return "scalar";
+    case Kernel::SSE: return "SSE";
+    }
+    return "";
+}
+
+void TextureCooker::Cook(const uint8_t* pixels, uint32_t width, uint32_t height, const TextureCookSettings& settings, CookedTexture& outTexture, Kernel kernel)
+{
+    outTexture.levels.clear();
+    outTexture.data.clear();
+    if (width == 0 || height == 0) return;
+
+    const size_t texelCount = (size_t)width * height;
+
+    bool opaque = true;
+    for (size_t i = 0; i < texelCount && opaque; ++i) opaque = pixels[i * 4 + 3] == 255;
+    outTexture.format = settings.compress && opaque ? TextureFormat::BC1 : TextureFormat::RGBA8;
+
+    uint32_t offset = 0;
+    for (uint32_t levelWidth = width, levelHeight = height;; levelWidth = std::max(levelWidth / 2, 1u), levelHeight = std::max(levelHeight / 2, 1u)) {
+        const uint32_t size = CookedTexture::GetLevelSize(outTexture.format, levelWidth, levelHeight);
+        outTexture.levels.push_back({ levelWidth, levelHeight, offset, size });
+        offset += size;
+        if (levelWidth == 1 && levelHeight == 1) break;
+    }
+    outTexture.data.resize(offset);
+
+    // the chain is filtered in premultiplied linear floats, each level from the one above
+    std::vector<float> level;
+    std::vector<float> reducedRows;
+    std::vector<float> reduced;
+    std::vector<uint8_t> levelPixels;
+    ReductionTaps taps;
+
+    for (size_t i = 0; i < outTexture.levels.size(); ++i) {
+        const TextureLevel& target = outTexture.levels[i];
+        const uint8_t* levelSource = pixels;
+        if (i > 0) {
+            const TextureLevel& above = outTexture.levels[i - 1];
+            PassBatch batch = {};
+            batch.kernel = kernel;
+            batch.taps = &taps;
+
+            // the first level always goes through the rows, even when they keep their width, to read the pixels
+            const float* source = level.data();
+            if (target.width != above.width || i == 1) {
+                BuildTaps(settings.mipFilter, above.width, target.width, taps);
+                reducedRows.resize((size_t)target.width * above.height * 4);
+                batch.pass = Pass::ReduceRows;
+                batch.source = source;
+                batch.pixels = i == 1 ? pixels : nullptr;
+                batch.out = reducedRows.data();
+                batch.sourceWidth = above.width;
+                batch.width = target.width;
+                RunPass(batch, above.height);
+                source = reducedRows.data();
+            }
+            if (target.height != above.height) {
+                BuildTaps(settings.mipFilter, above.height, target.height, taps);
+                reduced.resize((size_t)target.width * target.height * 4);
+                batch.pass = Pass::ReduceColumns;
+                batch.source = source;
+                batch.out = reduced.data();
+                batch.width = target.width;
+                RunPass(batch, target.height);
+                level.swap(reduced);
+            }
+            else {
+                level.swap(reducedRows);
+            }
+
+            levelPixels.resize((size_t)target.width * target.height * 4);
+            batch.pass = Pass::Store;
+            batch.source = level.data();
+            batch.outBytes = levelPixels.data();
+            batch.width = target.width;
+            RunPass(batch, target.height);
+            levelSource = levelPixels.data();
+        }
+
+        if (outTexture.format == TextureFormat::BC1) {
+            PassBatch batch = {};
+            batch.pass = Pass::CompressBC1;
+            batch.pixels = levelSource;
+            batch.outBytes = outTexture.data.data() + target.offset;
+            batch.width = target.width;
+            batch.height = target.height;
+            RunPass(batch, (target.height + 3) / 4);
+        }
+        else {
+            memcpy(outTexture.data.data() + target.offset, levelSource, target.size);
+        }
+    }
+}
+
+uint64_t TextureCooker::HashSettings(const TextureCookSettings& settings)
+{
+    const float values[] = {
+        (float)settings.mipFilter,
+        settings.compress ? 1.0f : 0.0f,
+    };
+    return MeshCache::Hash(values, sizeof(values));
+}
+
+uint64_t TextureCooker::GetUncookedSize(uint32_t width, uint32_t height)
+{
+    uint64_t size = 0;
+    for (;; width = std::max(width / 2, 1u), height = std::max(height / 2, 1u)) {
+        size += (uint64_t)width * height * 4;
+        if (width == 1 && height == 1) break;
+    }
+    return size;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "CookedTexture.h"
+#include <stdint.h>
+
+/// How each mip level is reduced from the one above.
+enum class MipFilter
+{
+    /// Averages the texels each one covers, blurs the least but aliases fine patterns.
+    Box,
+    /// Kaiser windowed sinc over two texels of the smaller level each side, sharper mips without aliasing.
+    Kaiser,
+};
+
+/// How textures are cooked.
+struct TextureCookSettings
+{
+    MipFilter mipFilter = MipFilter::Kaiser;
+    /// BC1 compress the textures that are fully opaque, the others stay RGBA8.
+    /// Uploading needs GL_EXT_texture_compression_s3tc, see CookedTexture::DecompressBC1 for drivers without it.
+    bool compress = false;
+    /// Save the cooked texture next to the source as <file>.mutex and load that instead while the source is unchanged.
+    bool useTextureCache = true;
+};
+
+/// Where the time of loading a texture went and what it takes on the GPU, summed over the textures of an asset.
+struct TextureCookStats
+{
+    bool loadedFromCache = false;
+    /// Decoding the source image and cooking it, both zero when it came from the cooked file.
+    float decodeMilliseconds = 0.0f;
+    float cookMilliseconds = 0.0f;
+    /// What the RGBA8 image with a mip chain generated by the driver would take.
+    uint64_t uncookedBytes = 0;
+    uint64_t cookedBytes = 0;
+};
+
+/// Builds the mip chain of an image on the CPU, filtering in linear space so mips keep the brightness of the
+/// texture, then optionally compresses every level. Colors are weighted by alpha while filtering so transparent
+/// texels don't bleed into their neighbours. Levels of odd sizes are reduced with per texel weights, and
+/// the filter wraps around the edges like the GL_REPEAT sampling of the textures.
+class TextureCooker
+{
+public:
+    enum class Kernel { Scalar, SSE };
+
+    /// Fastest kernel the running CPU supports.
+    static Kernel GetBestKernel();
+    static bool IsSupported(Kernel kernel);
+    static const char* GetKernelName(Kernel kernel);
+
+    /// Cooks width * height RGBA8 pixels with sRGB colors, rows top to bottom like sf::Image. The kernel must be supported.
+    static void Cook(const uint8_t* pixels, uint32_t width, uint32_t height, const TextureCookSettings& settings, CookedTexture& outTexture,
+        Kernel kernel = GetBestKernel());
+
+    /// Hash of the settings that change the cooked texture, for the staleness check of the cooked file.
+    static uint64_t HashSettings(const TextureCookSettings& settings);
+
+    /// Bytes of an RGBA8 texture of that size with all its mips, what the driver allocates for glGenerateMipmap.
+    static uint64_t GetUncookedSize(uint32_t width, uint32_t height);
+};
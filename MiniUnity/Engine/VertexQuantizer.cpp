@@ -0,0 +1,166 @@
+#include "VertexQuantizer.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace
+{
+    uint16_t QuantizeUnorm16(float value, float min, float extent)
+    {
+        if (extent <= 0.0f) return 0;
+        float normalized = std::min(std::max((value - min) / extent, 0.0f), 1.0f);
+        return (uint16_t)lrintf(normalized * 65535.0f);
+    }
+
+    int16_t QuantizeSnorm16(float value)
+    {
+        return (int16_t)lrintf(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f);
+    }
+
+    float SignNotZero(float value)
+    {
+        return value >= 0.0f ? 1.0f : -1.0f;
+    }
+}
+
+void VertexQuantizer::Quantize(ImportedMesh& mesh)
+{
+    const unsigned int vertexCount = mesh.GetVertexCount();
+    float extent[3];
+    for (int axis = 0; axis < 3; ++axis)
+        extent[axis] = mesh.boundsMax[axis] - mesh.boundsMin[axis];
+
+    mesh.quantizedVertices.resize(vertexCount);
+    for (unsigned int i = 0; i < vertexCount; ++i) {
+        const GLfloat* vertex = &mesh.vertices[(size_t)i * ImportedMesh::VertexSize];
+        QuantizedVertex& quantized = mesh.quantizedVertices[i];
+
+        for (int axis = 0; axis < 3; ++axis)
+            quantized.position[axis] = QuantizeUnorm16(vertex[axis], mesh.boundsMin[axis], extent[axis]);
+        quantized.padding = 0;
+        OctahedralEncode(vertex + 3, quantized.normal);
+        quantized.texCoord[0] = FloatToHalf(vertex[6]);
+        quantized.texCoord[1] = FloatToHalf(vertex[7]);
+    }
+}
+
+QuantizationError VertexQuantizer::MeasureError(const ImportedMesh& mesh)
+{
+    QuantizationError error;
+    if (mesh.quantizedVertices.size() != mesh.GetVertexCount()) return error;
+
+    for (unsigned int i = 0; i < mesh.GetVertexCount(); ++i) {
+        const GLfloat* vertex = &mesh.vertices[(size_t)i * ImportedMesh::VertexSize];
+        const QuantizedVertex& quantized = mesh.quantizedVertices[i];
+
+        for (int axis = 0; axis < 3; ++axis) {
+            float extent = mesh.boundsMax[axis] - mesh.boundsMin[axis];
+            float position = mesh.boundsMin[axis] + extent * (quantized.position[axis] / 65535.0f);
+            error.position = std::max(error.position, fabsf(position - vertex[axis]));
+        }
+
+        // zero normals (missing in the file) can't be encoded, they don't count
+        float length = sqrtf(vertex[3] * vertex[3] + vertex[4] * vertex[4] + vertex[5] * vertex[5]);
+        if (length > 0.0f) {
+            float normal[3];
+            OctahedralDecode(quantized.normal, normal);
+            float cosine = (normal[0] * vertex[3] + normal[1] * vertex[4] + normal[2] * vertex[5]) / length;
+            float degrees = acosf(std::min(std::max(cosine, -1.0f), 1.0f)) * (180.0f / 3.14159265f);
+            error.normalDegrees = std::max(error.normalDegrees, degrees);
+        }
+
+        for (int axis = 0; axis < 2; ++axis)
+            error.texCoord = std::max(error.texCoord, fabsf(HalfToFloat(quantized.texCoord[axis]) - vertex[6 + axis]));
+    }
+    return error;
+}
+
+QuantizationError VertexQuantizer::GetTolerance(const ImportedMesh& mesh)
+{
+    QuantizationError tolerance;
+    for (int axis = 0; axis < 3; ++axis)
+        tolerance.position = std::max(tolerance.position, (mesh.boundsMax[axis] - mesh.boundsMin[axis]) / 65535.0f);
+    tolerance.normalDegrees = 0.1f;
+    // half an ulp of a half float between 2 and 4
+    tolerance.texCoord = 1.0f / 1024.0f;
+    return tolerance;
+}
+
+uint16_t VertexQuantizer::FloatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+    const uint32_t magnitude = bits & 0x7fffffff;
+
+    // nan stays nan, infinity and anything rounding above 65504 becomes infinity
+    if (magnitude > 0x7f800000) return sign | 0x7e00;
+    if (magnitude >= 0x477ff000) return sign | 0x7c00;
+
+    // below the smallest normal half the step is 2^-24, so scaling and rounding gives the denormal bits
+    if (magnitude < 0x38800000) {
+        float absolute;
+        memcpy(&absolute, &magnitude, sizeof(absolute));
+        return sign | (uint16_t)lrintf(absolute * 16777216.0f);
+    }
+
+    // rebias the exponent from 127 to 15 and round the mantissa from 23 to 10 bits, ties to even
+    uint32_t half = magnitude - 0x38000000;
+    half += 0xfff + ((half >> 13) & 1);
+    return sign | (uint16_t)(half >> 13);
+}
+
+float VertexQuantizer::HalfToFloat(uint16_t value)
+{
+    const uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+    const uint32_t exponent = (value >> 10) & 0x1f;
+    const uint32_t mantissa = value & 0x3ff;
+
+    if (exponent == 0) {
+        float denormal = ldexpf((float)mantissa, -24);
+        return sign ? -denormal : denormal;
+    }
+
+    uint32_t bits = exponent == 31
+        ? sign | 0x7f800000 | (mantissa << 13)
+        : sign | ((exponent + 112) << 23) | (mantissa << 13);
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+void VertexQuantizer::OctahedralEncode(const float normal[3], int16_t outEncoded[2])
+{
+    float sum = fabsf(normal[0]) + fabsf(normal[1]) + fabsf(normal[2]);
+    if (sum == 0.0f) {
+        outEncoded[0] = outEncoded[1] = 0;
+        return;
+    }
+
+    float u = normal[0] / sum;
+    float v = normal[1] / sum;
+    // the lower hemisphere is folded over the diagonals
+    if (normal[2] < 0.0f) {
+        float foldedU = (1.0f - fabsf(v)) * SignNotZero(u);
+        float foldedV = (1.0f - fabsf(u)) * SignNotZero(v);
+        u = foldedU;
+        v = foldedV;
+    }
+    outEncoded[0] = QuantizeSnorm16(u);
+    outEncoded[1] = QuantizeSnorm16(v);
+}
+
+void VertexQuantizer::OctahedralDecode(const int16_t encoded[2], float outNormal[3])
+{
+    float x = std::max(encoded[0] / 32767.0f, -1.0f);
+    float y = std::max(encoded[1] / 32767.0f, -1.0f);
+    float z = 1.0f - fabsf(x) - fabsf(y);
+    float fold = std::max(-z, 0.0f);
+    x += x >= 0.0f ? -fold : fold;
+    y += y >= 0.0f ? -fold : fold;
+
+    float length = sqrtf(x * x + y * y + z * z);
+    outNormal[0] = x / length;
+    outNormal[1] = y / length;
+    outNormal[2] = z / length;
+}
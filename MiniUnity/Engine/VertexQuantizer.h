@@ -0,0 +1,41 @@
+#pragma once
+#include "ImportedMesh.h"
+#include <stdint.h>
+
+/// Largest difference between the original and the dequantized attributes.
+struct QuantizationError
+{
+    /// In mesh units.
+    float position = 0.0f;
+    /// Angle between the original and the decoded normal.
+    float normalDegrees = 0.0f;
+    float texCoord = 0.0f;
+
+    bool IsWithin(const QuantizationError& tolerance) const
+    {
+        return position <= tolerance.position && normalDegrees <= tolerance.normalDegrees && texCoord <= tolerance.texCoord;
+    }
+};
+
+/// Packs the float vertices of a mesh into QuantizedVertex, halving the vertex size.
+/// Positions are dequantized as boundsMin + (boundsMax - boundsMin) * position.
+class VertexQuantizer
+{
+public:
+    /// Fills mesh.quantizedVertices from mesh.vertices, the bounds must be up to date.
+    static void Quantize(ImportedMesh& mesh);
+
+    static QuantizationError MeasureError(const ImportedMesh& mesh);
+    /// Largest error the layout allows: a unorm16 step of the biggest extent of the bounds, a tenth of a degree
+    /// and the rounding of half floats to uvs within [-4, 4].
+    static QuantizationError GetTolerance(const ImportedMesh& mesh);
+
+    /// Round to nearest even, out of range values become infinity.
+    static uint16_t FloatToHalf(float value);
+    static float HalfToFloat(uint16_t value);
+
+    /// Maps a unit vector on the octahedron unfolded on a square, stored as two snorm16.
+    static void OctahedralEncode(const float normal[3], int16_t outEncoded[2]);
+    /// Same decoding as the vertex shader.
+    static void OctahedralDecode(const int16_t encoded[2], float outNormal[3]);
+};
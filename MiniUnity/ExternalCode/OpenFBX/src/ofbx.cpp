@@ -1,11 +1,13 @@
 #include "ofbx.h"
 #include "libdeflate.h"
+#include <algorithm>
 #include <cassert>
 #include <math.h>
 #include <ctype.h>
 #include <memory>
 #include <numeric>
 #include <string>
+#include <type_traits>
 #include <unordered_map>
 #include <vector>
 #include <mutex>
@@ -17,6 +19,24 @@
 #endif
 #include <map>
 
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#include <charconv>
+#if defined(__cpp_lib_to_chars)
+#define OFBX_HAS_FROM_CHARS
+#endif
+#endif
+
+#include <locale.h>
+#include <stdlib.h>
+#ifdef __APPLE__
+#include <xlocale.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OFBX_SSE2
+#endif
+
 namespace ofbx
 {
 
@@ -94,6 +114,29 @@ struct Video
 };
 
 
+// textures find their video by media name, compared bytewise
+struct MediaNameHash
+{
+	size_t operator()(const DataView& name) const
+	{
+		// FNV-1a, the names are short
+		u64 hash = 14695981039346656037ull;
+		for (const u8* c = name.begin; c != name.end; ++c) hash = (hash ^ *c) * 1099511628211ull;
+		return (size_t)hash;
+	}
+};
+
+
+struct MediaNameEqual
+{
+	bool operator()(const DataView& lhs, const DataView& rhs) const
+	{
+		const size_t len = lhs.end - lhs.begin;
+		return len == (size_t)(rhs.end - rhs.begin) && (len == 0 || memcmp(lhs.begin, rhs.begin, len) == 0);
+	}
+};
+
+
 struct Error
 {
 	Error() {}
@@ -106,16 +149,18 @@ struct Error
 	template <typename... Args>
 	Error(const char* fmt, Args... args) 
 	{
-		char buf[1024];
-		std::snprintf(buf, sizeof(buf), fmt, args...);
-		s_message = buf;
+		std::snprintf(s_buffer, sizeof(s_buffer), fmt, args...);
+		s_message = s_buffer;
 	}
 
-	static const char* s_message;
+	// per thread, so concurrent loads of different files don't overwrite each other's error
+	static thread_local const char* s_message;
+	static thread_local char s_buffer[1024];
 };
 
 
-const char* Error::s_message = "";
+thread_local const char* Error::s_message = "";
+thread_local char Error::s_buffer[1024];
 
 
 template <typename T> struct OptionalError
@@ -175,9 +220,16 @@ struct Cursor
 	const u8* current;
 	const u8* begin;
 	const u8* end;
+	u64 begin_offset = 0; // file offset of `begin`, when only a part of the file is in memory
 };
 
 
+static u64 getFileOffset(const Cursor& cursor)
+{
+	return cursor.begin_offset + (u64)(cursor.current - cursor.begin);
+}
+
+
 static void setTranslation(const DVec3& t, DMatrix* mtx)
 {
 	mtx->m[12] = t.x;
@@ -543,10 +595,91 @@ static IElement* resolveProperty(const Object& obj, const char* name, bool* is_p
 }
 
 
-static int resolveEnumProperty(const Object& object, const char* name, int default_value)
+// properties read whenever a node transform is evaluated, they get an O(1) slot in each object
+enum class KnownProperty : u8
+{
+	LCL_TRANSLATION,
+	LCL_ROTATION,
+	LCL_SCALING,
+	PRE_ROTATION,
+	POST_ROTATION,
+	ROTATION_OFFSET,
+	ROTATION_PIVOT,
+	SCALING_OFFSET,
+	SCALING_PIVOT,
+	ROTATION_ORDER,
+	GEOMETRIC_TRANSLATION,
+	GEOMETRIC_ROTATION,
+	GEOMETRIC_SCALING,
+
+	COUNT
+};
+
+
+static const char* const s_known_property_names[] = {
+	"Lcl Translation",
+	"Lcl Rotation",
+	"Lcl Scaling",
+	"PreRotation",
+	"PostRotation",
+	"RotationOffset",
+	"RotationPivot",
+	"ScalingOffset",
+	"ScalingPivot",
+	"RotationOrder",
+	"GeometricTranslation",
+	"GeometricRotation",
+	"GeometricScaling",
+};
+static_assert(sizeof(s_known_property_names) / sizeof(s_known_property_names[0]) == (int)KnownProperty::COUNT, "Missing property name");
+static_assert((int)KnownProperty::COUNT == Object::KNOWN_PROPERTY_COUNT, "Object::KNOWN_PROPERTY_COUNT is out of date");
+
+
+struct PropertyIndex
+{
+	// the index is built by the first thread asking, the others wait for it
+	static const IElement* resolve(const Object& obj, KnownProperty property, bool* is_p60)
+	{
+		if (!obj.properties_indexed.load(std::memory_order_acquire))
+		{
+			// striped by object, so scenes loaded on different threads rarely wait for each other
+			static std::mutex build_mutexes[64];
+			std::lock_guard<std::mutex> lock(build_mutexes[((uintptr_t)&obj / sizeof(Object)) % 64]);
+			if (!obj.properties_indexed.load(std::memory_order_relaxed)) build(obj);
+		}
+		*is_p60 = obj.properties_p60;
+		return obj.known_properties[(int)property];
+	}
+
+private:
+	// one walk over the property list, the first property with a given name wins like in resolveProperty
+	static void build(const Object& obj)
+	{
+		const Element* props = findChild((const Element&)obj.element, "Properties70");
+		if (!props) {
+			props = findChild((const Element&)obj.element, "Properties60");
+			obj.properties_p60 = props != nullptr;
+		}
+
+		for (const Element* prop = props ? props->child : nullptr; prop; prop = prop->sibling)
+		{
+			if (!prop->first_property) continue;
+			for (int i = 0; i < (int)KnownProperty::COUNT; ++i)
+			{
+				if (!obj.known_properties[i] && prop->first_property->value == s_known_property_names[i])
+				{
+					obj.known_properties[i] = prop;
+					break;
+				}
+			}
+		}
+		obj.properties_indexed.store(true, std::memory_order_release);
+	}
+};
+
+
+static int toEnumProperty(const Element* element, bool is_p60, int default_value)
 {
-	bool is_p60;
-	Element* element = (Element*)resolveProperty(object, name, &is_p60);
 	if (!element) return default_value;
 	Property* x = (Property*)element->getProperty(is_p60 ? 3 : 4);
 	if (!x) return default_value;
@@ -555,10 +688,8 @@ static int resolveEnumProperty(const Object& object, const char* name, int defau
 }
 
 
-static DVec3 resolveVec3Property(const Object& object, const char* name, const DVec3& default_value)
+static DVec3 toVec3Property(const Element* element, bool is_p60, const DVec3& default_value)
 {
-	bool is_p60;
-	Element* element = (Element*)resolveProperty(object, name, &is_p60);
 	if (!element) return default_value;
 	Property* x = (Property*)element->getProperty(is_p60 ? 3 : 4);
 	if (!x || !x->next || !x->next->next) return default_value;
@@ -566,6 +697,30 @@ static DVec3 resolveVec3Property(const Object& object, const char* name, const D
 	return {x->value.toDouble(), x->next->value.toDouble(), x->next->next->value.toDouble()};
 }
 
+
+static int resolveEnumProperty(const Object& object, const char* name, int default_value)
+{
+	bool is_p60 = false;
+	const Element* element = (const Element*)resolveProperty(object, name, &is_p60);
+	return toEnumProperty(element, is_p60, default_value);
+}
+
+
+static int resolveEnumProperty(const Object& object, KnownProperty property, int default_value)
+{
+	bool is_p60 = false;
+	const Element* element = (const Element*)PropertyIndex::resolve(object, property, &is_p60);
+	return toEnumProperty(element, is_p60, default_value);
+}
+
+
+static DVec3 resolveVec3Property(const Object& object, KnownProperty property, const DVec3& default_value)
+{
+	bool is_p60 = false;
+	const Element* element = (const Element*)PropertyIndex::resolve(object, property, &is_p60);
+	return toVec3Property(element, is_p60, default_value);
+}
+
 static bool isString(const Property* prop)
 {
 	if (!prop) return false;
@@ -579,13 +734,32 @@ static bool isLong(const Property* prop)
 	return prop->getType() == Property::LONG;
 }
 
+// decompressors keep no state between calls, so each thread allocates one and reuses it for all arrays it inflates
+struct ThreadDecompressor
+{
+	~ThreadDecompressor()
+	{
+		if (decompressor) libdeflate_free_decompressor(decompressor);
+	}
+
+	libdeflate_decompressor* get()
+	{
+		if (!decompressor) decompressor = libdeflate_alloc_decompressor();
+		return decompressor;
+	}
+
+	libdeflate_decompressor* decompressor = nullptr;
+};
+
+
 static bool decompress(const u8* in, size_t in_size, u8* out, size_t out_size)
 {
-	auto dec = libdeflate_alloc_decompressor();
+	if (in_size < 2) return false;
+	static thread_local ThreadDecompressor thread_decompressor;
+	libdeflate_decompressor* dec = thread_decompressor.get();
+	if (!dec) return false;
 	size_t dummy;
-	bool res = libdeflate_deflate_decompress(dec, in + 2, in_size - 2, out, out_size, &dummy) == LIBDEFLATE_SUCCESS;
-	libdeflate_free_decompressor(dec);
-	return res;
+	return libdeflate_deflate_decompress(dec, in + 2, in_size - 2, out, out_size, &dummy) == LIBDEFLATE_SUCCESS;
 }
 
 
@@ -718,7 +892,57 @@ static OptionalError<u64> readElementOffset(Cursor* cursor, u32 version)
 }
 
 
-static OptionalError<Element*> readElement(Cursor* cursor, u32 version, Allocator& allocator)
+// where an element sits in the tree, the tokenizer only skips whole objects and top level sections
+enum class TokenizeScope
+{
+	NONE,
+	ROOT,
+	OBJECTS
+};
+
+
+// subtrees parseObjects would ignore anyway because of the load flags
+static bool isIgnoredSubtree(const Element& element, TokenizeScope scope, u16 flags)
+{
+	auto ignored = [flags](LoadFlags flag) { return (flags & (u16)flag) != 0; };
+
+	if (scope == TokenizeScope::ROOT) return element.id == "Takes" && ignored(LoadFlags::IGNORE_ANIMATIONS);
+	if (scope != TokenizeScope::OBJECTS) return false;
+
+	const DataView& id = element.id;
+	if (id == "AnimationStack" || id == "AnimationLayer" || id == "AnimationCurve" || id == "AnimationCurveNode") return ignored(LoadFlags::IGNORE_ANIMATIONS);
+	if (id == "Material") return ignored(LoadFlags::IGNORE_MATERIALS);
+	if (id == "Texture") return ignored(LoadFlags::IGNORE_TEXTURES);
+	if (id == "Video") return ignored(LoadFlags::IGNORE_VIDEOS);
+	if (id == "Pose") return ignored(LoadFlags::IGNORE_POSES);
+	if (id == "Model") return ignored(LoadFlags::IGNORE_MODELS);
+
+	const Property* last_prop = element.first_property;
+	if (!last_prop) return false;
+	while (last_prop->next) last_prop = last_prop->next;
+
+	if (id == "Geometry")
+	{
+		if (ignored(LoadFlags::IGNORE_GEOMETRY)) return true;
+		return last_prop->value == "Shape" && ignored(LoadFlags::IGNORE_BLEND_SHAPES);
+	}
+	if (id == "Deformer")
+	{
+		if (last_prop->value == "Skin" || last_prop->value == "Cluster") return ignored(LoadFlags::IGNORE_SKIN);
+		if (last_prop->value == "BlendShape" || last_prop->value == "BlendShapeChannel") return ignored(LoadFlags::IGNORE_BLEND_SHAPES);
+		return false;
+	}
+	if (id == "NodeAttribute")
+	{
+		if (last_prop->value == "Light") return ignored(LoadFlags::IGNORE_LIGHTS);
+		if (last_prop->value == "Camera") return ignored(LoadFlags::IGNORE_CAMERAS);
+		return false;
+	}
+	return false;
+}
+
+
+static OptionalError<Element*> readElement(Cursor* cursor, u32 version, Allocator& allocator, u16 flags = 0, TokenizeScope scope = TokenizeScope::NONE)
 {
 	OptionalError<u64> end_offset = readElementOffset(cursor, version);
 	if (end_offset.isError()) return Error();
@@ -751,14 +975,26 @@ static OptionalError<Element*> readElement(Cursor* cursor, u32 version, Allocato
 		prop_link = &(*prop_link)->next;
 	}
 
-	if (cursor->current - cursor->begin >= (ptrdiff_t)end_offset.getValue()) return element;
+	if (getFileOffset(*cursor) >= end_offset.getValue()) return element;
+
+	// ignored subtrees keep their id and properties, but their children are jumped over without being tokenized
+	if (isIgnoredSubtree(*element, scope, flags))
+	{
+		if (end_offset.getValue() < cursor->begin_offset || end_offset.getValue() - cursor->begin_offset > (u64)(cursor->end - cursor->begin))
+		{
+			return Error("Reading past the end");
+		}
+		cursor->current = cursor->begin + (end_offset.getValue() - cursor->begin_offset);
+		return element;
+	}
 
 	int BLOCK_SENTINEL_LENGTH = version >= 7500 ? 25 : 13;
+	const TokenizeScope child_scope = scope == TokenizeScope::ROOT && element->id == "Objects" ? TokenizeScope::OBJECTS : TokenizeScope::NONE;
 
 	Element** link = &element->child;
-	while (cursor->current - cursor->begin < ((ptrdiff_t)end_offset.getValue() - BLOCK_SENTINEL_LENGTH))
+	while (getFileOffset(*cursor) + BLOCK_SENTINEL_LENGTH < end_offset.getValue())
 	{
-		OptionalError<Element*> child = readElement(cursor, version, allocator);
+		OptionalError<Element*> child = readElement(cursor, version, allocator, flags, child_scope);
 		if (child.isError())
 		{
 			return Error();
@@ -1043,7 +1279,7 @@ static OptionalError<Element*> tokenizeText(const u8* data, size_t size, Allocat
 }
 
 
-static OptionalError<Element*> tokenize(const u8* data, size_t size, u32& version, Allocator& allocator) {
+static OptionalError<Element*> tokenize(const u8* data, size_t size, u32& version, u16 flags, Allocator& allocator) {
 	if (size < sizeof(Header)) return Error("Invalid header");
 
 	Cursor cursor;
@@ -1072,7 +1308,7 @@ static OptionalError<Element*> tokenize(const u8* data, size_t size, u32& versio
 	Element** element = &root->child;
 	for (;;)
 	{
-		OptionalError<Element*> child = readElement(&cursor, header->version, allocator);
+		OptionalError<Element*> child = readElement(&cursor, header->version, allocator, flags, TokenizeScope::ROOT);
 		if (child.isError())
 		{
 			return Error();
@@ -1327,9 +1563,9 @@ struct MeshImpl : Mesh
 
 	DMatrix getGeometricMatrix() const override
 	{
-		DVec3 translation = resolveVec3Property(*this, "GeometricTranslation", {0, 0, 0});
-		DVec3 rotation = resolveVec3Property(*this, "GeometricRotation", {0, 0, 0});
-		DVec3 scale = resolveVec3Property(*this, "GeometricScaling", {1, 1, 1});
+		DVec3 translation = resolveVec3Property(*this, KnownProperty::GEOMETRIC_TRANSLATION, {0, 0, 0});
+		DVec3 rotation = resolveVec3Property(*this, KnownProperty::GEOMETRIC_ROTATION, {0, 0, 0});
+		DVec3 scale = resolveVec3Property(*this, KnownProperty::GEOMETRIC_SCALING, {1, 1, 1});
 
 		DMatrix scale_mtx = makeIdentity();
 		scale_mtx.m[0] = (float)scale.x;
@@ -1740,6 +1976,8 @@ struct TextureImpl : Texture
 	DataView getRelativeFileName() const override { return relative_filename; }
 	DataView getFileName() const override { return filename; }
 	DataView getEmbeddedData() const override;
+	const IElementProperty* getEmbeddedBase64Data() const override;
+	const Video* findVideo() const;
 
 	DataView media;
 	DataView filename;
@@ -1942,6 +2180,43 @@ struct Scene : IScene
 		Object* object;
 	};
 
+	// CSR adjacency of m_connections, so resolving links doesn't scan every connection.
+	// build() groups connection indices by object id in file order, bind() then replaces them
+	// with the linked objects, dropping missing ones, and adds a copy sorted by object type.
+	struct ConnectionIndex
+	{
+		enum Direction
+		{
+			CHILDREN, // connections to the object, linked object is the source
+			PARENTS,  // connections from the object, linked object is the destination
+			DIRECTION_COUNT
+		};
+
+		struct Link
+		{
+			Object* object;
+			u32 connection;
+		};
+
+		struct Range
+		{
+			const Link* begin = nullptr;
+			const Link* end = nullptr;
+		};
+
+		void build(const std::vector<Connection>& connections);
+		void bind(const std::vector<Connection>& connections, const std::unordered_map<u64, ObjectPair>& object_map);
+		// links in file order
+		Range getLinks(u64 id, Direction direction) const;
+		// links to objects of the given type, in file order
+		Range getLinks(u64 id, Direction direction, Object::Type type) const;
+
+		std::vector<u64> ids;
+		std::vector<u32> offsets[DIRECTION_COUNT];
+		std::vector<Link> links[DIRECTION_COUNT];
+		std::vector<Link> typed_links[DIRECTION_COUNT];
+	};
+
 
 	int getAnimationStackCount() const override { return (int)m_animation_stacks.size(); }
 	int getGeometryCount() const override { return (int)m_geometries.size(); }
@@ -2061,9 +2336,12 @@ struct Scene : IScene
 	std::vector<Camera*> m_cameras;
 	std::vector<Light*> m_lights;
 	std::vector<Connection> m_connections;
+	ConnectionIndex m_connection_index;
 	std::vector<u8> m_data;
 	std::vector<TakeInfo> m_take_infos;
 	std::vector<Video> m_videos;
+	// first video of each media name
+	std::unordered_map<DataView, int, MediaNameHash, MediaNameEqual> m_video_index;
 	Allocator m_allocator;
 	u32 version = 0;
 };
@@ -2088,16 +2366,23 @@ Object::Object(const Scene& scene, const IElement& element)
 	}
 }
 
+const Video* TextureImpl::findVideo() const {
+	if (!media.begin) return nullptr;
+	auto iter = scene.m_video_index.find(media);
+	return iter == scene.m_video_index.end() ? nullptr : &scene.m_videos[iter->second];
+}
+
+
 DataView TextureImpl::getEmbeddedData() const {
 	if (!media.begin) return media;
-	for (const Video& v : scene.m_videos) {
-		if (v.media.end - v.media.begin != media.end - media.begin) continue;
-		const size_t len = v.media.end - v.media.begin;
-		if (memcmp(v.media.begin, media.begin, len) != 0) continue;
+	const Video* video = findVideo();
+	return video ? video->content : DataView{};
+}
 
-		return v.content;
-	}
-	return {};
+
+const IElementProperty* TextureImpl::getEmbeddedBase64Data() const {
+	const Video* video = findVideo();
+	return video ? video->base64_property : nullptr;
 }
 
 
@@ -2110,6 +2395,13 @@ bool PoseImpl::postprocess(Scene& scene) {
 }
 
 
+// index of the first key in [begin, end) at or after `fbx_time`, i.e. the end of the segment containing it
+static int findKeySegment(const i64* times, int begin, int end, i64 fbx_time)
+{
+	return int(std::lower_bound(times + begin, times + end - 1, fbx_time) - times);
+}
+
+
 struct AnimationCurveNodeImpl : AnimationCurveNode
 {
 	AnimationCurveNodeImpl(const Scene& _scene, const IElement& _element)
@@ -2154,23 +2446,18 @@ struct AnimationCurveNodeImpl : AnimationCurveNode
 		i64 fbx_time = secondsToFbxTime(time);
 
 		auto getCoord = [&](const Curve& curve, i64 fbx_time, int idx) {
-			if (!curve.curve) return default_values[idx];
+			if (!curve.curve || curve.curve->getKeyCount() == 0) return default_values[idx];
 
 			const i64* times = curve.curve->getKeyTime();
 			const float* values = curve.curve->getKeyValue();
 			int count = curve.curve->getKeyCount();
+			if (count == 1) return values[0];
 
 			if (fbx_time < times[0]) fbx_time = times[0];
 			if (fbx_time > times[count - 1]) fbx_time = times[count - 1];
-			for (int i = 1; i < count; ++i)
-			{
-				if (times[i] >= fbx_time)
-				{
-					float t = float(double(fbx_time - times[i - 1]) / double(times[i] - times[i - 1]));
-					return values[i - 1] * (1 - t) + values[i] * t;
-				}
-			}
-			return values[0];
+			const int i = findKeySegment(times, 1, count, fbx_time);
+			float t = float(double(fbx_time - times[i - 1]) / double(times[i] - times[i - 1]));
+			return values[i - 1] * (1 - t) + values[i] * t;
 		};
 
 		return {getCoord(curves[0], fbx_time, 0), getCoord(curves[1], fbx_time, 1), getCoord(curves[2], fbx_time, 2)};
@@ -2229,6 +2516,139 @@ struct AnimationLayerImpl : AnimationLayer
 	std::vector<AnimationCurveNodeImpl*> curve_nodes;
 };
 
+struct AnimationSamplerImpl : AnimationSampler
+{
+	explicit AnimationSamplerImpl(const AnimationLayer& layer)
+	{
+		const AnimationLayerImpl& impl = static_cast<const AnimationLayerImpl&>(layer);
+		curve_nodes = impl.curve_nodes;
+
+		// keys of all curves end to end, three channels per curve node, curves used by several channels are copied once
+		const size_t channel_count = curve_nodes.size() * 3;
+		key_begins.resize(channel_count);
+		key_ends.resize(channel_count);
+		defaults.resize(channel_count);
+		std::unordered_map<const AnimationCurve*, size_t> copied;
+		for (size_t i = 0; i < curve_nodes.size(); ++i)
+		{
+			for (int j = 0; j < 3; ++j)
+			{
+				const size_t channel = i * 3 + j;
+				defaults[channel] = curve_nodes[i]->default_values[j];
+				const AnimationCurve* curve = curve_nodes[i]->curves[j].curve;
+				auto iter = curve ? copied.find(curve) : copied.end();
+				if (iter != copied.end())
+				{
+					key_begins[channel] = key_begins[iter->second];
+					key_ends[channel] = key_ends[iter->second];
+					continue;
+				}
+
+				key_begins[channel] = (u32)times.size();
+				if (curve && curve->getKeyCount() > 0)
+				{
+					times.insert(times.end(), curve->getKeyTime(), curve->getKeyTime() + curve->getKeyCount());
+					values.insert(values.end(), curve->getKeyValue(), curve->getKeyValue() + curve->getKeyCount());
+					copied.emplace(curve, channel);
+				}
+				key_ends[channel] = (u32)times.size();
+			}
+		}
+
+		cursors.resize(channel_count);
+		for (size_t i = 0; i < channel_count; ++i) cursors[i] = key_begins[i] + 1;
+		offsets.resize(channel_count);
+		spans.resize(channel_count);
+		from.resize(channel_count);
+		to.resize(channel_count);
+		results.resize(channel_count);
+	}
+
+	void destroy() override { delete this; }
+
+	int getCurveNodeCount() const override { return (int)curve_nodes.size(); }
+	const AnimationCurveNode* getCurveNode(int index) const override { return curve_nodes[index]; }
+
+	void sample(double time, DVec3* out) override
+	{
+		const i64 fbx_time = secondsToFbxTime(time);
+		const int channel_count = (int)key_begins.size();
+		const i64* key_times = times.data();
+
+		// find the segment of every channel, usually the cached one or the next
+		for (int c = 0; c < channel_count; ++c)
+		{
+			const int begin = (int)key_begins[c];
+			const int end = (int)key_ends[c];
+			if (end - begin < 2)
+			{
+				from[c] = to[c] = begin == end ? defaults[c] : values[begin];
+				offsets[c] = 0;
+				spans[c] = 1;
+				continue;
+			}
+
+			i64 t = fbx_time;
+			if (t < key_times[begin]) t = key_times[begin];
+			if (t > key_times[end - 1]) t = key_times[end - 1];
+
+			int key = (int)cursors[c];
+			if (key_times[key] < t)
+			{
+				// playing forward, gallop from the cursor so small steps stay cheap
+				int first = key + 1;
+				int last = first;
+				for (int step = 1; last < end - 1 && key_times[last] < t; step *= 2)
+				{
+					first = last + 1;
+					last = last + step < end - 1 ? last + step : end - 1;
+				}
+				key = findKeySegment(key_times, first, last + 1, t);
+				cursors[c] = (u32)key;
+			}
+			else if (key > begin + 1 && key_times[key - 1] >= t)
+			{
+				// jumped back, e.g. the animation looped
+				key = findKeySegment(key_times, begin + 1, key, t);
+				cursors[c] = (u32)key;
+			}
+
+			offsets[c] = double(t - key_times[key - 1]);
+			spans[c] = double(key_times[key] - key_times[key - 1]);
+			from[c] = values[key - 1];
+			to[c] = values[key];
+		}
+
+		// same interpolation as AnimationCurveNode::getNodeLocalTransform, branchless over flat arrays
+		for (int c = 0; c < channel_count; ++c)
+		{
+			const float t = float(offsets[c] / spans[c]);
+			results[c] = from[c] * (1 - t) + to[c] * t;
+		}
+
+		for (size_t i = 0, c = curve_nodes.size(); i < c; ++i)
+		{
+			out[i] = {results[i * 3 + 0], results[i * 3 + 1], results[i * 3 + 2]};
+		}
+	}
+
+	std::vector<AnimationCurveNodeImpl*> curve_nodes;
+	std::vector<i64> times;
+	std::vector<float> values;
+	std::vector<u32> key_begins;
+	std::vector<u32> key_ends;
+	std::vector<float> defaults;
+	// end of the last used segment per channel
+	std::vector<u32> cursors;
+	// per channel interpolation inputs of the current sample
+	std::vector<double> offsets;
+	std::vector<double> spans;
+	std::vector<float> from;
+	std::vector<float> to;
+	std::vector<float> results;
+};
+
+
 /*
 	DEBUGGING ONLY (but im not your boss so do what you want)
 	- maps the contents of the given node for viewing in the debugger
@@ -2283,6 +2703,7 @@ void parseVideo(Scene& scene, const Element& element, Allocator& allocator)
 	video.content = is_base64 ? DataView{} : content_element->first_property->value;
 	video.filename = filename_element->first_property->value;
 	video.media = element.first_property->next->value;
+	scene.m_video_index.emplace(video.media, (int)scene.m_videos.size());
 	scene.m_videos.push_back(video);
 }
 
@@ -2522,25 +2943,6 @@ struct OptionalError<Object*> parseCamera(Scene& scene, const Element& element,
 	return camera;
 }
 
-static bool toObjectID(const Scene& scene, const Property* property, u64* out) {
-	if (!property) return false;
-	if (isString(property)) {
-		if (property->value == "Scene") return 0;
-		std::string tmp((const char*)property->value.begin, property->value.end - property->value.begin);
-		auto iter = scene.m_fake_ids.find(tmp);
-		if (iter != scene.m_fake_ids.end()) {
-			*out = iter->second;
-			return true;
-		}
-
-		return false;
-	}
-
-	*out = property->value.toU64();
-	return true;
-}
-
-
 static u64 toObjectID(Scene& scene, const Property* property) {
 	if (isString(property)) {
 		if (property->value == "Scene") return 0;
@@ -2695,54 +3097,222 @@ static OptionalError<Object*> parseMaterial(const Scene& scene, const Element& e
 	return material;
 }
 
-template <typename T> const char* fromString(const char* str, const char* end, T* val);
-template <> const char* fromString<int>(const char* str, const char* end, int* val)
+// Text arrays are parsed in a single pass: each number is read up to the character that ends it,
+// so there is no second scan for the ',' and, unlike atof, the result doesn't depend on the C locale.
+static bool isTextNumberSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+
+static bool isTextDigit(char c)
+{
+	return (u8)(c - '0') < 10;
+}
+
+
+static const char* skipTextDelimiter(const char* iter, const char* end)
 {
-	*val = atoi(str);
-	const char* iter = str;
 	while (iter < end && *iter != ',') ++iter;
 	if (iter < end) ++iter; // skip ','
-	return (const char*)iter;
+	return iter;
 }
 
 
-template <> const char* fromString<u64>(const char* str, const char* end, u64* val)
+// same rules as strtoull, negative values wrap around
+static const char* parseTextInteger(const char* str, const char* end, u64* val)
 {
-	*val = strtoull(str, nullptr, 10);
 	const char* iter = str;
-	while (iter < end && *iter != ',') ++iter;
-	if (iter < end) ++iter; // skip ','
-	return (const char*)iter;
+	while (iter < end && isTextNumberSpace(*iter)) ++iter;
+	bool negative = false;
+	if (iter < end && (*iter == '-' || *iter == '+'))
+	{
+		negative = *iter == '-';
+		++iter;
+	}
+	u64 value = 0;
+	while (iter < end && isTextDigit(*iter))
+	{
+		value = value * 10 + (u64)(*iter - '0');
+		++iter;
+	}
+	*val = negative ? 0 - value : value;
+	return iter;
 }
 
 
-template <> const char* fromString<i64>(const char* str, const char* end, i64* val)
+// strtod in the "C" locale, plain strtod would expect a ',' as the decimal separator in many others
+static const char* parseTextDoubleStrtod(const char* str, const char* end, double* val)
+{
+	char tmp[128];
+	size_t len = end - str < (ptrdiff_t)sizeof(tmp) - 1 ? size_t(end - str) : sizeof(tmp) - 1;
+	memcpy(tmp, str, len);
+	tmp[len] = '\0';
+	char* tmp_end;
+#ifdef _WIN32
+	static const _locale_t c_locale = _create_locale(LC_NUMERIC, "C");
+	*val = _strtod_l(tmp, &tmp_end, c_locale);
+#else
+	static const locale_t c_locale = newlocale(LC_NUMERIC_MASK, "C", (locale_t)0);
+	*val = strtod_l(tmp, &tmp_end, c_locale);
+#endif
+	return str + (tmp_end - tmp);
+}
+
+
+// numbers the fast path can't handle exactly: long mantissas, large exponents, inf, nan...
+static const char* parseTextDoubleSlow(const char* str, const char* end, double* val)
 {
-	*val = atoll(str);
+#ifdef OFBX_HAS_FROM_CHARS
+	const char* number = str < end && *str == '+' ? str + 1 : str;
+	std::from_chars_result res = std::from_chars(number, end, *val);
+	if (res.ec == std::errc()) return res.ptr;
+	if (res.ec == std::errc::invalid_argument)
+	{
+		*val = 0;
+		return str;
+	}
+	// out of range, from_chars leaves the value alone and strtod knows whether it's an overflow or an underflow
+#endif
+	return parseTextDoubleStrtod(str, end, val);
+}
+
+
+// Clinger's fast path: when the decimal mantissa and the power of ten are both exactly representable,
+// a single multiplication or division is correctly rounded, so the result is the same as strtod's
+static const char* parseTextDouble(const char* str, const char* end, double* val)
+{
+	static const double exact_powers_of_ten[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+	const u64 max_exact_mantissa = (u64)1 << 53;
+
 	const char* iter = str;
-	while (iter < end && *iter != ',') ++iter;
-	if (iter < end) ++iter; // skip ','
-	return (const char*)iter;
+	while (iter < end && isTextNumberSpace(*iter)) ++iter;
+	const char* number = iter;
+
+	bool negative = false;
+	if (iter < end && (*iter == '-' || *iter == '+'))
+	{
+		negative = *iter == '-';
+		++iter;
+	}
+
+	u64 mantissa = 0;
+	int digits = 0;
+	int exponent = 0;
+	bool any_digit = false;
+	while (iter < end && isTextDigit(*iter))
+	{
+		if (mantissa != 0 || *iter != '0')
+		{
+			if (++digits > 19) return parseTextDoubleSlow(number, end, val);
+			mantissa = mantissa * 10 + (u64)(*iter - '0');
+		}
+		any_digit = true;
+		++iter;
+	}
+	if (iter < end && *iter == '.')
+	{
+		++iter;
+		while (iter < end && isTextDigit(*iter))
+		{
+			if (mantissa != 0 || *iter != '0')
+			{
+				if (++digits > 19) return parseTextDoubleSlow(number, end, val);
+				mantissa = mantissa * 10 + (u64)(*iter - '0');
+			}
+			--exponent;
+			any_digit = true;
+			++iter;
+		}
+	}
+	// hexadecimal floats aren't supported by from_chars' general format
+	if (iter < end && (*iter == 'x' || *iter == 'X')) return parseTextDoubleStrtod(number, end, val);
+	// inf, nan
+	if (!any_digit) return parseTextDoubleSlow(number, end, val);
+
+	if (iter < end && (*iter == 'e' || *iter == 'E'))
+	{
+		const char* exp_iter = iter + 1;
+		bool exp_negative = false;
+		if (exp_iter < end && (*exp_iter == '-' || *exp_iter == '+'))
+		{
+			exp_negative = *exp_iter == '-';
+			++exp_iter;
+		}
+		// "1e" is 1 followed by garbage, the 'e' isn't part of the number
+		if (exp_iter < end && isTextDigit(*exp_iter))
+		{
+			int exp_value = 0;
+			while (exp_iter < end && isTextDigit(*exp_iter))
+			{
+				if (exp_value < 100000) exp_value = exp_value * 10 + (*exp_iter - '0');
+				++exp_iter;
+			}
+			exponent += exp_negative ? -exp_value : exp_value;
+			iter = exp_iter;
+		}
+	}
+
+	double value;
+	if (mantissa == 0)
+	{
+		value = 0;
+	}
+	else if (mantissa <= max_exact_mantissa && exponent >= -22 && exponent <= 22)
+	{
+		value = (double)mantissa;
+		value = exponent < 0 ? value / exact_powers_of_ten[-exponent] : value * exact_powers_of_ten[exponent];
+	}
+	else
+	{
+		return parseTextDoubleSlow(number, end, val);
+	}
+	*val = negative ? -value : value;
+	return iter;
+}
+
+
+template <typename T> const char* fromString(const char* str, const char* end, T* val);
+template <> const char* fromString<int>(const char* str, const char* end, int* val)
+{
+	u64 tmp;
+	const char* iter = parseTextInteger(str, end, &tmp);
+	*val = (int)tmp;
+	return skipTextDelimiter(iter, end);
+}
+
+
+template <> const char* fromString<u64>(const char* str, const char* end, u64* val)
+{
+	return skipTextDelimiter(parseTextInteger(str, end, val), end);
+}
+
+
+template <> const char* fromString<i64>(const char* str, const char* end, i64* val)
+{
+	u64 tmp;
+	const char* iter = parseTextInteger(str, end, &tmp);
+	*val = (i64)tmp;
+	return skipTextDelimiter(iter, end);
 }
 
 
 template <> const char* fromString<double>(const char* str, const char* end, double* val)
 {
-	*val = atof(str);
-	const char* iter = str;
-	while (iter < end && *iter != ',') ++iter;
-	if (iter < end) ++iter; // skip ','
-	return (const char*)iter;
+	return skipTextDelimiter(parseTextDouble(str, end, val), end);
 }
 
 
 template <> const char* fromString<float>(const char* str, const char* end, float* val)
 {
-	*val = (float)atof(str);
-	const char* iter = str;
-	while (iter < end && *iter != ',') ++iter;
-	if (iter < end) ++iter; // skip ','
-	return (const char*)iter;
+	// parsed as double and narrowed, like atof did, so values stay bit identical
+	double tmp;
+	const char* iter = parseTextDouble(str, end, &tmp);
+	*val = (float)tmp;
+	return skipTextDelimiter(iter, end);
 }
 
 
@@ -2751,10 +3321,8 @@ const char* fromString(const char* str, const char* end, double* val, int count)
 	const char* iter = str;
 	for (int i = 0; i < count; ++i)
 	{
-		*val = atof(iter);
+		iter = skipTextDelimiter(parseTextDouble(iter, end, val), end);
 		++val;
-		while (iter < end && *iter != ',') ++iter;
-		if (iter < end) ++iter; // skip ','
 
 		if (iter == end) return iter;
 	}
@@ -2766,10 +3334,10 @@ const char* fromString(const char* str, const char* end, float* val, int count)
 	const char* iter = str;
 	for (int i = 0; i < count; ++i)
 	{
-		*val = (float)atof(iter);
+		double tmp;
+		iter = skipTextDelimiter(parseTextDouble(iter, end, &tmp), end);
+		*val = (float)tmp;
 		++val;
-		while (iter < end && *iter != ',') ++iter;
-		if (iter < end) ++iter; // skip ','
 
 		if (iter == end) return iter;
 	}
@@ -2930,6 +3498,8 @@ static bool parseMemory(const Property& property, T* out, int max_size_bytes) {
 template <typename T> static void parseTextArray(const Property& property, std::vector<T>* out)
 {
 	out->clear();
+	// the tokenizer already counted the numbers
+	out->reserve(property.count / (sizeof(T) / sizeof(typename TElemType<T>::Type)));
 	const u8* iter = property.value.begin;
 	while (iter < property.value.end)
 	{
@@ -3002,6 +3572,80 @@ template <typename T> static bool parseArray(const Property& property, std::vect
 	return parseMemory(property, out->data(), int(sizeof((*out)[0]) * out->size()));
 }
 
+// double to float narrowing, `in` doesn't need to be aligned
+static void convertValues(const u8* in, float* out, usize count)
+{
+	usize i = 0;
+#ifdef OFBX_SSE2
+	for (; i + 4 <= count; i += 4) {
+		const __m128 low = _mm_cvtpd_ps(_mm_loadu_pd((const double*)(in + i * sizeof(double))));
+		const __m128 high = _mm_cvtpd_ps(_mm_loadu_pd((const double*)(in + (i + 2) * sizeof(double))));
+		_mm_storeu_ps(out + i, _mm_movelh_ps(low, high));
+	}
+#endif
+	for (; i < count; ++i) out[i] = (float)read_value<double>(in + i * sizeof(double));
+}
+
+
+// float to double widening, front to back so `in` can be the second half of `out`
+static void convertValues(const u8* in, double* out, usize count)
+{
+	for (usize i = 0; i < count; ++i) out[i] = (double)read_value<float>(in + i * sizeof(float));
+}
+
+
+// decompression buffer of the narrowing conversions, kept by each thread unless it grew too big
+struct ThreadScratch
+{
+	static const usize MAX_KEPT_SIZE = 16 * 1024 * 1024;
+
+	std::vector<u8> data;
+};
+
+
+// binary 'd' and 'f' arrays parsed into vectors of the other precision: raw arrays are converted
+// straight from the file, compressed ones are inflated into the tail of the output when widening,
+// and into per-thread scratch when narrowing
+template <typename T> static bool parseConvertedArray(const Property& property, std::vector<T>* out_vec)
+{
+	using ElemType = typename TElemType<T>::Type;
+	const usize src_size = property.type == 'd' ? sizeof(double) : sizeof(float);
+	const usize elem_count = sizeof(T) / sizeof(ElemType);
+
+	const u8* data = property.value.begin + sizeof(u32) * 3;
+	if (data > property.value.end) return false;
+	const u32 count = property.getCount();
+	const u32 enc = read_value<u32>(property.value.begin + 4);
+	const u32 len = read_value<u32>(property.value.begin + 8);
+	if (count % elem_count != 0) return false;
+
+	out_vec->resize(count / elem_count);
+	if (count == 0) return true;
+	ElemType* out = (ElemType*)out_vec->data();
+	const usize src_bytes = count * src_size;
+
+	if (enc == 0) {
+		if (len != src_bytes || data + len > property.value.end) return false;
+		convertValues(data, out, count);
+		return true;
+	}
+	if (enc != 1) return false;
+
+	if (sizeof(ElemType) > src_size) {
+		u8* tail = (u8*)out + count * sizeof(ElemType) - src_bytes;
+		if (!decompress(data, len, tail, src_bytes)) return false;
+		convertValues(tail, out, count);
+		return true;
+	}
+
+	static thread_local ThreadScratch scratch;
+	if (scratch.data.size() < src_bytes) scratch.data.resize(src_bytes);
+	const bool decompressed = decompress(data, len, scratch.data.data(), src_bytes);
+	if (decompressed) convertValues(scratch.data.data(), out, count);
+	if (scratch.data.capacity() > ThreadScratch::MAX_KEPT_SIZE) std::vector<u8>().swap(scratch.data);
+	return decompressed;
+}
+
 template <typename T> static bool parseVecData(Property& property, std::vector<T>* out_vec) {
 	using ElemType = typename TElemType<T>::Type;
 	assert(out_vec);
@@ -3012,6 +3656,10 @@ template <typename T> static bool parseVecData(Property& property, std::vector<T
 
 	if (typeMatch<ElemType>(property.type)) return parseArray(property, out_vec);
 
+	if constexpr (std::is_floating_point<ElemType>::value) {
+		if (property.type == 'd' || property.type == 'f') return parseConvertedArray(property, out_vec);
+	}
+
 	if (property.type == 'f' || property.type == 'F') {
 		std::vector<float> tmp;
 		if (!parseArray(property, &tmp)) return false;
@@ -3123,9 +3771,7 @@ static OptionalError<Object*> parseAnimationCurve(const Scene& scene, const Elem
 	return curve;
 }
 
-static OptionalError<Object*> parseGeometry(const Element& element, GeometryImpl& geom, std::vector<ParseDataJob> &jobs, Allocator& allocator) {
-	assert(element.first_property);
-
+static OptionalError<GeometryDataImpl*> parseGeometryData(const Element& element, GeometryDataImpl& geom, std::vector<ParseDataJob> &jobs) {
 	const Element* vertices_element = findChild(element, "Vertices");
 	if (!vertices_element || !vertices_element->first_property)
 	{
@@ -3148,6 +3794,15 @@ static OptionalError<Object*> parseGeometry(const Element& element, GeometryImpl
 }
 
 
+static OptionalError<Object*> parseGeometry(const Element& element, GeometryImpl& geom, std::vector<ParseDataJob> &jobs, Allocator& allocator) {
+	assert(element.first_property);
+
+	OptionalError<GeometryDataImpl*> data = parseGeometryData(element, geom, jobs);
+	if (data.isError()) return Error();
+	return &geom;
+}
+
+
 bool ShapeImpl::postprocess(GeometryImpl& geom, Allocator& allocator) {
 	const Element* vertices_element = findChild((const Element&)element, "Vertices");
 	const Element* normals_element = findChild((const Element&)element, "Normals");
@@ -3161,6 +3816,8 @@ bool ShapeImpl::postprocess(GeometryImpl& geom, Allocator& allocator) {
 	if (!parseVecData(*vertices_element->first_property, &vertices)) return false;
 	if (normals_element && !parseVecData(*normals_element->first_property, &normals)) return false;
 	if (!parseVecData(*indexes_element->first_property, &indices)) return false;
+	// normals are only usable paired with the vertices, the interface doesn't expose their count
+	if (normals.size() != vertices.size()) normals.clear();
 
 	return true;
 }
@@ -3231,6 +3888,7 @@ static bool parseConnections(const Element& root, Scene& scene)
 
 		connection = connection->sibling;
 	}
+	scene.m_connection_index.build(scene.m_connections);
 	return true;
 }
 
@@ -3449,7 +4107,7 @@ static bool parseObjects(const Element& root, Scene& scene, u16 flags, Allocator
 				obj = geom;
 				scene.m_geometries.push_back(geom);
 			}
-			else if (last_prop && last_prop->value == "Shape")
+			else if (last_prop && last_prop->value == "Shape" && !ignore_blend_shapes)
 			{
 				obj = allocator.allocate<ShapeImpl>(scene, *iter.second.element);
 			}
@@ -3486,9 +4144,9 @@ static bool parseObjects(const Element& root, Scene& scene, u16 flags, Allocator
 
 			if (class_prop)
 			{
-				if (class_prop->getValue() == "Cluster")
+				if (class_prop->getValue() == "Cluster" && !ignore_skin)
 					obj = parseCluster(scene, *iter.second.element, allocator);
-				else if (class_prop->getValue() == "Skin")
+				else if (class_prop->getValue() == "Skin" && !ignore_skin)
 					obj = allocator.allocate<SkinImpl>(scene, *iter.second.element);
 				else if (class_prop->getValue() == "BlendShape" && !ignore_blend_shapes)
 					obj = allocator.allocate<BlendShapeImpl>(scene, *iter.second.element);
@@ -3560,6 +4218,7 @@ static bool parseObjects(const Element& root, Scene& scene, u16 flags, Allocator
 			obj.getValue()->id = iter.first;
 		}
 	}
+	scene.m_connection_index.bind(scene.m_connections, scene.m_object_map);
 
 	if (!jobs.empty()) {
 		(*job_processor)([](void* ptr){
@@ -3822,37 +4481,37 @@ static bool parseObjects(const Element& root, Scene& scene, u16 flags, Allocator
 RotationOrder Object::getRotationOrder() const
 {
 	// This assumes that the default rotation order is EULER_XYZ.
-	return (RotationOrder) resolveEnumProperty(*this, "RotationOrder", (int) RotationOrder::EULER_XYZ);
+	return (RotationOrder) resolveEnumProperty(*this, KnownProperty::ROTATION_ORDER, (int) RotationOrder::EULER_XYZ);
 }
 
 
 DVec3 Object::getRotationOffset() const
 {
-	return resolveVec3Property(*this, "RotationOffset", {0, 0, 0});
+	return resolveVec3Property(*this, KnownProperty::ROTATION_OFFSET, {0, 0, 0});
 }
 
 
 DVec3 Object::getRotationPivot() const
 {
-	return resolveVec3Property(*this, "RotationPivot", {0, 0, 0});
+	return resolveVec3Property(*this, KnownProperty::ROTATION_PIVOT, {0, 0, 0});
 }
 
 
 DVec3 Object::getPostRotation() const
 {
-	return resolveVec3Property(*this, "PostRotation", {0, 0, 0});
+	return resolveVec3Property(*this, KnownProperty::POST_ROTATION, {0, 0, 0});
 }
 
 
 DVec3 Object::getScalingOffset() const
 {
-	return resolveVec3Property(*this, "ScalingOffset", {0, 0, 0});
+	return resolveVec3Property(*this, KnownProperty::SCALING_OFFSET, {0, 0, 0});
 }
 
 
 DVec3 Object::getScalingPivot() const
 {
-	return resolveVec3Property(*this, "ScalingPivot", {0, 0, 0});
+	return resolveVec3Property(*this, KnownProperty::SCALING_PIVOT, {0, 0, 0});
 }
 
 
@@ -3905,25 +4564,25 @@ DMatrix Object::evalLocal(const DVec3& translation, const DVec3& rotation, const
 
 DVec3 Object::getLocalTranslation() const
 {
-	return resolveVec3Property(*this, "Lcl Translation", {0, 0, 0});
+	return resolveVec3Property(*this, KnownProperty::LCL_TRANSLATION, {0, 0, 0});
 }
 
 
 DVec3 Object::getPreRotation() const
 {
-	return resolveVec3Property(*this, "PreRotation", {0, 0, 0});
+	return resolveVec3Property(*this, KnownProperty::PRE_ROTATION, {0, 0, 0});
 }
 
 
 DVec3 Object::getLocalRotation() const
 {
-	return resolveVec3Property(*this, "Lcl Rotation", {0, 0, 0});
+	return resolveVec3Property(*this, KnownProperty::LCL_ROTATION, {0, 0, 0});
 }
 
 
 DVec3 Object::getLocalScaling() const
 {
-	return resolveVec3Property(*this, "Lcl Scaling", {1, 1, 1});
+	return resolveVec3Property(*this, KnownProperty::LCL_SCALING, {1, 1, 1});
 }
 
 
@@ -3944,68 +4603,287 @@ DMatrix Object::getLocalTransform() const
 
 Object* Object::resolveObjectLinkReverse(Object::Type type) const
 {
-	u64 id;
-	if (!toObjectID(scene, ((Element&)element).first_property, &id)) return nullptr;
-	for (auto& connection : scene.m_connections)
+	Scene::ConnectionIndex::Range links = scene.m_connection_index.getLinks(id, Scene::ConnectionIndex::PARENTS, type);
+	return links.begin != links.end ? links.begin->object : nullptr;
+}
+
+
+const IScene& Object::getScene() const
+{
+	return scene;
+}
+
+
+Object* Object::resolveObjectLink(int idx) const
+{
+	Scene::ConnectionIndex::Range links = scene.m_connection_index.getLinks(id, Scene::ConnectionIndex::CHILDREN);
+	if (idx < 0 || idx >= links.end - links.begin) return nullptr;
+	return links.begin[idx].object;
+}
+
+
+Object* Object::resolveObjectLink(Object::Type type, const char* property, int idx) const
+{
+	Scene::ConnectionIndex::Range links = scene.m_connection_index.getLinks(id, Scene::ConnectionIndex::CHILDREN, type);
+	if (idx < 0) return nullptr;
+	if (property == nullptr) return idx < links.end - links.begin ? links.begin[idx].object : nullptr;
+
+	for (const Scene::ConnectionIndex::Link* link = links.begin; link != links.end; ++link)
 	{
-		if (connection.from_object == id && connection.to_object != 0)
+		if (scene.m_connections[link->connection].to_property == property)
 		{
-			const Scene::ObjectPair& pair = scene.m_object_map.find(connection.to_object)->second;
-			Object* obj = pair.object;
-			if (obj && obj->getType() == type) return obj;
+			if (idx == 0) return link->object;
+			--idx;
 		}
 	}
 	return nullptr;
 }
 
 
-const IScene& Object::getScene() const
+void Scene::ConnectionIndex::build(const std::vector<Connection>& connections)
 {
-	return scene;
+	ids.clear();
+	ids.reserve(connections.size() * 2);
+	for (const Connection& connection : connections)
+	{
+		ids.push_back(connection.to_object);
+		ids.push_back(connection.from_object);
+	}
+	std::sort(ids.begin(), ids.end());
+	ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+	auto indexOf = [&](u64 id) { return u32(std::lower_bound(ids.begin(), ids.end(), id) - ids.begin()); };
+
+	// counting sort, links of an object keep the file order
+	for (int direction = 0; direction < DIRECTION_COUNT; ++direction)
+	{
+		offsets[direction].assign(ids.size() + 1, 0);
+		links[direction].clear();
+		typed_links[direction].clear();
+	}
+	// the root (id 0) is never returned as a linked object
+	for (const Connection& connection : connections)
+	{
+		if (connection.from_object != 0) ++offsets[CHILDREN][indexOf(connection.to_object) + 1];
+		if (connection.to_object != 0) ++offsets[PARENTS][indexOf(connection.from_object) + 1];
+	}
+	for (int direction = 0; direction < DIRECTION_COUNT; ++direction)
+	{
+		std::vector<u32>& offset = offsets[direction];
+		for (size_t i = 1; i < offset.size(); ++i) offset[i] += offset[i - 1];
+		links[direction].resize(offset.back());
+	}
+
+	std::vector<u32> cursor[DIRECTION_COUNT] = { offsets[CHILDREN], offsets[PARENTS] };
+	for (u32 i = 0, c = (u32)connections.size(); i < c; ++i)
+	{
+		const Connection& connection = connections[i];
+		if (connection.from_object != 0) links[CHILDREN][cursor[CHILDREN][indexOf(connection.to_object)]++] = { nullptr, i };
+		if (connection.to_object != 0) links[PARENTS][cursor[PARENTS][indexOf(connection.from_object)]++] = { nullptr, i };
+	}
 }
 
 
-Object* Object::resolveObjectLink(int idx) const
+void Scene::ConnectionIndex::bind(const std::vector<Connection>& connections, const std::unordered_map<u64, ObjectPair>& object_map)
 {
-	u64 id = 0;
-	toObjectID(scene, ((Element&)element).first_property, &id);
-	for (auto& connection : scene.m_connections)
+	for (int direction = 0; direction < DIRECTION_COUNT; ++direction)
 	{
-		if (connection.to_object == id && connection.from_object != 0)
+		std::vector<u32>& offset = offsets[direction];
+		std::vector<Link>& list = links[direction];
+
+		// compact in place, keeping only links to objects which were created
+		u32 out = 0;
+		u32 begin = 0;
+		for (size_t i = 0; i < ids.size(); ++i)
 		{
-			Object* obj = scene.m_object_map.find(connection.from_object)->second.object;
-			if (obj)
+			const u32 end = offset[i + 1];
+			offset[i] = out;
+			for (u32 j = begin; j < end; ++j)
 			{
-				if (idx == 0) return obj;
-				--idx;
+				const Connection& connection = connections[list[j].connection];
+				auto iter = object_map.find(direction == CHILDREN ? connection.from_object : connection.to_object);
+				if (iter == object_map.end() || !iter->second.object) continue;
+				list[out++] = { iter->second.object, list[j].connection };
 			}
+			begin = end;
+		}
+		offset.back() = out;
+		list.resize(out);
+
+		// most objects link to a single type, their range is already sorted
+		auto byType = [](const Link& a, const Link& b) { return a.object->getType() < b.object->getType(); };
+		typed_links[direction] = list;
+		for (size_t i = 0; i < ids.size(); ++i)
+		{
+			auto begin = typed_links[direction].begin() + offset[i];
+			auto end = typed_links[direction].begin() + offset[i + 1];
+			if (!std::is_sorted(begin, end, byType)) std::stable_sort(begin, end, byType);
 		}
 	}
-	return nullptr;
 }
 
 
-Object* Object::resolveObjectLink(Object::Type type, const char* property, int idx) const
+Scene::ConnectionIndex::Range Scene::ConnectionIndex::getLinks(u64 id, Direction direction) const
+{
+	Range range;
+	auto iter = std::lower_bound(ids.begin(), ids.end(), id);
+	if (iter == ids.end() || *iter != id) return range;
+
+	const size_t i = iter - ids.begin();
+	if (links[direction].empty()) return range;
+	range.begin = links[direction].data() + offsets[direction][i];
+	range.end = links[direction].data() + offsets[direction][i + 1];
+	return range;
+}
+
+
+Scene::ConnectionIndex::Range Scene::ConnectionIndex::getLinks(u64 id, Direction direction, Object::Type type) const
 {
-	u64 id;
-	if (!toObjectID(scene, ((Element&)element).first_property, &id)) return nullptr;
-	for (auto& connection : scene.m_connections)
+	Range range;
+	auto iter = std::lower_bound(ids.begin(), ids.end(), id);
+	if (iter == ids.end() || *iter != id) return range;
+
+	const size_t i = iter - ids.begin();
+	if (typed_links[direction].empty()) return range;
+	const Link* begin = typed_links[direction].data() + offsets[direction][i];
+	const Link* end = typed_links[direction].data() + offsets[direction][i + 1];
+	range.begin = std::lower_bound(begin, end, type, [](const Link& link, Object::Type t) { return link.object->getType() < t; });
+	range.end = std::upper_bound(range.begin, end, type, [](Object::Type t, const Link& link) { return t < link.object->getType(); });
+	return range;
+}
+
+
+struct TransformHierarchyImpl : TransformHierarchy
+{
+	struct LocalOverride
+	{
+		bool active = false;
+		DVec3 translation;
+		DVec3 rotation;
+		DVec3 scaling;
+	};
+
+	explicit TransformHierarchyImpl(const IScene& scene)
 	{
-		if (connection.to_object == id && connection.from_object != 0)
+		// every node and the parents outside of the object list, like the root
+		std::vector<const Object*> objects;
+		for (int i = 0, c = scene.getAllObjectCount(); i < c; ++i)
 		{
-			Object* obj = scene.m_object_map.find(connection.from_object)->second.object;
-			if (obj && obj->getType() == type)
+			for (const Object* obj = scene.getAllObjects()[i]; obj && obj->isNode(); obj = obj->getParent())
 			{
-				if (property == nullptr || connection.to_property == property)
-				{
-					if (idx == 0) return obj;
-					--idx;
-				}
+				if (!indices.emplace(obj, 0).second) break;
+				objects.push_back(obj);
 			}
 		}
+
+		// counting sort by the depth computed in Scene::finalize, file order is kept inside a level
+		auto depthOf = [](const Object* obj) { return obj->depth == 0xffFFffFF ? 0 : obj->depth; };
+		u32 max_depth = 0;
+		for (const Object* obj : objects) max_depth = depthOf(obj) > max_depth ? depthOf(obj) : max_depth;
+		std::vector<u32> offsets(max_depth + 2, 0);
+		for (const Object* obj : objects) ++offsets[depthOf(obj) + 1];
+		for (size_t i = 1; i < offsets.size(); ++i) offsets[i] += offsets[i - 1];
+		nodes.resize(objects.size());
+		for (const Object* obj : objects) nodes[offsets[depthOf(obj)]++] = obj;
+
+		parents.resize(nodes.size());
+		for (int i = 0; i < (int)nodes.size(); ++i)
+		{
+			indices[nodes[i]] = i;
+			parents[i] = -1;
+		}
+		for (int i = 0; i < (int)nodes.size(); ++i)
+		{
+			const Object* parent = nodes[i]->getParent();
+			if (parent) parents[i] = indices.find(parent)->second;
+			assert(parents[i] < i);
+		}
+
+		overrides.resize(nodes.size());
+		local_transforms.resize(nodes.size());
+		global_transforms.resize(nodes.size());
+		dirty.assign(nodes.size(), 1);
+		changed.resize(nodes.size());
+		first_dirty = 0;
 	}
-	return nullptr;
-}
+
+	void destroy() override { delete this; }
+
+	int getNodeCount() const override { return (int)nodes.size(); }
+	const Object* getNode(int index) const override { return nodes[index]; }
+	int getParentIndex(int index) const override { return parents[index]; }
+
+	int getNodeIndex(const Object& node) const override
+	{
+		auto iter = indices.find(&node);
+		return iter == indices.end() ? -1 : iter->second;
+	}
+
+	void setLocalTransform(int index, const DVec3& translation, const DVec3& rotation, const DVec3& scaling) override
+	{
+		LocalOverride& local = overrides[index];
+		local.active = true;
+		local.translation = translation;
+		local.rotation = rotation;
+		local.scaling = scaling;
+		markDirty(index);
+	}
+
+	void resetLocalTransform(int index) override
+	{
+		overrides[index].active = false;
+		markDirty(index);
+	}
+
+	void markDirty(int index) override
+	{
+		dirty[index] = 1;
+		if ((size_t)index < first_dirty) first_dirty = index;
+	}
+
+	void evaluateAll() override
+	{
+		// parents come first, so their global transform is final when the children need it,
+		// and nothing before the first dirty node can change
+		const size_t first = first_dirty;
+		for (size_t i = first, c = nodes.size(); i < c; ++i)
+		{
+			const Object* node = nodes[i];
+			const bool local_changed = dirty[i] != 0;
+			if (local_changed)
+			{
+				const LocalOverride& local = overrides[i];
+				local_transforms[i] = local.active
+					? node->evalLocal(local.translation, local.rotation, local.scaling)
+					: node->evalLocal(node->getLocalTranslation(), node->getLocalRotation());
+				dirty[i] = 0;
+			}
+
+			const int parent = parents[i];
+			changed[i] = local_changed || (parent >= 0 && (size_t)parent >= first && changed[parent]);
+			if (changed[i])
+			{
+				global_transforms[i] = parent >= 0 ? global_transforms[parent] * local_transforms[i] : local_transforms[i];
+			}
+		}
+		first_dirty = nodes.size();
+	}
+
+	const DMatrix& getLocalTransform(int index) const override { return local_transforms[index]; }
+	const DMatrix& getGlobalTransform(int index) const override { return global_transforms[index]; }
+
+	std::vector<const Object*> nodes;
+	std::vector<int> parents;
+	std::unordered_map<const Object*, int> indices;
+	std::vector<LocalOverride> overrides;
+	std::vector<DMatrix> local_transforms;
+	std::vector<DMatrix> global_transforms;
+	std::vector<u8> dirty;
+	// global transform recomputed in the current evaluation
+	std::vector<u8> changed;
+	// nodes.size() when nothing is dirty
+	size_t first_dirty = 0;
+};
 
 
 bool Scene::finalize() {
@@ -4055,15 +4933,21 @@ bool Scene::finalize() {
 
 IScene* load(const u8* data, usize size, u16 flags, JobProcessor job_processor, void* job_user_ptr)
 {
+	Error::s_message = "";
 	std::unique_ptr<Scene> scene(new Scene());
-	scene->m_data.resize(size);
-	memcpy(&scene->m_data[0], data, size);
+	// tokens point directly into the source bytes, so borrowed data (e.g. a file mapping) can be used as is
+	const u8* scene_data = data;
+	if ((flags & (u16)LoadFlags::BORROW_DATA) == 0) {
+		scene->m_data.resize(size);
+		memcpy(&scene->m_data[0], data, size);
+		scene_data = &scene->m_data[0];
+	}
 
 	const bool is_binary = size >= 18 && strncmp((const char*)data, "Kaydara FBX Binary", 18) == 0;
 	OptionalError<Element*> root(nullptr);
 	if (is_binary) {
 		u32 version;
-		root = tokenize(&scene->m_data[0], size, version, scene->m_allocator);
+		root = tokenize(scene_data, size, version, flags, scene->m_allocator);
 		scene->version = version;
 		if (version < 6100)
 		{
@@ -4077,7 +4961,7 @@ IScene* load(const u8* data, usize size, u16 flags, JobProcessor job_processor,
 		}
 	}
 	else {
-		root = tokenizeText(&scene->m_data[0], size, scene->m_allocator);
+		root = tokenizeText(scene_data, size, scene->m_allocator);
 		if (root.isError()) return nullptr;
 		const ofbx::Element* header = findChild(*root.getValue(), "FBXHeaderExtension");
 		if (header) {
@@ -4102,6 +4986,181 @@ IScene* load(const u8* data, usize size, u16 flags, JobProcessor job_processor,
 }
 
 
+struct StreamRecord
+{
+	u64 end_offset;
+	u64 children_offset; // children follow the properties of the record
+	char id[256];
+};
+
+
+// reads the header and the id of the node record at `offset`, the properties and children stay on disk
+static bool readStreamRecord(StreamReadFunction read, void* read_user_ptr, u64 offset, u32 version, StreamRecord* record)
+{
+	const usize header_size = version >= 7500 ? 25 : 13;
+	u8 header[25];
+	if (!read(read_user_ptr, offset, header, header_size))
+	{
+		Error::s_message = "Reading past the end";
+		return false;
+	}
+
+	record->end_offset = version >= 7500 ? read_value<u64>(header) : read_value<u32>(header);
+	if (record->end_offset == 0) return true; // end of the list
+
+	const u64 properties_length = version >= 7500 ? read_value<u64>(header + 16) : read_value<u32>(header + 8);
+	const u8 id_length = header[header_size - 1];
+	record->children_offset = offset + header_size + id_length + properties_length;
+	if (record->end_offset <= offset || !read(read_user_ptr, offset + header_size, record->id, id_length))
+	{
+		Error::s_message = "Invalid node record";
+		return false;
+	}
+	record->id[id_length] = '\0';
+	return true;
+}
+
+
+static bool streamGeometry(StreamReadFunction read, void* read_user_ptr, u64 offset, u64 end_offset, u32 version, std::vector<u8>& buffer,
+	GeometryStreamCallback callback, void* callback_user_ptr, JobProcessor job_processor, void* job_user_ptr, bool* stop)
+{
+	if (end_offset - offset > (u64)(usize)-1)
+	{
+		Error::s_message = "Geometry too big";
+		return false;
+	}
+	buffer.resize((usize)(end_offset - offset));
+	if (!read(read_user_ptr, offset, buffer.data(), buffer.size()))
+	{
+		Error::s_message = "Reading past the end";
+		return false;
+	}
+
+	// the record is tokenized on its own, with a cursor that knows where it is in the file
+	Allocator allocator;
+	Cursor cursor;
+	cursor.begin = buffer.data();
+	cursor.current = cursor.begin;
+	cursor.end = cursor.begin + buffer.size();
+	cursor.begin_offset = offset;
+	OptionalError<Element*> element = readElement(&cursor, version, allocator);
+	if (element.isError() || !element.getValue() || !element.getValue()->first_property)
+	{
+		Error::s_message = "Invalid geometry";
+		return false;
+	}
+	const Element& geometry_element = *element.getValue();
+
+	// blend shapes are geometries too
+	const Property* last_prop = geometry_element.first_property;
+	while (last_prop->next) last_prop = last_prop->next;
+	if (!(last_prop->value == "Mesh")) return true;
+
+	GeometryDataImpl geom;
+	std::vector<ParseDataJob> jobs;
+	OptionalError<GeometryDataImpl*> parsed = parseGeometryData(geometry_element, geom, jobs);
+	if (parsed.isError()) return false;
+
+	if (!jobs.empty()) {
+		(*job_processor)([](void* ptr){
+			ParseDataJob* job = (ParseDataJob*)ptr;
+			job->error = !job->f(job->property, job->data);
+		}, job_user_ptr, &jobs[0], (u32)sizeof(jobs[0]), (u32)jobs.size());
+
+		for (const ParseDataJob& job : jobs) {
+			if (job.error) {
+				Error::s_message = "Failed to parse data";
+				return false;
+			}
+		}
+	}
+	if (!geom.postprocess()) {
+		Error::s_message = "Failed to postprocess geometry";
+		return false;
+	}
+
+	char name[128];
+	const Property* id_prop = geometry_element.first_property;
+	if (version < 6200 && isString(id_prop)) id_prop->value.toString(name);
+	else if (id_prop->next) id_prop->next->value.toString(name);
+	else name[0] = '\0';
+	const u64 id = isString(id_prop) ? 0 : id_prop->value.toU64();
+
+	*stop = !callback(callback_user_ptr, id, name, geom);
+	return true;
+}
+
+
+bool streamGeometries(StreamReadFunction read, void* read_user_ptr, u64 size, u16 flags, GeometryStreamCallback callback, void* callback_user_ptr,
+	JobProcessor job_processor, void* job_user_ptr)
+{
+	Error::s_message = "";
+	if (!job_processor) job_processor = &sync_job_processor;
+
+	Header header;
+	if (size < sizeof(header) || !read(read_user_ptr, 0, &header, sizeof(header)) || strncmp((const char*)header.magic, "Kaydara FBX Binary", 18) != 0)
+	{
+		Error::s_message = "Only binary FBX files can be streamed";
+		return false;
+	}
+	if (header.version < 6100)
+	{
+		Error::s_message = "Unsupported FBX file format version. Minimum supported version is 6.1";
+		return false;
+	}
+	if (flags & (u16)LoadFlags::IGNORE_GEOMETRY) return true;
+
+	const u64 sentinel_length = header.version >= 7500 ? 25 : 13;
+	std::vector<u8> buffer;
+
+	// everything except the geometries in the Objects section is skipped using the record end offsets
+	u64 offset = sizeof(header);
+	while (offset < size)
+	{
+		StreamRecord record;
+		if (!readStreamRecord(read, read_user_ptr, offset, header.version, &record)) return false;
+		if (record.end_offset == 0) break;
+
+		if (strcmp(record.id, "Objects") == 0)
+		{
+			u64 child_offset = record.children_offset;
+			while (child_offset + sentinel_length < record.end_offset)
+			{
+				StreamRecord child;
+				if (!readStreamRecord(read, read_user_ptr, child_offset, header.version, &child)) return false;
+				if (child.end_offset == 0) break;
+
+				if (strcmp(child.id, "Geometry") == 0)
+				{
+					bool stop = false;
+					if (!streamGeometry(read, read_user_ptr, child_offset, child.end_offset, header.version, buffer,
+						callback, callback_user_ptr, job_processor, job_user_ptr, &stop))
+					{
+						return false;
+					}
+					if (stop) return true;
+				}
+				child_offset = child.end_offset;
+			}
+		}
+		offset = record.end_offset;
+	}
+	return true;
+}
+
+
+TransformHierarchy* createTransformHierarchy(const IScene& scene)
+{
+	return new TransformHierarchyImpl(scene);
+}
+
+
+AnimationSampler* createAnimationSampler(const AnimationLayer& layer)
+{
+	return new AnimationSamplerImpl(layer);
+}
+
+
 const char* getError()
 {
 	return Error::s_message;
@@ -1,4 +1,5 @@
 #pragma once
+#include <atomic>
 
 
 namespace ofbx
@@ -26,11 +27,12 @@ typedef decltype(sizeof(0)) usize;
 using JobFunction = void (*)(void*);
 using JobProcessor = void (*)(JobFunction, void*, void*, u32, u32);
 
-// Ignoring certain nodes will only stop them from being processed not tokenised (i.e. they will still be in the tree)
+// Ignored objects stay in the element tree with their properties, but in binary files their children
+// (curve keys, vertex arrays, video content...) are skipped by the tokenizer and never materialized
 enum class LoadFlags : u16
 {
 	NONE = 0,
-	UNUSED = 1 << 0, // can be reused
+	BORROW_DATA = 1 << 0, // `data` passed to load() is not copied, it must stay valid and unchanged until the scene is destroyed
 	IGNORE_GEOMETRY = 1 << 1,
 	IGNORE_BLEND_SHAPES = 1 << 2,
 	IGNORE_CAMERAS = 1 << 3,
@@ -248,10 +250,18 @@ struct Object
 	const IElement& element;
 	const Object* node_attribute;
 
+	// number of properties with a slot in the property index, see KnownProperty in ofbx.cpp
+	static const int KNOWN_PROPERTY_COUNT = 13;
+
 protected:
 	friend struct Scene;
+	friend struct PropertyIndex;
 	bool is_node;
 	const Scene& scene;
+	// Properties70 children read by the transform getters, found on first use
+	mutable std::atomic<bool> properties_indexed{false};
+	mutable bool properties_p60 = false;
+	mutable const IElement* known_properties[KNOWN_PROPERTY_COUNT] = {};
 };
 
 
@@ -284,6 +294,8 @@ struct Texture : Object
 	virtual DataView getFileName() const = 0;
 	virtual DataView getRelativeFileName() const = 0;
 	virtual DataView getEmbeddedData() const = 0;
+	// base64 text of an embedded texture in text files, encoded in returned property and all ->next properties
+	virtual const IElementProperty* getEmbeddedBase64Data() const = 0;
 };
 
 struct Light : Object
@@ -573,6 +585,7 @@ struct Shape : Object
 	virtual const int* getIndices() const = 0;
 	virtual int getIndexCount() const = 0;
 
+	// one per vertex, null if the shape has none or not as many as vertices
 	virtual const Vec3* getNormals() const = 0;
 };
 
@@ -759,7 +772,74 @@ protected:
 };
 
 
+// Flattened node hierarchy of a scene with cached local and global transforms. Nodes are ordered by depth,
+// so evaluateAll() computes all of them in one linear pass instead of walking the parent chain of every node
+// like Object::getGlobalTransform() does. Later calls only recompute dirty nodes and their descendants, starting
+// from the first dirty node in that order.
+struct TransformHierarchy
+{
+	virtual void destroy() = 0;
+
+	virtual int getNodeCount() const = 0;
+	virtual const Object* getNode(int index) const = 0;
+	// -1 if the object isn't a node
+	virtual int getNodeIndex(const Object& node) const = 0;
+	// parents always come before their children, -1 for the roots
+	virtual int getParentIndex(int index) const = 0;
+
+	// replaces the local transform from the file, e.g. with an animated pose
+	virtual void setLocalTransform(int index, const DVec3& translation, const DVec3& rotation, const DVec3& scaling) = 0;
+	// goes back to the local transform from the file
+	virtual void resetLocalTransform(int index) = 0;
+	// reevaluates the local transform on the next evaluateAll()
+	virtual void markDirty(int index) = 0;
+	virtual void evaluateAll() = 0;
+
+	// valid after evaluateAll()
+	virtual const DMatrix& getLocalTransform(int index) const = 0;
+	virtual const DMatrix& getGlobalTransform(int index) const = 0;
+
+protected:
+	virtual ~TransformHierarchy() {}
+};
+
+
+// Samples all curve nodes of an animation layer at once. Keys of all curves are copied to flat arrays and every
+// curve remembers its last segment, so playing forward doesn't search the keys at all and jumps use a binary search.
+// Not thread safe, use one sampler per playing instance.
+struct AnimationSampler
+{
+	virtual void destroy() = 0;
+
+	virtual int getCurveNodeCount() const = 0;
+	virtual const AnimationCurveNode* getCurveNode(int index) const = 0;
+	// writes getCurveNode(i)->getNodeLocalTransform(time) to out[i] for every curve node
+	virtual void sample(double time, DVec3* out) = 0;
+
+protected:
+	virtual ~AnimationSampler() {}
+};
+
+
+// Thread-safe: different threads can load different files at the same time, and the job processor
+// can be shared by concurrent loads. Returns null on error, see getError().
 IScene* load(const u8* data, usize size, u16 flags, JobProcessor job_processor = nullptr, void* job_user_ptr = nullptr);
+// the hierarchy references the scene objects, destroy it before the scene
+TransformHierarchy* createTransformHierarchy(const IScene& scene);
+// the sampler references the curve nodes of the layer, destroy it before the scene
+AnimationSampler* createAnimationSampler(const AnimationLayer& layer);
+
+// Streaming alternative to load() for huge binary files. Node records are read one at a time through `read`,
+// everything but the mesh geometries is skipped by offset, and each geometry is decoded and passed to `callback`
+// on its own, so memory is bounded by the biggest geometry. There is no scene: objects aren't connected,
+// so models, transforms and materials aren't available. `geometry` and `name` are valid only during the callback,
+// which can return false to stop. Returns false on error, see getError().
+using StreamReadFunction = bool (*)(void* user_ptr, u64 offset, void* buffer, usize size);
+using GeometryStreamCallback = bool (*)(void* user_ptr, u64 id, const char* name, const GeometryData& geometry);
+bool streamGeometries(StreamReadFunction read, void* read_user_ptr, u64 size, u16 flags, GeometryStreamCallback callback, void* callback_user_ptr,
+	JobProcessor job_processor = nullptr, void* job_user_ptr = nullptr);
+// Error of the last load() or streamGeometries() call made by the calling thread, empty if it succeeded.
+// Valid until that thread calls one of them again.
 const char* getError();
 double fbxTimeToSeconds(i64 value);
 i64 secondsToFbxTime(double value);
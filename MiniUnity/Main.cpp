@@ -19,8 +19,31 @@
 #include <sstream>
 #include <string>
 #include <vector>
-
+#include <cstddef>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+#include <cstdio>
+#include <thread>
+#include <random>
+
+#include "Engine/AssetLoader.h"
+#include "Engine/Base64.h"
+#include "Engine/BonePalette.h"
+#include "Engine/CpuSkinner.h"
 #include "Engine/FbxImporter.h"
+#include "Engine/JobSystem.h"
+#include "Engine/MappedFile.h"
+#include "Engine/MeshletCuller.h"
+#include "Engine/MorphWeights.h"
+#include "Engine/ProcessMemory.h"
+#include "Engine/SkeletonPose.h"
+#include "Engine/SyntheticFbx.h"
+#include "Engine/TextureCooker.h"
+#include "Engine/VertexQuantizer.h"
+#include "ExternalCode/OpenFBX/src/libdeflate.h"
+#include "ExternalCode/OpenFBX/src/ofbx.h"
 
 #ifndef GL_SRGB8_ALPHA8
 #define GL_SRGB8_ALPHA8 0x8C43
@@ -29,9 +52,10 @@
 ///Shader Types
 enum class ShaderType { Vertex, Fragment, Geometry, Count };
 ///Standard Uniforms in the shader.
-enum class UniformType { TransformPVM, Count };
+enum class UniformType { TransformPVM, PositionOffset, PositionScale, OctahedralNormals, Skinned, BonePalette, FirstBone,
+    Morphed, MorphStarts, MorphDeltas, MorphWeights, FirstMorphWeight, MorphPositionScale, MorphNormalScale, Count };
 ///Vertex attributes for shaders and the input vertex array.
-enum class VertexAttribute { Position, Normal, TexCoord, Count };
+enum class VertexAttribute { Position, Normal, TexCoord, BoneIndices, BoneWeights, Count };
 
 ///Shader Program
 GLuint program = 0;
@@ -43,12 +67,85 @@ GLint uniform[static_cast<unsigned int>(UniformType::Count)];
 
 ///Vertex Array Object ID.
 GLuint vao = 0;
-///Vertex Buffer Object for Vertices.
-GLuint vertexVBO = 0;
-///Vertex Buffer Object for Indices.
-GLuint indexVBO = 0;
 ///Depending on input, the amount of vertices or indices that are needed to be drawn for this object.
 unsigned int drawCount;
+///The level of detail drawn starts at this index, it's picked every frame from the size of the mesh on screen.
+unsigned int drawFirstIndex = 0;
+///Meshes split into meshlets draw only the ones left after culling, merged into ranges of the index buffer.
+bool drawMeshlets = false;
+MeshletDrawList meshletDraws;
+///Quantized positions are relative to the mesh bounds, the shader maps them back.
+glm::vec3 positionOffset(0.f);
+glm::vec3 positionScale(1.f);
+bool octahedralNormals = false;
+///Skinned meshes read their bones from the palette, starting at firstBone.
+bool skinned = false;
+unsigned int firstBone = 0;
+///Morphed meshes read their target weights starting at firstMorphWeight, the scales map the snorm16 deltas back.
+bool morphed = false;
+unsigned int firstMorphWeight = 0;
+float morphPositionScale = 0.f;
+float morphNormalScale = 0.f;
+
+///Sampler states of the mesh texture, without and with mipmaps.
+GLuint samplers[2] = { 0, 0 };
+
+///Milliseconds of each frame that can be spent uploading loaded assets to the GPU.
+const float UploadBudgetMilliseconds = 2.f;
+///Texture unit the bone palette is bound to, the mesh texture uses the first one.
+const GLint BonePaletteTextureUnit = 1;
+///Pixels the surface of a level of detail may stray from the full mesh before a finer level is drawn.
+const float LodPixelError = 1.f;
+///Texture units of the morph target data of the mesh and of the weights of the frame.
+const GLint MorphStartsTextureUnit = 2;
+const GLint MorphDeltasTextureUnit = 3;
+const GLint MorphWeightsTextureUnit = 4;
+///Seconds between two logs of the meshlet culling figures.
+const float CullStatsSeconds = 5.f;
+///Camera positions the culling benchmark is run from.
+const unsigned int BenchmarkViewCount = 10000;
+///Times each file is loaded by the loading benchmarks, the fastest load is kept.
+const unsigned int BenchmarkLoadCount = 5;
+///Copies of the scene mesh skinned by the skinning benchmark, so the vertices don't fit in the caches.
+const unsigned int BenchmarkSkinCopies = 100;
+///Where the benchmarks write the FBX files they generate, removed once they are done.
+const char* BenchmarkFbxPath = "resources/benchmark.fbx";
+///Flags of the benchmarks calling ofbx::load directly, only the meshes are read like the import of a mesh without skin.
+const ofbx::LoadFlags BenchmarkOfbxFlags = ofbx::LoadFlags::IGNORE_BLEND_SHAPES | ofbx::LoadFlags::IGNORE_CAMERAS | ofbx::LoadFlags::IGNORE_LIGHTS
+    | ofbx::LoadFlags::IGNORE_TEXTURES | ofbx::LoadFlags::IGNORE_SKIN | ofbx::LoadFlags::IGNORE_BONES | ofbx::LoadFlags::IGNORE_PIVOTS
+    | ofbx::LoadFlags::IGNORE_MATERIALS | ofbx::LoadFlags::IGNORE_POSES | ofbx::LoadFlags::IGNORE_VIDEOS | ofbx::LoadFlags::IGNORE_LIMBS
+    | ofbx::LoadFlags::IGNORE_ANIMATIONS;
+///Flags of the benchmarks on generated rigs, which also read the skin, the bones and their animation.
+const ofbx::LoadFlags BenchmarkRigFlags = ofbx::LoadFlags::IGNORE_BLEND_SHAPES | ofbx::LoadFlags::IGNORE_CAMERAS | ofbx::LoadFlags::IGNORE_LIGHTS
+    | ofbx::LoadFlags::IGNORE_TEXTURES | ofbx::LoadFlags::IGNORE_PIVOTS | ofbx::LoadFlags::IGNORE_MATERIALS | ofbx::LoadFlags::IGNORE_POSES
+    | ofbx::LoadFlags::IGNORE_VIDEOS;
+
+///The import settings of the scene mesh, shared by the application and the benchmark.
+FbxImportSettings getImportSettings()
+{
+    FbxImportSettings importSettings;
+    importSettings.weldVertices = true;
+    importSettings.optimizeVertexCache = true;
+    importSettings.optimizeOverdraw = true;
+    importSettings.useMeshCache = true;
+    importSettings.quantizeVertices = true;
+    importSettings.importSkin = true;
+    importSettings.importBlendShapes = true;
+    importSettings.lodCount = 3;
+    importSettings.buildMeshlets = true;
+    return importSettings;
+}
+
+///The cook settings of the textures of the scene, opaque ones are compressed.
+TextureCookSettings getTextureSettings()
+{
+    TextureCookSettings cookSettings;
+    cookSettings.mipFilter = MipFilter::Kaiser;
+    // Without S3TC support AssetLoader uploads the decoded BC1 levels, the settings are needed before the context exists.
+    cookSettings.compress = true;
+    cookSettings.useTextureCache = true;
+    return cookSettings;
+}
 
 ///Checks for any errors specific to the shaders. It will output any errors within the shader if it's not valid.
 void checkError(GLuint l_shader, GLuint l_flag, bool l_program, const std::string& l_errorMsg)
@@ -87,6 +184,17 @@ GLuint buildShader(const std::string& l_src, unsigned int l_type)
     return shaderID;
 }
 
+///Binds the vertex attributes and the fragment output to the locations the vertex arrays and the draw buffer use, before linking.
+void bindProgramLocations(GLuint l_program)
+{
+    glBindAttribLocation(l_program, static_cast<GLuint>(VertexAttribute::Position), "position");
+    glBindAttribLocation(l_program, static_cast<GLuint>(VertexAttribute::Normal), "normal");
+    glBindAttribLocation(l_program, static_cast<GLuint>(VertexAttribute::TexCoord), "texCoord");
+    glBindAttribLocation(l_program, static_cast<GLuint>(VertexAttribute::BoneIndices), "boneIndices");
+    glBindAttribLocation(l_program, static_cast<GLuint>(VertexAttribute::BoneWeights), "boneWeights");
+    glBindFragDataLocation(l_program, 0, "fragColor");
+}
+
 ///Function to load the shaders from string data.
 void LoadFromMemory(const std::string& shaderData, ShaderType type)
 {
@@ -120,9 +228,7 @@ void LoadFromMemory(const std::string& shaderData, ShaderType type)
     }
 
     glAttachShader(program, shader[static_cast<unsigned int>(type)]);
-    glBindAttribLocation(program, static_cast<GLuint>(VertexAttribute::Position), "position");
-    glBindAttribLocation(program, static_cast<GLuint>(VertexAttribute::Normal), "normal");
-    glBindAttribLocation(program, static_cast<GLuint>(VertexAttribute::TexCoord), "texCoord");
+    bindProgramLocations(program);
 
     glLinkProgram(program);
     checkError(program, GL_LINK_STATUS, true, "Shader link error:");
@@ -130,35 +236,1245 @@ void LoadFromMemory(const std::string& shaderData, ShaderType type)
     checkError(program, GL_VALIDATE_STATUS, true, "Invalid shader:");
 
     uniform[static_cast<unsigned int>(UniformType::TransformPVM)] = glGetUniformLocation(program, "pvm");
+    uniform[static_cast<unsigned int>(UniformType::PositionOffset)] = glGetUniformLocation(program, "positionOffset");
+    uniform[static_cast<unsigned int>(UniformType::PositionScale)] = glGetUniformLocation(program, "positionScale");
+    uniform[static_cast<unsigned int>(UniformType::OctahedralNormals)] = glGetUniformLocation(program, "octahedralNormals");
+    uniform[static_cast<unsigned int>(UniformType::Skinned)] = glGetUniformLocation(program, "skinned");
+    uniform[static_cast<unsigned int>(UniformType::BonePalette)] = glGetUniformLocation(program, "bonePalette");
+    uniform[static_cast<unsigned int>(UniformType::FirstBone)] = glGetUniformLocation(program, "firstBone");
+    uniform[static_cast<unsigned int>(UniformType::Morphed)] = glGetUniformLocation(program, "morphed");
+    uniform[static_cast<unsigned int>(UniformType::MorphStarts)] = glGetUniformLocation(program, "morphStarts");
+    uniform[static_cast<unsigned int>(UniformType::MorphDeltas)] = glGetUniformLocation(program, "morphDeltas");
+    uniform[static_cast<unsigned int>(UniformType::MorphWeights)] = glGetUniformLocation(program, "morphWeights");
+    uniform[static_cast<unsigned int>(UniformType::FirstMorphWeight)] = glGetUniformLocation(program, "firstMorphWeight");
+    uniform[static_cast<unsigned int>(UniformType::MorphPositionScale)] = glGetUniformLocation(program, "morphPositionScale");
+    uniform[static_cast<unsigned int>(UniformType::MorphNormalScale)] = glGetUniformLocation(program, "morphNormalScale");
+}
+
+///Creates the Vertex Array Object pointing each attribute to the buffers of an uploaded mesh.
+GLuint createVertexArray(const AssetLoader& l_assets, AssetLoader::Handle l_mesh)
+{
+    const bool quantized = !l_assets.GetMesh(l_mesh).quantizedVertices.empty();
+
+    GLuint vertexArray = 0;
+    glGenVertexArrays(1, &vertexArray);
+    glBindVertexArray(vertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, l_assets.GetVertexBuffer(l_mesh));
+    glEnableVertexAttribArray(static_cast<GLuint>(VertexAttribute::Position));
+    glEnableVertexAttribArray(static_cast<GLuint>(VertexAttribute::Normal));
+    glEnableVertexAttribArray(static_cast<GLuint>(VertexAttribute::TexCoord));
+    if (quantized)
+    {
+        // unorm16 position, octahedral snorm16 normal and half float texture coordinate.
+        auto stride = sizeof(QuantizedVertex);
+        glVertexAttribPointer(static_cast<GLuint>(VertexAttribute::Position), 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)offsetof(QuantizedVertex, position));
+        glVertexAttribPointer(static_cast<GLuint>(VertexAttribute::Normal), 2, GL_SHORT, GL_TRUE, stride, (void*)offsetof(QuantizedVertex, normal));
+        glVertexAttribPointer(static_cast<GLuint>(VertexAttribute::TexCoord), 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offsetof(QuantizedVertex, texCoord));
+    }
+    else
+    {
+        // Stride is the number of bytes per array element.
+        auto stride = sizeof(GLfloat) * 8;
+        // Data offset for normals in bytes.
+        auto normalOffset = sizeof(GLfloat) * 3;
+        // Data offset for texture coordinate in bytes.
+        auto textureCoordOffset = sizeof(GLfloat) * 6;
+
+        glVertexAttribPointer(static_cast<GLuint>(VertexAttribute::Position), 3, GL_FLOAT, GL_FALSE, stride, 0);
+        glVertexAttribPointer(static_cast<GLuint>(VertexAttribute::Normal), 3, GL_FLOAT, GL_FALSE, stride, (void*)normalOffset);
+        glVertexAttribPointer(static_cast<GLuint>(VertexAttribute::TexCoord), 2, GL_FLOAT, GL_FALSE, stride, (void*)textureCoordOffset);
+    }
+    if (l_assets.GetMesh(l_mesh).IsSkinned())
+    {
+        // The skin vertices follow the vertices in the same buffer: byte bone indices and unorm16 weights.
+        auto stride = sizeof(SkinVertex);
+        auto skinOffset = l_assets.GetSkinVertexOffset(l_mesh);
+        glEnableVertexAttribArray(static_cast<GLuint>(VertexAttribute::BoneIndices));
+        glEnableVertexAttribArray(static_cast<GLuint>(VertexAttribute::BoneWeights));
+        glVertexAttribPointer(static_cast<GLuint>(VertexAttribute::BoneIndices), 4, GL_UNSIGNED_BYTE, GL_FALSE, stride, (void*)(skinOffset + offsetof(SkinVertex, boneIndices)));
+        glVertexAttribPointer(static_cast<GLuint>(VertexAttribute::BoneWeights), 4, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)(skinOffset + offsetof(SkinVertex, boneWeights)));
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, l_assets.GetIndexBuffer(l_mesh));
+
+    //Make sure to bind the vertex array to null if you wish to define more objects.
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return vertexArray;
+}
+
+///Logs what the import of a mesh did.
+void logMeshStats(const AssetLoader& l_assets, AssetLoader::Handle l_mesh, bool l_quantized)
+{
+    const std::string& path = l_assets.GetPath(l_mesh);
+    const FbxImportStats& importStats = l_assets.GetMeshStats(l_mesh);
+    std::cout << path << ": " << importStats.sourceVertexCount << " -> " << importStats.outputVertexCount
+        << " vertices after welding (" << importStats.GetVertexReductionRatio() << "x)\n";
+    std::cout << path << ": ACMR " << importStats.cacheStatsBefore.acmr << " -> " << importStats.cacheStatsAfter.acmr
+        << ", ATVR " << importStats.cacheStatsBefore.atvr << " -> " << importStats.cacheStatsAfter.atvr << "\n";
+    if (l_quantized)
+        std::cout << path << ": " << sizeof(GLfloat) * ImportedMesh::VertexSize << " -> " << sizeof(QuantizedVertex) << " bytes per vertex, max error position "
+            << importStats.quantizationError.position << ", normal " << importStats.quantizationError.normalDegrees << " deg, uv " << importStats.quantizationError.texCoord << "\n";
+    if (importStats.boneCount > 0)
+        std::cout << path << ": " << importStats.boneCount << " bones, " << sizeof(SkinVertex) << " skin bytes per vertex\n";
+    if (importStats.morphTargetCount > 0)
+    {
+        // Dense targets would store a position and a normal delta for every vertex of every target.
+        const size_t sparseBytes = (importStats.outputVertexCount + 1) * sizeof(uint32_t) + importStats.morphDeltaCount * sizeof(MorphDelta);
+        const size_t denseBytes = (size_t)importStats.morphTargetCount * importStats.outputVertexCount * sizeof(GLfloat) * 6;
+        std::cout << path << ": " << importStats.morphTargetCount << " morph targets, " << importStats.morphDeltaCount << " deltas, "
+            << sparseBytes / 1024 << " KB instead of " << denseBytes / 1024 << " KB dense\n";
+    }
+    if (importStats.lodCount > 1)
+    {
+        std::cout << path << ": levels of detail";
+        for (const MeshLod& lod : l_assets.GetMesh(l_mesh).lods)
+            std::cout << " " << lod.indexCount / 3 << " (" << lod.error << ")";
+        std::cout << " triangles (error)\n";
+    }
+    if (importStats.meshletCount > 0)
+        std::cout << path << ": " << importStats.meshletCount << " meshlets over all levels\n";
+    std::cout << path << ": " << (importStats.loadedFromCache ? "loaded from cache" : "parsed") << " in " << importStats.parseMilliseconds << " ms\n";
+}
+
+///The first diffuse texture of the FBX file once it's uploaded, otherwise the fallback texture when it's ready, 0 until then.
+GLuint getMeshTexture(const AssetLoader& l_assets, AssetLoader::Handle l_fbxTextures, AssetLoader::Handle l_fallback)
+{
+    if (l_assets.IsReady(l_fbxTextures))
+    {
+        const std::vector<ImportedTexture>& textures = l_assets.GetFbxTextures(l_fbxTextures);
+        for (size_t i = 0; i < textures.size(); ++i)
+        {
+            if (textures[i].usage == ImportedTexture::Usage::Diffuse)
+                return l_assets.GetTexture(l_fbxTextures, (unsigned int)i);
+        }
+    }
+    return l_assets.IsReady(l_fallback) ? l_assets.GetTexture(l_fallback) : 0;
+}
+
+///Logs what the extraction of the textures of an FBX file found.
+void logTextureStats(const AssetLoader& l_assets, AssetLoader::Handle l_textures)
+{
+    const std::string& path = l_assets.GetPath(l_textures);
+    const TextureImportStats& stats = l_assets.GetTextureStats(l_textures);
+    std::cout << path << ": " << stats.embeddedCount << " embedded, " << stats.referencedCount << " referenced, "
+        << stats.missingCount << " missing textures in " << stats.importMilliseconds << " ms\n";
+    if (stats.base64Bytes > 0)
+        std::cout << path << ": " << stats.base64Bytes / 1024 << " KB of base64 decoded with " << Base64::GetKernelName(Base64::GetBestKernel())
+            << " in " << stats.base64Milliseconds << " ms\n";
+    for (const ImportedTexture& texture : l_assets.GetFbxTextures(l_textures))
+        std::cout << path << ": texture " << texture.path << " of " << texture.materialName << (texture.embedded ? ", embedded\n" : "\n");
 }
 
-std::string loadShaderFromFile(const std::string& filePath)
+///Logs what loading a texture took and what its cooked mip chain takes on the GPU, against the RGBA8 texture with mipmaps generated by the driver.
+void logTextureCookStats(const AssetLoader& l_assets, AssetLoader::Handle l_texture)
 {
-    std::ifstream shaderFile(filePath);
-    if (!shaderFile.is_open())
+    const std::string& path = l_assets.GetPath(l_texture);
+    const TextureCookStats& stats = l_assets.GetTextureCookStats(l_texture);
+    std::cout << path << ": " << stats.cookedBytes / 1024 << " KB of VRAM cooked, " << stats.uncookedBytes / 1024 << " KB uncooked\n";
+    std::cout << path << ": " << (stats.loadedFromCache ? "loaded from the cooked file" : "cooked") << " in " << l_assets.GetLoadMilliseconds(l_texture) << " ms";
+    if (!stats.loadedFromCache)
+        std::cout << ", " << stats.decodeMilliseconds << " ms decoding and " << stats.cookMilliseconds << " ms cooking with "
+            << TextureCooker::GetKernelName(TextureCooker::GetBestKernel());
+    std::cout << "\n";
+}
+
+///Logs what baking the animation stacks into clips took, each clip against the OpenFBX curves it comes from.
+void logAnimationStats(const AssetLoader& l_assets, AssetLoader::Handle l_animations)
+{
+    const std::string& path = l_assets.GetPath(l_animations);
+    const AnimationImportStats& stats = l_assets.GetAnimationStats(l_animations);
+    for (const AnimationClip& clip : l_assets.GetAnimations(l_animations))
     {
-        std::cerr << "Failed to open shader file: " << filePath << std::endl;
-        return "";
+        const size_t clipBytes = clip.GetMemorySize();
+        std::cout << path << ": clip " << clip.name << ", " << clip.GetTrackCount() << " tracks, " << clipBytes << " bytes baked, "
+            << clip.sourceCurveBytes << " bytes of curves (" << (clipBytes ? (float)clip.sourceCurveBytes / clipBytes : 1.f) << "x)\n";
+    }
+    std::cout << path << ": " << stats.clipBytes << " bytes baked, " << stats.sourceCurveBytes << " bytes of curves ("
+        << stats.GetCompressionRatio() << "x), " << (stats.loadedFromCache ? "loaded from cache" : "imported") << " in " << stats.importMilliseconds << " ms\n";
+    if (!stats.loadedFromCache)
+        std::cout << path << ": max error translation " << stats.compressionError.translation << ", rotation " << stats.compressionError.rotationDegrees
+            << " deg, scale " << stats.compressionError.scale << "\n";
+}
+
+///Culls the meshlets of every level of detail of the scene mesh from cameras orbiting it at random, without opening a window.
+int benchmarkCulling()
+{
+    ImportedMesh mesh;
+    FbxImportStats importStats;
+    std::string error;
+    if (!FbxImporter::ImportFBX("resources/Kleo.fbx", mesh, getImportSettings(), &importStats, &error))
+    {
+        std::cerr << "Cannot benchmark culling: " << error << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Skinned meshlets are culled in the bind pose, their bounds still go through the palette.
+    std::unique_ptr<SkeletonPose> skeletonPose;
+    if (mesh.IsSkinned())
+    {
+        skeletonPose.reset(new SkeletonPose(mesh.skeleton, nullptr));
+        skeletonPose->Evaluate(0.f);
+    }
+    const float* palette = skeletonPose ? skeletonPose->GetPalette() : nullptr;
+    const unsigned int boneCount = skeletonPose ? skeletonPose->GetBoneCount() : 0;
+
+    const glm::vec3 boundsMin(mesh.boundsMin[0], mesh.boundsMin[1], mesh.boundsMin[2]);
+    const glm::vec3 boundsMax(mesh.boundsMax[0], mesh.boundsMax[1], mesh.boundsMax[2]);
+    const glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    const float extent = glm::length(boundsMax - boundsMin);
+    const glm::mat4 projection = glm::perspective(0.8f, 16.f / 9.f, extent * 0.01f, extent * 100.f);
+
+    // Every level sees the same cameras, from close enough to leave parts of the mesh out of the frustum to far away.
+    std::vector<glm::mat4> views(BenchmarkViewCount);
+    std::vector<glm::vec3> cameras(BenchmarkViewCount);
+    unsigned int seed = 1;
+    auto random = [&seed]() { seed = seed * 1664525u + 1013904223u; return (seed >> 8) / 16777216.f; };
+    for (unsigned int i = 0; i < BenchmarkViewCount; i++)
+    {
+        const float yaw = random() * 6.2831853f;
+        const float pitch = (random() - 0.5f) * 3.f;
+        const float distance = extent * (0.3f + random() * 2.f);
+        cameras[i] = center + distance * glm::vec3(std::cos(pitch) * std::sin(yaw), std::sin(pitch), std::cos(pitch) * std::cos(yaw));
+        const glm::vec3 target = center + (glm::vec3(random(), random(), random()) - 0.5f) * extent * 0.3f;
+        views[i] = projection * glm::lookAt(cameras[i], target, glm::vec3(0.f, 1.f, 0.f));
+    }
+
+    std::cout << "Culling " << mesh.meshlets.size() << " meshlets from " << BenchmarkViewCount << " views\n";
+    MeshletDrawList drawList;
+    for (size_t level = 0; level < mesh.lods.size(); level++)
+    {
+        const MeshLod& lod = mesh.lods[level];
+        MeshletCullStats total;
+        float seconds = 0.f;
+        for (unsigned int i = 0; i < BenchmarkViewCount; i++)
+        {
+            MeshletCullStats stats;
+            const MeshletCuller::View view = MeshletCuller::MakeView(&views[i][0][0], &cameras[i][0]);
+            sf::Clock cullClock;
+            MeshletCuller::Cull(mesh.meshlets.data() + lod.firstMeshlet, lod.meshletCount, view, palette, boneCount, drawList, &stats);
+            seconds += cullClock.getElapsedTime().asSeconds();
+            total.meshletCount += stats.meshletCount;
+            total.frustumCulled += stats.frustumCulled;
+            total.backfaceCulled += stats.backfaceCulled;
+            total.triangleCount += stats.triangleCount;
+            total.trianglesCulled += stats.trianglesCulled;
+            total.drawCount += stats.drawCount;
+        }
+        std::cout << "Level " << level << ": " << lod.meshletCount << " meshlets, " << seconds * 1e6f / BenchmarkViewCount << " us per view, "
+            << 100.f * total.trianglesCulled / std::max(total.triangleCount, 1u) << "% triangles culled, meshlets culled "
+            << 100.f * total.frustumCulled / std::max(total.meshletCount, 1u) << "% by the frustum and "
+            << 100.f * total.backfaceCulled / std::max(total.meshletCount, 1u) << "% as back facing, "
+            << (float)total.drawCount / BenchmarkViewCount << " draws per view\n";
     }
+    return EXIT_SUCCESS;
+}
 
-    std::stringstream shaderData;
-    shaderData << shaderFile.rdbuf();
-    shaderFile.close();
+///Loads the scene FBX and a generated one of 170 MB with ofbx::load, reading the file into memory for OpenFBX to copy it like the importer used to,
+///then borrowing a read-only mapping of it, and compares the time and the memory held once the scene is loaded.
+int benchmarkLoading()
+{
+    SyntheticFbxSettings largeSettings;
+    largeSettings.gridSize = 1000;
+    if (SyntheticFbx::Write(BenchmarkFbxPath, largeSettings) == 0)
+    {
+        std::cerr << "Cannot benchmark loading: failed to write " << BenchmarkFbxPath << std::endl;
+        return EXIT_FAILURE;
+    }
 
-    return shaderData.str();
+    bool loaded = true;
+    for (const char* path : { "resources/Kleo.fbx", BenchmarkFbxPath })
+    {
+        for (bool mapped : { false, true })
+        {
+            float bestMilliseconds = 0.f;
+            size_t heldBytes = 0;
+            // The first load only warms up the file cache and the heap.
+            for (unsigned int i = 0; i <= BenchmarkLoadCount && loaded; i++)
+            {
+                const size_t residentBefore = ProcessMemory::GetResidentSize();
+                sf::Clock loadClock;
+                std::unique_ptr<ofbx::u8[]> content;
+                MappedFile file;
+                ofbx::IScene* scene = nullptr;
+                if (mapped)
+                {
+                    if (file.Open(path))
+                        scene = ofbx::load(file.GetData(), file.GetSize(), (ofbx::u16)(BenchmarkOfbxFlags | ofbx::LoadFlags::BORROW_DATA), &JobSystem::OfbxJobProcessor);
+                }
+                else
+                {
+                    std::ifstream stream(path, std::ios::binary | std::ios::ate);
+                    const size_t size = stream ? (size_t)stream.tellg() : 0;
+                    content.reset(new ofbx::u8[size]);
+                    stream.seekg(0);
+                    if (size > 0 && stream.read((char*)content.get(), size))
+                        scene = ofbx::load(content.get(), size, (ofbx::u16)BenchmarkOfbxFlags, &JobSystem::OfbxJobProcessor);
+                }
+                const float milliseconds = loadClock.getElapsedTime().asSeconds() * 1000.f;
+                const size_t residentAfter = ProcessMemory::GetResidentSize();
+                if (!scene)
+                {
+                    std::cerr << "Cannot benchmark loading " << path << ": " << ofbx::getError() << std::endl;
+                    loaded = false;
+                    break;
+                }
+                scene->destroy();
+                if (i == 0)
+                    continue;
+                bestMilliseconds = i == 1 ? milliseconds : std::min(bestMilliseconds, milliseconds);
+                heldBytes = std::max(heldBytes, residentAfter > residentBefore ? residentAfter - residentBefore : 0);
+            }
+            if (loaded)
+                std::cout << path << ": " << (mapped ? "mapped and borrowed" : "read and copied") << " in " << bestMilliseconds << " ms, "
+                    << heldBytes / (1024.f * 1024.f) << " MB more resident once loaded\n";
+        }
+    }
+    std::remove(BenchmarkFbxPath);
+    return loaded ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+///Imports the scene FBX and a generated one of 8 meshes with the data arrays decoded on 1 to all the JobSystem threads,
+///then with parallelParsing off like before the job system, and compares the parse times.
+int benchmarkParsing()
+{
+    SyntheticFbxSettings gridsSettings;
+    gridsSettings.meshCount = 8;
+    gridsSettings.gridSize = 300;
+    if (SyntheticFbx::Write(BenchmarkFbxPath, gridsSettings) == 0)
+    {
+        std::cerr << "Cannot benchmark parsing: failed to write " << BenchmarkFbxPath << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const unsigned int defaultWorkerCount = JobSystem::GetWorkerCount();
+    const unsigned int maxWorkerCount = std::max(1u, std::thread::hardware_concurrency() - 1);
+    bool imported = true;
+    for (const char* path : { "resources/Kleo.fbx", BenchmarkFbxPath })
+    {
+        // 0 workers with parallelParsing off, then the dispatching thread helped by 0, 1, 2, 4... workers
+        for (unsigned int workerCount = 0; imported && workerCount <= maxWorkerCount; workerCount = workerCount ? workerCount * 2 : 1)
+        {
+            for (bool parallel : { false, true })
+            {
+                if (!parallel && workerCount > 0)
+                    continue;
+                JobSystem::SetWorkerCount(workerCount);
+                FbxImportSettings settings;
+                settings.parallelParsing = parallel;
+                float bestMilliseconds = 0.f;
+                for (unsigned int i = 0; i <= BenchmarkLoadCount; i++)
+                {
+                    ImportedMesh mesh;
+                    FbxImportStats stats;
+                    std::string error;
+                    if (!FbxImporter::ImportFBX(path, mesh, settings, &stats, &error))
+                    {
+                        std::cerr << "Cannot benchmark parsing " << path << ": " << error << std::endl;
+                        imported = false;
+                        break;
+                    }
+                    if (i > 0)
+                        bestMilliseconds = i == 1 ? stats.parseMilliseconds : std::min(bestMilliseconds, stats.parseMilliseconds);
+                }
+                if (!imported)
+                    break;
+                if (parallel)
+                    std::cout << path << ": parsed on " << workerCount + 1 << (workerCount > 0 ? " threads in " : " thread in ") << bestMilliseconds << " ms\n";
+                else
+                    std::cout << path << ": parsed without jobs in " << bestMilliseconds << " ms\n";
+            }
+        }
+    }
+    JobSystem::SetWorkerCount(defaultWorkerCount);
+    std::remove(BenchmarkFbxPath);
+    return imported ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+///Gathers the deflated array properties below l_element, each value starts with the count, encoding and compressed size of the array.
+void gatherDeflatedArrays(const ofbx::IElement* l_element, std::vector<ofbx::DataView>& l_arrays)
+{
+    for (const ofbx::IElement* child = l_element->getFirstChild(); child; child = child->getSibling())
+    {
+        for (const ofbx::IElementProperty* property = child->getFirstProperty(); property; property = property->getNext())
+        {
+            const ofbx::IElementProperty::Type type = property->getType();
+            const bool isArray = type == ofbx::IElementProperty::ARRAY_DOUBLE || type == ofbx::IElementProperty::ARRAY_FLOAT
+                || type == ofbx::IElementProperty::ARRAY_INT || type == ofbx::IElementProperty::ARRAY_LONG;
+            const ofbx::DataView value = property->getValue();
+            uint32_t encoding = 0;
+            if (isArray && value.is_binary)
+                std::memcpy(&encoding, value.begin + 4, sizeof(encoding));
+            if (encoding == 1)
+                l_arrays.push_back(value);
+        }
+        gatherDeflatedArrays(child, l_arrays);
+    }
+}
+
+///Loads a generated FBX of 5000 small meshes whose arrays are all deflated, then inflates its arrays again with a libdeflate
+///decompressor allocated for each like OpenFBX used to, and with a single one like each thread now reuses.
+int benchmarkDecompression()
+{
+    SyntheticFbxSettings smallSettings;
+    smallSettings.meshCount = 5000;
+    smallSettings.gridSize = 4;
+    smallSettings.compressArrays = true;
+    MappedFile file;
+    if (SyntheticFbx::Write(BenchmarkFbxPath, smallSettings) == 0 || !file.Open(BenchmarkFbxPath))
+    {
+        std::cerr << "Cannot benchmark decompression: failed to write " << BenchmarkFbxPath << std::endl;
+        std::remove(BenchmarkFbxPath);
+        return EXIT_FAILURE;
+    }
+
+    float loadMilliseconds = 0.f;
+    float bestMilliseconds[2] = {};
+    std::vector<ofbx::DataView> arrays;
+    std::vector<ofbx::u8> decompressed;
+    bool inflated = true;
+    for (unsigned int i = 0; i <= BenchmarkLoadCount && inflated; i++)
+    {
+        sf::Clock loadClock;
+        ofbx::IScene* scene = ofbx::load(file.GetData(), file.GetSize(), (ofbx::u16)(BenchmarkOfbxFlags | ofbx::LoadFlags::BORROW_DATA),
+            &JobSystem::OfbxJobProcessor);
+        const float milliseconds = loadClock.getElapsedTime().asSeconds() * 1000.f;
+        if (!scene)
+        {
+            std::cerr << "Cannot benchmark decompression: " << ofbx::getError() << std::endl;
+            inflated = false;
+            break;
+        }
+        if (i == 0)
+            gatherDeflatedArrays(scene->getRootElement(), arrays);
+        else
+            loadMilliseconds = i == 1 ? milliseconds : std::min(loadMilliseconds, milliseconds);
+
+        // The arrays are borrowed from the mapping, they stay valid after the scene is gone.
+        scene->destroy();
+        for (int reused = 0; reused < 2 && inflated; reused++)
+        {
+            sf::Clock inflateClock;
+            libdeflate_decompressor* decompressor = reused ? libdeflate_alloc_decompressor() : nullptr;
+            for (const ofbx::DataView& array : arrays)
+            {
+                // 8 byte elements would be the largest, the zlib header is skipped like OpenFBX does
+                uint32_t header[3];
+                std::memcpy(header, array.begin, sizeof(header));
+                decompressed.resize((size_t)header[0] * 8);
+                if (!reused)
+                    decompressor = libdeflate_alloc_decompressor();
+                size_t decompressedSize = 0;
+                inflated = inflated && libdeflate_deflate_decompress(decompressor, array.begin + sizeof(header) + 2, header[2] - 2,
+                    decompressed.data(), decompressed.size(), &decompressedSize) == LIBDEFLATE_SUCCESS;
+                if (!reused)
+                    libdeflate_free_decompressor(decompressor);
+            }
+            if (reused)
+                libdeflate_free_decompressor(decompressor);
+            const float inflateMilliseconds = inflateClock.getElapsedTime().asSeconds() * 1000.f;
+            if (i > 0)
+                bestMilliseconds[reused] = i == 1 ? inflateMilliseconds : std::min(bestMilliseconds[reused], inflateMilliseconds);
+        }
+        if (!inflated)
+            std::cerr << "Cannot benchmark decompression: an array failed to inflate" << std::endl;
+    }
+    if (inflated)
+        std::cout << arrays.size() << " deflated arrays loaded in " << loadMilliseconds << " ms, inflated in " << bestMilliseconds[0]
+            << " ms with a decompressor per array and " << bestMilliseconds[1] << " ms with one for all\n";
+    file.Close();
+    std::remove(BenchmarkFbxPath);
+    return inflated ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+///Gathers the double array properties below l_element.
+void gatherDoubleArrays(const ofbx::IElement* l_element, std::vector<const ofbx::IElementProperty*>& l_arrays)
+{
+    for (const ofbx::IElement* child = l_element->getFirstChild(); child; child = child->getSibling())
+    {
+        for (const ofbx::IElementProperty* property = child->getFirstProperty(); property; property = property->getNext())
+            if (property->getType() == ofbx::IElementProperty::ARRAY_DOUBLE)
+                l_arrays.push_back(property);
+        gatherDoubleArrays(child, l_arrays);
+    }
+}
+
+///Loads a generated FBX of 1M vertices whose positions, normals and uvs are doubles, raw then deflated, on a single thread
+///so the time is the one of decoding the arrays. OpenFBX converts them straight to floats, the same arrays are then converted
+///through a temporary double vector like it used to, built against the ofbx.cpp of before the change the load times compare too.
+int benchmarkConversion()
+{
+    bool converted = true;
+    for (bool compressed : { false, true })
+    {
+        SyntheticFbxSettings largeSettings;
+        largeSettings.gridSize = 1000;
+        largeSettings.compressArrays = compressed;
+        MappedFile file;
+        if (SyntheticFbx::Write(BenchmarkFbxPath, largeSettings) == 0 || !file.Open(BenchmarkFbxPath))
+        {
+            std::cerr << "Cannot benchmark conversion: failed to write " << BenchmarkFbxPath << std::endl;
+            converted = false;
+            break;
+        }
+
+        float loadMilliseconds = 0.f;
+        float temporaryMilliseconds = 0.f;
+        size_t valueCount = 0;
+        for (unsigned int i = 0; i <= BenchmarkLoadCount && converted; i++)
+        {
+            sf::Clock loadClock;
+            ofbx::IScene* scene = ofbx::load(file.GetData(), file.GetSize(), (ofbx::u16)(BenchmarkOfbxFlags | ofbx::LoadFlags::BORROW_DATA));
+            const float milliseconds = loadClock.getElapsedTime().asSeconds() * 1000.f;
+            if (!scene)
+            {
+                std::cerr << "Cannot benchmark conversion: " << ofbx::getError() << std::endl;
+                converted = false;
+                break;
+            }
+            std::vector<const ofbx::IElementProperty*> arrays;
+            gatherDoubleArrays(scene->getRootElement(), arrays);
+
+            sf::Clock temporaryClock;
+            valueCount = 0;
+            for (const ofbx::IElementProperty* array : arrays)
+            {
+                const int count = array->getCount();
+                std::vector<double> values(count);
+                std::vector<float> floats(count);
+                converted = converted && array->getValues(values.data(), count * (int)sizeof(double));
+                for (int value = 0; value < count; value++)
+                    floats[value] = (float)values[value];
+                valueCount += count;
+            }
+            const float temporary = temporaryClock.getElapsedTime().asSeconds() * 1000.f;
+            scene->destroy();
+            if (i == 0)
+                continue;
+            loadMilliseconds = i == 1 ? milliseconds : std::min(loadMilliseconds, milliseconds);
+            temporaryMilliseconds = i == 1 ? temporary : std::min(temporaryMilliseconds, temporary);
+        }
+        file.Close();
+        std::remove(BenchmarkFbxPath);
+        if (!converted)
+            break;
+        std::cout << valueCount << (compressed ? " deflated" : " raw") << " doubles loaded in " << loadMilliseconds
+            << " ms, converted through a temporary vector in " << temporaryMilliseconds << " ms\n";
+    }
+    if (!converted)
+        std::cerr << "Cannot benchmark conversion: an array failed to decode" << std::endl;
+    return converted ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+///Skins copies of the scene mesh in its first animation pose with each CpuSkinner kernel the CPU supports on one thread,
+///then with SkinParallel on 1 to all the JobSystem threads, and compares the times.
+int benchmarkSkinning()
+{
+    ImportedMesh mesh;
+    std::string error;
+    if (!FbxImporter::ImportFBX("resources/Kleo.fbx", mesh, getImportSettings(), nullptr, &error) || !mesh.IsSkinned())
+    {
+        std::cerr << "Cannot benchmark skinning: " << (error.empty() ? "the mesh has no skin" : error.c_str()) << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::vector<AnimationClip> clips;
+    FbxImporter::ImportAnimations("resources/Kleo.fbx", clips);
+    SkeletonPose skeletonPose(mesh.skeleton, clips.empty() ? nullptr : &clips[0]);
+    skeletonPose.Evaluate(0.f);
+    const unsigned int boneCount = skeletonPose.GetBoneCount();
+    std::vector<float> bones(boneCount * CpuSkinner::BoneElements);
+    CpuSkinner::TransposePalette(skeletonPose.GetPalette(), boneCount, bones.data());
+
+    const unsigned int vertexCount = mesh.GetVertexCount() * BenchmarkSkinCopies;
+    std::vector<float> vertices;
+    std::vector<SkinVertex> skinVertices;
+    vertices.reserve((size_t)vertexCount * ImportedMesh::VertexSize);
+    skinVertices.reserve(vertexCount);
+    for (unsigned int i = 0; i < BenchmarkSkinCopies; i++)
+    {
+        vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+        skinVertices.insert(skinVertices.end(), mesh.skinVertices.begin(), mesh.skinVertices.end());
+    }
+    std::vector<float> skinned(vertices.size());
+    std::vector<float> scalarSkinned(vertices.size());
+    CpuSkinner::Skin(vertices.data(), skinVertices.data(), vertexCount, bones.data(), boneCount, scalarSkinned.data(), CpuSkinner::Kernel::Scalar);
+
+    // the best of a few runs, the first one warms the caches up
+    auto timeSkinning = [&](CpuSkinner::Kernel l_kernel, bool l_parallel) {
+        float bestMilliseconds = 0.f;
+        for (unsigned int i = 0; i <= BenchmarkLoadCount; i++)
+        {
+            sf::Clock skinClock;
+            if (l_parallel)
+                CpuSkinner::SkinParallel(vertices.data(), skinVertices.data(), vertexCount, bones.data(), boneCount, skinned.data(), l_kernel);
+            else
+                CpuSkinner::Skin(vertices.data(), skinVertices.data(), vertexCount, bones.data(), boneCount, skinned.data(), l_kernel);
+            const float milliseconds = skinClock.getElapsedTime().asSeconds() * 1000.f;
+            if (i > 0)
+                bestMilliseconds = i == 1 ? milliseconds : std::min(bestMilliseconds, milliseconds);
+        }
+        return bestMilliseconds;
+    };
+
+    std::cout << vertexCount << " vertices, " << boneCount << " bones\n";
+    for (CpuSkinner::Kernel kernel : { CpuSkinner::Kernel::Scalar, CpuSkinner::Kernel::SSE, CpuSkinner::Kernel::AVX2 })
+    {
+        if (!CpuSkinner::IsSupported(kernel))
+        {
+            std::cout << CpuSkinner::GetKernelName(kernel) << ": not supported\n";
+            continue;
+        }
+        const float milliseconds = timeSkinning(kernel, false);
+        float maxDifference = 0.f;
+        for (size_t i = 0; i < skinned.size(); i++)
+            maxDifference = std::max(maxDifference, std::abs(skinned[i] - scalarSkinned[i]));
+        std::cout << CpuSkinner::GetKernelName(kernel) << ": " << milliseconds << " ms on 1 thread, " << vertexCount / milliseconds / 1000.f
+            << " M vertices/s, " << maxDifference << " away from the scalar kernel\n";
+    }
+
+    const unsigned int defaultWorkerCount = JobSystem::GetWorkerCount();
+    const unsigned int maxWorkerCount = std::max(1u, std::thread::hardware_concurrency() - 1);
+    for (unsigned int workerCount = 0; workerCount <= maxWorkerCount; workerCount = workerCount ? workerCount * 2 : 1)
+    {
+        JobSystem::SetWorkerCount(workerCount);
+        std::cout << CpuSkinner::GetKernelName(CpuSkinner::GetBestKernel()) << ": " << timeSkinning(CpuSkinner::GetBestKernel(), true) << " ms on "
+            << workerCount + 1 << (workerCount > 0 ? " threads\n" : " thread\n");
+    }
+    JobSystem::SetWorkerCount(defaultWorkerCount);
+    return EXIT_SUCCESS;
+}
+
+///Loads a generated rig of 20000 bones, each with its skin cluster, whose skin is linked to the mesh last, on a single thread.
+///Then resolves the links of every object: its children, and its parent bone and skin. Both used to scan all the connections.
+int benchmarkConnections()
+{
+    SyntheticFbxSettings rigSettings;
+    rigSettings.boneCount = 20000;
+    MappedFile file;
+    if (SyntheticFbx::Write(BenchmarkFbxPath, rigSettings) == 0 || !file.Open(BenchmarkFbxPath))
+    {
+        std::cerr << "Cannot benchmark connections: failed to write " << BenchmarkFbxPath << std::endl;
+        std::remove(BenchmarkFbxPath);
+        return EXIT_FAILURE;
+    }
+
+    float loadMilliseconds = 0.f;
+    float resolveMilliseconds = 0.f;
+    size_t linkCount = 0;
+    int objectCount = 0;
+    bool loaded = true;
+    for (unsigned int i = 0; i <= BenchmarkLoadCount; i++)
+    {
+        sf::Clock loadClock;
+        ofbx::IScene* scene = ofbx::load(file.GetData(), file.GetSize(), (ofbx::u16)(BenchmarkRigFlags | ofbx::LoadFlags::BORROW_DATA));
+        const float milliseconds = loadClock.getElapsedTime().asSeconds() * 1000.f;
+        if (!scene)
+        {
+            std::cerr << "Cannot benchmark connections: " << ofbx::getError() << std::endl;
+            loaded = false;
+            break;
+        }
+
+        sf::Clock resolveClock;
+        linkCount = 0;
+        objectCount = scene->getAllObjectCount();
+        for (int object = 0; object < objectCount; object++)
+        {
+            const ofbx::Object* source = scene->getAllObjects()[object];
+            for (int link = 0; source->resolveObjectLink(link); link++)
+                linkCount++;
+            linkCount += source->resolveObjectLinkReverse(ofbx::Object::Type::LIMB_NODE) != nullptr;
+            linkCount += source->resolveObjectLinkReverse(ofbx::Object::Type::SKIN) != nullptr;
+        }
+        const float resolve = resolveClock.getElapsedTime().asSeconds() * 1000.f;
+        scene->destroy();
+        if (i == 0)
+            continue;
+        loadMilliseconds = i == 1 ? milliseconds : std::min(loadMilliseconds, milliseconds);
+        resolveMilliseconds = i == 1 ? resolve : std::min(resolveMilliseconds, resolve);
+    }
+    if (loaded)
+        std::cout << objectCount << " objects loaded in " << loadMilliseconds << " ms, their " << linkCount << " links resolved in "
+            << resolveMilliseconds << " ms\n";
+    file.Close();
+    std::remove(BenchmarkFbxPath);
+    return loaded ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+///Evaluates the global transforms of every node of the scene FBX, of a generated rig of 20000 bones in a binary tree and of one
+///of 2000 bones in a single chain, first with the recursive Object::getGlobalTransform, then with a full pass of an
+///ofbx::TransformHierarchy. Then the same for a single leaf whose local transform changed.
+int benchmarkHierarchy()
+{
+    SyntheticFbxSettings treeSettings;
+    treeSettings.gridSize = 10;
+    treeSettings.boneCount = 20000;
+    SyntheticFbxSettings chainSettings = treeSettings;
+    chainSettings.boneCount = 2000;
+    chainSettings.boneBranching = 1;
+
+    // Single dirty leaves are too quick to time one by one.
+    const unsigned int leafPassCount = 1000;
+    // no settings for the scene FBX
+    const SyntheticFbxSettings* const rigs[] = { nullptr, &treeSettings, &chainSettings };
+    bool evaluated = true;
+    for (const SyntheticFbxSettings* settings : rigs)
+    {
+        const char* path = settings ? BenchmarkFbxPath : "resources/Kleo.fbx";
+        MappedFile file;
+        ofbx::IScene* scene = nullptr;
+        if ((!settings || SyntheticFbx::Write(BenchmarkFbxPath, *settings) > 0) && file.Open(path))
+            scene = ofbx::load(file.GetData(), file.GetSize(), (ofbx::u16)(BenchmarkRigFlags | ofbx::LoadFlags::BORROW_DATA));
+        if (!scene)
+        {
+            std::cerr << "Cannot benchmark the hierarchy of " << path << ": " << ofbx::getError() << std::endl;
+            evaluated = false;
+            break;
+        }
+        ofbx::TransformHierarchy* hierarchy = ofbx::createTransformHierarchy(*scene);
+        const int nodeCount = hierarchy->getNodeCount();
+        const int leaf = nodeCount - 1;
+
+        float recursiveMilliseconds = 0.f;
+        float passMilliseconds = 0.f;
+        float recursiveLeafMicroseconds = 0.f;
+        float leafMicroseconds = 0.f;
+        double maxDifference = 0.0;
+        std::vector<ofbx::DMatrix> recursive(nodeCount);
+        for (unsigned int i = 0; i <= BenchmarkLoadCount; i++)
+        {
+            sf::Clock recursiveClock;
+            for (int node = 0; node < nodeCount; node++)
+                recursive[node] = hierarchy->getNode(node)->getGlobalTransform();
+            const float recursiveTime = recursiveClock.getElapsedTime().asSeconds() * 1000.f;
+
+            // every local transform is evaluated again, like after the first pass
+            sf::Clock passClock;
+            for (int node = 0; node < nodeCount; node++)
+                hierarchy->markDirty(node);
+            hierarchy->evaluateAll();
+            const float passTime = passClock.getElapsedTime().asSeconds() * 1000.f;
+
+            sf::Clock recursiveLeafClock;
+            for (unsigned int pass = 0; pass < leafPassCount; pass++)
+                recursive[leaf] = hierarchy->getNode(leaf)->getGlobalTransform();
+            const float recursiveLeafTime = recursiveLeafClock.getElapsedTime().asSeconds() * 1000000.f / leafPassCount;
+
+            sf::Clock leafClock;
+            for (unsigned int pass = 0; pass < leafPassCount; pass++)
+            {
+                hierarchy->markDirty(leaf);
+                hierarchy->evaluateAll();
+            }
+            const float leafTime = leafClock.getElapsedTime().asSeconds() * 1000000.f / leafPassCount;
+
+            for (int node = 0; node < nodeCount; node++)
+                for (int element = 0; element < 16; element++)
+                    maxDifference = std::max(maxDifference, std::abs(recursive[node].m[element] - hierarchy->getGlobalTransform(node).m[element]));
+            if (i == 0)
+                continue;
+            recursiveMilliseconds = i == 1 ? recursiveTime : std::min(recursiveMilliseconds, recursiveTime);
+            passMilliseconds = i == 1 ? passTime : std::min(passMilliseconds, passTime);
+            recursiveLeafMicroseconds = i == 1 ? recursiveLeafTime : std::min(recursiveLeafMicroseconds, recursiveLeafTime);
+            leafMicroseconds = i == 1 ? leafTime : std::min(leafMicroseconds, leafTime);
+        }
+        hierarchy->destroy();
+        scene->destroy();
+        file.Close();
+
+        std::cout << (settings ? (settings->boneBranching == 1 ? "bone chain" : "bone tree") : path) << ", " << nodeCount << " nodes: all in "
+            << recursiveMilliseconds << " ms recursively, " << passMilliseconds << " ms in a pass, a leaf in " << recursiveLeafMicroseconds
+            << " us recursively, " << leafMicroseconds << " us in a pass, " << maxDifference << " apart\n";
+    }
+    std::remove(BenchmarkFbxPath);
+    return evaluated ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+///Evaluates l_node at l_time like OpenFBX did before searching the keys, scanning every curve from its first key.
+///Curves missing from the node give 0 instead of the default value of the node, which the generated rigs don't need.
+ofbx::DVec3 sampleLinearly(const ofbx::AnimationCurveNode& l_node, double l_time)
+{
+    const ofbx::i64 fbxTime = ofbx::secondsToFbxTime(l_time);
+    double coordinates[3] = {};
+    for (int axis = 0; axis < 3; axis++)
+    {
+        const ofbx::AnimationCurve* curve = l_node.getCurve(axis);
+        const int count = curve ? curve->getKeyCount() : 0;
+        if (count == 0)
+            continue;
+        const ofbx::i64* times = curve->getKeyTime();
+        const float* values = curve->getKeyValue();
+        const ofbx::i64 time = std::min(std::max(fbxTime, times[0]), times[count - 1]);
+        coordinates[axis] = values[0];
+        for (int key = 1; key < count; key++)
+        {
+            if (times[key] >= time)
+            {
+                const float t = float(double(time - times[key - 1]) / double(times[key] - times[key - 1]));
+                coordinates[axis] = values[key - 1] * (1 - t) + values[key] * t;
+                break;
+            }
+        }
+    }
+    return { coordinates[0], coordinates[1], coordinates[2] };
+}
+
+///Samples every bone of a generated rig of 500 bones whose rotation curves have 10000 keys, with the linear scan OpenFBX used
+///to do, the binary search of AnimationCurveNode::getNodeLocalTransform and an ofbx::AnimationSampler, playing the clip forward
+///then jumping to random times.
+int benchmarkSampling()
+{
+    SyntheticFbxSettings rigSettings;
+    rigSettings.gridSize = 10;
+    rigSettings.boneCount = 500;
+    rigSettings.animationKeyCount = 10000;
+    MappedFile file;
+    ofbx::IScene* scene = nullptr;
+    if (SyntheticFbx::Write(BenchmarkFbxPath, rigSettings) > 0 && file.Open(BenchmarkFbxPath))
+        scene = ofbx::load(file.GetData(), file.GetSize(), (ofbx::u16)(BenchmarkRigFlags | ofbx::LoadFlags::BORROW_DATA));
+    const ofbx::AnimationLayer* layer = scene && scene->getAnimationStackCount() > 0 ? scene->getAnimationStack(0)->getLayer(0) : nullptr;
+    if (!layer)
+    {
+        std::cerr << "Cannot benchmark sampling: " << (scene ? "the rig has no animation" : ofbx::getError()) << std::endl;
+        if (scene)
+            scene->destroy();
+        file.Close();
+        std::remove(BenchmarkFbxPath);
+        return EXIT_FAILURE;
+    }
+    ofbx::AnimationSampler* sampler = ofbx::createAnimationSampler(*layer);
+    const int curveNodeCount = sampler->getCurveNodeCount();
+
+    // Forward playback steps through the whole clip, 5 keys apart, random access jumps anywhere in it.
+    const unsigned int sampleCount = 2000;
+    const double duration = (rigSettings.animationKeyCount - 1) / 30.0;
+    std::vector<double> forwardTimes(sampleCount);
+    std::vector<double> randomTimes(sampleCount);
+    std::mt19937 random(7);
+    std::uniform_real_distribution<double> anyTime(0.0, duration);
+    for (unsigned int i = 0; i < sampleCount; i++)
+    {
+        forwardTimes[i] = duration * i / sampleCount;
+        randomTimes[i] = anyTime(random);
+    }
+
+    enum Method { LinearScan, BinarySearch, Sampler, MethodCount };
+    const char* methodNames[MethodCount] = { "linear scan", "binary search", "sampler" };
+    std::vector<ofbx::DVec3> samples[MethodCount];
+    for (std::vector<ofbx::DVec3>& methodSamples : samples)
+        methodSamples.resize(curveNodeCount);
+    for (const std::vector<double>* times : { &forwardTimes, &randomTimes })
+    {
+        double maxDifference = 0.0;
+        for (int method = 0; method < MethodCount; method++)
+        {
+            sf::Clock sampleClock;
+            for (double time : *times)
+            {
+                if (method == Sampler)
+                    sampler->sample(time, samples[Sampler].data());
+                for (int node = 0; node < curveNodeCount && method != Sampler; node++)
+                {
+                    const ofbx::AnimationCurveNode& curveNode = *sampler->getCurveNode(node);
+                    samples[method][node] = method == LinearScan ? sampleLinearly(curveNode, time) : curveNode.getNodeLocalTransform(time);
+                }
+            }
+            const float milliseconds = sampleClock.getElapsedTime().asSeconds() * 1000.f / sampleCount;
+            // the last samples of every method are at the same time
+            for (int node = 0; node < curveNodeCount; node++)
+            {
+                maxDifference = std::max(maxDifference, std::abs(samples[method][node].x - samples[LinearScan][node].x));
+                maxDifference = std::max(maxDifference, std::abs(samples[method][node].y - samples[LinearScan][node].y));
+                maxDifference = std::max(maxDifference, std::abs(samples[method][node].z - samples[LinearScan][node].z));
+            }
+            std::cout << (times == &forwardTimes ? "forward, " : "random, ") << methodNames[method] << ": " << milliseconds
+                << " ms per sample of " << curveNodeCount << " bones\n";
+        }
+        std::cout << "the methods are " << maxDifference << " apart\n";
+    }
+
+    sampler->destroy();
+    scene->destroy();
+    file.Close();
+    std::remove(BenchmarkFbxPath);
+    return EXIT_SUCCESS;
+}
+
+///Times the vertex shader over a generated grid morphed by 60 blend shapes with GL_TIME_ELAPSED queries, without morphing,
+///morphed with every weight 0 then with 50 of them set. The vertices are captured by transform feedback like checkQuantization does,
+///so nothing is rasterized and the last pass can be checked against the targets added on the CPU.
+int benchmarkMorphing()
+{
+    sf::Context context;
+    glewExperimental = GL_TRUE;
+    if (glewInit() != GLEW_OK)
+        return EXIT_FAILURE;
+    if (!GLEW_ARB_timer_query)
+    {
+        std::cerr << "Cannot benchmark morphing: the driver has no timer queries" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    SyntheticFbxSettings fbxSettings;
+    fbxSettings.gridSize = 200;
+    fbxSettings.blendShapeCount = 60;
+    if (SyntheticFbx::Write(BenchmarkFbxPath, fbxSettings) == 0)
+    {
+        std::cerr << "Cannot benchmark morphing: failed to write " << BenchmarkFbxPath << std::endl;
+        return EXIT_FAILURE;
+    }
+    // Only the full mesh is drawn, there is nothing to simplify or to cache.
+    FbxImportSettings importSettings = getImportSettings();
+    importSettings.useMeshCache = false;
+    importSettings.lodCount = 0;
+    importSettings.buildMeshlets = false;
+
+    AssetLoader assetLoader;
+    const AssetLoader::Handle meshAsset = assetLoader.LoadMesh(BenchmarkFbxPath, importSettings);
+    const AssetLoader::Handle vertexShaderAsset = assetLoader.LoadText("resources/vertex_shader.glsl");
+    while (assetLoader.GetPendingCount() > 0)
+        assetLoader.Update(UploadBudgetMilliseconds);
+    std::remove(BenchmarkFbxPath);
+    if (!assetLoader.IsReady(meshAsset) || !assetLoader.IsReady(vertexShaderAsset))
+    {
+        std::cerr << "Cannot benchmark morphing: failed to load " << assetLoader.GetPath(assetLoader.IsReady(meshAsset) ? vertexShaderAsset : meshAsset) << std::endl;
+        return EXIT_FAILURE;
+    }
+    const ImportedMesh& mesh = assetLoader.GetMesh(meshAsset);
+    const unsigned int vertexCount = mesh.GetVertexCount();
+    const unsigned int targetCount = (unsigned int)mesh.morphTargetNames.size();
+    const unsigned int activeTargetCount = 50;
+    if (!mesh.HasMorphTargets() || targetCount < activeTargetCount)
+    {
+        std::cerr << "Cannot benchmark morphing: the grid has " << targetCount << " morph targets" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Only the position is captured, the rest of the shader still runs.
+    const GLchar* captured[] = { "gl_Position" };
+    const GLuint vertexShader = buildShader(assetLoader.GetText(vertexShaderAsset), GL_VERTEX_SHADER);
+    const GLuint morphProgram = glCreateProgram();
+    glAttachShader(morphProgram, vertexShader);
+    bindProgramLocations(morphProgram);
+    glTransformFeedbackVaryings(morphProgram, 1, captured, GL_INTERLEAVED_ATTRIBS);
+    glLinkProgram(morphProgram);
+    GLint linked = 0;
+    glGetProgramiv(morphProgram, GL_LINK_STATUS, &linked);
+    checkError(morphProgram, GL_LINK_STATUS, true, "Shader link error:");
+    if (!linked)
+    {
+        glDeleteProgram(morphProgram);
+        glDeleteShader(vertexShader);
+        return EXIT_FAILURE;
+    }
+
+    const bool quantized = !mesh.quantizedVertices.empty();
+    const glm::vec3 boundsMin(mesh.boundsMin[0], mesh.boundsMin[1], mesh.boundsMin[2]);
+    const glm::vec3 offset = quantized ? boundsMin : glm::vec3(0.f);
+    const glm::vec3 scale = quantized ? glm::vec3(mesh.boundsMax[0], mesh.boundsMax[1], mesh.boundsMax[2]) - boundsMin : glm::vec3(1.f);
+    const glm::mat4 identity(1.f);
+    glUseProgram(morphProgram);
+    glUniformMatrix4fv(glGetUniformLocation(morphProgram, "pvm"), 1, GL_FALSE, &identity[0][0]);
+    glUniform3fv(glGetUniformLocation(morphProgram, "positionOffset"), 1, &offset[0]);
+    glUniform3fv(glGetUniformLocation(morphProgram, "positionScale"), 1, &scale[0]);
+    glUniform1i(glGetUniformLocation(morphProgram, "octahedralNormals"), quantized ? GL_TRUE : GL_FALSE);
+    glUniform1i(glGetUniformLocation(morphProgram, "skinned"), GL_FALSE);
+    glUniform1i(glGetUniformLocation(morphProgram, "bonePalette"), BonePaletteTextureUnit);
+    glUniform1i(glGetUniformLocation(morphProgram, "morphStarts"), MorphStartsTextureUnit);
+    glUniform1i(glGetUniformLocation(morphProgram, "morphDeltas"), MorphDeltasTextureUnit);
+    glUniform1i(glGetUniformLocation(morphProgram, "morphWeights"), MorphWeightsTextureUnit);
+    glUniform1i(glGetUniformLocation(morphProgram, "firstMorphWeight"), 0);
+    glUniform1f(glGetUniformLocation(morphProgram, "morphPositionScale"), mesh.morphPositionScale / 32767.f);
+    glUniform1f(glGetUniformLocation(morphProgram, "morphNormalScale"), mesh.morphNormalScale / 32767.f);
+
+    GLuint feedbackBuffer = 0;
+    glGenBuffers(1, &feedbackBuffer);
+    glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, feedbackBuffer);
+    glBufferData(GL_TRANSFORM_FEEDBACK_BUFFER, sizeof(GLfloat) * 4 * vertexCount, nullptr, GL_STATIC_READ);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, feedbackBuffer);
+    GLuint query = 0;
+    glGenQueries(1, &query);
+    const GLuint vertexArray = createVertexArray(assetLoader, meshAsset);
+    glBindVertexArray(vertexArray);
+    glEnable(GL_RASTERIZER_DISCARD);
+
+    enum Pass { Unmorphed, ZeroWeights, ActiveWeights, PassCount };
+    const char* passNames[PassCount] = { "not morphed", "morphed, every weight 0", "morphed, 50 weights set" };
+    std::vector<float> targetWeights(targetCount, 0.f);
+    MorphWeights morphWeights;
+    for (int pass = 0; pass < PassCount; pass++)
+    {
+        if (pass == ActiveWeights)
+            for (unsigned int target = 0; target < activeTargetCount; target++)
+                targetWeights[target] = 0.5f + 0.01f * target;
+        morphWeights.Clear();
+        morphWeights.Add(targetWeights.data(), targetCount);
+        // Bound after the upload like when drawing, creating the weights texture binds the active unit.
+        morphWeights.Upload();
+        glActiveTexture(GL_TEXTURE0 + MorphWeightsTextureUnit);
+        glBindTexture(GL_TEXTURE_BUFFER, morphWeights.GetTexture());
+        glActiveTexture(GL_TEXTURE0 + MorphStartsTextureUnit);
+        glBindTexture(GL_TEXTURE_BUFFER, assetLoader.GetMorphStartTexture(meshAsset));
+        glActiveTexture(GL_TEXTURE0 + MorphDeltasTextureUnit);
+        glBindTexture(GL_TEXTURE_BUFFER, assetLoader.GetMorphDeltaTexture(meshAsset));
+        glUniform1i(glGetUniformLocation(morphProgram, "morphed"), pass == Unmorphed ? GL_FALSE : GL_TRUE);
+
+        // The first draw is a warm-up, the driver may compile the shader variant lazily. The time until glFinish returns
+        // is printed too, software drivers like llvmpipe leave the vertex work out of their timer queries.
+        float bestMilliseconds = 0.f;
+        float bestFinishMilliseconds = 0.f;
+        for (unsigned int i = 0; i < BenchmarkLoadCount; i++)
+        {
+            glFinish();
+            sf::Clock finishClock;
+            glBeginQuery(GL_TIME_ELAPSED, query);
+            glBeginTransformFeedback(GL_POINTS);
+            glDrawArrays(GL_POINTS, 0, vertexCount);
+            glEndTransformFeedback();
+            glEndQuery(GL_TIME_ELAPSED);
+            glFinish();
+            const float finishMilliseconds = finishClock.getElapsedTime().asSeconds() * 1000.f;
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+            const float milliseconds = nanoseconds / 1e6f;
+            if (i > 0)
+            {
+                bestMilliseconds = i == 1 ? milliseconds : std::min(bestMilliseconds, milliseconds);
+                bestFinishMilliseconds = i == 1 ? finishMilliseconds : std::min(bestFinishMilliseconds, finishMilliseconds);
+            }
+        }
+        std::cout << passNames[pass] << ": " << bestMilliseconds << " ms on the GPU, " << bestFinishMilliseconds << " ms until finished, for "
+            << vertexCount << " vertices\n";
+    }
+
+    // The last pass against the deltas added on the CPU to the float vertices.
+    std::vector<GLfloat> morphed((size_t)4 * vertexCount);
+    glGetBufferSubData(GL_TRANSFORM_FEEDBACK_BUFFER, 0, sizeof(GLfloat) * morphed.size(), morphed.data());
+    float maxDistance = 0.f;
+    for (unsigned int i = 0; i < vertexCount; i++)
+    {
+        glm::vec3 position(mesh.vertices[(size_t)i * ImportedMesh::VertexSize], mesh.vertices[(size_t)i * ImportedMesh::VertexSize + 1],
+            mesh.vertices[(size_t)i * ImportedMesh::VertexSize + 2]);
+        for (uint32_t delta = mesh.morphStarts[i]; delta < mesh.morphStarts[i + 1]; delta++)
+        {
+            const MorphDelta& morphDelta = mesh.morphDeltas[delta];
+            const glm::vec3 deltaPosition(morphDelta.position[0], morphDelta.position[1], morphDelta.position[2]);
+            position += targetWeights[morphDelta.target] * mesh.morphPositionScale / 32767.f * deltaPosition;
+        }
+        maxDistance = std::max(maxDistance, glm::distance(position, glm::vec3(morphed[(size_t)i * 4], morphed[(size_t)i * 4 + 1], morphed[(size_t)i * 4 + 2])));
+    }
+    std::cout << mesh.morphDeltas.size() << " deltas over " << targetCount << " targets, the GPU morph is " << maxDistance
+        << " from the CPU one\n";
+
+    glDisable(GL_RASTERIZER_DISCARD);
+    glBindVertexArray(0);
+    glDeleteVertexArrays(1, &vertexArray);
+    glDeleteQueries(1, &query);
+    glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, 0);
+    glDeleteBuffers(1, &feedbackBuffer);
+    glUseProgram(0);
+    glDeleteProgram(morphProgram);
+    glDeleteShader(vertexShader);
+    return glGetError() == GL_NO_ERROR ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+///Decodes the quantized vertices of the scene mesh with the vertex shader, captured by transform feedback without opening a window,
+///and fails when they stray from the float vertices further than VertexQuantizer::GetTolerance.
+int checkQuantization()
+{
+    // An offscreen context is enough, nothing is rasterized.
+    sf::Context context;
+    glewExperimental = GL_TRUE;
+    if (glewInit() != GLEW_OK)
+        return EXIT_FAILURE;
+
+    AssetLoader assetLoader;
+    const AssetLoader::Handle meshAsset = assetLoader.LoadMesh("resources/Kleo.fbx", getImportSettings());
+    const AssetLoader::Handle vertexShaderAsset = assetLoader.LoadText("resources/vertex_shader.glsl");
+    while (assetLoader.GetPendingCount() > 0)
+        assetLoader.Update(UploadBudgetMilliseconds);
+    if (!assetLoader.IsReady(meshAsset) || !assetLoader.IsReady(vertexShaderAsset))
+    {
+        std::cerr << "Cannot check quantization: failed to load " << assetLoader.GetPath(assetLoader.IsReady(meshAsset) ? vertexShaderAsset : meshAsset) << std::endl;
+        return EXIT_FAILURE;
+    }
+    const ImportedMesh& mesh = assetLoader.GetMesh(meshAsset);
+    if (mesh.quantizedVertices.empty())
+    {
+        std::cerr << "Cannot check quantization: the import settings don't quantize vertices" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // The position before projection, the normal and the uv of every vertex, interleaved.
+    const unsigned int vertexCount = mesh.GetVertexCount();
+    const unsigned int capturedSize = 4 + 3 + 2;
+    const GLchar* captured[] = { "gl_Position", "modelNormal", "uv" };
+    const GLuint vertexShader = buildShader(assetLoader.GetText(vertexShaderAsset), GL_VERTEX_SHADER);
+    const GLuint decodeProgram = glCreateProgram();
+    glAttachShader(decodeProgram, vertexShader);
+    bindProgramLocations(decodeProgram);
+    glTransformFeedbackVaryings(decodeProgram, 3, captured, GL_INTERLEAVED_ATTRIBS);
+    glLinkProgram(decodeProgram);
+    GLint linked = 0;
+    glGetProgramiv(decodeProgram, GL_LINK_STATUS, &linked);
+    checkError(decodeProgram, GL_LINK_STATUS, true, "Shader link error:");
+
+    QuantizationError error;
+    if (linked)
+    {
+        // The same uniforms as a quantized mesh in its bind pose, projected by nothing.
+        const glm::vec3 boundsMin(mesh.boundsMin[0], mesh.boundsMin[1], mesh.boundsMin[2]);
+        const glm::vec3 extent = glm::vec3(mesh.boundsMax[0], mesh.boundsMax[1], mesh.boundsMax[2]) - boundsMin;
+        const glm::mat4 identity(1.f);
+        glUseProgram(decodeProgram);
+        glUniformMatrix4fv(glGetUniformLocation(decodeProgram, "pvm"), 1, GL_FALSE, &identity[0][0]);
+        glUniform3fv(glGetUniformLocation(decodeProgram, "positionOffset"), 1, &boundsMin[0]);
+        glUniform3fv(glGetUniformLocation(decodeProgram, "positionScale"), 1, &extent[0]);
+        glUniform1i(glGetUniformLocation(decodeProgram, "octahedralNormals"), GL_TRUE);
+        glUniform1i(glGetUniformLocation(decodeProgram, "skinned"), GL_FALSE);
+        glUniform1i(glGetUniformLocation(decodeProgram, "morphed"), GL_FALSE);
+        // Samplers of different types can't share a unit even unused, they get theirs like when drawing.
+        glUniform1i(glGetUniformLocation(decodeProgram, "bonePalette"), BonePaletteTextureUnit);
+        glUniform1i(glGetUniformLocation(decodeProgram, "morphStarts"), MorphStartsTextureUnit);
+        glUniform1i(glGetUniformLocation(decodeProgram, "morphDeltas"), MorphDeltasTextureUnit);
+        glUniform1i(glGetUniformLocation(decodeProgram, "morphWeights"), MorphWeightsTextureUnit);
+
+        GLuint feedbackBuffer = 0;
+        glGenBuffers(1, &feedbackBuffer);
+        glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, feedbackBuffer);
+        glBufferData(GL_TRANSFORM_FEEDBACK_BUFFER, sizeof(GLfloat) * capturedSize * vertexCount, nullptr, GL_STATIC_READ);
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, feedbackBuffer);
+
+        const GLuint vertexArray = createVertexArray(assetLoader, meshAsset);
+        glBindVertexArray(vertexArray);
+        glEnable(GL_RASTERIZER_DISCARD);
+        glBeginTransformFeedback(GL_POINTS);
+        glDrawArrays(GL_POINTS, 0, vertexCount);
+        glEndTransformFeedback();
+        glDisable(GL_RASTERIZER_DISCARD);
+        glBindVertexArray(0);
+        glDeleteVertexArrays(1, &vertexArray);
+
+        std::vector<GLfloat> decoded((size_t)capturedSize * vertexCount);
+        glGetBufferSubData(GL_TRANSFORM_FEEDBACK_BUFFER, 0, sizeof(GLfloat) * decoded.size(), decoded.data());
+        glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, 0);
+        glDeleteBuffers(1, &feedbackBuffer);
+        glUseProgram(0);
+        if (glGetError() != GL_NO_ERROR)
+        {
+            std::cerr << "Cannot check quantization: decoding the vertices failed" << std::endl;
+            linked = GL_FALSE;
+        }
+
+        // Measured like VertexQuantizer::MeasureError, normals missing from the file don't count.
+        for (unsigned int i = 0; i < vertexCount; i++)
+        {
+            const GLfloat* vertex = &mesh.vertices[(size_t)i * ImportedMesh::VertexSize];
+            const GLfloat* decodedVertex = &decoded[(size_t)i * capturedSize];
+            for (int axis = 0; axis < 3; axis++)
+                error.position = std::max(error.position, std::fabs(decodedVertex[axis] / decodedVertex[3] - vertex[axis]));
+            const glm::vec3 normal(vertex[3], vertex[4], vertex[5]);
+            if (glm::length(normal) > 0.f)
+            {
+                const float cosine = glm::dot(glm::normalize(normal), glm::vec3(decodedVertex[4], decodedVertex[5], decodedVertex[6]));
+                error.normalDegrees = std::max(error.normalDegrees, glm::degrees(std::acos(glm::clamp(cosine, -1.f, 1.f))));
+            }
+            for (int axis = 0; axis < 2; axis++)
+                error.texCoord = std::max(error.texCoord, std::fabs(decodedVertex[7 + axis] - vertex[6 + axis]));
+        }
+    }
+    glDeleteProgram(decodeProgram);
+    glDeleteShader(vertexShader);
+    if (!linked)
+        return EXIT_FAILURE;
+
+    const QuantizationError& cpuError = assetLoader.GetMeshStats(meshAsset).quantizationError;
+    const QuantizationError tolerance = VertexQuantizer::GetTolerance(mesh);
+    std::cout << "Decoded " << vertexCount << " vertices with the vertex shader, max error position " << error.position << ", normal "
+        << error.normalDegrees << " deg, uv " << error.texCoord << "\n";
+    std::cout << "Decoded on the CPU: position " << cpuError.position << ", normal " << cpuError.normalDegrees << " deg, uv " << cpuError.texCoord << "\n";
+    std::cout << "Tolerance: position " << tolerance.position << ", normal " << tolerance.normalDegrees << " deg, uv " << tolerance.texCoord << "\n";
+    if (!error.IsWithin(tolerance) || !cpuError.IsWithin(tolerance))
+    {
+        std::cerr << "Quantization error over the tolerance" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
 }
 
 ////////////////////////////////////////////////////////////
 /// Entry point of application
 ///
+/// \param argc, argv --benchmark-culling runs the meshlet culling benchmark instead,
+/// --benchmark-loading the benchmark of reading FBX files in place, --benchmark-parsing the one of decoding them on the job system,
+/// --benchmark-decompression the one of inflating their arrays, --benchmark-conversion the one of converting them to floats,
+/// --benchmark-skinning the one of the CPU skinning kernels, --benchmark-connections the one of resolving the links of a big rig,
+/// --benchmark-hierarchy the one of evaluating its global transforms, --benchmark-sampling the one of sampling its animation,
+/// --benchmark-morphing the one of the vertex shader applying blend shapes,
+/// --check-quantization checks the error of the quantized vertices decoded by the vertex shader
+///
 /// \return Application exit code
 ///
 ////////////////////////////////////////////////////////////
-int main()
+int main(int argc, char** argv)
 {
+    if (argc > 1 && std::strcmp(argv[1], "--benchmark-culling") == 0)
+        return benchmarkCulling();
+    if (argc > 1 && std::strcmp(argv[1], "--benchmark-loading") == 0)
+        return benchmarkLoading();
+    if (argc > 1 && std::strcmp(argv[1], "--benchmark-parsing") == 0)
+        return benchmarkParsing();
+    if (argc > 1 && std::strcmp(argv[1], "--benchmark-decompression") == 0)
+        return benchmarkDecompression();
+    if (argc > 1 && std::strcmp(argv[1], "--benchmark-conversion") == 0)
+        return benchmarkConversion();
+    if (argc > 1 && std::strcmp(argv[1], "--benchmark-skinning") == 0)
+        return benchmarkSkinning();
+    if (argc > 1 && std::strcmp(argv[1], "--benchmark-connections") == 0)
+        return benchmarkConnections();
+    if (argc > 1 && std::strcmp(argv[1], "--benchmark-hierarchy") == 0)
+        return benchmarkHierarchy();
+    if (argc > 1 && std::strcmp(argv[1], "--benchmark-sampling") == 0)
+        return benchmarkSampling();
+    if (argc > 1 && std::strcmp(argv[1], "--benchmark-morphing") == 0)
+        return benchmarkMorphing();
+    if (argc > 1 && std::strcmp(argv[1], "--check-quantization") == 0)
+        return checkQuantization();
+
     bool exit = false;
     bool sRgb = false;
 
+    // Time to first frame is measured from here.
+    sf::Clock startupClock;
+    bool firstFrameReported = false;
+    bool assetsReadyReported = false;
+
+    // Heavy assets are read and parsed on worker threads and uploaded a bit every frame,
+    // so the loop starts rendering right away. They are kept across window recreation.
+    AssetLoader assetLoader;
+    const AssetLoader::Handle meshAsset = assetLoader.LoadMesh("resources/Kleo.fbx", getImportSettings());
+    const AssetLoader::Handle animationAsset = assetLoader.LoadAnimations("resources/Kleo.fbx");
+    // The mesh uses its own diffuse texture when the FBX has one, the default texture otherwise.
+    const AssetLoader::Handle fbxTextureAsset = assetLoader.LoadFbxTextures("resources/Kleo.fbx", getTextureSettings());
+    const AssetLoader::Handle textureAsset = assetLoader.LoadTexture("resources/texture.jpg", getTextureSettings());
+    const AssetLoader::Handle vertexShaderAsset = assetLoader.LoadText("resources/vertex_shader.glsl");
+    const AssetLoader::Handle fragmentShaderAsset = assetLoader.LoadText("resources/fragment_shader.glsl");
+    bool meshStatsLogged = false;
+
+    // The pose of the skinned mesh and the bones sent to the GPU every frame, both outlive the windows.
+    std::unique_ptr<SkeletonPose> skeletonPose;
+    BonePalette bonePalette;
+    sf::Clock animationClock;
+    // The weights of the morph targets, recomputed and sent to the GPU every frame.
+    std::vector<float> targetWeights;
+    MorphWeights morphWeights;
+    // What the meshlet culling rejected since it was last logged.
+    MeshletCullStats cullStats;
+    unsigned int cullFrames = 0;
+    sf::Clock cullStatsClock;
+
+    // Flag to track whether mipmapping is currently enabled
+    bool mipmapEnabled = true;
+
     while (!exit)
     {
         // Request a 24-bits depth buffer when creating the window
@@ -175,6 +1491,17 @@ int main()
         if (glewInit() != GLEW_OK)
             return EXIT_FAILURE;
 
+        // Create the sampler states, toggling mipmapping only switches between them
+        glGenSamplers(2, samplers);
+        for (unsigned int i = 0; i < 2; i++)
+        {
+            glSamplerParameteri(samplers[i], GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glSamplerParameteri(samplers[i], GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glSamplerParameteri(samplers[i], GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        }
+        glSamplerParameteri(samplers[0], GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glSamplerParameteri(samplers[1], GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+
         // Create a sprite for the background
         sf::Texture backgroundTexture;
         backgroundTexture.setSrgb(sRgb);
@@ -196,26 +1523,9 @@ int main()
         sRgbInstructions.setPosition(150.f, 500.f);
         mipmapInstructions.setPosition(180.f, 550.f);
 
-        // Load a texture to apply to our 3D cube
-        sf::Texture texture;
-        if (!texture.loadFromFile("resources/texture.jpg"))
-            return EXIT_FAILURE;
-
-        // Attempt to generate a mipmap for our cube texture
-        // We don't check the return value here since
-        // mipmapping is purely optional in this example
-        texture.generateMipmap();
-
         // Make the window the active window for OpenGL calls
         window.setActive(true);
 
-        // Load the shaders we need.
-        if (program == 0)
-        {
-            LoadFromMemory(loadShaderFromFile("resources/vertex_shader.glsl"), ShaderType::Vertex);
-            LoadFromMemory(loadShaderFromFile("resources/fragment_shader.glsl"), ShaderType::Fragment);
-        }
-
         // Enable Z-buffer read and write and culling.
         glEnable(GL_DEPTH_TEST);
         glEnable(GL_CULL_FACE);
@@ -225,49 +1535,12 @@ int main()
         GLfloat ratio = static_cast<float>(window.getSize().x) / window.getSize().y;
         glm::mat4 projection = glm::frustum(-ratio, ratio, -1.f, 1.f, 1.f, 1000.0f);
 
-        std::vector<GLfloat> objectVertices;
-        std::vector<GLuint> objectTriangles;
-
-        FbxImporter::ImportFBX("resources/Kleo.fbx", objectVertices, objectTriangles, drawCount);
-
-        // Stride is the number of bytes per array element.
-        auto stride = sizeof(GLfloat) * 8;
-        // Data offset for normals in bytes.
-        auto normalOffset = sizeof(GLfloat) * 3;
-        // Data offset for texture coordinate in bytes.
-        auto textureCoordOffset = sizeof(GLfloat) * 6;
-
-
-        // Generate Vertex Array and Vertex Buffer and point the area of data to assign to each attribute.
-        glGenVertexArrays(1, &vao);
-        glBindVertexArray(vao);
-        glGenBuffers(1, &vertexVBO);
-        glBindBuffer(GL_ARRAY_BUFFER, vertexVBO);
-        glBufferData(GL_ARRAY_BUFFER, drawCount * stride, objectVertices.data(), GL_DYNAMIC_DRAW);
-        glEnableVertexAttribArray(static_cast<GLuint>(VertexAttribute::Position));
-        glVertexAttribPointer(static_cast<GLuint>(VertexAttribute::Position), 3, GL_FLOAT, GL_FALSE, stride, 0);
-        glEnableVertexAttribArray(static_cast<GLuint>(VertexAttribute::Normal));
-        glVertexAttribPointer(static_cast<GLuint>(VertexAttribute::Normal), 3, GL_FLOAT, GL_FALSE, stride, (void*)normalOffset);
-        glEnableVertexAttribArray(static_cast<GLuint>(VertexAttribute::TexCoord));
-        glVertexAttribPointer(static_cast<GLuint>(VertexAttribute::TexCoord), 2, GL_FLOAT, GL_FALSE, stride, (void*)textureCoordOffset);
-
-        // Generate Index Buffer and define the amount of indices to point to.
-        glGenBuffers(1, &indexVBO);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexVBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, drawCount * sizeof(objectTriangles[0]), objectTriangles.data(), GL_DYNAMIC_DRAW);
-
-        //Make sure to bind the vertex array to null if you wish to define more objects.
-        glBindVertexArray(0);
-
         // Make the window no longer the active window for OpenGL calls
         window.setActive(false);
 
         // Create a clock for measuring the time elapsed
         sf::Clock clock;
 
-        // Flag to track whether mipmapping is currently enabled
-        bool mipmapEnabled = true;
-
         // Start game loop
         while (window.isOpen())
         {
@@ -289,23 +1562,10 @@ int main()
                     window.close();
                 }
 
-                // Return key: toggle mipmapping
+                // Return key: toggle mipmapping, the texture keeps its cooked mipmaps and only the sampler bound changes
                 if ((event.type == sf::Event::KeyPressed) && (event.key.code == sf::Keyboard::Return))
                 {
-                    if (mipmapEnabled)
-                    {
-                        // We simply reload the texture to disable mipmapping
-                        if (!texture.loadFromFile("resources/texture.jpg"))
-                            return EXIT_FAILURE;
-
-                        mipmapEnabled = false;
-                    }
-                    else
-                    {
-                        texture.generateMipmap();
-
-                        mipmapEnabled = true;
-                    }
+                    mipmapEnabled = !mipmapEnabled;
                 }
 
                 // Space key: toggle sRGB conversion
@@ -342,8 +1602,86 @@ int main()
             // Make the window the active window for OpenGL calls
             window.setActive(true);
 
-            // Bind the texture
-            sf::Texture::bind(&texture);
+            // Upload what the workers finished loading, without spending more than the budget.
+            assetLoader.Update(UploadBudgetMilliseconds);
+
+            // Build what this window needs once its assets are there.
+            if (program == 0 && assetLoader.IsReady(vertexShaderAsset) && assetLoader.IsReady(fragmentShaderAsset))
+            {
+                LoadFromMemory(assetLoader.GetText(vertexShaderAsset), ShaderType::Vertex);
+                LoadFromMemory(assetLoader.GetText(fragmentShaderAsset), ShaderType::Fragment);
+            }
+            if (vao == 0 && assetLoader.IsReady(meshAsset))
+            {
+                const ImportedMesh& objectMesh = assetLoader.GetMesh(meshAsset);
+                octahedralNormals = !objectMesh.quantizedVertices.empty();
+                positionOffset = glm::vec3(0.f);
+                positionScale = glm::vec3(1.f);
+                if (octahedralNormals)
+                {
+                    positionOffset = glm::vec3(objectMesh.boundsMin[0], objectMesh.boundsMin[1], objectMesh.boundsMin[2]);
+                    positionScale = glm::vec3(objectMesh.boundsMax[0], objectMesh.boundsMax[1], objectMesh.boundsMax[2]) - positionOffset;
+                }
+                drawFirstIndex = 0;
+                drawCount = objectMesh.GetIndexCount();
+                vao = createVertexArray(assetLoader, meshAsset);
+
+                skinned = objectMesh.IsSkinned();
+                morphed = objectMesh.HasMorphTargets();
+                morphPositionScale = objectMesh.morphPositionScale / 32767.f;
+                morphNormalScale = objectMesh.morphNormalScale / 32767.f;
+                targetWeights.assign(objectMesh.morphTargetNames.size(), 0.f);
+
+                if (!meshStatsLogged)
+                {
+                    logMeshStats(assetLoader, meshAsset, octahedralNormals);
+                    meshStatsLogged = true;
+                }
+            }
+
+            // Pose the skeleton once its clips are there, it stays in its bind pose until then.
+            const bool animationsDone = assetLoader.IsReady(animationAsset) || assetLoader.GetState(animationAsset) == AssetState::Failed;
+            if (!skeletonPose && skinned && animationsDone)
+            {
+                const std::vector<AnimationClip>& clips = assetLoader.GetAnimations(animationAsset);
+                skeletonPose.reset(new SkeletonPose(assetLoader.GetMesh(meshAsset).skeleton, clips.empty() ? nullptr : &clips[0]));
+            }
+
+            // Every skinned mesh adds its bones, then the palette goes to the GPU in one upload.
+            bonePalette.Clear();
+            if (skeletonPose)
+            {
+                const std::vector<AnimationClip>& clips = assetLoader.GetAnimations(animationAsset);
+                const float duration = clips.empty() ? 0.f : clips[0].GetDuration();
+                skeletonPose->Evaluate(duration > 0.f ? std::fmod(animationClock.getElapsedTime().asSeconds(), duration) : 0.f);
+                firstBone = bonePalette.Add(skeletonPose->GetPalette(), skeletonPose->GetBoneCount());
+            }
+            bonePalette.Upload();
+            glActiveTexture(GL_TEXTURE0 + BonePaletteTextureUnit);
+            glBindTexture(GL_TEXTURE_BUFFER, bonePalette.GetTexture());
+
+            // The targets swell in turn, about half of them are off at any time and cost nothing in the shader.
+            morphWeights.Clear();
+            if (morphed)
+            {
+                const float time = animationClock.getElapsedTime().asSeconds();
+                for (size_t target = 0; target < targetWeights.size(); target++)
+                    targetWeights[target] = std::max(0.f, std::sin(time * 2.f + (float)target));
+                firstMorphWeight = morphWeights.Add(targetWeights.data(), (unsigned int)targetWeights.size());
+            }
+            morphWeights.Upload();
+            glActiveTexture(GL_TEXTURE0 + MorphWeightsTextureUnit);
+            glBindTexture(GL_TEXTURE_BUFFER, morphWeights.GetTexture());
+            glActiveTexture(GL_TEXTURE0 + MorphStartsTextureUnit);
+            glBindTexture(GL_TEXTURE_BUFFER, morphed ? assetLoader.GetMorphStartTexture(meshAsset) : 0);
+            glActiveTexture(GL_TEXTURE0 + MorphDeltasTextureUnit);
+            glBindTexture(GL_TEXTURE_BUFFER, morphed ? assetLoader.GetMorphDeltaTexture(meshAsset) : 0);
+            glActiveTexture(GL_TEXTURE0);
+
+            // Bind the texture, nothing until it's loaded
+            const GLuint meshTexture = getMeshTexture(assetLoader, fbxTextureAsset, textureAsset);
+            glBindTexture(GL_TEXTURE_2D, meshTexture);
+            glBindSampler(0, samplers[mipmapEnabled ? 1 : 0]);
             glBindVertexArray(vao);
 
             // We get the position of the mouse cursor, so that we can move the box accordingly
@@ -362,20 +1700,96 @@ int main()
             glm::mat4 identity;
             glm::mat4 viewProj = projection * transform;
 
+            // Pick the coarsest level of detail whose error stays under a pixel at the distance of the mesh.
+            if (vao != 0 && !assetLoader.GetMesh(meshAsset).lods.empty())
+            {
+                const ImportedMesh& objectMesh = assetLoader.GetMesh(meshAsset);
+                const glm::vec3 center = (glm::vec3(objectMesh.boundsMin[0], objectMesh.boundsMin[1], objectMesh.boundsMin[2])
+                    + glm::vec3(objectMesh.boundsMax[0], objectMesh.boundsMax[1], objectMesh.boundsMax[2])) * 0.5f;
+                const float distance = std::max(-(transform * glm::vec4(center, 1.f)).z, 1.f);
+                const float pixelsPerUnit = projection[1][1] * window.getSize().y * 0.5f / distance;
+                const MeshLod& lod = objectMesh.lods[objectMesh.SelectLod(pixelsPerUnit, LodPixelError)];
+                drawFirstIndex = lod.firstIndex;
+                drawCount = lod.indexCount;
+
+                // Cull the meshlets of the level in model space, where their bounds are. The bones move them as they move the mesh.
+                drawMeshlets = lod.meshletCount > 0;
+                if (drawMeshlets)
+                {
+                    const glm::vec4 camera = glm::inverse(transform) * glm::vec4(0.f, 0.f, 0.f, 1.f);
+                    const MeshletCuller::View view = MeshletCuller::MakeView(&viewProj[0][0], &camera[0]);
+                    MeshletCullStats stats;
+                    MeshletCuller::Cull(objectMesh.meshlets.data() + lod.firstMeshlet, lod.meshletCount, view,
+                        skeletonPose ? skeletonPose->GetPalette() : nullptr, skeletonPose ? skeletonPose->GetBoneCount() : 0, meshletDraws, &stats);
+                    cullStats.meshletCount += stats.meshletCount;
+                    cullStats.frustumCulled += stats.frustumCulled;
+                    cullStats.backfaceCulled += stats.backfaceCulled;
+                    cullStats.triangleCount += stats.triangleCount;
+                    cullStats.trianglesCulled += stats.trianglesCulled;
+                    cullStats.drawCount += stats.drawCount;
+                    cullFrames++;
+                }
+            }
+            if (cullFrames > 0 && cullStatsClock.getElapsedTime().asSeconds() >= CullStatsSeconds)
+            {
+                std::cout << "Meshlet culling: " << cullStats.trianglesCulled / cullFrames << " of " << cullStats.triangleCount / cullFrames
+                    << " triangles culled per frame, " << cullStats.frustumCulled / cullFrames << " meshlets outside the frustum, "
+                    << cullStats.backfaceCulled / cullFrames << " back facing, " << (float)cullStats.drawCount / cullFrames << " draws\n";
+                cullStats = MeshletCullStats();
+                cullFrames = 0;
+                cullStatsClock.restart();
+            }
+
             //Bind the shaders.
             glUseProgram(program);
 
             //Set the uniforms for the shader to use.
             if (uniform[(int)UniformType::TransformPVM] >= 0)
                 glUniformMatrix4fv((unsigned int)uniform[(int)UniformType::TransformPVM], 1, GL_FALSE, &viewProj[0][0]);
-
-            // Draw the cube
-            glDrawElements(GL_TRIANGLES, drawCount, GL_UNSIGNED_INT, 0);
+            if (uniform[(int)UniformType::PositionOffset] >= 0)
+                glUniform3fv(uniform[(int)UniformType::PositionOffset], 1, &positionOffset[0]);
+            if (uniform[(int)UniformType::PositionScale] >= 0)
+                glUniform3fv(uniform[(int)UniformType::PositionScale], 1, &positionScale[0]);
+            if (uniform[(int)UniformType::OctahedralNormals] >= 0)
+                glUniform1i(uniform[(int)UniformType::OctahedralNormals], octahedralNormals ? 1 : 0);
+            if (uniform[(int)UniformType::Skinned] >= 0)
+                glUniform1i(uniform[(int)UniformType::Skinned], skinned && skeletonPose ? 1 : 0);
+            if (uniform[(int)UniformType::BonePalette] >= 0)
+                glUniform1i(uniform[(int)UniformType::BonePalette], BonePaletteTextureUnit);
+            if (uniform[(int)UniformType::FirstBone] >= 0)
+                glUniform1i(uniform[(int)UniformType::FirstBone], (GLint)firstBone);
+            if (uniform[(int)UniformType::Morphed] >= 0)
+                glUniform1i(uniform[(int)UniformType::Morphed], morphed ? 1 : 0);
+            if (uniform[(int)UniformType::MorphStarts] >= 0)
+                glUniform1i(uniform[(int)UniformType::MorphStarts], MorphStartsTextureUnit);
+            if (uniform[(int)UniformType::MorphDeltas] >= 0)
+                glUniform1i(uniform[(int)UniformType::MorphDeltas], MorphDeltasTextureUnit);
+            if (uniform[(int)UniformType::MorphWeights] >= 0)
+                glUniform1i(uniform[(int)UniformType::MorphWeights], MorphWeightsTextureUnit);
+            if (uniform[(int)UniformType::FirstMorphWeight] >= 0)
+                glUniform1i(uniform[(int)UniformType::FirstMorphWeight], (GLint)firstMorphWeight);
+            if (uniform[(int)UniformType::MorphPositionScale] >= 0)
+                glUniform1f(uniform[(int)UniformType::MorphPositionScale], morphPositionScale);
+            if (uniform[(int)UniformType::MorphNormalScale] >= 0)
+                glUniform1f(uniform[(int)UniformType::MorphNormalScale], morphNormalScale);
+
+            // Draw the cube, the meshlets left after culling in one call
+            if (vao != 0 && program != 0 && drawMeshlets)
+                glMultiDrawElements(GL_TRIANGLES, meshletDraws.counts.data(), GL_UNSIGNED_INT, meshletDraws.offsets.data(), meshletDraws.GetDrawCount());
+            else if (vao != 0 && program != 0)
+                glDrawElements(GL_TRIANGLES, drawCount, GL_UNSIGNED_INT, (void*)(sizeof(GLuint) * drawFirstIndex));
 
             // Reset the vertex array bound, shader and texture for other assets to draw.
             glBindVertexArray(0);
             glUseProgram(0);
             glBindTexture(GL_TEXTURE_2D, 0);
+            glBindSampler(0, 0);
+            for (GLint unit : { BonePaletteTextureUnit, MorphStartsTextureUnit, MorphDeltasTextureUnit, MorphWeightsTextureUnit })
+            {
+                glActiveTexture(GL_TEXTURE0 + unit);
+                glBindTexture(GL_TEXTURE_BUFFER, 0);
+            }
+            glActiveTexture(GL_TEXTURE0);
 
             // Make the window no longer the active window for OpenGL calls
             window.setActive(false);
@@ -389,17 +1803,41 @@ int main()
 
             // Finally, display the rendered frame on screen
             window.display();
+
+            if (!firstFrameReported)
+            {
+                std::cout << "Time to first frame: " << startupClock.getElapsedTime().asSeconds() * 1000.f << " ms\n";
+                firstFrameReported = true;
+            }
+            if (!assetsReadyReported && assetLoader.GetPendingCount() == 0)
+            {
+                std::cout << "All assets loaded after " << startupClock.getElapsedTime().asSeconds() * 1000.f << " ms\n";
+                for (AssetLoader::Handle asset : { meshAsset, animationAsset, fbxTextureAsset, textureAsset, vertexShaderAsset, fragmentShaderAsset })
+                {
+                    if (assetLoader.GetState(asset) == AssetState::Failed)
+                        std::cerr << "Failed to load " << assetLoader.GetPath(asset)
+                            << (assetLoader.GetError(asset).empty() ? "" : ": " + assetLoader.GetError(asset)) << std::endl;
+                }
+                if (assetLoader.IsReady(animationAsset))
+                    logAnimationStats(assetLoader, animationAsset);
+                if (assetLoader.IsReady(fbxTextureAsset))
+                    logTextureStats(assetLoader, fbxTextureAsset);
+                for (AssetLoader::Handle texture : { fbxTextureAsset, textureAsset })
+                {
+                    if (assetLoader.IsReady(texture))
+                        logTextureCookStats(assetLoader, texture);
+                }
+                assetsReadyReported = true;
+            }
         }
 
-        //Destroy all buffers, shaders and programs.
-        glDeleteBuffers(1, &vertexVBO);
-        glDeleteBuffers(1, &indexVBO);
+        //Destroy the vertex array, samplers, shaders and programs. Buffers and textures belong to the asset loader and are shared between windows.
         glDeleteVertexArrays(1, &vao);
+        glDeleteSamplers(2, samplers);
 
         //Setting these values to zero will allow them to be initialised with new data on reset.
-        vertexVBO = 0;
-        indexVBO = 0;
         vao = 0;
+        samplers[0] = samplers[1] = 0;
 
         for (unsigned int i = 0; i < static_cast<unsigned int>(ShaderType::Count); i++)
         {
@@ -1,13 +1,16 @@
-uniform sampler2D texture;
+#version 140
+uniform sampler2D diffuseTexture;
 
-varying vec2 uv;
-varying vec3 modelNormal;
+in vec2 uv;
+in vec3 modelNormal;
+// bound to the first draw buffer before linking
+out vec4 fragColor;
 
 void main()
 {
     // lookup the pixel in the texture
-    vec4 pixel = texture2D(texture, uv);
+    vec4 pixel = texture(diffuseTexture, uv);
 
     // multiply it by the color
-    gl_FragColor = vec4(modelNormal,1);//gl_Color * pixel;
+    fragColor = vec4(modelNormal,1);//gl_Color * pixel;
 }
\ No newline at end of file
@@ -1,13 +1,80 @@
-attribute vec3 position;
-attribute vec2 texCoord;
-attribute vec3 normal;
+#version 140
+in vec3 position;
+in vec2 texCoord;
+in vec3 normal;
 uniform mat4 pvm;
+// quantized meshes store positions relative to their bounds and octahedral encoded normals
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+uniform bool octahedralNormals;
+// skinned meshes blend up to four bones per vertex, read from a palette shared by all meshes of the frame
+in vec4 boneIndices;
+in vec4 boneWeights;
+uniform bool skinned;
+// three texels per bone, the rows of its affine transform
+uniform samplerBuffer bonePalette;
+uniform int firstBone;
+// morphed meshes add the deltas of their targets before skinning, grouped by vertex so each vertex only
+// visits the targets moving it: its deltas go from morphStarts[gl_VertexID] to morphStarts[gl_VertexID + 1]
+uniform bool morphed;
+uniform usamplerBuffer morphStarts;
+// two texels per delta, the target and the snorm16 position then the snorm16 normal
+uniform isamplerBuffer morphDeltas;
+// one per target starting at firstMorphWeight, shared by all meshes of the frame
+uniform samplerBuffer morphWeights;
+uniform int firstMorphWeight;
+// what a snorm16 unit stands for
+uniform float morphPositionScale;
+uniform float morphNormalScale;
 
-varying vec2 uv;
-varying vec3 modelNormal;
+out vec2 uv;
+out vec3 modelNormal;
+
+vec3 decodeOctahedral(vec2 e) {
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float fold = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -fold : fold;
+	n.y += n.y >= 0.0 ? -fold : fold;
+	return normalize(n);
+}
+
+void addBone(inout mat3x4 rows, float index, float weight) {
+	int texel = (firstBone + int(index)) * 3;
+	rows[0] += weight * texelFetch(bonePalette, texel);
+	rows[1] += weight * texelFetch(bonePalette, texel + 1);
+	rows[2] += weight * texelFetch(bonePalette, texel + 2);
+}
 
 void main() {
-	gl_Position = pvm * vec4(position, 1.0);
+	vec4 modelPosition = vec4(positionOffset + positionScale * position, 1.0);
+	vec3 vertexNormal = octahedralNormals ? decodeOctahedral(normal.xy) : normal;
+	if (morphed) {
+		int end = int(texelFetch(morphStarts, gl_VertexID + 1).x);
+		vec3 positionDelta = vec3(0.0);
+		vec3 normalDelta = vec3(0.0);
+		for (int delta = int(texelFetch(morphStarts, gl_VertexID).x); delta < end; ++delta) {
+			ivec4 targetPosition = texelFetch(morphDeltas, delta * 2);
+			// the target index is unsigned, the texel reads it sign extended
+			float weight = texelFetch(morphWeights, firstMorphWeight + (targetPosition.x & 0xFFFF)).x;
+			if (weight == 0.0) continue;
+			positionDelta += weight * vec3(targetPosition.yzw);
+			normalDelta += weight * vec3(texelFetch(morphDeltas, delta * 2 + 1).xyz);
+		}
+		modelPosition.xyz += morphPositionScale * positionDelta;
+		vertexNormal = normalize(vertexNormal + morphNormalScale * normalDelta);
+	}
+	if (skinned) {
+		// the weight the bones don't take keeps the vertex where it was bound
+		float rest = 1.0 - dot(boneWeights, vec4(1.0));
+		mat3x4 rows = mat3x4(vec4(rest, 0.0, 0.0, 0.0), vec4(0.0, rest, 0.0, 0.0), vec4(0.0, 0.0, rest, 0.0));
+		addBone(rows, boneIndices.x, boneWeights.x);
+		addBone(rows, boneIndices.y, boneWeights.y);
+		addBone(rows, boneIndices.z, boneWeights.z);
+		addBone(rows, boneIndices.w, boneWeights.w);
+		modelPosition = vec4(modelPosition * rows, 1.0);
+		vertexNormal = normalize(vec4(vertexNormal, 0.0) * rows);
+	}
+	gl_Position = pvm * modelPosition;
 	uv = texCoord;
-	modelNormal = normal;
+	modelNormal = vertexNormal;
 }
\ No newline at end of file